@@ -16,6 +16,7 @@
  */
 #include "events/EventQueue.h"
 #include "events/mbed_events.h"
+#include "mbed_config.h"
 
 using mbed::Callback;
 
@@ -24,6 +25,7 @@ namespace events {
 EventQueue::EventQueue(unsigned event_size, unsigned char *event_pointer)
 {
     if (!event_pointer) {
+        MBED_ASSERT(!MBED_CONF_EVENTS_STATIC_MEMORY && "EventQueue: no buffer given");
         equeue_create(&_equeue, event_size);
     } else {
         equeue_create_inplace(&_equeue, event_size, event_pointer);
@@ -62,12 +64,13 @@ int EventQueue::time_left(int id)
 
 void EventQueue::background(Callback<void(int)> update)
 {
+    // the previous update is told it is dropped, it must still be there
+    equeue_background(&_equeue, 0, 0);
+
     _update = update;
 
     if (_update) {
         equeue_background(&_equeue, &Callback<void(int)>::thunk, &_update);
-    } else {
-        equeue_background(&_equeue, 0, 0);
     }
 }
 
@@ -55,6 +55,7 @@ public:
      *
      *  Create an event queue. The event queue either allocates a buffer of
      *  the specified size with malloc or uses the user provided buffer.
+     *  With MBED_CONF_EVENTS_STATIC_MEMORY, the buffer must be provided.
      *
      *  @param size     Size of buffer to use for events in bytes
      *                  (default to EVENTS_QUEUE_SIZE)
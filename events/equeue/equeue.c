@@ -16,10 +16,9 @@
  * limitations under the License.
  */
 #include "equeue.h"
+#include "mbed_config.h"
 #include "platform/mbed_critical.h"
-#include  <kernel/include/os.h>
-#include  <kernel/include/os_trace.h>
-#include  <common/include/rtos_utils.h>
+#include "platform/profile.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -53,6 +52,12 @@ static inline void equeue_incid(equeue_t *q, struct equeue_event *e)
 // equeue lifetime management
 int equeue_create(equeue_t *q, size_t size)
 {
+#if MBED_CONF_EVENTS_STATIC_MEMORY
+    // no heap, the buffer must be given to equeue_create_inplace
+    (void) q;
+    (void) size;
+    return -1;
+#else
     // dynamically allocate the specified buffer
     void *buffer = malloc(size);
     if (!buffer) {
@@ -62,6 +67,7 @@ int equeue_create(equeue_t *q, size_t size)
     int err = equeue_create_inplace(q, size, buffer);
     q->allocated = buffer;
     return err;
+#endif
 }
 
 int equeue_create_inplace(equeue_t *q, size_t size, void *buffer)
@@ -92,12 +98,13 @@ int equeue_create_inplace(equeue_t *q, size_t size, void *buffer)
     q->background.update = 0;
     q->background.timer = 0;
 
-    RTOS_ERR  error;
     // initialize platform resources
-    OSSemCreate(&q->eventsema, "Enqueue Semaphore", 0, &error);
-    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
-
     int err;
+    err = equeue_sema_create(&q->eventsema);
+    if (err < 0) {
+        return err;
+    }
+
     err = equeue_mutex_create(&q->queuelock);
     if (err < 0) {
         return err;
@@ -132,12 +139,11 @@ void equeue_destroy(equeue_t *q)
     // clean up platform resources + memory
     equeue_mutex_destroy(&q->memlock);
     equeue_mutex_destroy(&q->queuelock);
+    equeue_sema_destroy(&q->eventsema);
 
-    RTOS_ERR  error;
-    OSSemDel(&q->eventsema, 0, &error);
-    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
-
+#if !MBED_CONF_EVENTS_STATIC_MEMORY
     free(q->allocated);
+#endif
 }
 
 
@@ -376,11 +382,7 @@ int equeue_post(equeue_t *q, void (*cb)(void *), void *p)
     e->target = tick + e->target;
 
     int id = equeue_enqueue(q, e, tick);
-
-    RTOS_ERR  error;
-    OSSemPost(&q->eventsema, OS_OPT_POST_ALL, &error);
-    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
-
+    equeue_sema_signal(&q->eventsema);
     return id;
 }
 
@@ -422,9 +424,7 @@ void equeue_break(equeue_t *q)
     q->break_requested = true;
     equeue_mutex_unlock(&q->queuelock);
 
-    RTOS_ERR  error;
-    OSSemPost(&q->eventsema, OS_OPT_POST_1, &error);
-    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
+    equeue_sema_signal(&q->eventsema);
 }
 
 void equeue_dispatch(equeue_t *q, int ms)
@@ -445,7 +445,9 @@ void equeue_dispatch(equeue_t *q, int ms)
             // actually dispatch the callbacks
             void (*cb)(void *) = e->cb;
             if (cb) {
+                PROFILE_BEGIN(PROFILE_EQUEUE_DISPATCH);
                 cb(e + 1);
+                PROFILE_END(PROFILE_EQUEUE_DISPATCH);
             }
 
             // reenqueue periodic events or deallocate
@@ -490,17 +492,8 @@ void equeue_dispatch(equeue_t *q, int ms)
         }
         equeue_mutex_unlock(&q->queuelock);
 
-		OS_TICK ticks;
-		if(deadline > 0) {
-			ticks = (((deadline * OSCfg_TickRate_Hz)  + 1000u - 1u) / 1000u);
-		}
-		else {
-			ticks = 0;
-		}
         // wait for events
-		RTOS_ERR  error;
-        CPU_TS ts;
-        OSSemPend(&q->eventsema, ticks, OS_OPT_PEND_BLOCKING, &ts, &error);
+        equeue_sema_wait(&q->eventsema, deadline);
 
         // check if we were notified to break out of dispatch
         if (q->break_requested) {
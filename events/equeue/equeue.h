@@ -27,7 +27,6 @@ extern "C" {
 
 // Platform specific files
 #include "equeue_platform.h"
-#include  <kernel/include/os.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -77,9 +76,9 @@ typedef struct equeue {
         void *timer;
     } background;
 
-    OS_SEM eventsema;
-    OS_MUTEX queuelock;
-    OS_MUTEX memlock;
+    equeue_sema_t eventsema;
+    equeue_mutex_t queuelock;
+    equeue_mutex_t memlock;
 } equeue_t;
 
 
@@ -17,8 +17,8 @@
  * limitations under the License.
  */
 #include "equeue_platform.h"
-#include "em_core.h"
 #if defined(EQUEUE_PLATFORM_MBED)
+#include "em_core.h"
 #include  <kernel/include/os.h>
 #include <stdbool.h>
 #include <string.h>
@@ -38,19 +38,19 @@ unsigned equeue_tick()
 }
 
 // Mutex operations
-int equeue_mutex_create(OS_MUTEX *m)
+int equeue_mutex_create(equeue_mutex_t *m)
 {
 	RTOS_ERR  error;
 	OSMutexCreate(m, "Enqueue Mutex", &error);
 	return 0;
 }
-void equeue_mutex_destroy(OS_MUTEX *m)
+void equeue_mutex_destroy(equeue_mutex_t *m)
 {
 	RTOS_ERR  error;
 	OSMutexDel(m,OS_OPT_DEL_ALWAYS,&error);
 }
 
-void equeue_mutex_lock(OS_MUTEX *m)
+void equeue_mutex_lock(equeue_mutex_t *m)
 {
 //	core_util_critical_section_enter();
     RTOS_ERR  error;
@@ -58,7 +58,7 @@ void equeue_mutex_lock(OS_MUTEX *m)
     OSMutexPend(m,0, OS_OPT_PEND_BLOCKING, &ts, &error);
 }
 
-void equeue_mutex_unlock(OS_MUTEX *m)
+void equeue_mutex_unlock(equeue_mutex_t *m)
 {
 //	core_util_critical_section_exit();
     RTOS_ERR  error;
@@ -66,6 +66,48 @@ void equeue_mutex_unlock(OS_MUTEX *m)
     OSMutexPost(m, OS_OPT_POST_NONE, &error);
 }
 
+// Semaphore operations
+int equeue_sema_create(equeue_sema_t *s)
+{
+    RTOS_ERR  error;
+    OSSemCreate(s, "Enqueue Semaphore", 0, &error);
+    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
+    return 0;
+}
+
+void equeue_sema_destroy(equeue_sema_t *s)
+{
+    RTOS_ERR  error;
+    OSSemDel(s, 0, &error);
+    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
+}
+
+void equeue_sema_signal(equeue_sema_t *s)
+{
+    RTOS_ERR  error;
+    OSSemPost(s, OS_OPT_POST_ALL, &error);
+    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE), 1);
+}
+
+bool equeue_sema_wait(equeue_sema_t *s, int ms)
+{
+    RTOS_ERR  error;
+    CPU_TS ts;
+
+    // a timeout of 0 ticks waits forever
+    if (ms == 0) {
+        OSSemPend(s, 0, OS_OPT_PEND_NON_BLOCKING, &ts, &error);
+    } else {
+        OS_TICK ticks = 0;
+        if (ms > 0) {
+            ticks = ((ms * OSCfg_TickRate_Hz) + 1000u - 1u) / 1000u;
+        }
+        OSSemPend(s, ticks, OS_OPT_PEND_BLOCKING, &ts, &error);
+    }
+
+    return RTOS_ERR_CODE_GET(error) == RTOS_ERR_NONE;
+}
+
 #endif
 
 
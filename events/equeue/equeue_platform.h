@@ -26,17 +26,22 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
-#include  <kernel/include/os.h>
 
 // Currently supported platforms
 //
 // Uncomment to select a supported platform or reimplement this file
-// for a specific target.
+// for a specific target. The target runs on Micrium OS; the host builds
+// select EQUEUE_PLATFORM_POSIX or EQUEUE_PLATFORM_SIM on the command line.
 //#define EQUEUE_PLATFORM_POSIX
+//#define EQUEUE_PLATFORM_SIM
+#if !defined(EQUEUE_PLATFORM_POSIX)     \
+ && !defined(EQUEUE_PLATFORM_SIM)
 #define EQUEUE_PLATFORM_MBED
+#endif
 
 // Try to infer a platform if none was manually selected
 #if !defined(EQUEUE_PLATFORM_POSIX)     \
+ && !defined(EQUEUE_PLATFORM_SIM)       \
  && !defined(EQUEUE_PLATFORM_MBED)
 #if defined(__unix__)
 #define EQUEUE_PLATFORM_POSIX
@@ -50,9 +55,8 @@ extern "C" {
 // Platform includes
 #if defined(EQUEUE_PLATFORM_POSIX)
 #include <pthread.h>
-#elif defined(EQUEUE_PLATFORM_MBED) && defined(MBED_CONF_RTOS_PRESENT)
-//#include "cmsis_os2.h"
-//#include "mbed_rtos_storage.h"
+#elif defined(EQUEUE_PLATFORM_MBED)
+#include  <kernel/include/os.h>
 #endif
 
 
@@ -79,6 +83,8 @@ typedef pthread_mutex_t equeue_mutex_t;
 #elif defined(EQUEUE_PLATFORM_WINDOWS)
 typedef CRITICAL_SECTION equeue_mutex_t;
 #elif defined(EQUEUE_PLATFORM_MBED)
+typedef OS_MUTEX equeue_mutex_t;
+#elif defined(EQUEUE_PLATFORM_SIM)
 typedef unsigned equeue_mutex_t;
 #elif defined(EQUEUE_PLATFORM_FREERTOS)
 typedef UBaseType_t equeue_mutex_t;
@@ -92,10 +98,10 @@ typedef UBaseType_t equeue_mutex_t;
 //
 // The equeue_mutex_lock and equeue_mutex_unlock lock and unlock the
 // underlying mutex.
-int equeue_mutex_create(OS_MUTEX *mutex);
-void equeue_mutex_destroy(OS_MUTEX *mutex);
-void equeue_mutex_lock(OS_MUTEX *mutex);
-void equeue_mutex_unlock(OS_MUTEX *mutex);
+int equeue_mutex_create(equeue_mutex_t *mutex);
+void equeue_mutex_destroy(equeue_mutex_t *mutex);
+void equeue_mutex_lock(equeue_mutex_t *mutex);
+void equeue_mutex_unlock(equeue_mutex_t *mutex);
 
 
 // Platform semaphore type
@@ -109,20 +115,17 @@ void equeue_mutex_unlock(OS_MUTEX *mutex);
 // A counting semaphore will also work, however may cause the event queue
 // dispatch loop to run unnecessarily. For that matter, equeue_signal_wait
 // may even be implemented as a single return statement.
-//#if defined(EQUEUE_PLATFORM_POSIX)
-//typedef struct equeue_sema {
-//    pthread_mutex_t mutex;
-//    pthread_cond_t cond;
-//    bool signal;
-//} equeue_sema_t;
-//#elif defined(EQUEUE_PLATFORM_MBED) && defined(MBED_CONF_RTOS_PRESENT)
-//typedef struct equeue_sema {
-//    osEventFlagsId_t id;
-//    mbed_rtos_storage_event_flags_t mem;
-//} equeue_sema_t;
-//#elif defined(EQUEUE_PLATFORM_MBED)
-//typedef volatile int equeue_sema_t;
-//#endif
+#if defined(EQUEUE_PLATFORM_POSIX)
+typedef struct equeue_sema {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool signal;
+} equeue_sema_t;
+#elif defined(EQUEUE_PLATFORM_MBED)
+typedef OS_SEM equeue_sema_t;
+#elif defined(EQUEUE_PLATFORM_SIM)
+typedef volatile int equeue_sema_t;
+#endif
 
 // Platform semaphore operations
 //
@@ -138,11 +141,20 @@ void equeue_mutex_unlock(OS_MUTEX *mutex);
 // equeue_sema_wait. The equeue_sema_wait returns true if it detected that
 // equeue_sema_signal had been called. If ms is negative, equeue_sema_wait
 // will wait for a signal indefinitely.
-/*int equeue_sema_create(equeue_sema_t *sema);
+int equeue_sema_create(equeue_sema_t *sema);
 void equeue_sema_destroy(equeue_sema_t *sema);
 void equeue_sema_signal(equeue_sema_t *sema);
 bool equeue_sema_wait(equeue_sema_t *sema, int ms);
-*/
+
+#if defined(EQUEUE_PLATFORM_SIM)
+// Virtual clock
+//
+// The simulation platform never waits: equeue_sema_wait returns at once and
+// the tick only moves when the simulation advances it, usually to the next
+// event of the queues being simulated. The tick is per thread.
+void equeue_sim_advance(unsigned ms);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,86 @@
+/*
+ * Implementation for host simulations on a virtual clock
+ *
+ * Copyright (c) 2016 Christopher Haster
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "equeue_platform.h"
+
+#if defined(EQUEUE_PLATFORM_SIM)
+
+// Time only moves when the simulation tells it to, so a queue dispatched
+// with a timeout of 0 runs what is due and returns. Each thread has a clock
+// of its own and the queues of a thread are only used from that thread.
+static __thread unsigned equeue_sim_tick = 0;
+
+
+// Tick operations
+unsigned equeue_tick(void)
+{
+    return equeue_sim_tick;
+}
+
+void equeue_sim_advance(unsigned ms)
+{
+    equeue_sim_tick += ms;
+}
+
+
+// Mutex operations
+int equeue_mutex_create(equeue_mutex_t *m)
+{
+    *m = 0;
+    return 0;
+}
+
+void equeue_mutex_destroy(equeue_mutex_t *m)
+{
+}
+
+void equeue_mutex_lock(equeue_mutex_t *m)
+{
+    *m += 1;
+}
+
+void equeue_mutex_unlock(equeue_mutex_t *m)
+{
+    *m -= 1;
+}
+
+
+// Semaphore operations
+int equeue_sema_create(equeue_sema_t *s)
+{
+    *s = false;
+    return 0;
+}
+
+void equeue_sema_destroy(equeue_sema_t *s)
+{
+}
+
+void equeue_sema_signal(equeue_sema_t *s)
+{
+    *s = 1;
+}
+
+bool equeue_sema_wait(equeue_sema_t *s, int ms)
+{
+    // nothing else can run, waiting would never end
+    bool signal = *s;
+    *s = 0;
+    return signal;
+}
+
+#endif
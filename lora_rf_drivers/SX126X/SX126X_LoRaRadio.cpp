@@ -24,7 +24,9 @@ SPDX-License-Identifier: BSD-3-Clause
 
 #include <math.h>
 #include "SX126X_LoRaRadio.h"
+#include "mbed_config.h"
 #include "gpiointerrupt.h"
+#include "platform/profile.h"
 #include <stdio.h>
 
 
@@ -39,6 +41,7 @@ extern uint32_t readmsTicks(void);
 
 using namespace mbed;
 
+#if MBED_CONF_LORA_FSK
 /*!
  * FSK bandwidth definition
  */
@@ -75,6 +78,7 @@ static const fsk_bw_t fsk_bandwidths[] =
 };
 
 const uint8_t sync_word[] = {0xC1, 0x94, 0xC1, 0x00, 0x00, 0x00, 0x00,0x00};
+#endif
 
 // in ms                                 SF12    SF11    SF10    SF9    SF8    SF7
 const float lora_symbol_time[3][6] = {{ 32.768, 16.384, 8.192, 4.096, 2.048, 1.024 },  // 125 KHz
@@ -224,6 +228,8 @@ void SX126X_LoRaRadio::set_tx_continuous_wave(uint32_t freq, int8_t power,
 
 void SX126X_LoRaRadio::handle_dio1_irq()
 {
+    PROFILE_ZONE(PROFILE_HANDLE_DIO1_IRQ);
+
     uint16_t irq_status = get_irq_status();
     clear_irq_status(IRQ_RADIO_ALL);
 
@@ -249,7 +255,7 @@ void SX126X_LoRaRadio::handle_dio1_irq()
                 get_rx_buffer_status(&payload_len, &offset);
                 read_fifo(_data_buffer, payload_len, offset);
                 get_packet_status(&pkt_status);
-                if (pkt_status.modem_type == MODEM_FSK) {
+                if (MBED_CONF_LORA_FSK && pkt_status.modem_type == MODEM_FSK) {
                     rssi = pkt_status.params.gfsk.rssi_sync;
                 } else {
                     rssi = pkt_status.params.lora.rssi_pkt;
@@ -439,6 +445,7 @@ uint32_t SX126X_LoRaRadio::time_on_air(radio_modems_t modem, uint8_t pkt_len)
     uint32_t air_time = 0;
 
     switch (modem) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK: {
             air_time = rint((8 * (_packet_params.params.gfsk.preamble_length
                             + (_packet_params.params.gfsk.syncword_length >> 3)
@@ -448,6 +455,7 @@ uint32_t SX126X_LoRaRadio::time_on_air(radio_modems_t modem, uint8_t pkt_len)
                             / _mod_params.params.gfsk.bit_rate) * 1000);
         }
             break;
+#endif
         case MODEM_LORA: {
             float ts = lora_symbol_time[_mod_params.params.lora.bandwidth - 4][12
                             - _mod_params.params.lora.spreading_factor];
@@ -689,6 +697,7 @@ uint8_t SX126X_LoRaRadio::get_frequency_support(void)
     }
 }
 
+#if MBED_CONF_LORA_FSK
 uint8_t SX126X_LoRaRadio::get_fsk_bw_reg_val(uint32_t bandwidth)
 {
     uint8_t i;
@@ -703,6 +712,7 @@ uint8_t SX126X_LoRaRadio::get_fsk_bw_reg_val(uint32_t bandwidth)
     // This should never happen
     while (1);
 }
+#endif
 
 void SX126X_LoRaRadio::set_max_payload_length(radio_modems_t modem, uint8_t max)
 {
@@ -730,6 +740,7 @@ void SX126X_LoRaRadio::set_tx_config(radio_modems_t modem,
 
     uint8_t modem_type = (uint8_t) modem;
     switch (modem_type) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK:
             _mod_params.modem_type = MODEM_FSK;
             _mod_params.params.gfsk.bit_rate = datarate;
@@ -759,6 +770,7 @@ void SX126X_LoRaRadio::set_tx_config(radio_modems_t modem,
             write_to_register(REG_LR_SYNCWORDBASEADDRESS, (uint8_t *) sync_word, 8);
             set_whitening_seed(0x01FF);
             break;
+#endif
 
         case MODEM_LORA:
             _mod_params.modem_type = MODEM_LORA;
@@ -833,6 +845,7 @@ void SX126X_LoRaRadio::set_rx_config(radio_modems_t modem,
     uint8_t modem_type = (uint8_t) modem;
 
     switch (modem_type) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK: {
             _mod_params.modem_type = MODEM_FSK;
             _mod_params.params.gfsk.bit_rate = datarate;
@@ -869,6 +882,7 @@ void SX126X_LoRaRadio::set_rx_config(radio_modems_t modem,
 
             break;
         }
+#endif
 
         case MODEM_LORA: {
             _rx_timeout_in_symbols = symb_timeout;
@@ -1064,6 +1078,7 @@ void SX126X_LoRaRadio::set_modulation_params(modulation_params_t *params)
     }
 
     switch (params->modem_type) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK:
             n = 8;
             temp = (uint32_t) (32 * ((float) XTAL_FREQ / (float) params->params.gfsk.bit_rate));
@@ -1078,6 +1093,7 @@ void SX126X_LoRaRadio::set_modulation_params(modulation_params_t *params)
             buf[7] = (temp & 0xFF);
             write_opmode_command(RADIO_SET_MODULATIONPARAMS, buf, n);
             break;
+#endif
 
         case MODEM_LORA:
             n = 4;
@@ -1108,7 +1124,7 @@ void SX126X_LoRaRadio::set_pa_config(uint8_t pa_DC, uint8_t hp_max,
 
 void SX126X_LoRaRadio::set_crc_seed(uint16_t seed)
 {
-    if (_active_modem == MODEM_FSK) {
+    if (MBED_CONF_LORA_FSK && _active_modem == MODEM_FSK) {
         uint8_t buf[2];
         buf[0] = (uint8_t) ((seed >> 8) & 0xFF);
         buf[1] = (uint8_t) (seed & 0xFF);
@@ -1118,7 +1134,7 @@ void SX126X_LoRaRadio::set_crc_seed(uint16_t seed)
 
 void SX126X_LoRaRadio::set_crc_polynomial(uint16_t polynomial)
 {
-    if (_active_modem == MODEM_FSK) {
+    if (MBED_CONF_LORA_FSK && _active_modem == MODEM_FSK) {
         uint8_t buf[2];
         buf[0] = (uint8_t) ((polynomial >> 8) & 0xFF);
         buf[1] = (uint8_t) (polynomial & 0xFF);
@@ -1128,7 +1144,7 @@ void SX126X_LoRaRadio::set_crc_polynomial(uint16_t polynomial)
 
 void SX126X_LoRaRadio::set_whitening_seed(uint16_t seed)
 {
-    if (_active_modem == MODEM_FSK) {
+    if (MBED_CONF_LORA_FSK && _active_modem == MODEM_FSK) {
         uint8_t reg_value = read_register(REG_LR_WHITSEEDBASEADDR_MSB) & 0xFE;
         reg_value = ((seed >> 8) & 0x01) | reg_value;
         write_to_register(REG_LR_WHITSEEDBASEADDR_MSB, reg_value); // only 1 bit.
@@ -1149,6 +1165,7 @@ void SX126X_LoRaRadio::set_packet_params(packet_params_t *packet_params)
     }
 
     switch (packet_params->modem_type) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK:
             if (packet_params->params.gfsk.crc_length == RADIO_CRC_2_BYTES_IBM) {
                 set_crc_seed(CRC_IBM_SEED);
@@ -1172,6 +1189,7 @@ void SX126X_LoRaRadio::set_packet_params(packet_params_t *packet_params)
             buf[7] = crc_val;
             buf[8] = packet_params->params.gfsk.whitening_mode;
             break;
+#endif
 
         case MODEM_LORA:
             n = 6;
@@ -1262,12 +1280,14 @@ void SX126X_LoRaRadio::get_packet_status(packet_status_t *pkt_status)
 
     pkt_status->modem_type = (radio_modems_t) get_modem();
     switch (pkt_status->modem_type) {
+#if MBED_CONF_LORA_FSK
         case MODEM_FSK:
             pkt_status->params.gfsk.rx_status = status[0];
             pkt_status->params.gfsk.rssi_sync = -status[1] >> 1;
             pkt_status->params.gfsk.rssi_avg = -status[2] >> 1;
             pkt_status->params.gfsk.freq_error = 0;
             break;
+#endif
 
         case MODEM_LORA:
             pkt_status->params.lora.rssi_pkt = -status[0] >> 1;
@@ -19,30 +19,77 @@
  * limitations under the License.
  */
 
+#include <new>
 #include "LoRaWANInterface.h"
-#include "lorastack/phy/loraphy_target.h"
 #include "trace.h"
 
 using namespace mbed;
 using namespace events;
 
+#if MBED_CONF_LORA_MULTI_REGION
+/**
+ * Constructs the PHY object of a region in the given storage
+ */
+static LoRaPHY *construct_phy(lorawan_region_t region, loraphy_region_storage_t *storage)
+{
+    switch (region) {
+        case LORAWAN_REGION_EU868:
+            return new (storage) LoRaPHYEU868;
+        case LORAWAN_REGION_AS923:
+            return new (storage) LoRaPHYAS923;
+        case LORAWAN_REGION_AU915:
+            return new (storage) LoRaPHYAU915;
+        case LORAWAN_REGION_CN470:
+            return new (storage) LoRaPHYCN470;
+        case LORAWAN_REGION_CN779:
+            return new (storage) LoRaPHYCN779;
+        case LORAWAN_REGION_EU433:
+            return new (storage) LoRaPHYEU433;
+        case LORAWAN_REGION_IN865:
+            return new (storage) LoRaPHYIN865;
+        case LORAWAN_REGION_KR920:
+            return new (storage) LoRaPHYKR920;
+        case LORAWAN_REGION_US915:
+            return new (storage) LoRaPHYUS915;
+        default:
+            return NULL;
+    }
+}
+#endif
+
 LoRaWANInterface::LoRaWANInterface(LoRaRadio &radio)
     : _default_phy(NULL)
 {
+#if MBED_CONF_LORA_MULTI_REGION
+    _radio = &radio;
+    _default_phy = construct_phy((lorawan_region_t) LORA_REGION, &_default_phy_storage);
+#elif MBED_CONF_LORA_STATIC_MEMORY
+    _default_phy = new (_default_phy_storage.bytes) LoRaPHY_region;
+#else
     _default_phy = new LoRaPHY_region;
+#endif
     MBED_ASSERT(_default_phy);
     _lw_stack.bind_phy_and_radio_driver(radio, *_default_phy);
 }
 
-LoRaWANInterface::LoRaWANInterface(LoRaRadio &radio, LoRaPHY &phy)
+LoRaWANInterface::LoRaWANInterface(LoRaRadio &radio, LoRaPHY_target &phy)
     : _default_phy(NULL)
 {
+#if MBED_CONF_LORA_MULTI_REGION
+    _radio = &radio;
+#endif
     _lw_stack.bind_phy_and_radio_driver(radio, phy);
 }
 
 LoRaWANInterface::~LoRaWANInterface()
 {
+#if MBED_CONF_LORA_MULTI_REGION || MBED_CONF_LORA_STATIC_MEMORY
+    if (_default_phy) {
+        _default_phy->~LoRaPHY_target();
+    }
+#else
     delete _default_phy;
+#endif
     _default_phy = NULL;
 }
 
@@ -52,6 +99,38 @@ lorawan_status_t LoRaWANInterface::initialize(EventQueue *queue)
     return _lw_stack.initialize_mac_layer(queue);
 }
 
+lorawan_status_t LoRaWANInterface::set_region(lorawan_region_t region)
+{
+    Lock lock(*this);
+
+#if MBED_CONF_LORA_MULTI_REGION
+    if (!_default_phy) {
+        return LORAWAN_STATUS_UNSUPPORTED;
+    }
+
+    if (region < LORAWAN_REGION_EU868 || region > LORAWAN_REGION_US915) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    if (region == _default_phy->get_region()) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    lorawan_status_t status = _lw_stack.check_phy_replaceable();
+    if (status != LORAWAN_STATUS_OK) {
+        return status;
+    }
+
+    _default_phy->~LoRaPHY_target();
+    _default_phy = construct_phy(region, &_default_phy_storage);
+    _lw_stack.bind_phy_and_radio_driver(*_radio, *_default_phy);
+
+    return LORAWAN_STATUS_OK;
+#else
+    return region == (lorawan_region_t) LORA_REGION ? LORAWAN_STATUS_OK : LORAWAN_STATUS_UNSUPPORTED;
+#endif
+}
+
 lorawan_status_t LoRaWANInterface::connect()
 {
     Lock lock(*this);
@@ -70,6 +149,37 @@ lorawan_status_t LoRaWANInterface::disconnect()
     return _lw_stack.shutdown();
 }
 
+lorawan_status_t LoRaWANInterface::set_session_storage(LoRaWANStorage *storage)
+{
+    Lock lock(*this);
+    return _lw_stack.set_session_storage(storage);
+}
+
+lorawan_status_t LoRaWANInterface::save_session()
+{
+    Lock lock(*this);
+    return _lw_stack.save_session();
+}
+
+lorawan_status_t LoRaWANInterface::forget_session()
+{
+    Lock lock(*this);
+    return _lw_stack.forget_session();
+}
+
+lorawan_status_t LoRaWANInterface::set_frag_session_storage(LoRaWANStorage *storage,
+                                                            uint32_t addr, uint32_t size)
+{
+    Lock lock(*this);
+    return _lw_stack.set_frag_session_storage(storage, addr, size);
+}
+
+lorawan_status_t LoRaWANInterface::get_frag_session_status(lorawan_frag_status_t &status)
+{
+    Lock lock(*this);
+    return _lw_stack.get_frag_session_status(status);
+}
+
 lorawan_status_t LoRaWANInterface::add_link_check_request()
 {
     Lock lock(*this);
@@ -82,6 +192,24 @@ void LoRaWANInterface::remove_link_check_request()
     _lw_stack.remove_link_check_request();
 }
 
+lorawan_status_t LoRaWANInterface::add_device_time_request()
+{
+    Lock lock(*this);
+    return _lw_stack.set_device_time_request();
+}
+
+lorawan_status_t LoRaWANInterface::get_gps_time(uint32_t &seconds, uint16_t &ms)
+{
+    Lock lock(*this);
+    return _lw_stack.get_gps_time(seconds, ms);
+}
+
+lorawan_status_t LoRaWANInterface::get_clock_drift(int32_t &ppm)
+{
+    Lock lock(*this);
+    return _lw_stack.get_clock_drift(ppm);
+}
+
 lorawan_status_t LoRaWANInterface::set_datarate(uint8_t data_rate)
 {
     Lock lock(*this);
@@ -124,6 +252,25 @@ lorawan_status_t LoRaWANInterface::remove_channel(uint8_t id)
     return _lw_stack.remove_a_channel(id);
 }
 
+lorawan_status_t LoRaWANInterface::add_multicast_group(const multicast_params_t &group)
+{
+    Lock lock(*this);
+    return _lw_stack.add_multicast_group(group);
+}
+
+lorawan_status_t LoRaWANInterface::remove_multicast_group(uint32_t address)
+{
+    Lock lock(*this);
+    return _lw_stack.remove_multicast_group(address);
+}
+
+lorawan_status_t LoRaWANInterface::get_multicast_group_status(uint32_t address,
+                                                              lorawan_multicast_status_t &status)
+{
+    Lock lock(*this);
+    return _lw_stack.get_multicast_group_status(address, status);
+}
+
 lorawan_status_t LoRaWANInterface::remove_channel_plan()
 {
     Lock lock(*this);
@@ -136,6 +283,38 @@ int16_t LoRaWANInterface::send(uint8_t port, const uint8_t *data, uint16_t lengt
     return _lw_stack.handle_tx(port, data, length, flags);
 }
 
+int16_t LoRaWANInterface::queue_send(uint8_t port, const uint8_t *data, uint16_t length,
+                                     int flags, uint8_t priority, uint32_t expiry)
+{
+    Lock lock(*this);
+    return _lw_stack.queue_tx(port, data, length, flags, priority, expiry);
+}
+
+lorawan_status_t LoRaWANInterface::enable_aggregation(uint8_t port, int flags,
+                                                      uint32_t window, uint16_t size)
+{
+    Lock lock(*this);
+    return _lw_stack.enable_aggregation(port, flags, window, size);
+}
+
+lorawan_status_t LoRaWANInterface::disable_aggregation(void)
+{
+    Lock lock(*this);
+    return _lw_stack.disable_aggregation();
+}
+
+lorawan_status_t LoRaWANInterface::add_record(uint8_t tag, const uint8_t *data, uint8_t length)
+{
+    Lock lock(*this);
+    return _lw_stack.add_record(tag, data, length);
+}
+
+lorawan_status_t LoRaWANInterface::flush_records(void)
+{
+    Lock lock(*this);
+    return _lw_stack.flush_records();
+}
+
 lorawan_status_t LoRaWANInterface::cancel_sending(void)
 {
     Lock lock(*this);
@@ -172,6 +351,18 @@ int16_t LoRaWANInterface::receive(uint8_t *data, uint16_t length, uint8_t &port,
     return _lw_stack.handle_rx(data, length, port, flags, false);
 }
 
+lorawan_status_t LoRaWANInterface::release_rx_frame(const lorawan_rx_frame_t &frame)
+{
+    Lock lock(*this);
+    return _lw_stack.release_rx_frame(frame);
+}
+
+uint32_t LoRaWANInterface::get_rx_drop_count(void)
+{
+    Lock lock(*this);
+    return _lw_stack.get_rx_drop_count();
+}
+
 lorawan_status_t LoRaWANInterface::add_app_callbacks(lorawan_app_callbacks_t *callbacks)
 {
     Lock lock(*this);
@@ -183,3 +374,9 @@ lorawan_status_t LoRaWANInterface::set_device_class(const device_class_t device_
     Lock lock(*this);
     return _lw_stack.set_device_class(device_class);
 }
+
+lorawan_status_t LoRaWANInterface::get_class_b_status(lorawan_class_b_status_t &status)
+{
+    Lock lock(*this);
+    return _lw_stack.get_class_b_status(status);
+}
@@ -29,9 +29,7 @@
 #include "LoRaWANStack.h"
 #include "LoRaRadio.h"
 #include "lorawan_types.h"
-
-// Forward declaration of LoRaPHY class
-class LoRaPHY;
+#include "lorastack/phy/loraphy_target.h"
 
 /** LoRaWANInterface Class
  * A network interface for LoRaWAN
@@ -52,11 +50,14 @@ public:
     LoRaWANInterface(LoRaRadio &radio);
 
     /** Constructs a LoRaWANInterface using the user provided PHY object.
-
+     *
+     * With "lora.phy-static-dispatch", the PHY object must be of the region
+     * class "lora.phy" selects.
+     *
      * @param radio A reference to radio object
      * @param phy   A reference to PHY object
      */
-    LoRaWANInterface(LoRaRadio &radio, LoRaPHY &phy);
+    LoRaWANInterface(LoRaRadio &radio, LoRaPHY_target &phy);
 
     ~LoRaWANInterface();
 
@@ -71,6 +72,23 @@ public:
      */
     lorawan_status_t initialize(events::EventQueue *queue);
 
+    /** Switch to the regional parameters of another region.
+     *
+     * Only with "lora.multi-region", and the PHY object LoRaWANInterface
+     * created, which is replaced by that of the region in the same storage.
+     * The channels, channel plan and MAC parameters are reset to the defaults
+     * of the region. Call before connect(), or after disconnect().
+     *
+     * @param region        The region to switch to.
+     *
+     * @return              LORAWAN_STATUS_OK on success, a negative error code on failure:
+     *                      LORAWAN_STATUS_UNSUPPORTED if the region cannot be switched,
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if the region is unknown,
+     *                      LORAWAN_STATUS_BUSY if a connection is in progress,
+     *                      LORAWAN_STATUS_ALREADY_CONNECTED if connected.
+     */
+    lorawan_status_t set_region(lorawan_region_t region);
+
     /** Connect OTAA or ABP using the Mbed OS config system
      *
      * Connect by Over The Air Activation or Activation By Personalization.
@@ -167,6 +185,92 @@ public:
      */
     lorawan_status_t disconnect();
 
+    /** Sets the non-volatile storage for the session.
+     *
+     * Once an OTAA session is established, it is saved to 'storage', as it is
+     * on disconnect(). If the storage has at least two erase units beyond
+     * the session, they hold a frame counter journal. Uplink counters are
+     * reserved there in blocks of MBED_CONF_LORA_FCNT_JOURNAL_BLOCK, so a
+     * resumed or ABP session never reuses a frame counter, even after an
+     * unexpected reset.
+     *
+     * After a reset, connect() then restores the saved session and sends the
+     * CONNECTED event right away, without a Join Request. If there is no
+     * valid session in the storage, no journal, or the journal holds no
+     * counters for the DevAddr of the session, the device joins as usual.
+     *
+     * @param storage       Storage to use, NULL to stop persisting. Must outlive
+     *                      the interface.
+     *
+     * @return              LORAWAN_STATUS_OK on success, a negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize()
+     */
+    lorawan_status_t set_session_storage(LoRaWANStorage *storage);
+
+    /** Saves the current session.
+     *
+     * The session is saved automatically after joining and on disconnect().
+     * Save it explicitly before a power down which skips disconnect().
+     *
+     * @return              LORAWAN_STATUS_OK on success, a negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_NO_OP if no storage is set,
+     *                      LORAWAN_STATUS_NO_ACTIVE_SESSIONS if there is no session to save,
+     *                      LORAWAN_STATUS_STORAGE_ERROR if the storage failed
+     */
+    lorawan_status_t save_session();
+
+    /** Discards the saved session, so that the next connect() joins again.
+     *
+     * @return              LORAWAN_STATUS_OK on success, a negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_NO_OP if no storage is set,
+     *                      LORAWAN_STATUS_STORAGE_ERROR if the storage failed
+     */
+    lorawan_status_t forget_session();
+
+    /** Sets the storage receiving fragmented data blocks, e.g. firmware images.
+     *
+     * Enables the LoRaWAN Fragmented Data Block Transport on port
+     * MBED_CONF_LORA_FRAG_PORT. Frames on that port are then handled by the
+     * stack and not handed to the application. The network sets up a
+     * session for a block of fragments, usually sent to a multicast group,
+     * followed by coded fragments which let the device recover lost ones.
+     * The block is reassembled at the start of the area and the
+     * FRAG_SESSION_COMPLETE event is sent once it is whole.
+     *
+     * Fragments sent to a multicast group are taken if the session's
+     * McGroupBitMask has the McGroupID the group was added with.
+     *
+     * The area must hold the block plus a fragment per lost fragment as
+     * scratch space. It is erased from the event queue when a session is set
+     * up, and the network answered once it is. At most
+     * MBED_CONF_LORA_FRAG_MAX_REDUNDANCY lost fragments can be recovered.
+     *
+     * @param storage       Storage to use, NULL to disable the package. Must outlive
+     *                      the interface.
+     * @param addr          Start of the area, aligned to an erase unit.
+     * @param size          Size of the area.
+     *
+     * @return              LORAWAN_STATUS_OK on success, a negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if the area is misaligned or out of the storage
+     */
+    lorawan_status_t set_frag_session_storage(LoRaWANStorage *storage, uint32_t addr,
+                                              uint32_t size);
+
+    /** Get the fragmentation session status
+     *
+     * Tells where the block is, its size and descriptor, and how the
+     * reception is going.
+     *
+     * @param status        the inbound structure that will be filled with the status.
+     *
+     * @return              LORAWAN_STATUS_OK on success,
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize()
+     */
+    lorawan_status_t get_frag_session_status(lorawan_frag_status_t &status);
+
     /** Validate the connectivity with the network.
      *
      * Application may use this API to submit a request to the stack for validation of its connectivity
@@ -202,6 +306,51 @@ public:
      */
     void remove_link_check_request();
 
+    /** Add device time request.
+     *
+     * Schedules a DeviceTimeReq MAC command for the next transmission. Once the
+     * network answers with DeviceTimeAns, the stack keeps the GPS time and the
+     * DEVICE_TIME_SYNCED event is sent. The request is dropped with the answer,
+     * it is repeated on every transmission until then.
+     *
+     * Time references also let the stack measure the drift of the device clock,
+     * which narrows the Class B receive windows.
+     *
+     * @return          LORAWAN_STATUS_OK on successfully queuing a request, or
+     *                  LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized
+     *                  with initialize().
+     */
+    lorawan_status_t add_device_time_request();
+
+    /** Get GPS time
+     *
+     * The time is set by DeviceTimeAns, or by the beacon in Class B, and kept
+     * from the device clock in between.
+     *
+     * @param seconds   [out] Seconds since the GPS epoch.
+     * @param ms        [out] Milliseconds within the second.
+     *
+     * @return          LORAWAN_STATUS_OK on success,
+     *                  LORAWAN_STATUS_NO_OP if the time was never set,
+     *                  LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized
+     *                  with initialize().
+     */
+    lorawan_status_t get_gps_time(uint32_t &seconds, uint16_t &ms);
+
+    /** Get the drift of the device clock
+     *
+     * Measured from pairs of time references, DeviceTimeAns or beacons, some
+     * half an hour apart at least.
+     *
+     * @param ppm       [out] Drift in ppm, positive if the device clock is fast.
+     *
+     * @return          LORAWAN_STATUS_OK on success,
+     *                  LORAWAN_STATUS_NO_OP if the drift is not measured yet,
+     *                  LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized
+     *                  with initialize().
+     */
+    lorawan_status_t get_clock_drift(int32_t &ppm);
+
     /** Sets up a particular data rate
      *
      * @param data_rate   The intended data rate, for example DR_0 or DR_1.
@@ -323,6 +472,50 @@ public:
      */
     lorawan_status_t remove_channel(uint8_t index);
 
+    /** Adds a multicast group.
+     *
+     * The group is copied into the stack's multicast group table, 'group'
+     * need not outlive the call. Adding an address which is already in the
+     * table replaces its keys.
+     *
+     * @param    group      Group address and session keys.
+     *
+     * @return              LORAWAN_STATUS_OK on success, negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED   if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if the McGroupID is above 3,
+     *                      LORAWAN_STATUS_BUSY              if TX currently ongoing,
+     *                      LORAWAN_STATUS_NO_OP             if the group table is full,
+     *                      LORAWAN_STATUS_CRYPTO_FAIL       if the keys could not be set up,
+     *                      LORAWAN_STATUS_UNSUPPORTED       if "lora.multicast-groups" is 0
+     */
+    lorawan_status_t add_multicast_group(const multicast_params_t &group);
+
+    /** Removes a multicast group.
+     *
+     * @param    address    Address of the group.
+     *
+     * @return              LORAWAN_STATUS_OK on success, negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED   if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if the group is not in the table,
+     *                      LORAWAN_STATUS_BUSY              if TX currently ongoing,
+     *                      LORAWAN_STATUS_UNSUPPORTED       if "lora.multicast-groups" is 0
+     */
+    lorawan_status_t remove_multicast_group(uint32_t address);
+
+    /** Get the status of a multicast group
+     *
+     * @param    address    Address of the group.
+     *
+     * @param    status     the inbound structure that will be filled with the status.
+     *
+     * @return              LORAWAN_STATUS_OK on success, negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED   if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if the group is not in the table,
+     *                      LORAWAN_STATUS_UNSUPPORTED       if "lora.multicast-groups" is 0
+     */
+    lorawan_status_t get_multicast_group_status(uint32_t address,
+                                                lorawan_multicast_status_t &status);
+
     /** Send message to gateway
      *
      * @param port          The application port number. Port numbers 0 and 224 are reserved,
@@ -348,10 +541,113 @@ public:
      *                      LORAWAN_STATUS_NO_ACTIVE_SESSIONS if connection is not open,
      *                      LORAWAN_STATUS_WOULD_BLOCK       if another TX is ongoing,
      *                      LORAWAN_STATUS_PORT_INVALID      if trying to send to an invalid port (e.g. to 0)
-     *                      LORAWAN_STATUS_PARAMETER_INVALID if NULL data pointer is given or flags are invalid.
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if NULL data pointer is given or flags are invalid,
+     *                      LORAWAN_STATUS_BUSY              if the frame counter journal waits for an erase,
+     *                      LORAWAN_STATUS_STORAGE_ERROR     if the frame counter could not be reserved.
      */
     int16_t send(uint8_t port, const uint8_t *data, uint16_t length, int flags);
 
+    /** Queue a message for the gateway
+     *
+     * Unlike send(), this method does not fail while another transmission is
+     * ongoing. The message is copied into a bounded queue (MBED_CONF_LORA_UPLINK_QUEUE_SIZE
+     * entries) and the stack sends queued messages back to back as duty cycle allows,
+     * highest priority first. Each message is reported through the 'uplink_status'
+     * callback once it completes, fails or expires.
+     *
+     * @param port          The application port number. Port numbers 0 and 224 are reserved,
+     *                      whereas port numbers from 1 to 223 (0x01 to 0xDF) are valid port numbers.
+     *                      Anything out of this range is illegal.
+     *
+     * @param data          A pointer to the data being sent. The data is copied to the queue.
+     *
+     * @param length        The size of data in bytes. A message is never split, it must fit
+     *                      in one frame at the current datarate. If the datarate drops
+     *                      before it is sent and it no longer fits, it is reported with
+     *                      TX_SCHEDULING_ERROR.
+     *
+     * @param flags         MSG_UNCONFIRMED_FLAG, MSG_CONFIRMED_FLAG or MSG_PROPRIETARY_FLAG.
+     *
+     * @param priority      Messages with a higher priority are sent first. Equal priorities
+     *                      are sent in the order they were queued.
+     *
+     * @param expiry        Time in ms after which the message is dropped if its transmission
+     *                      has not started yet, 0 if the message never expires.
+     *
+     * @return              A non-negative message identifier, or a negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED   if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_WOULD_BLOCK       if the queue is full,
+     *                      LORAWAN_STATUS_LENGTH_ERROR      if the message does not fit in a frame,
+     *                      LORAWAN_STATUS_PORT_INVALID      if trying to send to an invalid port (e.g. to 0)
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if NULL data pointer is given or flags are invalid.
+     */
+    int16_t queue_send(uint8_t port, const uint8_t *data, uint16_t length, int flags,
+                       uint8_t priority, uint32_t expiry);
+
+    /** Enable uplink aggregation
+     *
+     * Many small readings sent one per frame spend most of their airtime on the
+     * 13 bytes of LoRaWAN framing. With aggregation enabled, records given to
+     * add_record() are packed into one FRMPayload using a compact TLV framing
+     * (see lorawan/system/lorawan_tlv.h, which also contains the decoder that
+     * sim/lorawan_unpack runs for the network backend) and queued with queue_send()
+     * once the time or size window is reached. A pack is never larger than the
+     * current datarate allows.
+     *
+     * @param port          The application port number for the packed uplinks.
+     *
+     * @param flags         MSG_UNCONFIRMED_FLAG or MSG_CONFIRMED_FLAG.
+     *
+     * @param window        Time in ms from the first record until the pack is sent,
+     *                      0 to send only when the size is reached or on flush_records().
+     *
+     * @param size          Pack size in bytes which triggers sending.
+     *
+     * @return              LORAWAN_STATUS_OK on success, negative error code on failure:
+     *                      LORAWAN_STATUS_NOT_INITIALIZED   if system is not initialized with initialize(),
+     *                      LORAWAN_STATUS_PORT_INVALID      if the port is invalid,
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if flags are invalid,
+     *                      LORAWAN_STATUS_LENGTH_ERROR      if size is 0 or above MBED_CONF_LORA_TX_MAX_SIZE.
+     */
+    lorawan_status_t enable_aggregation(uint8_t port, int flags, uint32_t window, uint16_t size);
+
+    /** Disable uplink aggregation
+     *
+     * Any records collected so far are queued for transmission.
+     *
+     * @return              LORAWAN_STATUS_OK on success,
+     *                      LORAWAN_STATUS_NO_OP if aggregation is not enabled,
+     *                      or the error returned by queue_send().
+     */
+    lorawan_status_t disable_aggregation(void);
+
+    /** Add a record to the current aggregated uplink
+     *
+     * @param tag           Record type, 0 - 15.
+     *
+     * @param data          Record value. The data is copied.
+     *
+     * @param length        Length of the value in bytes.
+     *
+     * @return              LORAWAN_STATUS_OK on success, negative error code on failure:
+     *                      LORAWAN_STATUS_NO_OP             if aggregation is not enabled,
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if tag is out of range or data is NULL,
+     *                      LORAWAN_STATUS_LENGTH_ERROR      if the record does not fit in a frame
+     *                                                       at the current datarate,
+     *                      or the error returned by queue_send() if the pack had to be sent.
+     *                      On failure the record is not added and can be added again.
+     */
+    lorawan_status_t add_record(uint8_t tag, const uint8_t *data, uint8_t length);
+
+    /** Send the current aggregated uplink right away
+     *
+     * Records that could not be queued are kept, and tried again at the end of
+     * the aggregation window if there is one.
+     *
+     * @return              LORAWAN_STATUS_OK on success, or the error returned by queue_send().
+     */
+    lorawan_status_t flush_records(void);
+
     /** Receives a message from the Network Server on a specific port.
      *
      * @param port          The application port number. Port numbers 0 and 224 are reserved,
@@ -413,6 +709,31 @@ public:
      */
     int16_t receive(uint8_t *data, uint16_t length, uint8_t &port, int &flags);
 
+    /** Releases a received frame.
+     *
+     * If the 'rx_frame' callback is set, received payloads are handed over as a
+     * read-only view into the RX frame ring of the stack, where they are decrypted
+     * in place and never copied. The view stays valid until this method is called
+     * with it. Frames can be released in any order.
+     *
+     * @param frame         The frame as handed over by the 'rx_frame' callback
+     *
+     * @return              LORAWAN_STATUS_OK on success,
+     *                      LORAWAN_STATUS_NO_OP if the frame was released already,
+     *                      LORAWAN_STATUS_PARAMETER_INVALID if it is no frame of the stack.
+     */
+    lorawan_status_t release_rx_frame(const lorawan_rx_frame_t &frame);
+
+    /** Number of dropped downlinks
+     *
+     * Received frames are buffered in a ring of MBED_CONF_LORA_RX_RING_SLOTS
+     * slots until processed, or until released by the application. A frame
+     * arriving while all slots are taken is dropped.
+     *
+     * @return              Number of frames dropped since initialization.
+     */
+    uint32_t get_rx_drop_count(void);
+
     /** Add application callbacks to the stack.
      *
      * An example of using this API with a latch onto 'lorawan_events' could be:
@@ -461,14 +782,35 @@ public:
      *
      * Change current device class.
      *
+     * CLASS_B is only available once connected. The device then searches for
+     * the beacon and reports BEACON_LOCKED once it is tracked; ping slots open
+     * after the network has acknowledged the ping slot periodicity. If the
+     * beacon is lost for longer than the beacon-less period, BEACON_LOST is
+     * reported and the device falls back to CLASS_A.
+     *
      * @param    device_class   The device class
      *
      * @return              LORAWAN_STATUS_OK on success or other negative error code if request failed:
      *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize(),
-     *                      LORAWAN_STATUS_UNSUPPORTED if requested class is not supported
+     *                      LORAWAN_STATUS_NO_ACTIVE_SESSIONS if CLASS_B is requested while not connected,
+     *                      LORAWAN_STATUS_UNSUPPORTED if requested class is not supported, e.g.,
+     *                      CLASS_B in a region without a beacon, or CLASS_C without
+     *                      "lora.class-c"
      */
     lorawan_status_t set_device_class(device_class_t device_class);
 
+    /** Get Class B status
+     *
+     * Beacon tracking state, the information carried by the last beacon, and
+     * the ping slot and radio-on counters since CLASS_B was last set.
+     *
+     * @param    status     the inbound structure that will be filled with the status.
+     *
+     * @return              LORAWAN_STATUS_OK on success,
+     *                      LORAWAN_STATUS_NOT_INITIALIZED if system is not initialized with initialize()
+     */
+    lorawan_status_t get_class_b_status(lorawan_class_b_status_t &status);
+
     /** Get hold of TX meta-data
      *
      * Use this method to acquire any TX meta-data related to previous transmission.
@@ -570,7 +912,24 @@ private:
      * PHY object if LoRaWANInterface has created it.
      * If PHY object is provided by the application, this pointer is NULL.
      */
-    LoRaPHY *_default_phy;
+    LoRaPHY_target *_default_phy;
+
+#if MBED_CONF_LORA_MULTI_REGION
+    /** Storage of the PHY object LoRaWANInterface creates, of any region
+     */
+    loraphy_region_storage_t _default_phy_storage;
+
+    /** Radio driver, bound to the PHY object of each region
+     */
+    LoRaRadio *_radio;
+#elif MBED_CONF_LORA_STATIC_MEMORY
+    /** Storage of the PHY object LoRaWANInterface creates, rather than the heap
+     */
+    union {
+        uint64_t align;
+        uint8_t bytes[sizeof(LoRaPHY_region)];
+    } _default_phy_storage;
+#endif
 };
 
 #endif /* LORAWANINTERFACE_H_ */
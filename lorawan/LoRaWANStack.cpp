@@ -27,8 +27,10 @@ SPDX-License-Identifier: BSD-3-Clause
 #include <stdlib.h>
 #include "platform/Callback.h"
 #include "events/EventQueue.h"
-#include "em_core.h"
+#include "platform/mbed_critical.h"
+#include "platform/profile.h"
 #include "LoRaWANStack.h"
+#include "system/lorawan_tlv.h"
 #include "trace.h"
 
 #define INVALID_PORT                0xFF
@@ -44,6 +46,49 @@ SPDX-License-Identifier: BSD-3-Clause
 #define USING_OTAA_FLAG             0x00000008
 #define TX_DONE_FLAG                0x00000010
 #define CONN_IN_PROGRESS_FLAG       0x00000020
+#define SESSION_RESUMED_FLAG        0x00000040
+
+/**
+ * Address of the session snapshot in the session storage
+ */
+#define SESSION_SNAPSHOT_ADDR       0
+
+/**
+ * Fragmented Data Block Transport package
+ */
+#define FRAG_PACKAGE_IDENTIFIER     3
+#define FRAG_PACKAGE_VERSION        1
+
+#define FRAG_PACKAGE_VERSION_REQ    0x00
+#define FRAG_SESSION_STATUS_REQ     0x01
+#define FRAG_SESSION_SETUP_REQ      0x02
+#define FRAG_SESSION_DELETE_REQ     0x03
+#define FRAG_DATA_FRAGMENT          0x08
+
+#define FRAG_SESSION_SETUP_REQ_SIZE 10
+
+/**
+ * FragSessionSetupAns status bits
+ */
+#define FRAG_SETUP_ENCODING_UNSUPPORTED 0x01
+#define FRAG_SETUP_NOT_ENOUGH_MEMORY    0x02
+#define FRAG_SETUP_INDEX_UNSUPPORTED    0x04
+
+/**
+ * FragSessionDeleteAns status bit
+ */
+#define FRAG_DELETE_NO_SESSION      0x04
+
+/**
+ * Room for the answers to one downlink, the longest answer is 5 bytes
+ */
+#define FRAG_ANS_MAX_SIZE           16
+#define FRAG_ANS_MAX_LENGTH         5
+
+/**
+ * Package answers are sent ahead of queued application messages
+ */
+#define FRAG_ANS_PRIORITY           0xFF
 
 using namespace mbed;
 using namespace events;
@@ -58,24 +103,55 @@ using namespace events;
  * Constructor                                                               *
  ****************************************************************************/
 LoRaWANStack::LoRaWANStack()
-    : _loramac(),
+    : _queue(NULL),
+      _ctrl_flags(IDLE_FLAG),
       _device_current_state(DEVICE_STATE_NOT_INITIALIZED),
-      _lw_session(),
-      _tx_msg(),
-      _rx_msg(),
-      _tx_metadata(),
-      _rx_metadata(),
       _num_retry(1),
       _qos_cnt(1),
-      _ctrl_flags(IDLE_FLAG),
       _app_port(INVALID_PORT),
+      _automatic_uplink_port(0),
       _link_check_requested(false),
+      _device_time_requested(false),
       _automatic_uplink_ongoing(false),
-      _queue(NULL)
+      _rx_frame_handed_over(false),
+      _agg_enabled(false),
+      _app_uplink_seen(false),
+      _agg_port(INVALID_PORT),
+      _agg_flags(MSG_UNCONFIRMED_FLAG),
+      _frag_ack_delay(0),
+      _tx_timestamp(0),
+      _automatic_uplink_timer(0),
+      _last_app_uplink(0),
+      _app_uplink_period(0),
+      _rx_ring_seq(0),
+      _rx_msg_slot(NULL),
+      _rx_drop_count(0),
+      _uplink_in_flight(NULL),
+      _uplink_seq(0),
+      _uplink_next_id(0),
+      _agg_size(0),
+      _agg_len(0),
+      _agg_window(0),
+      _agg_timer(0),
+      _storage(NULL),
+      _frag_storage(NULL),
+      _frag_addr(0),
+      _frag_area(0),
+      _frag_status_timer(0),
+      _frag_setup_event(0),
+      _lw_session(),
+      _tx_metadata(),
+      _rx_metadata(),
+      _rx_msg(),
+      _loramac(),
+      _fcnt_journal(),
+      _frag_decoder()
 {
     _tx_metadata.stale = true;
     _rx_metadata.stale = true;
-    core_util_atomic_flag_clear(&_rx_payload_in_use);
+    memset(_rx_ring, 0, sizeof(_rx_ring));
+    memset(_uplink_queue, 0, sizeof(_uplink_queue));
+    memset(&_frag_status, 0, sizeof(_frag_status));
 
 #ifdef MBED_CONF_LORA_APP_PORT
     if (is_port_valid(MBED_CONF_LORA_APP_PORT)) {
@@ -89,7 +165,7 @@ LoRaWANStack::LoRaWANStack()
 /*****************************************************************************
  * Public Methods                                                            *
  ****************************************************************************/
-void LoRaWANStack::bind_phy_and_radio_driver(LoRaRadio &radio, LoRaPHY &phy)
+void LoRaWANStack::bind_phy_and_radio_driver(LoRaRadio &radio, LoRaPHY_target &phy)
 {
     radio_events.tx_done = mbed::callback(this, &LoRaWANStack::tx_interrupt_handler);
     radio_events.rx_done = mbed::callback(this, &LoRaWANStack::rx_interrupt_handler);
@@ -103,6 +179,24 @@ void LoRaWANStack::bind_phy_and_radio_driver(LoRaRadio &radio, LoRaPHY &phy)
     radio.lock();
     radio.init_radio(&radio_events);
     radio.unlock();
+
+    // the session area follows the channels of the region
+    if (_storage) {
+        set_session_storage(_storage);
+    }
+}
+
+lorawan_status_t LoRaWANStack::check_phy_replaceable()
+{
+    if (_ctrl_flags & CONN_IN_PROGRESS_FLAG) {
+        return LORAWAN_STATUS_BUSY;
+    }
+
+    if (_ctrl_flags & CONNECTED_FLAG) {
+        return LORAWAN_STATUS_ALREADY_CONNECTED;
+    }
+
+    return LORAWAN_STATUS_OK;
 }
 
 lorawan_status_t LoRaWANStack::initialize_mac_layer(EventQueue *queue)
@@ -138,6 +232,14 @@ lorawan_status_t LoRaWANStack::set_lora_callbacks(const lorawan_app_callbacks_t
         _loramac.set_batterylevel_callback(callbacks->battery_level);
     }
 
+    if (callbacks->rx_frame) {
+        _callbacks.rx_frame = callbacks->rx_frame;
+    }
+
+    if (callbacks->uplink_status) {
+        _callbacks.uplink_status = callbacks->uplink_status;
+    }
+
     return LORAWAN_STATUS_OK;
 }
 
@@ -194,6 +296,204 @@ lorawan_status_t LoRaWANStack::connect(const lorawan_connect_t &connect)
     return handle_connect(is_otaa);
 }
 
+lorawan_status_t LoRaWANStack::set_session_storage(LoRaWANStorage *storage)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    _storage = storage;
+    _fcnt_journal.unmount();
+
+    if (_storage) {
+        const uint32_t erase_size = _storage->get_erase_size();
+        const uint32_t area = ((_loramac.get_session_snapshot_size() + erase_size - 1)
+                               / erase_size) * erase_size;
+
+        if (area >= _storage->size()
+                || _fcnt_journal.mount(_storage, SESSION_SNAPSHOT_ADDR + area,
+                                       _storage->size() - area) != LORAWAN_STATUS_OK) {
+            tr_error("No frame counter journal, saved sessions will not be resumed");
+        }
+    }
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::set_frag_session_storage(LoRaWANStorage *storage,
+                                                        uint32_t addr, uint32_t size)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (storage && (size == 0 || addr % storage->get_erase_size()
+                    || addr > storage->size() || size > storage->size() - addr)) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    reset_frag_session();
+
+    _frag_storage = storage;
+    _frag_addr = addr;
+    _frag_area = size;
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::get_frag_session_status(lorawan_frag_status_t &status)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (_frag_status.active) {
+        _frag_status.complete = _frag_decoder.is_complete();
+        _frag_status.out_of_memory = _frag_decoder.is_out_of_memory();
+        _frag_status.nb_received = _frag_decoder.get_nb_received();
+        _frag_status.nb_missing = _frag_decoder.get_nb_missing();
+    }
+
+    status = _frag_status;
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::save_session()
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!_storage) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    if (!_lw_session.active) {
+        return LORAWAN_STATUS_NO_ACTIVE_SESSIONS;
+    }
+
+    const uint8_t connect_type = (_ctrl_flags & USING_OTAA_FLAG) ?
+                                 LORAWAN_CONNECTION_OTAA : LORAWAN_CONNECTION_ABP;
+
+    return _loramac.save_session(*_storage, SESSION_SNAPSHOT_ADDR, connect_type);
+}
+
+lorawan_status_t LoRaWANStack::forget_session()
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!_storage) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    const uint32_t erase_size = _storage->get_erase_size();
+    const uint32_t area = ((_loramac.get_session_snapshot_size() + erase_size - 1)
+                           / erase_size) * erase_size;
+
+    if (_storage->erase(SESSION_SNAPSHOT_ADDR, area) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    return LORAWAN_STATUS_OK;
+}
+
+bool LoRaWANStack::resume_session()
+{
+    lorawan_session_snapshot_t snapshot;
+    uint32_t ul_counter;
+    uint32_t dl_counter;
+
+    if (!_storage) {
+        return false;
+    }
+
+    // the snapshot holds the counters of when it was saved, only the
+    // journal knows how far they went since
+    if (!_fcnt_journal.is_mounted()) {
+        tr_debug("No frame counter journal, joining");
+        return false;
+    }
+
+    if (_storage->read(&snapshot, SESSION_SNAPSHOT_ADDR, sizeof(snapshot)) != 0
+            || snapshot.magic != LORAWAN_SESSION_SNAPSHOT_MAGIC) {
+        tr_debug("No saved session to resume");
+        return false;
+    }
+
+    if (!_fcnt_journal.get_counters(snapshot.dev_addr, ul_counter, dl_counter)) {
+        tr_debug("No frame counters for DevAddr 0x%08lx, joining", snapshot.dev_addr);
+        return false;
+    }
+
+    if (_loramac.restore_session(*_storage, SESSION_SNAPSHOT_ADDR,
+                                 LORAWAN_CONNECTION_OTAA) != LORAWAN_STATUS_OK) {
+        tr_debug("No saved session to resume");
+        return false;
+    }
+
+    restore_frame_counters();
+
+    return true;
+}
+
+void LoRaWANStack::restore_frame_counters()
+{
+    uint32_t ul_counter;
+    uint32_t dl_counter;
+
+    // the journal is never behind the counters actually used
+    if (_fcnt_journal.get_counters(_loramac.get_dev_addr(), ul_counter, dl_counter)) {
+        _loramac.advance_frame_counters(ul_counter, dl_counter);
+    }
+
+    _loramac.get_frame_counters(_lw_session.uplink_counter, _lw_session.downlink_counter);
+}
+
+lorawan_status_t LoRaWANStack::reserve_frame_counters(bool new_session)
+{
+    uint32_t ul_counter;
+    uint32_t dl_counter;
+
+    if (!_fcnt_journal.is_mounted()) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    const uint32_t dev_addr = _loramac.get_dev_addr();
+    _loramac.get_frame_counters(ul_counter, dl_counter);
+
+    if (!new_session && _fcnt_journal.is_reserved(dev_addr, ul_counter)) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    // a program only, erasing is left to maintenance
+    lorawan_status_t status = _fcnt_journal.reserve(dev_addr, ul_counter, dl_counter);
+    if (status != LORAWAN_STATUS_OK) {
+        tr_error("Failed to reserve frame counters (%d)", status);
+    }
+
+    if (_fcnt_journal.needs_maintenance()) {
+        const int ret = _queue->call(this, &LoRaWANStack::maintain_frame_counter_journal);
+        MBED_ASSERT(ret != 0);
+        (void)ret;
+    }
+
+    return status;
+}
+
+void LoRaWANStack::maintain_frame_counter_journal()
+{
+    lorawan_status_t status = _fcnt_journal.maintain();
+
+    if (status == LORAWAN_STATUS_OK) {
+        // uplinks held back while the journal was full may go now
+        schedule_uplink_queue();
+    } else if (status != LORAWAN_STATUS_BUSY) {
+        tr_error("Frame counter journal maintenance failed");
+    }
+}
+
 lorawan_status_t LoRaWANStack::add_channels(const lorawan_channelplan_t &channel_plan)
 {
     if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
@@ -212,6 +512,34 @@ lorawan_status_t LoRaWANStack::remove_a_channel(uint8_t channel_id)
     return _loramac.remove_single_channel(channel_id);
 }
 
+lorawan_status_t LoRaWANStack::add_multicast_group(const multicast_params_t &group)
+{
+    if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    return _loramac.multicast_channel_link(&group);
+}
+
+lorawan_status_t LoRaWANStack::remove_multicast_group(uint32_t address)
+{
+    if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    return _loramac.multicast_channel_unlink(address);
+}
+
+lorawan_status_t LoRaWANStack::get_multicast_group_status(uint32_t address,
+                                                          lorawan_multicast_status_t &status)
+{
+    if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    return _loramac.get_multicast_group_status(address, status);
+}
+
 lorawan_status_t LoRaWANStack::drop_channel_list()
 {
     if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
@@ -308,6 +636,10 @@ int16_t LoRaWANStack::handle_tx(const uint8_t port, const uint8_t *data,
     if (_link_check_requested) {
         _loramac.setup_link_check_request();
     }
+
+    if (_device_time_requested) {
+        _loramac.setup_device_time_request(mbed::callback(this, &LoRaWANStack::device_time_handler));
+    }
     _qos_cnt = 1;
 
     lorawan_status_t status;
@@ -336,15 +668,249 @@ int16_t LoRaWANStack::handle_tx(const uint8_t port, const uint8_t *data,
             return LORAWAN_STATUS_PARAMETER_INVALID;
     }
 
+    // the counter of this uplink must be persisted before it goes on air,
+    // an uplink the journal does not cover is not sent at all
+    status = reserve_frame_counters();
+    if (status != LORAWAN_STATUS_OK) {
+        return status;
+    }
+
     int16_t len = _loramac.prepare_ongoing_tx(port, data, length, flags, _num_retry);
 
     status = state_controller(DEVICE_STATE_SCHEDULING);
 
+    if (status == LORAWAN_STATUS_OK && !null_allowed) {
+        // any held back MAC answers went out in the FOpts of this frame
+        if (_automatic_uplink_timer) {
+            tr_debug("MAC answers piggybacked on application uplink");
+            _queue->cancel(_automatic_uplink_timer);
+            _automatic_uplink_timer = 0;
+        }
+
+        // learn the application uplink period, averaged over a few uplinks
+        const lorawan_time_t now = _loramac.get_current_time();
+        if (_app_uplink_seen) {
+            const uint32_t interval = now - _last_app_uplink;
+            _app_uplink_period = _app_uplink_period ?
+                                 (3 * _app_uplink_period + interval) / 4 : interval;
+        }
+        _last_app_uplink = now;
+        _app_uplink_seen = true;
+    }
+
     // send user the length of data which is scheduled now.
     // user should take care of the pending data.
     return (status == LORAWAN_STATUS_OK) ? len : (int16_t) status;
 }
 
+int16_t LoRaWANStack::queue_tx(uint8_t port, const uint8_t *data, uint16_t length,
+                               int flags, uint8_t priority, uint32_t expiry)
+{
+    if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!data || length == 0) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    // a message goes out in a single frame, it is never cut
+    if (length > _loramac.get_current_max_tx_size()) {
+        return LORAWAN_STATUS_LENGTH_ERROR;
+    }
+
+    if (!is_port_valid(port)) {
+        return LORAWAN_STATUS_PORT_INVALID;
+    }
+
+    switch (flags & MSG_FLAG_MASK) {
+        case MSG_UNCONFIRMED_FLAG:
+        case MSG_CONFIRMED_FLAG:
+        case MSG_PROPRIETARY_FLAG:
+            break;
+
+        default:
+            tr_error("Invalid send flags");
+            return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    // expired messages must not take the room of a new one
+    drop_expired_uplinks(_loramac.get_current_time());
+
+    uplink_queue_entry_t *entry = NULL;
+    for (uint8_t i = 0; i < MBED_CONF_LORA_UPLINK_QUEUE_SIZE; i++) {
+        if (!_uplink_queue[i].in_use) {
+            entry = &_uplink_queue[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        return LORAWAN_STATUS_WOULD_BLOCK;
+    }
+
+    memcpy(entry->data, data, length);
+    entry->length = length;
+    entry->id = _uplink_next_id;
+    entry->port = port;
+    entry->flags = flags;
+    entry->priority = priority;
+    entry->seq = _uplink_seq++;
+    entry->expiry = expiry ? _loramac.get_current_time() + expiry : 0;
+    entry->in_use = true;
+
+    // identifiers stay non-negative so that they never clash with error codes
+    _uplink_next_id = (_uplink_next_id + 1) & 0x7FFF;
+
+    tr_debug("Uplink #%d queued, %d bytes, priority %d", entry->id, length, priority);
+
+    if (!_uplink_in_flight) {
+        schedule_uplink_queue();
+    }
+
+    return entry->id;
+}
+
+lorawan_status_t LoRaWANStack::enable_aggregation(uint8_t port, int flags,
+                                                  uint32_t window, uint16_t size)
+{
+    if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!is_port_valid(port)) {
+        return LORAWAN_STATUS_PORT_INVALID;
+    }
+
+    if (flags != MSG_UNCONFIRMED_FLAG && flags != MSG_CONFIRMED_FLAG) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    if (size == 0 || size > sizeof(_agg_buffer)) {
+        return LORAWAN_STATUS_LENGTH_ERROR;
+    }
+
+    // records collected so far go out with the old settings
+    if (_agg_enabled) {
+        flush_records();
+    }
+
+    _agg_port = port;
+    _agg_flags = flags;
+    _agg_window = window;
+    _agg_size = size;
+    _agg_enabled = true;
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::disable_aggregation(void)
+{
+    if (!_agg_enabled) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    lorawan_status_t status = flush_records();
+    _agg_enabled = false;
+
+    return status;
+}
+
+lorawan_status_t LoRaWANStack::add_record(uint8_t tag, const uint8_t *data, uint8_t length)
+{
+    if (!_agg_enabled) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    if (tag > LORAWAN_TLV_MAX_TAG || (!data && length > 0)) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    // bound the pack by what a single frame can carry right now
+    uint16_t limit = _agg_size;
+    uint8_t max_size = _loramac.get_current_max_tx_size();
+    if (max_size < limit) {
+        limit = max_size;
+    }
+
+    // a record is never cut across frames
+    uint16_t record_size = lorawan_tlv_encoded_size(length);
+    if (record_size > max_size || record_size > sizeof(_agg_buffer)) {
+        return LORAWAN_STATUS_LENGTH_ERROR;
+    }
+
+    if (_agg_len > 0 && _agg_len + record_size > limit) {
+        lorawan_status_t status = flush_records();
+        if (status != LORAWAN_STATUS_OK) {
+            return status;
+        }
+    }
+
+    if (!lorawan_tlv_encode(_agg_buffer, sizeof(_agg_buffer), &_agg_len,
+                            tag, data, length)) {
+        return LORAWAN_STATUS_LENGTH_ERROR;
+    }
+
+    if (_agg_len >= limit) {
+        lorawan_status_t status = flush_records();
+        if (status != LORAWAN_STATUS_OK) {
+            // the record is the last of the pack, never sent: take it back
+            // so that the caller can add it again
+            _agg_len -= record_size;
+        }
+        return status;
+    }
+
+    start_aggregation_timer();
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::flush_records(void)
+{
+    if (_agg_timer) {
+        _queue->cancel(_agg_timer);
+        _agg_timer = 0;
+    }
+
+    uint8_t max_size = _loramac.get_current_max_tx_size();
+    uint16_t offset = 0;
+
+    while (offset < _agg_len) {
+        // take as many whole records as fit in a frame, but at least one:
+        // if the datarate dropped and it fits no more, queue_tx() refuses it
+        // and it is kept until it does
+        lorawan_tlv_record_t record;
+        uint16_t end = offset;
+        uint16_t pos = offset;
+
+        while (lorawan_tlv_decode(_agg_buffer, _agg_len, &pos, &record) == 1) {
+            if (end > offset && pos - offset > max_size) {
+                break;
+            }
+            end = pos;
+        }
+
+        int16_t ret = queue_tx(_agg_port, &_agg_buffer[offset], end - offset,
+                               _agg_flags, 0, 0);
+        if (ret < 0) {
+            // keep what is left for the next attempt, at the end of a new
+            // window
+            memmove(_agg_buffer, &_agg_buffer[offset], _agg_len - offset);
+            _agg_len -= offset;
+            start_aggregation_timer();
+            return (lorawan_status_t) ret;
+        }
+
+        tr_debug("Aggregated uplink #%d, %d bytes", ret, end - offset);
+        offset = end;
+    }
+
+    _agg_len = 0;
+
+    return LORAWAN_STATUS_OK;
+}
+
 int16_t LoRaWANStack::handle_rx(uint8_t *data, uint16_t length, uint8_t &port, int &flags, bool validate_params)
 {
     if (_device_current_state == DEVICE_STATE_NOT_INITIALIZED) {
@@ -404,15 +970,52 @@ int16_t LoRaWANStack::handle_rx(uint8_t *data, uint16_t length, uint8_t &port, i
     }
 
     if (read_complete) {
-        _rx_msg.msg.mcps_indication.buffer = NULL;
-        _rx_msg.msg.mcps_indication.buffer_size = 0;
-        _rx_msg.pending_size = 0;
-        _rx_msg.receive_ready = false;
+        drop_pending_receive();
     }
 
     return base_size;
 }
 
+void LoRaWANStack::drop_pending_receive(void)
+{
+    _rx_msg.msg.mcps_indication.buffer = NULL;
+    _rx_msg.msg.mcps_indication.buffer_size = 0;
+    _rx_msg.pending_size = 0;
+    _rx_msg.receive_ready = false;
+
+    if (_rx_msg_slot) {
+        free_rx_slot(_rx_msg_slot);
+        _rx_msg_slot = NULL;
+    }
+}
+
+lorawan_status_t LoRaWANStack::release_rx_frame(const lorawan_rx_frame_t &frame)
+{
+    for (uint8_t i = 0; i < MBED_CONF_LORA_RX_RING_SLOTS; i++) {
+        rx_frame_slot_t *slot = &_rx_ring[i];
+
+        // the payload was decrypted in place, it lies in its own slot
+        if (frame.buffer < slot->payload || frame.buffer >= slot->payload + LORAMAC_PHY_MAXPAYLOAD) {
+            continue;
+        }
+
+        // the frame of receive() is freed once read
+        if (slot->state != RX_FRAME_HELD || slot == _rx_msg_slot) {
+            return LORAWAN_STATUS_NO_OP;
+        }
+
+        free_rx_slot(slot);
+        return LORAWAN_STATUS_OK;
+    }
+
+    return LORAWAN_STATUS_PARAMETER_INVALID;
+}
+
+uint32_t LoRaWANStack::get_rx_drop_count() const
+{
+    return _rx_drop_count;
+}
+
 lorawan_status_t LoRaWANStack::set_link_check_request()
 {
     if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
@@ -433,6 +1036,42 @@ void LoRaWANStack::remove_link_check_request()
     _link_check_requested = false;
 }
 
+lorawan_status_t LoRaWANStack::set_device_time_request()
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    _device_time_requested = true;
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::get_gps_time(uint32_t &seconds, uint16_t &ms)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!_loramac.get_gps_time(seconds, ms)) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANStack::get_clock_drift(int32_t &ppm)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (!_loramac.get_clock_drift(ppm)) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    return LORAWAN_STATUS_OK;
+}
+
 lorawan_status_t LoRaWANStack::shutdown()
 {
     if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
@@ -448,11 +1087,23 @@ lorawan_status_t LoRaWANStack::set_device_class(const device_class_t &device_cla
         return LORAWAN_STATUS_NOT_INITIALIZED;
     }
 
-    if (device_class == CLASS_B) {
-        return LORAWAN_STATUS_UNSUPPORTED;
+    // the beacon is tracked on behalf of a session
+    if (device_class == CLASS_B && !(_ctrl_flags & CONNECTED_FLAG)) {
+        return LORAWAN_STATUS_NO_ACTIVE_SESSIONS;
+    }
+
+    return _loramac.set_device_class(device_class,
+                                     mbed::callback(this, &LoRaWANStack::post_process_tx_no_reception),
+                                     mbed::callback(this, &LoRaWANStack::class_b_event_handler));
+}
+
+lorawan_status_t LoRaWANStack::get_class_b_status(lorawan_class_b_status_t &status)
+{
+    if (DEVICE_STATE_NOT_INITIALIZED == _device_current_state) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
     }
-    _loramac.set_device_class(device_class,
-                              mbed::callback(this, &LoRaWANStack::post_process_tx_no_reception));
+
+    _loramac.get_class_b_status(status);
     return LORAWAN_STATUS_OK;
 }
 
@@ -517,15 +1168,20 @@ void LoRaWANStack::tx_interrupt_handler(void)
 void LoRaWANStack::rx_interrupt_handler(const uint8_t *payload, uint16_t size,
                                         int16_t rssi, int8_t snr)
 {
-    if (size > sizeof _rx_payload || core_util_atomic_flag_test_and_set(&_rx_payload_in_use)) {
+    rx_frame_slot_t *slot = NULL;
+
+    if (size > sizeof slot->payload || (slot = reserve_rx_slot()) == NULL) {
+        _rx_drop_count++;
         return;
     }
 
-    memcpy(_rx_payload, payload, size);
+    memcpy(slot->payload, payload, size);
+    slot->size = size;
+    slot->rssi = rssi;
+    slot->snr = snr;
+    slot->timestamp = _loramac.get_current_time();
 
-    const uint8_t *ptr = _rx_payload;
-    const int ret = _queue->call(this, &LoRaWANStack::process_reception,
-                                 ptr, size, rssi, snr);
+    const int ret = _queue->call(this, &LoRaWANStack::process_reception, slot);
     MBED_ASSERT(ret != 0);
     (void)ret;
 }
@@ -607,8 +1263,8 @@ void LoRaWANStack::post_process_tx_with_reception()
         } else {
             if (!_loramac.continue_sending_process()
                     && _loramac.get_current_slot() != RX_SLOT_WIN_1) {
-                tr_error("Retries exhausted for Class %s device",
-                         _loramac.get_device_class() == CLASS_A ? "A" : "C");
+                tr_error("Retries exhausted for Class %c device",
+                         _loramac.get_device_class() == CLASS_A ? 'A' : 'C');
                 _ctrl_flags &= ~TX_DONE_FLAG;
                 _ctrl_flags |= RETRY_EXHAUSTED_FLAG;
                 _loramac.post_process_mcps_req();
@@ -652,8 +1308,8 @@ void LoRaWANStack::post_process_tx_no_reception()
             return;
         }
 
-        tr_error("Retries exhausted for Class %s device",
-                 _loramac.get_device_class() == CLASS_A ? "A" : "C");
+        tr_error("Retries exhausted for Class %c device",
+                 _loramac.get_device_class() == CLASS_A ? 'A' : 'C');
         _ctrl_flags &= ~TX_DONE_FLAG;
         _ctrl_flags |= RETRY_EXHAUSTED_FLAG;
     } else {
@@ -690,36 +1346,52 @@ void LoRaWANStack::handle_scheduling_failure(void)
 }
 
 
-void LoRaWANStack::process_reception(const uint8_t *const payload, uint16_t size,
-                                     int16_t rssi, int8_t snr)
+void LoRaWANStack::process_reception(rx_frame_slot_t *slot)
 {
+    PROFILE_ZONE(PROFILE_PROCESS_RECEPTION);
+
+    // beacons never reach the state machine
+    if (_loramac.get_current_slot() == RX_SLOT_WIN_BEACON) {
+        _loramac.on_radio_rx_done(slot->payload, slot->size, slot->rssi,
+                                  slot->snr, slot->timestamp);
+        free_rx_slot(slot);
+        return;
+    }
+
+    bool is_ping_slot = (_loramac.get_current_slot() == RX_SLOT_WIN_PING_SLOT);
+
     _device_current_state = DEVICE_STATE_RECEIVING;
 
     _ctrl_flags &= ~MSG_RECVD_FLAG;
     _ctrl_flags &= ~TX_DONE_FLAG;
     _ctrl_flags &= ~RETRY_EXHAUSTED_FLAG;
 
-    _loramac.on_radio_rx_done(payload, size, rssi, snr);
+    _loramac.on_radio_rx_done(slot->payload, slot->size, slot->rssi, slot->snr,
+                              slot->timestamp);
 
     if (_loramac.get_mlme_confirmation()->pending) {
         _loramac.post_process_mlme_request();
         mlme_confirm_handler();
 
         if (_loramac.get_mlme_confirmation()->req_type == MLME_JOIN) {
-            core_util_atomic_flag_clear(&_rx_payload_in_use);
+            free_rx_slot(slot);
             return;
         }
     }
 
     if (!_loramac.nwk_joined()) {
-        core_util_atomic_flag_clear(&_rx_payload_in_use);
+        free_rx_slot(slot);
         return;
     }
 
     make_rx_metadata_available();
+    _rx_metadata.timestamp = slot->timestamp;
 
-    // Post process transmission in response to the reception
-    post_process_tx_with_reception();
+    // Post process transmission in response to the reception, a ping slot
+    // frame answers no uplink
+    if (!is_ping_slot) {
+        post_process_tx_with_reception();
+    }
 
     // handle any pending MCPS indication
     if (_loramac.get_mcps_indication()->pending) {
@@ -741,7 +1413,17 @@ void LoRaWANStack::process_reception(const uint8_t *const payload, uint16_t size
         mlme_indication_handler();
     }
 
-    core_util_atomic_flag_clear(&_rx_payload_in_use);
+    // the application holds a view into the slot, it will be freed when
+    // the application releases the frame, or when receive() has read it
+    if (_rx_frame_handed_over) {
+        _rx_frame_handed_over = false;
+        slot->state = RX_FRAME_HELD;
+        if (_rx_msg.receive_ready && !_rx_msg_slot) {
+            _rx_msg_slot = slot;
+        }
+    } else {
+        free_rx_slot(slot);
+    }
 }
 
 void LoRaWANStack::process_reception_timeout(bool is_timeout)
@@ -827,7 +1509,7 @@ lorawan_status_t LoRaWANStack::set_application_port(const uint8_t port, bool all
 
 void LoRaWANStack::state_machine_run_to_completion()
 {
-    if (_loramac.get_device_class() == CLASS_C) {
+    if (_loramac.is_class_c()) {
         _device_current_state = DEVICE_STATE_RECEIVING;
         return;
     }
@@ -835,6 +1517,24 @@ void LoRaWANStack::state_machine_run_to_completion()
     _device_current_state = DEVICE_STATE_IDLE;
 }
 
+void LoRaWANStack::class_b_event_handler(lorawan_event_t event)
+{
+    if (event == BEACON_LOST) {
+        tr_info("Beacon lost, falling back to Class A");
+        _loramac.set_device_class(CLASS_A,
+                                  mbed::callback(this, &LoRaWANStack::post_process_tx_no_reception),
+                                  mbed::callback(this, &LoRaWANStack::class_b_event_handler));
+    }
+
+    send_event_to_application(event);
+}
+
+void LoRaWANStack::device_time_handler(void)
+{
+    _device_time_requested = false;
+    send_event_to_application(DEVICE_TIME_SYNCED);
+}
+
 void LoRaWANStack::send_event_to_application(const lorawan_event_t event) const
 {
     if (_callbacks.events) {
@@ -857,6 +1557,67 @@ void LoRaWANStack::send_automatic_uplink_message(const uint8_t port)
     }
 }
 
+void LoRaWANStack::request_automatic_uplink(const uint8_t port)
+{
+    if (_automatic_uplink_timer) {
+        // already holding back for an application uplink
+        return;
+    }
+
+    if (MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE > 0 && is_app_uplink_expected()) {
+        tr_debug("Holding MAC answers for an application uplink");
+        _automatic_uplink_port = port;
+        _automatic_uplink_timer = _queue->call_in(MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE, this,
+                                                  &LoRaWANStack::automatic_uplink_deadline);
+        MBED_ASSERT(_automatic_uplink_timer != 0);
+        return;
+    }
+
+    _automatic_uplink_ongoing = true;
+    const int ret = _queue->call(this, &LoRaWANStack::send_automatic_uplink_message, port);
+    MBED_ASSERT(ret != 0);
+    (void)ret;
+}
+
+bool LoRaWANStack::is_app_uplink_expected()
+{
+    // packed records will be flushed at the latest when the window closes,
+    // without a window they wait for the pack to fill up
+    if (_agg_len > 0 && _agg_window > 0
+            && _agg_window <= MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE) {
+        return true;
+    }
+
+    for (uint8_t i = 0; i < MBED_CONF_LORA_UPLINK_QUEUE_SIZE; i++) {
+        const uplink_queue_entry_t *entry = &_uplink_queue[i];
+        if (entry->in_use && entry != _uplink_in_flight) {
+            return true;
+        }
+    }
+
+    if (!_app_uplink_period) {
+        return false;
+    }
+
+    // an uplink overdue by more than a period is not coming
+    const uint32_t elapsed = _loramac.get_current_time() - _last_app_uplink;
+    return elapsed <= _app_uplink_period
+           && elapsed + MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE >= _app_uplink_period;
+}
+
+void LoRaWANStack::automatic_uplink_deadline()
+{
+    _automatic_uplink_timer = 0;
+
+    if (_automatic_uplink_ongoing) {
+        return;
+    }
+
+    tr_debug("No application uplink before the deadline, sending empty uplink...");
+    _automatic_uplink_ongoing = true;
+    send_automatic_uplink_message(_automatic_uplink_port);
+}
+
 int LoRaWANStack::convert_to_msg_flag(const mcps_type_t type)
 {
     int msg_flag = MSG_UNCONFIRMED_FLAG;
@@ -898,15 +1659,19 @@ lorawan_status_t LoRaWANStack::handle_connect(bool is_otaa)
         _lw_session.downlink_counter = 0;
         _lw_session.uplink_counter = 0;
         _ctrl_flags |= USING_OTAA_FLAG;
+        _ctrl_flags &= ~SESSION_RESUMED_FLAG;
+
+        // a saved session spares the join procedure altogether
+        if (resume_session()) {
+            _ctrl_flags |= SESSION_RESUMED_FLAG;
+        }
     } else {
         // If current state is SHUTDOWN, device may be trying to re-establish
         // communication. In case of ABP specification is meddled about frame counters.
         // It says to reset counters to zero but there is no mechanism to tell the
         // network server that the device was disconnected or restarted.
-        // At the moment, this implementation does not support a non-volatile
-        // memory storage.
-        //_lw_session.downlink_counter; //Get from NVM
-        //_lw_session.uplink_counter; //Get from NVM
+        // Continue from the frame counter journal, if there is one.
+        restore_frame_counters();
 
         tr_debug("Initiating ABP");
         tr_debug("Frame Counters. UpCnt=%lu, DownCnt=%lu",
@@ -922,12 +1687,8 @@ void LoRaWANStack::mlme_indication_handler()
     if (_loramac.get_mlme_indication()->indication_type == MLME_SCHEDULE_UPLINK) {
         // The MAC signals that we shall provide an uplink as soon as possible
 #if MBED_CONF_LORA_AUTOMATIC_UPLINK_MESSAGE
-        _automatic_uplink_ongoing = true;
-        tr_debug("mlme indication: sending empty uplink to port 0 to acknowledge MAC commands...");
-        const uint8_t port = 0;
-        const int ret = _queue->call(this, &LoRaWANStack::send_automatic_uplink_message, port);
-        MBED_ASSERT(ret != 0);
-        (void)ret;
+        tr_debug("mlme indication: uplink required to acknowledge MAC commands...");
+        request_automatic_uplink(0);
 #else
         send_event_to_application(UPLINK_REQUIRED);
 #endif
@@ -985,26 +1746,38 @@ void LoRaWANStack::mlme_confirm_handler()
 
 void LoRaWANStack::mcps_confirm_handler()
 {
+    lorawan_event_t event;
+
     switch (_loramac.get_mcps_confirmation()->status) {
 
         case LORAMAC_EVENT_INFO_STATUS_OK:
             _lw_session.uplink_counter = _loramac.get_mcps_confirmation()->ul_frame_counter;
-            send_event_to_application(TX_DONE);
+            event = TX_DONE;
             break;
 
         case LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT:
             tr_error("Fatal Error, Radio failed to transmit");
-            send_event_to_application(TX_TIMEOUT);
+            event = TX_TIMEOUT;
             break;
 
         case LORAMAC_EVENT_INFO_STATUS_TX_DR_PAYLOAD_SIZE_ERROR:
-            send_event_to_application(TX_SCHEDULING_ERROR);
+            event = TX_SCHEDULING_ERROR;
             break;
 
         default:
             // if no ack was received after enough retries, send TX_ERROR
-            send_event_to_application(TX_ERROR);
+            event = TX_ERROR;
+    }
+
+    send_event_to_application(event);
+
+    if (_uplink_in_flight) {
+        uplink_queue_entry_t *entry = _uplink_in_flight;
+        _uplink_in_flight = NULL;
+        report_queued_uplink(entry, event);
     }
+
+    schedule_uplink_queue();
 }
 
 void LoRaWANStack::mcps_indication_handler()
@@ -1028,8 +1801,31 @@ void LoRaWANStack::mcps_indication_handler()
 #endif
     }
 
-    if (mcps_indication->is_data_recvd) {
-        // Valid message arrived.
+    if (mcps_indication->is_data_recvd && _frag_storage
+            && mcps_indication->port == MBED_CONF_LORA_FRAG_PORT) {
+        handle_frag_package(mcps_indication->buffer, mcps_indication->buffer_size,
+                            mcps_indication->multicast, mcps_indication->multicast_group);
+    } else if (mcps_indication->is_data_recvd && _callbacks.rx_frame) {
+        // Valid message arrived. Hand over the decrypted payload without
+        // copying, the RX ring slot is held until the application
+        // releases the frame.
+        lorawan_rx_frame_t frame;
+        frame.buffer = mcps_indication->buffer;
+        frame.size = mcps_indication->buffer_size;
+        frame.port = mcps_indication->port;
+        frame.flags = convert_to_msg_flag(mcps_indication->type);
+        frame.metadata = _rx_metadata;
+
+        tr_debug("Packet Received %d bytes, Port=%d", frame.size, frame.port);
+        _rx_frame_handed_over = true;
+        const int ret = _queue->call(_callbacks.rx_frame, frame);
+        MBED_ASSERT(ret != 0);
+        (void)ret;
+    } else if (mcps_indication->is_data_recvd) {
+        // Valid message arrived. receive() reads it from the RX ring slot,
+        // held until then; a frame the application did not read is dropped
+        drop_pending_receive();
+        _rx_frame_handed_over = true;
         _rx_msg.type = LORAMAC_RX_MCPS_INDICATION;
         _rx_msg.msg.mcps_indication.buffer_size = mcps_indication->buffer_size;
         _rx_msg.msg.mcps_indication.port = mcps_indication->port;
@@ -1056,19 +1852,16 @@ void LoRaWANStack::mcps_indication_handler()
      * but version 1.1.0 says that network SHALL not send any new
      * confirmed messages until ack has been sent
      */
-    if ((_loramac.get_device_class() != CLASS_C
+    if ((!_loramac.is_class_c()
             && mcps_indication->fpending_status)
-            || (_loramac.get_device_class() == CLASS_C
+            || (_loramac.is_class_c()
                 && mcps_indication->type == MCPS_CONFIRMED)) {
 #if (MBED_CONF_LORA_AUTOMATIC_UPLINK_MESSAGE)
         // Do not queue an automatic uplink of there is one already outgoing
         // This means we have not received an ack for the previous automatic uplink
         if (!_automatic_uplink_ongoing) {
-            tr_debug("Sending empty uplink message...");
-            _automatic_uplink_ongoing = true;
-            const int ret = _queue->call(this, &LoRaWANStack::send_automatic_uplink_message, mcps_indication->port);
-            MBED_ASSERT(ret != 0);
-            (void)ret;
+            tr_debug("Uplink required by the network...");
+            request_automatic_uplink(mcps_indication->port);
         }
 #else
         send_event_to_application(UPLINK_REQUIRED);
@@ -1079,6 +1872,8 @@ void LoRaWANStack::mcps_indication_handler()
 
 lorawan_status_t LoRaWANStack::state_controller(device_states_t new_state)
 {
+    PROFILE_ZONE(PROFILE_STATE_CONTROLLER);
+
     lorawan_status_t status = LORAWAN_STATUS_OK;
 
     switch (new_state) {
@@ -1117,12 +1912,36 @@ void LoRaWANStack::process_shutdown_state(lorawan_status_t &op_status)
      * Remove channels
      * Radio will be put to sleep by the APIs underneath
      */
+    // keep the session for the next connect()
+    if (_storage && _lw_session.active && (_ctrl_flags & USING_OTAA_FLAG)) {
+        save_session();
+    }
+
     drop_channel_list();
     _loramac.disconnect();
     _lw_session.active = false;
     _device_current_state = DEVICE_STATE_SHUTDOWN;
     op_status = LORAWAN_STATUS_DEVICE_OFF;
     _ctrl_flags = 0;
+    // queued messages are not carried over to the next session
+    memset(_uplink_queue, 0, sizeof(_uplink_queue));
+    _uplink_in_flight = NULL;
+    if (_agg_timer) {
+        _queue->cancel(_agg_timer);
+        _agg_timer = 0;
+    }
+    _agg_len = 0;
+    if (_automatic_uplink_timer) {
+        _queue->cancel(_automatic_uplink_timer);
+        _automatic_uplink_timer = 0;
+    }
+    _last_app_uplink = 0;
+    _app_uplink_period = 0;
+    _app_uplink_seen = false;
+    if (_frag_status_timer) {
+        _queue->cancel(_frag_status_timer);
+        _frag_status_timer = 0;
+    }
     send_event_to_application(DISCONNECTED);
 }
 
@@ -1153,6 +1972,7 @@ void LoRaWANStack::process_status_check_state()
             // event to application
             if (_automatic_uplink_ongoing) {
                 _automatic_uplink_ongoing = false;
+                schedule_uplink_queue();
             } else {
                 mcps_confirm_handler();
             }
@@ -1170,7 +1990,7 @@ void LoRaWANStack::process_scheduling_state(lorawan_status_t &op_status)
 {
     if (_device_current_state != DEVICE_STATE_IDLE) {
         if (_device_current_state != DEVICE_STATE_RECEIVING
-                && _loramac.get_device_class() != CLASS_C) {
+                && !_loramac.is_class_c()) {
             op_status = LORAWAN_STATUS_BUSY;
             return;
         }
@@ -1213,14 +2033,25 @@ void LoRaWANStack::process_connected_state()
     _ctrl_flags |= CONNECTED_FLAG;
     _ctrl_flags &= ~CONN_IN_PROGRESS_FLAG;
 
-    if (_ctrl_flags & USING_OTAA_FLAG) {
+    _lw_session.active = true;
+
+    if (_ctrl_flags & SESSION_RESUMED_FLAG) {
+        tr_debug("OTAA session resumed");
+    } else if (_ctrl_flags & USING_OTAA_FLAG) {
         tr_debug("OTAA Connection OK!");
+        // counters start over, older reservations do not apply
+        reserve_frame_counters(true);
+        if (_storage) {
+            save_session();
+        }
     }
 
-    _lw_session.active = true;
     send_event_to_application(CONNECTED);
 
     _device_current_state = DEVICE_STATE_IDLE;
+
+    // anything queued before the session came up
+    schedule_uplink_queue();
 }
 
 void LoRaWANStack::process_connecting_state(lorawan_status_t &op_status)
@@ -1230,13 +2061,17 @@ void LoRaWANStack::process_connecting_state(lorawan_status_t &op_status)
 
     _device_current_state = DEVICE_STATE_CONNECTING;
 
-    if (_ctrl_flags & USING_OTAA_FLAG) {
+    if ((_ctrl_flags & USING_OTAA_FLAG) && !(_ctrl_flags & SESSION_RESUMED_FLAG)) {
         process_joining_state(op_status);
         return;
     }
 
     op_status = _loramac.join(false);
-    tr_debug("ABP connection OK.");
+    if (_ctrl_flags & USING_OTAA_FLAG) {
+        tr_debug("Resumed connection OK.");
+    } else {
+        tr_debug("ABP connection OK.");
+    }
     process_connected_state();
 }
 
@@ -1263,17 +2098,379 @@ void LoRaWANStack::process_uninitialized_state(lorawan_status_t &op_status)
 
 }
 
-void LoRaWANStack::core_util_atomic_flag_clear(core_util_atomic_flag *flagPtr)
+void LoRaWANStack::start_aggregation_timer(void)
+{
+    if (_agg_window && _agg_len > 0 && !_agg_timer) {
+        _agg_timer = _queue->call_in(_agg_window, this,
+                                     &LoRaWANStack::aggregation_timeout);
+        MBED_ASSERT(_agg_timer != 0);
+    }
+}
+
+void LoRaWANStack::aggregation_timeout(void)
+{
+    _agg_timer = 0;
+
+    // a pack that could not be queued is tried again a window later
+    lorawan_status_t status = flush_records();
+    if (status != LORAWAN_STATUS_OK) {
+        tr_debug("Aggregated uplink deferred: %d", status);
+    }
+}
+
+void LoRaWANStack::handle_frag_package(const uint8_t *payload, uint16_t size,
+                                       bool multicast, uint8_t mc_group)
+{
+    uint8_t ans[FRAG_ANS_MAX_SIZE];
+    uint8_t ans_len = 0;
+    uint16_t pos = 0;
+
+    while (pos < size && ans_len + FRAG_ANS_MAX_LENGTH <= FRAG_ANS_MAX_SIZE) {
+        const uint8_t cid = payload[pos++];
+
+        switch (cid) {
+            case FRAG_PACKAGE_VERSION_REQ:
+                ans[ans_len++] = FRAG_PACKAGE_VERSION_REQ;
+                ans[ans_len++] = FRAG_PACKAGE_IDENTIFIER;
+                ans[ans_len++] = FRAG_PACKAGE_VERSION;
+                break;
+
+            case FRAG_SESSION_STATUS_REQ: {
+                if (pos + 1 > size) {
+                    pos = size;
+                    break;
+                }
+
+                const bool all_participants = payload[pos] & 0x01;
+                const uint8_t index = (payload[pos++] >> 1) & 0x03;
+
+                if (!_frag_status.active || index != _frag_status.frag_index) {
+                    break;
+                }
+
+                // unless all are asked, only devices still missing fragments answer
+                if (!all_participants && _frag_decoder.is_complete()) {
+                    break;
+                }
+
+                if (!multicast) {
+                    ans_len += build_frag_status_ans(&ans[ans_len]);
+                } else if (!_frag_status_timer) {
+                    // spread the answers of the whole group over the
+                    // BlockAckDelay window
+                    const uint32_t window = (1UL << (_frag_ack_delay + 4)) * 1000;
+                    _frag_status_timer = _queue->call_in(rand() % window, this,
+                                                         &LoRaWANStack::send_frag_status);
+                    MBED_ASSERT(_frag_status_timer != 0);
+                }
+                break;
+            }
+
+            case FRAG_SESSION_SETUP_REQ: {
+                if (pos + FRAG_SESSION_SETUP_REQ_SIZE > size) {
+                    pos = size;
+                    break;
+                }
+
+                const uint8_t index = (payload[pos] >> 4) & 0x03;
+                const uint8_t mc_group_mask = payload[pos] & 0x0F;
+                const uint16_t nb_frag = payload[pos + 1] | (payload[pos + 2] << 8);
+                const uint8_t frag_size = payload[pos + 3];
+                const uint8_t control = payload[pos + 4];
+                const uint8_t padding = payload[pos + 5];
+                const uint32_t descriptor = payload[pos + 6]
+                                            | (payload[pos + 7] << 8)
+                                            | ((uint32_t) payload[pos + 8] << 16)
+                                            | ((uint32_t) payload[pos + 9] << 24);
+                uint8_t status = index << 6;
+
+                pos += FRAG_SESSION_SETUP_REQ_SIZE;
+
+                // only the LDPC style parity matrix is defined
+                if ((control >> 3) & 0x07) {
+                    status |= FRAG_SETUP_ENCODING_UNSUPPORTED;
+                }
+
+                // one session at a time, a finished one may be replaced
+                if (_frag_status.active && index != _frag_status.frag_index
+                        && !_frag_decoder.is_complete()) {
+                    status |= FRAG_SETUP_INDEX_UNSUPPORTED;
+                }
+
+                if (status & 0x0F) {
+                    ans[ans_len++] = FRAG_SESSION_SETUP_REQ;
+                    ans[ans_len++] = status;
+                    break;
+                }
+
+                // erasing the area takes long, the session is set up and
+                // answered from the queue
+                reset_frag_session();
+                _frag_status.frag_index = index;
+                _frag_status.mc_group_mask = mc_group_mask;
+                _frag_status.nb_frag = nb_frag;
+                _frag_status.frag_size = frag_size;
+                _frag_status.padding = padding;
+                _frag_status.descriptor = descriptor;
+                _frag_status.addr = _frag_addr;
+                _frag_status.size = (uint32_t) nb_frag * frag_size - padding;
+                _frag_ack_delay = control & 0x07;
+
+                _frag_setup_event = _queue->call(this, &LoRaWANStack::setup_frag_session);
+                MBED_ASSERT(_frag_setup_event != 0);
+                break;
+            }
+
+            case FRAG_SESSION_DELETE_REQ: {
+                if (pos + 1 > size) {
+                    pos = size;
+                    break;
+                }
+
+                const uint8_t index = payload[pos++] & 0x03;
+                uint8_t status = index;
+
+                if (!_frag_status.active || index != _frag_status.frag_index) {
+                    status |= FRAG_DELETE_NO_SESSION;
+                } else {
+                    reset_frag_session();
+                }
+
+                ans[ans_len++] = FRAG_SESSION_DELETE_REQ;
+                ans[ans_len++] = status;
+                break;
+            }
+
+            case FRAG_DATA_FRAGMENT: {
+                // a fragment takes the rest of the frame
+                if (pos + 2 <= size && _frag_status.active
+                        && (!multicast || (_frag_status.mc_group_mask & (1 << mc_group)))) {
+                    const uint16_t index_and_n = payload[pos] | (payload[pos + 1] << 8);
+
+                    if ((index_and_n >> 14) == _frag_status.frag_index
+                            && size - pos - 2 >= _frag_status.frag_size) {
+                        process_data_fragment(index_and_n & 0x3FFF, &payload[pos + 2]);
+                    }
+                }
+                pos = size;
+                break;
+            }
+
+            default:
+                // the rest of the frame cannot be parsed
+                tr_error("Unknown fragmentation command 0x%02x", cid);
+                pos = size;
+                break;
+        }
+    }
+
+    if (ans_len > 0) {
+        send_frag_ans(ans, ans_len);
+    }
+}
+
+void LoRaWANStack::setup_frag_session(void)
+{
+    uint8_t ans[2];
+
+    _frag_setup_event = 0;
+
+    ans[0] = FRAG_SESSION_SETUP_REQ;
+    ans[1] = _frag_status.frag_index << 6;
+
+    if (_frag_decoder.setup(_frag_storage, _frag_addr, _frag_area, _frag_status.nb_frag,
+                            _frag_status.frag_size) != LORAWAN_STATUS_OK) {
+        ans[1] |= FRAG_SETUP_NOT_ENOUGH_MEMORY;
+        reset_frag_session();
+    } else {
+        _frag_status.active = true;
+        tr_info("Fragmentation session %d, %d fragments of %d bytes",
+                _frag_status.frag_index, _frag_status.nb_frag, _frag_status.frag_size);
+    }
+
+    send_frag_ans(ans, sizeof(ans));
+}
+
+void LoRaWANStack::process_data_fragment(uint16_t index, const uint8_t *data)
+{
+    const bool was_complete = _frag_decoder.is_complete();
+
+    if (_frag_decoder.process(index, data) == LORAWAN_STATUS_STORAGE_ERROR) {
+        tr_error("Fragment %d could not be stored", index);
+        return;
+    }
+
+    if (!was_complete && _frag_decoder.is_complete()) {
+        tr_info("Data block complete, %d fragments received",
+                _frag_decoder.get_nb_received());
+        send_event_to_application(FRAG_SESSION_COMPLETE);
+    }
+}
+
+uint8_t LoRaWANStack::build_frag_status_ans(uint8_t *ans)
+{
+    const uint16_t received = MIN(_frag_decoder.get_nb_received(), 0x3FFF);
+    const uint16_t missing = _frag_decoder.get_nb_missing();
+
+    ans[0] = FRAG_SESSION_STATUS_REQ;
+    ans[1] = received & 0xFF;
+    ans[2] = (received >> 8) | (_frag_status.frag_index << 6);
+    ans[3] = MIN(missing, 0xFF);
+    ans[4] = _frag_decoder.is_out_of_memory() ? 0x01 : 0x00;
+
+    return FRAG_ANS_MAX_LENGTH;
+}
+
+void LoRaWANStack::send_frag_status(void)
+{
+    uint8_t ans[FRAG_ANS_MAX_LENGTH];
+
+    _frag_status_timer = 0;
+
+    if (_frag_status.active) {
+        send_frag_ans(ans, build_frag_status_ans(ans));
+    }
+}
+
+void LoRaWANStack::send_frag_ans(const uint8_t *ans, uint8_t length)
+{
+    const int16_t ret = queue_tx(MBED_CONF_LORA_FRAG_PORT, ans, length,
+                                 MSG_UNCONFIRMED_FLAG, FRAG_ANS_PRIORITY, 0);
+    if (ret < 0) {
+        tr_error("Fragmentation answer dropped (%d)", ret);
+    }
+}
+
+void LoRaWANStack::reset_frag_session(void)
+{
+    if (_frag_status_timer) {
+        _queue->cancel(_frag_status_timer);
+        _frag_status_timer = 0;
+    }
+
+    if (_frag_setup_event) {
+        _queue->cancel(_frag_setup_event);
+        _frag_setup_event = 0;
+    }
+
+    _frag_decoder.reset();
+    memset(&_frag_status, 0, sizeof(_frag_status));
+    _frag_ack_delay = 0;
+}
+
+void LoRaWANStack::schedule_uplink_queue(void)
+{
+    for (uint8_t i = 0; i < MBED_CONF_LORA_UPLINK_QUEUE_SIZE; i++) {
+        if (_uplink_queue[i].in_use) {
+            // state machine needs to settle before the next transmission
+            const int ret = _queue->call(this, &LoRaWANStack::drain_uplink_queue);
+            MBED_ASSERT(ret != 0);
+            (void)ret;
+            return;
+        }
+    }
+}
+
+void LoRaWANStack::drain_uplink_queue(void)
+{
+    if (_uplink_in_flight || !_lw_session.active || _loramac.tx_ongoing()) {
+        // kicked again when the ongoing transmission completes
+        return;
+    }
+
+    drop_expired_uplinks(_loramac.get_current_time());
+
+    uplink_queue_entry_t *next = NULL;
+
+    // the highest priority goes first, and the oldest among equals
+    for (uint8_t i = 0; i < MBED_CONF_LORA_UPLINK_QUEUE_SIZE; i++) {
+        uplink_queue_entry_t *entry = &_uplink_queue[i];
+
+        if (entry->in_use
+                && (!next || entry->priority > next->priority
+                    || (entry->priority == next->priority
+                        && (int32_t)(entry->seq - next->seq) < 0))) {
+            next = entry;
+        }
+    }
+
+    if (!next) {
+        return;
+    }
+
+    // the datarate may have dropped since the message was queued
+    if (next->length > _loramac.get_current_max_tx_size()) {
+        tr_error("Uplink #%d does not fit a frame any more", next->id);
+        send_event_to_application(TX_SCHEDULING_ERROR);
+        report_queued_uplink(next, TX_SCHEDULING_ERROR);
+        schedule_uplink_queue();
+        return;
+    }
+
+    int16_t ret = handle_tx(next->port, next->data, next->length, next->flags,
+                            false, false);
+
+    if (ret == LORAWAN_STATUS_WOULD_BLOCK || ret == LORAWAN_STATUS_BUSY) {
+        // somebody else is transmitting, we will get another kick
+        return;
+    }
+
+    if (ret < 0) {
+        tr_error("Uplink #%d could not be scheduled (%d)", next->id, ret);
+        send_event_to_application(TX_SCHEDULING_ERROR);
+        report_queued_uplink(next, TX_SCHEDULING_ERROR);
+        schedule_uplink_queue();
+        return;
+    }
+
+    _uplink_in_flight = next;
+}
+
+void LoRaWANStack::drop_expired_uplinks(lorawan_time_t now)
 {
-    flagPtr->_flag = false;
+    for (uint8_t i = 0; i < MBED_CONF_LORA_UPLINK_QUEUE_SIZE; i++) {
+        uplink_queue_entry_t *entry = &_uplink_queue[i];
+
+        if (entry->in_use && entry != _uplink_in_flight && entry->expiry
+                && (int32_t)(now - entry->expiry) >= 0) {
+            tr_debug("Uplink #%d expired", entry->id);
+            send_event_to_application(UPLINK_EXPIRED);
+            report_queued_uplink(entry, UPLINK_EXPIRED);
+        }
+    }
+}
+
+void LoRaWANStack::report_queued_uplink(uplink_queue_entry_t *entry,
+                                        lorawan_event_t event)
+{
+    if (_callbacks.uplink_status) {
+        const int ret = _queue->call(_callbacks.uplink_status, entry->id, event);
+        MBED_ASSERT(ret != 0);
+        (void)ret;
+    }
+
+    entry->in_use = false;
+}
+
+rx_frame_slot_t *LoRaWANStack::reserve_rx_slot(void)
+{
+    rx_frame_slot_t *slot = NULL;
+
+    core_util_critical_section_enter();
+    for (uint8_t i = 0; i < MBED_CONF_LORA_RX_RING_SLOTS; i++) {
+        if (_rx_ring[i].state == RX_FRAME_FREE) {
+            slot = &_rx_ring[i];
+            slot->state = RX_FRAME_PENDING;
+            slot->seq = _rx_ring_seq++;
+            break;
+        }
+    }
+    core_util_critical_section_exit();
+
+    return slot;
 }
 
-bool LoRaWANStack::core_util_atomic_flag_test_and_set(volatile core_util_atomic_flag *flagPtr)
+void LoRaWANStack::free_rx_slot(rx_frame_slot_t *slot)
 {
-	CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
-    uint8_t currentValue = flagPtr->_flag;
-    flagPtr->_flag = true;
-    CORE_EXIT_CRITICAL();
-    return currentValue;
+    slot->state = RX_FRAME_FREE;
 }
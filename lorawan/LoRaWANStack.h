@@ -48,21 +48,12 @@
 
 #include "lorastack/mac/LoRaMac.h"
 #include "system/LoRaWANTimer.h"
+#include "system/LoRaWANStorage.h"
+#include "system/LoRaWANCounterJournal.h"
+#include "system/LoRaWANFragDecoder.h"
 #include "system/lorawan_data_structures.h"
 #include "LoRaRadio.h"
 
-class LoRaPHY;
-
-/**
- * A lock-free, primitive atomic flag.
- *
- * Emulate C11's atomic_flag. The flag is initially in an indeterminate state
- * unless explicitly initialized with CORE_UTIL_ATOMIC_FLAG_INIT.
- */
-typedef struct core_util_atomic_flag {
-    uint8_t _flag;
-} core_util_atomic_flag;
-
 /** LoRaWANStack Class
  * A controller layer for LoRaWAN MAC and PHY
  */
@@ -81,10 +72,22 @@ public:
      * use in order to report events.
      *
      * @param radio            LoRaRadio object, i.e., the radio driver
-     * @param phy              LoRaPHY object.
+     * @param phy              LoRaPHY object, of the region class of lora.phy
+     *                         with lora.phy-static-dispatch.
      *
      */
-    void bind_phy_and_radio_driver(LoRaRadio &radio, LoRaPHY &phy);
+    void bind_phy_and_radio_driver(LoRaRadio &radio, LoRaPHY_target &phy);
+
+    /** Checks that the PHY layer may be replaced by that of another region.
+     *
+     * The PHY layer may be replaced, with bind_phy_and_radio_driver(), unless
+     * a connection is in progress or established.
+     *
+     * @return          LORAWAN_STATUS_OK if the PHY layer may be replaced,
+     *                  LORAWAN_STATUS_BUSY if a connection is in progress,
+     *                  LORAWAN_STATUS_ALREADY_CONNECTED if connected.
+     */
+    lorawan_status_t check_phy_replaceable();
 
     /** End device initialization.
      * @param queue            A pointer to an EventQueue passed from the application.
@@ -127,6 +130,61 @@ public:
      */
     lorawan_status_t connect(const lorawan_connect_t &connect);
 
+    /** Sets the non-volatile storage for the session.
+     *
+     * With a storage in place, an OTAA session is saved once joined and on
+     * shutdown. The storage beyond the session snapshot holds the frame
+     * counter journal, if there are at least two erase units left, and
+     * connect() resumes a saved session without joining only if the journal
+     * holds the counters of its DevAddr.
+     *
+     * @param storage           Storage to use, NULL to stop persisting.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t set_session_storage(LoRaWANStorage *storage);
+
+    /** Saves the current session.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t save_session();
+
+    /** Discards the saved session, the next connect() joins again.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t forget_session();
+
+    /** Sets the storage receiving fragmented data blocks.
+     *
+     * Enables the Fragmented Data Block Transport on port
+     * MBED_CONF_LORA_FRAG_PORT. Blocks set up by the network are reassembled
+     * in the given area, followed by scratch space for the recovery of lost
+     * fragments.
+     *
+     * @param storage           Storage to use, NULL to disable the package.
+     * @param addr              Start of the area, aligned to an erase unit.
+     * @param size              Size of the area.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t set_frag_session_storage(LoRaWANStorage *storage,
+                                              uint32_t addr, uint32_t size);
+
+    /** Gets the fragmentation session status.
+     *
+     * @param status            [out] Status of the current session.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t get_frag_session_status(lorawan_frag_status_t &status);
+
     /** Adds channels to use.
      *
      * You can provide a list of channels with appropriate parameters filled
@@ -160,6 +218,36 @@ public:
      */
     lorawan_status_t remove_a_channel(uint8_t channel_id);
 
+    /** Adds a multicast group.
+     *
+     * @param group             Group address and session keys
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t add_multicast_group(const multicast_params_t &group);
+
+    /** Removes a multicast group.
+     *
+     * @param address           Address of the group
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t remove_multicast_group(uint32_t address);
+
+    /** Gets the counters of a multicast group.
+     *
+     * @param address           Address of the group
+     *
+     * @param status            Downlink counter and frames accepted
+     *
+     * @return                  LORAWAN_STATUS_OK on success, a negative error
+     *                          code on failure.
+     */
+    lorawan_status_t get_multicast_group_status(uint32_t address,
+                                                lorawan_multicast_status_t &status);
+
     /** Removes a previously set channel plan.
      *
      * @return                  LORAWAN_STATUS_OK on success, a negative error
@@ -253,6 +341,90 @@ public:
                       uint16_t length, uint8_t flags,
                       bool null_allowed = false, bool allow_port_0 = false);
 
+    /** Queues a message for transmission.
+     *
+     * The message is copied into the uplink queue of the stack and sent as
+     * soon as no other transmission is ongoing and duty cycle allows. Messages
+     * are sent in order of priority, and in order of arrival within the same
+     * priority. The outcome is reported per message through the 'uplink_status'
+     * callback, in addition to the usual events.
+     *
+     * @param port              The application port number.
+     *
+     * @param data              A pointer to the data being sent.
+     *
+     * @param length            The size of data in bytes, at most what a frame
+     *                          carries at the current datarate.
+     *
+     * @param flags             MSG_UNCONFIRMED_FLAG, MSG_CONFIRMED_FLAG or
+     *                          MSG_PROPRIETARY_FLAG.
+     *
+     * @param priority          Messages with a higher priority are sent first.
+     *
+     * @param expiry            Time in ms after which the message is discarded
+     *                          if it could not be sent yet, 0 for no expiry.
+     *
+     * @return                  A non-negative message identifier on success,
+     *                          LORAWAN_STATUS_WOULD_BLOCK if the queue is full,
+     *                          LORAWAN_STATUS_LENGTH_ERROR if the message does
+     *                          not fit in a frame, or another negative error code
+     *                          on failure.
+     */
+    int16_t queue_tx(uint8_t port, const uint8_t *data, uint16_t length,
+                     int flags, uint8_t priority, uint32_t expiry);
+
+    /** Enables uplink aggregation.
+     *
+     * Records added with add_record() are packed into a single uplink using
+     * the TLV framing described in lorawan_tlv.h.
+     *
+     * @param port              Application port for the packed uplinks.
+     *
+     * @param flags             MSG_UNCONFIRMED_FLAG or MSG_CONFIRMED_FLAG.
+     *
+     * @param window            Time in ms after the first record until the pack
+     *                          is sent, 0 to send only when full or flushed.
+     *
+     * @param size              Pack size in bytes which triggers sending. The pack
+     *                          is never larger than what the current datarate allows.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, or a negative error code.
+     */
+    lorawan_status_t enable_aggregation(uint8_t port, int flags,
+                                        uint32_t window, uint16_t size);
+
+    /** Disables uplink aggregation, any pending records are sent.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, or a negative error code.
+     */
+    lorawan_status_t disable_aggregation(void);
+
+    /** Adds a record to the current pack.
+     *
+     * @param tag               Record type, 0 - LORAWAN_TLV_MAX_TAG.
+     *
+     * @param data              Record value.
+     *
+     * @param length            Length of the value.
+     *
+     * @return                  LORAWAN_STATUS_OK on success,
+     *                          LORAWAN_STATUS_LENGTH_ERROR if the record does not
+     *                          fit in a frame at the current datarate, or another
+     *                          negative error code. On error, the record is not
+     *                          added.
+     */
+    lorawan_status_t add_record(uint8_t tag, const uint8_t *data, uint8_t length);
+
+    /** Queues the current pack for transmission.
+     *
+     * If the pack does not fit in a single frame at the current datarate, it
+     * is split on record boundaries. What could not be queued is kept and
+     * tried again at the end of the aggregation window.
+     *
+     * @return                  LORAWAN_STATUS_OK on success, or a negative error code.
+     */
+    lorawan_status_t flush_records(void);
+
     /** Receives a message from the Network Server.
      *
      * @param data              A pointer to buffer where the received data will be
@@ -304,6 +476,28 @@ public:
      */
     int16_t handle_rx(uint8_t *data, uint16_t length, uint8_t &port, int &flags, bool validate_params);
 
+    /** Releases a frame handed over through the 'rx_frame' callback.
+     *
+     * The slot in the RX frame ring the frame lies in becomes free for the
+     * next downlink.
+     *
+     * @param frame     Frame as handed over
+     *
+     * @return          LORAWAN_STATUS_OK if the frame was released,
+     *                  LORAWAN_STATUS_NO_OP if it was released already,
+     *                  LORAWAN_STATUS_PARAMETER_INVALID if it is not in the ring.
+     */
+    lorawan_status_t release_rx_frame(const lorawan_rx_frame_t &frame);
+
+    /** Number of received frames dropped so far
+     *
+     * A frame is dropped if it arrives while all slots of the RX frame ring
+     * are taken, or if it does not fit in a slot.
+     *
+     * @return          Count of dropped frames since initialization.
+     */
+    uint32_t get_rx_drop_count() const;
+
     /** Send Link Check Request MAC command.
      *
      *
@@ -327,6 +521,31 @@ public:
      */
     void remove_link_check_request();
 
+    /** Puts DeviceTimeReq on the outgoing messages until answered
+     *
+     * @return          LORAWAN_STATUS_OK, or LORAWAN_STATUS_NOT_INITIALIZED.
+     */
+    lorawan_status_t set_device_time_request();
+
+    /** Reads the GPS time
+     *
+     * @param seconds   [out] Seconds since the GPS epoch.
+     * @param ms        [out] Milliseconds within the second.
+     *
+     * @return          LORAWAN_STATUS_OK, LORAWAN_STATUS_NO_OP if the time
+     *                  was never set, or LORAWAN_STATUS_NOT_INITIALIZED.
+     */
+    lorawan_status_t get_gps_time(uint32_t &seconds, uint16_t &ms);
+
+    /** Reads the measured drift of the device clock
+     *
+     * @param ppm       [out] Drift in ppm, positive if the clock is fast.
+     *
+     * @return          LORAWAN_STATUS_OK, LORAWAN_STATUS_NO_OP if it is
+     *                  not measured yet, or LORAWAN_STATUS_NOT_INITIALIZED.
+     */
+    lorawan_status_t get_clock_drift(int32_t &ppm);
+
     /** Shuts down the LoRaWAN protocol.
      *
      * In response to the user call for disconnection, the stack shuts down itself.
@@ -343,10 +562,21 @@ public:
      *
      * @return                  LORAWAN_STATUS_OK on success,
      *                          LORAWAN_STATUS_UNSUPPORTED is requested class is not supported,
+     *                          LORAWAN_STATUS_NO_ACTIVE_SESSIONS if Class B is
+     *                          requested while not connected,
      *                          or other negative error code if request failed.
      */
     lorawan_status_t set_device_class(const device_class_t &device_class);
 
+    /** Get Class B status
+     *
+     * @param    status         [out] Beacon tracking and ping slot status.
+     *
+     * @return                  LORAWAN_STATUS_OK on success,
+     *                          LORAWAN_STATUS_NOT_INITIALIZED otherwise.
+     */
+    lorawan_status_t get_class_b_status(lorawan_class_b_status_t &status);
+
     /** Acquire TX meta-data
      *
      * Upon successful transmission, TX meta-data will be made available
@@ -464,6 +694,20 @@ private:
      */
     void send_event_to_application(const lorawan_event_t event) const;
 
+    /** Handles beacon acquisition and loss.
+     *
+     * Falls back to Class A when the beacon is lost, then forwards the event
+     * to the application.
+     *
+     * @param  event            BEACON_LOCKED or BEACON_LOST.
+     */
+    void class_b_event_handler(lorawan_event_t event);
+
+    /**
+     * Drops the device time request and tells the application
+     */
+    void device_time_handler(void);
+
     /** Send empty uplink message to network.
      *
      * Sends an empty confirmed message to gateway.
@@ -472,6 +716,26 @@ private:
      */
     void send_automatic_uplink_message(uint8_t port);
 
+    /** Requests an automatic uplink for pending MAC answers or acks.
+     *
+     * If an application uplink is expected before the deadline, the answers
+     * are held back so that they ride along in the FOpts of that uplink. The
+     * automatic uplink is then only sent if the deadline expires first.
+     *
+     * @param  port            Port to use for the automatic uplink.
+     */
+    void request_automatic_uplink(uint8_t port);
+
+    /**
+     * Checks if the application is likely to send before the deadline
+     */
+    bool is_app_uplink_expected(void);
+
+    /**
+     * Fallback for held back MAC answers
+     */
+    void automatic_uplink_deadline(void);
+
     /**
      * TX interrupt handlers and corresponding processors
      */
@@ -487,8 +751,7 @@ private:
                               int8_t snr);
     void rx_timeout_interrupt_handler(void);
     void rx_error_interrupt_handler(void);
-    void process_reception(const uint8_t *payload, uint16_t size, int16_t rssi,
-                           int8_t snr);
+    void process_reception(rx_frame_slot_t *slot);
     void process_reception_timeout(bool is_timeout);
 
     int convert_to_msg_flag(const mcps_type_t type);
@@ -500,29 +763,114 @@ private:
 
     void post_process_tx_with_reception(void);
     void post_process_tx_no_reception(void);
-    void core_util_atomic_flag_clear(core_util_atomic_flag *flagPtr);
-    bool core_util_atomic_flag_test_and_set(volatile core_util_atomic_flag *flagPtr);
+
+    /**
+     * Tries to resume a saved session instead of joining
+     */
+    bool resume_session(void);
+
+    /**
+     * Frame counter journal handling
+     */
+    void restore_frame_counters(void);
+    lorawan_status_t reserve_frame_counters(bool new_session = false);
+    void maintain_frame_counter_journal(void);
+
+    /**
+     * Uplink queue management
+     */
+    void schedule_uplink_queue(void);
+    void drain_uplink_queue(void);
+    void drop_expired_uplinks(lorawan_time_t now);
+    void report_queued_uplink(uplink_queue_entry_t *entry, lorawan_event_t event);
+
+    /**
+     * Starts the aggregation window, unless running or the pack is empty
+     */
+    void start_aggregation_timer(void);
+
+    /**
+     * Aggregation window expiry
+     */
+    void aggregation_timeout(void);
+
+    /**
+     * Fragmented Data Block Transport package handling
+     */
+    void handle_frag_package(const uint8_t *payload, uint16_t size, bool multicast,
+                             uint8_t mc_group);
+    void setup_frag_session(void);
+    void process_data_fragment(uint16_t index, const uint8_t *data);
+    uint8_t build_frag_status_ans(uint8_t *ans);
+    void send_frag_status(void);
+    void send_frag_ans(const uint8_t *ans, uint8_t length);
+    void reset_frag_session(void);
+
+    /**
+     * RX frame ring management, reserve_rx_slot() is called from interrupt
+     * context.
+     */
+    rx_frame_slot_t *reserve_rx_slot(void);
+    void free_rx_slot(rx_frame_slot_t *slot);
+
+    /**
+     * Drops the frame waiting for receive(), freeing the slot it is read from
+     */
+    void drop_pending_receive(void);
 
 private:
-    LoRaMac _loramac;
-    radio_events_t radio_events;
+    // The state touched on every event comes first, within the reach of the
+    // short load and store encodings, the flags packed; the rest goes by
+    // alignment so that it leaves no holes.
+    events::EventQueue *_queue;
+    uint32_t _ctrl_flags;
     device_states_t _device_current_state;
-    lorawan_app_callbacks_t _callbacks;
-    lorawan_session_t _lw_session;
-    loramac_tx_message_t _tx_msg;
-    loramac_rx_message_t _rx_msg;
-    lorawan_tx_metadata _tx_metadata;
-    lorawan_rx_metadata _rx_metadata;
     uint8_t _num_retry;
     uint8_t _qos_cnt;
-    uint32_t _ctrl_flags;
     uint8_t _app_port;
-    bool _link_check_requested;
-    bool _automatic_uplink_ongoing;
-    core_util_atomic_flag _rx_payload_in_use;
-    uint8_t _rx_payload[LORAMAC_PHY_MAXPAYLOAD];
-    events::EventQueue *_queue;
+    uint8_t _automatic_uplink_port;
+    bool _link_check_requested : 1;
+    bool _device_time_requested : 1;
+    bool _automatic_uplink_ongoing : 1;
+    bool _rx_frame_handed_over : 1;
+    bool _agg_enabled : 1;
+    bool _app_uplink_seen : 1;
+    uint8_t _agg_port;
+    uint8_t _agg_flags;
+    uint8_t _frag_ack_delay;
     lorawan_time_t _tx_timestamp;
+    int _automatic_uplink_timer;
+    lorawan_time_t _last_app_uplink;
+    uint32_t _app_uplink_period;
+    uint32_t _rx_ring_seq;
+    rx_frame_slot_t *_rx_msg_slot;
+    volatile uint32_t _rx_drop_count;
+    uplink_queue_entry_t *_uplink_in_flight;
+    uint32_t _uplink_seq;
+    int16_t _uplink_next_id;
+    uint16_t _agg_size;
+    uint16_t _agg_len;
+    uint32_t _agg_window;
+    int _agg_timer;
+    LoRaWANStorage *_storage;
+    LoRaWANStorage *_frag_storage;
+    uint32_t _frag_addr;
+    uint32_t _frag_area;
+    int _frag_status_timer;
+    int _frag_setup_event;
+    lorawan_session_t _lw_session;
+    lorawan_tx_metadata _tx_metadata;
+    lorawan_rx_metadata _rx_metadata;
+    lorawan_frag_status_t _frag_status;
+    loramac_rx_message_t _rx_msg;
+    lorawan_app_callbacks_t _callbacks;
+    radio_events_t radio_events;
+    LoRaMac _loramac;
+    rx_frame_slot_t _rx_ring[MBED_CONF_LORA_RX_RING_SLOTS];
+    uplink_queue_entry_t _uplink_queue[MBED_CONF_LORA_UPLINK_QUEUE_SIZE];
+    LoRaWANCounterJournal _fcnt_journal;
+    LoRaWANFragDecoder _frag_decoder;
+    uint8_t _agg_buffer[MBED_CONF_LORA_TX_MAX_SIZE];
 };
 
 #endif /* LORAWANSTACK_H_ */
@@ -23,6 +23,8 @@ SPDX-License-Identifier: BSD-3-Clause
 */
 #include <stdlib.h>
 #include "LoRaMac.h"
+#include "../../system/lorawan_crc.h"
+#include "platform/profile.h"
 #include "trace.h"
 
 using namespace events;
@@ -38,6 +40,11 @@ using namespace mbed;
  */
 #define LORA_MAC_COMMAND_MAX_FOPTS_LENGTH           15
 
+/*!
+ * Accuracy (ms) of DeviceTimeAns, its fractional part is in 1/256 s
+ */
+#define LORAMAC_DEVICE_TIME_ACCURACY                4
+
 /*!
  * LoRaMac duty cycle for the back-off procedure during the first hour.
  */
@@ -64,24 +71,30 @@ using namespace mbed;
 #define DOWN_LINK                                   1
 
 LoRaMac::LoRaMac()
-    : _lora_time(),
-      _lora_phy(NULL),
+    : _lora_phy(NULL),
+      _ev_queue(NULL),
+      _device_class(CLASS_A),
+      _prev_qos_level(LORAWAN_DEFAULT_QOS),
+      _multicast_group_count(0),
+      _is_nwk_joined(false),
+      _can_cancel_tx(true),
+      _continuous_rx2_window_open(false),
+      _demod_ongoing(false),
+      _class_a_exchange_ongoing(false),
+      _params(),
+      _lora_time(),
       _mac_commands(),
       _channel_plan(),
       _lora_crypto(),
-      _ev_queue(NULL),
       _mcps_indication(),
       _mcps_confirmation(),
       _mlme_indication(),
-      _mlme_confirmation(),
-      _is_nwk_joined(false),
-      _can_cancel_tx(true),
-      _continuous_rx2_window_open(false),
-      _device_class(CLASS_A),
-      _prev_qos_level(LORAWAN_DEFAULT_QOS),
-      _demod_ongoing(false)
+      _mlme_confirmation()
 {
-    memset(&_params, 0, sizeof(_params));
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    memset(_multicast_groups, 0, sizeof(_multicast_groups));
+    memset(_multicast_index, 0, sizeof(_multicast_index));
+#endif
     _params.keys.dev_eui = NULL;
     _params.keys.app_eui = NULL;
     _params.keys.app_key = NULL;
@@ -95,7 +108,6 @@ LoRaMac::LoRaMac()
     _params.net_id = 0;
     _params.dev_addr = 0;
     _params.tx_buffer_len = 0;
-    _params.rx_buffer_len = 0;
     _params.ul_frame_counter = 0;
     _params.dl_frame_counter = 0;
     _params.is_rx_window_enabled = true;
@@ -109,8 +121,6 @@ LoRaMac::LoRaMac()
     _params.is_ack_retry_timeout_expired = false;
     _params.timers.tx_toa = 0;
 
-    _params.multicast_channels = NULL;
-
 
     _params.sys_params.adr_on = false;
     _params.sys_params.max_duty_cycle = 0;
@@ -122,6 +132,11 @@ LoRaMac::LoRaMac()
 
 LoRaMac::~LoRaMac()
 {
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    for (uint8_t i = 0; i < _multicast_group_count; i++) {
+        _lora_crypto.free_payload_key(&_multicast_groups[_multicast_index[i]].app_skey_ctx);
+    }
+#endif
 }
 
 /***************************************************************************
@@ -203,23 +218,22 @@ rx_slot_t LoRaMac::get_current_slot(void)
 /**
  * This part handles incoming frames in response to Radio RX Interrupt
  */
-void LoRaMac::handle_join_accept_frame(const uint8_t *payload, uint16_t size)
+void LoRaMac::handle_join_accept_frame(uint8_t *payload, uint16_t size)
 {
     uint32_t mic = 0;
     uint32_t mic_rx = 0;
 
     _mlme_confirmation.nb_retries = _params.join_request_trial_counter;
 
+    // Join Accept is decrypted in place, MHDR stays as it is
     if (0 != _lora_crypto.decrypt_join_frame(payload + 1, size - 1,
                                              _params.keys.app_key, APPKEY_KEY_LENGTH,
-                                             _params.rx_buffer + 1)) {
+                                             payload + 1)) {
         _mlme_confirmation.status = LORAMAC_EVENT_INFO_STATUS_CRYPTO_FAIL;
         return;
     }
 
-    _params.rx_buffer[0] = payload[0];
-
-    if (_lora_crypto.compute_join_frame_mic(_params.rx_buffer,
+    if (_lora_crypto.compute_join_frame_mic(payload,
                                             size - LORAMAC_MFR_LEN,
                                             _params.keys.app_key,
                                             APPKEY_KEY_LENGTH,
@@ -228,16 +242,16 @@ void LoRaMac::handle_join_accept_frame(const uint8_t *payload, uint16_t size)
         return;
     }
 
-    mic_rx |= (uint32_t) _params.rx_buffer[size - LORAMAC_MFR_LEN];
-    mic_rx |= ((uint32_t) _params.rx_buffer[size - LORAMAC_MFR_LEN + 1] << 8);
-    mic_rx |= ((uint32_t) _params.rx_buffer[size - LORAMAC_MFR_LEN + 2] << 16);
-    mic_rx |= ((uint32_t) _params.rx_buffer[size - LORAMAC_MFR_LEN + 3] << 24);
+    mic_rx |= (uint32_t) payload[size - LORAMAC_MFR_LEN];
+    mic_rx |= ((uint32_t) payload[size - LORAMAC_MFR_LEN + 1] << 8);
+    mic_rx |= ((uint32_t) payload[size - LORAMAC_MFR_LEN + 2] << 16);
+    mic_rx |= ((uint32_t) payload[size - LORAMAC_MFR_LEN + 3] << 24);
 
     if (mic_rx == mic) {
         _lora_time.stop(_params.timers.rx_window2_timer);
         if (_lora_crypto.compute_skeys_for_join_frame(_params.keys.app_key,
                                                       APPKEY_KEY_LENGTH,
-                                                      _params.rx_buffer + 1,
+                                                      payload + 1,
                                                       _params.dev_nonce,
                                                       _params.keys.nwk_skey,
                                                       _params.keys.app_skey) != 0) {
@@ -245,19 +259,19 @@ void LoRaMac::handle_join_accept_frame(const uint8_t *payload, uint16_t size)
             return;
         }
 
-        _params.net_id = (uint32_t) _params.rx_buffer[4];
-        _params.net_id |= ((uint32_t) _params.rx_buffer[5] << 8);
-        _params.net_id |= ((uint32_t) _params.rx_buffer[6] << 16);
+        _params.net_id = (uint32_t) payload[4];
+        _params.net_id |= ((uint32_t) payload[5] << 8);
+        _params.net_id |= ((uint32_t) payload[6] << 16);
 
-        _params.dev_addr = (uint32_t) _params.rx_buffer[7];
-        _params.dev_addr |= ((uint32_t) _params.rx_buffer[8] << 8);
-        _params.dev_addr |= ((uint32_t) _params.rx_buffer[9] << 16);
-        _params.dev_addr |= ((uint32_t) _params.rx_buffer[10] << 24);
+        _params.dev_addr = (uint32_t) payload[7];
+        _params.dev_addr |= ((uint32_t) payload[8] << 8);
+        _params.dev_addr |= ((uint32_t) payload[9] << 16);
+        _params.dev_addr |= ((uint32_t) payload[10] << 24);
 
-        _params.sys_params.rx1_dr_offset = (_params.rx_buffer[11] >> 4) & 0x07;
-        _params.sys_params.rx2_channel.datarate = _params.rx_buffer[11] & 0x0F;
+        _params.sys_params.rx1_dr_offset = (payload[11] >> 4) & 0x07;
+        _params.sys_params.rx2_channel.datarate = payload[11] & 0x0F;
 
-        _params.sys_params.recv_delay1 = (_params.rx_buffer[12] & 0x0F);
+        _params.sys_params.recv_delay1 = (payload[12] & 0x0F);
 
         if (_params.sys_params.recv_delay1 == 0) {
             _params.sys_params.recv_delay1 = 1;
@@ -267,7 +281,9 @@ void LoRaMac::handle_join_accept_frame(const uint8_t *payload, uint16_t size)
         _params.sys_params.recv_delay2 = _params.sys_params.recv_delay1 + 1000;
 
         // Size of the regular payload is 12. Plus 1 byte MHDR and 4 bytes MIC
-        _lora_phy->apply_cf_list(&_params.rx_buffer[13], size - 17);
+        if (LoRaPHY_target::cflist_supported) {
+            _lora_phy->apply_cf_list(&payload[13], size - 17);
+        }
 
         _mlme_confirmation.status = LORAMAC_EVENT_INFO_STATUS_OK;
         _is_nwk_joined = true;
@@ -338,11 +354,12 @@ bool LoRaMac::message_integrity_check(const uint8_t *const payload,
     return true;
 }
 
-void LoRaMac::extract_data_and_mac_commands(const uint8_t *payload,
+void LoRaMac::extract_data_and_mac_commands(uint8_t *payload,
                                             uint16_t size,
                                             uint8_t fopts_len,
                                             uint8_t *nwk_skey,
                                             uint8_t *app_skey,
+                                            multicast_group_t *group,
                                             uint32_t address,
                                             uint32_t downlink_counter,
                                             int16_t rssi,
@@ -366,13 +383,15 @@ void LoRaMac::extract_data_and_mac_commands(const uint8_t *payload,
                                              address,
                                              DOWN_LINK,
                                              downlink_counter,
-                                             _params.rx_buffer) != 0) {
+                                             payload + payload_start_index) != 0) {
                 _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_CRYPTO_FAIL;
             }
 
-            if (_mac_commands.process_mac_commands(_params.rx_buffer, 0, frame_len,
+            if (_mac_commands.process_mac_commands(payload + payload_start_index,
+                                                   0, frame_len,
                                                    snr, _mlme_confirmation,
-                                                   _params.sys_params, *_lora_phy)
+                                                   _params.sys_params, *_lora_phy,
+                                                   _class_b)
                     != LORAWAN_STATUS_OK) {
                 _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_ERROR;
                 return;
@@ -401,7 +420,8 @@ void LoRaMac::extract_data_and_mac_commands(const uint8_t *payload,
                                                snr,
                                                _mlme_confirmation,
                                                _params.sys_params,
-                                               *_lora_phy) != LORAWAN_STATUS_OK) {
+                                               *_lora_phy,
+                                               _class_b) != LORAWAN_STATUS_OK) {
             _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_ERROR;
             return;
         }
@@ -413,17 +433,33 @@ void LoRaMac::extract_data_and_mac_commands(const uint8_t *payload,
     }
 
     // sizeof app_skey must be the same as _params.keys.app_skey
-    if (_lora_crypto.decrypt_payload(payload + payload_start_index,
-                                     frame_len,
-                                     app_skey,
-                                     sizeof(_params.keys.app_skey) * 8,
-                                     address,
-                                     DOWN_LINK,
-                                     downlink_counter,
-                                     _params.rx_buffer) != 0) {
+    // FRMPayload is decrypted in place, the application is handed a view
+    // into the stack owned reception buffer. Multicast groups carry their
+    // application key pre-expanded.
+    int ret;
+    if (group != NULL) {
+        ret = _lora_crypto.decrypt_payload(payload + payload_start_index,
+                                           frame_len,
+                                           &group->app_skey_ctx,
+                                           address,
+                                           DOWN_LINK,
+                                           downlink_counter,
+                                           payload + payload_start_index);
+    } else {
+        ret = _lora_crypto.decrypt_payload(payload + payload_start_index,
+                                           frame_len,
+                                           app_skey,
+                                           sizeof(_params.keys.app_skey) * 8,
+                                           address,
+                                           DOWN_LINK,
+                                           downlink_counter,
+                                           payload + payload_start_index);
+    }
+
+    if (ret != 0) {
         _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_CRYPTO_FAIL;
     } else {
-        _mcps_indication.buffer = _params.rx_buffer;
+        _mcps_indication.buffer = payload + payload_start_index;
         _mcps_indication.buffer_size = frame_len;
         _mcps_indication.is_data_recvd = true;
     }
@@ -437,7 +473,8 @@ void LoRaMac::extract_mac_commands_only(const uint8_t *payload,
     if (fopts_len > 0) {
         if (_mac_commands.process_mac_commands(payload, 8, payload_start_index,
                                                snr, _mlme_confirmation,
-                                               _params.sys_params, *_lora_phy)
+                                               _params.sys_params, *_lora_phy,
+                                               _class_b)
                 != LORAWAN_STATUS_OK) {
             _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_ERROR;
             return;
@@ -450,7 +487,7 @@ void LoRaMac::extract_mac_commands_only(const uint8_t *payload,
     }
 }
 
-void LoRaMac::handle_data_frame(const uint8_t *const payload,
+void LoRaMac::handle_data_frame(uint8_t *const payload,
                                 const uint16_t size,
                                 uint8_t ptr_pos,
                                 uint8_t msg_type,
@@ -461,7 +498,7 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
 
     bool is_multicast = false;
     loramac_frame_ctrl_t fctrl;
-    multicast_params_t *cur_multicast_params;
+    multicast_group_t *cur_multicast_group = NULL;
     uint32_t address = 0;
     uint32_t downlink_counter = 0;
     uint8_t app_payload_start_index = 0;
@@ -475,18 +512,13 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
 
     if (address != _params.dev_addr) {
         // check if Multicast is destined for us
-        cur_multicast_params = _params.multicast_channels;
-
-        while (cur_multicast_params != NULL) {
-            if (address == cur_multicast_params->address) {
-                is_multicast = true;
-                nwk_skey = cur_multicast_params->nwk_skey;
-                app_skey = cur_multicast_params->app_skey;
-                downlink_counter = cur_multicast_params->dl_frame_counter;
-                break;
-            }
+        cur_multicast_group = find_multicast_group(address);
 
-            cur_multicast_params = cur_multicast_params->next;
+        if (cur_multicast_group != NULL) {
+            is_multicast = true;
+            nwk_skey = cur_multicast_group->nwk_skey;
+            app_skey = NULL;
+            downlink_counter = cur_multicast_group->dl_frame_counter;
         }
 
         if (!is_multicast) {
@@ -520,6 +552,7 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
     _mcps_indication.is_data_recvd = false;
     _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_OK;
     _mcps_indication.multicast = is_multicast;
+    _mcps_indication.multicast_group = is_multicast ? cur_multicast_group->group_id : 0;
     _mcps_indication.fpending_status = fctrl.bits.fpending;
     _mcps_indication.buffer = NULL;
     _mcps_indication.buffer_size = 0;
@@ -537,8 +570,8 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
         _mcps_indication.type = MCPS_MULTICAST;
 
         // Discard if its a repeated message
-        if ((cur_multicast_params->dl_frame_counter == downlink_counter)
-                && (cur_multicast_params->dl_frame_counter != 0)) {
+        if ((cur_multicast_group->dl_frame_counter == downlink_counter)
+                && (cur_multicast_group->dl_frame_counter != 0)) {
             _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_DOWNLINK_REPEATED;
             _mcps_indication.dl_frame_counter = downlink_counter;
             _mcps_indication.pending = false;
@@ -546,7 +579,8 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
             return;
         }
 
-        cur_multicast_params->dl_frame_counter = downlink_counter;
+        cur_multicast_group->dl_frame_counter = downlink_counter;
+        cur_multicast_group->rx_count++;
 
     } else {
         if (msg_type == FRAME_TYPE_DATA_CONFIRMED_DOWN) {
@@ -591,7 +625,7 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
         _lora_time.stop(_params.timers.rx_window2_timer);
     }
 
-    if (_device_class == CLASS_C) {
+    if (is_class_c()) {
         _lora_time.stop(_rx2_closure_timer_for_class_c);
     }
 
@@ -604,19 +638,17 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
 
     if (frame_len > 0) {
         extract_data_and_mac_commands(payload, size, fctrl.bits.fopts_len,
-                                      nwk_skey, app_skey, address,
-                                      downlink_counter, rssi, snr);
+                                      nwk_skey, app_skey, cur_multicast_group,
+                                      address, downlink_counter, rssi, snr);
     } else {
         extract_mac_commands_only(payload, snr, fctrl.bits.fopts_len);
     }
 
     // Handle proprietary messages.
     if (msg_type == FRAME_TYPE_PROPRIETARY) {
-        memcpy(_params.rx_buffer, &payload[ptr_pos], size);
-
         _mcps_indication.type = MCPS_PROPRIETARY;
         _mcps_indication.status = LORAMAC_EVENT_INFO_STATUS_OK;
-        _mcps_indication.buffer = _params.rx_buffer;
+        _mcps_indication.buffer = &payload[ptr_pos];
         _mcps_indication.buffer_size = size - ptr_pos;
     }
 
@@ -625,8 +657,7 @@ void LoRaMac::handle_data_frame(const uint8_t *const payload,
         _lora_time.stop(_params.timers.ack_timeout_timer);
     }
 
-    channel_params_t *list = _lora_phy->get_phy_channels();
-    _mcps_indication.channel = list[_params.channel].frequency;
+    _mcps_indication.channel = _lora_phy->get_channel_frequency(_params.channel);
 
     if (get_current_slot() == RX_SLOT_WIN_1) {
         _mcps_indication.rx_toa = _lora_phy->get_rx_time_on_air(_params.rx_window1_config.modem_type,
@@ -642,9 +673,24 @@ void LoRaMac::set_batterylevel_callback(mbed::Callback<uint8_t(void)> battery_le
     _mac_commands.set_batterylevel_callback(battery_level);
 }
 
+bool LoRaMac::get_gps_time(uint32_t &seconds, uint16_t &ms)
+{
+    return _lora_time.get_gps_time(seconds, ms);
+}
+
+bool LoRaMac::get_clock_drift(int32_t &ppm)
+{
+    if (!_clock_estimator.has_drift()) {
+        return false;
+    }
+
+    ppm = _clock_estimator.get_drift();
+    return true;
+}
+
 void LoRaMac::on_radio_tx_done(lorawan_time_t timestamp)
 {
-    if (_device_class == CLASS_C) {
+    if (is_class_c()) {
         // this will open a continuous RX2 window until time==RECV_DELAY1
         open_rx2_window();
     } else {
@@ -670,7 +716,7 @@ void LoRaMac::on_radio_tx_done(lorawan_time_t timestamp)
         // If class C and an Unconfirmed messgae is outgoing,
         // this will start a timer which will invoke rx2 would be
         // closure handler
-        if (get_device_class() == CLASS_C) {
+        if (is_class_c()) {
             _lora_time.start(_rx2_closure_timer_for_class_c,
                              (_params.rx_window2_delay - time_diff) +
                              _params.rx_window2_config.window_timeout_ms);
@@ -686,8 +732,11 @@ void LoRaMac::on_radio_tx_done(lorawan_time_t timestamp)
     } else {
         _mcps_confirmation.status = LORAMAC_EVENT_INFO_STATUS_OK;
         _mlme_confirmation.status = LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT;
+        end_class_a_exchange();
     }
 
+    _class_b.on_uplink_done(timestamp);
+
     _params.last_channel_idx = _params.channel;
 
     _lora_phy->set_last_tx_done(_params.channel, _is_nwk_joined, timestamp);
@@ -697,14 +746,30 @@ void LoRaMac::on_radio_tx_done(lorawan_time_t timestamp)
     _mac_commands.clear_command_buffer();
 }
 
-void LoRaMac::on_radio_rx_done(const uint8_t *const payload, uint16_t size,
-                               int16_t rssi, int8_t snr)
+void LoRaMac::on_radio_rx_done(uint8_t *const payload, uint16_t size,
+                               int16_t rssi, int8_t snr,
+                               lorawan_time_t timestamp)
 {
+    // A beacon is no LoRaWAN frame, it goes to the Class B subsystem only
+    if (_params.rx_slot == RX_SLOT_WIN_BEACON) {
+        _lora_phy->put_radio_to_sleep();
+        _class_b.on_window_closed(RX_SLOT_WIN_BEACON, true);
+        _class_b.on_beacon_received(payload, size, rssi, snr, timestamp);
+        return;
+    }
+
+    if (_params.rx_slot == RX_SLOT_WIN_PING_SLOT) {
+        _class_b.on_window_closed(RX_SLOT_WIN_PING_SLOT, true);
+    } else if (_params.rx_slot == RX_SLOT_WIN_1 || _params.rx_slot == RX_SLOT_WIN_2) {
+        track_rx_offset(size, timestamp);
+        end_class_a_exchange();
+    }
+
     _demod_ongoing = false;
-    if (_device_class == CLASS_C && !_continuous_rx2_window_open) {
+    if (is_class_c() && !_continuous_rx2_window_open) {
         _lora_time.stop(_rx2_closure_timer_for_class_c);
         open_rx2_window();
-    } else if (_device_class != CLASS_C) {
+    } else if (!is_class_c()) {
         _lora_time.stop(_params.timers.rx_window1_timer);
         _lora_phy->put_radio_to_sleep();
     }
@@ -747,12 +812,14 @@ void LoRaMac::on_radio_tx_timeout(void)
     _lora_time.stop(_rx2_closure_timer_for_class_c);
     _lora_time.stop(_params.timers.ack_timeout_timer);
 
-    if (_device_class == CLASS_C) {
+    if (is_class_c()) {
         open_rx2_window();
     } else {
         _lora_phy->put_radio_to_sleep();
     }
 
+    end_class_a_exchange();
+
     _mcps_confirmation.status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
     _mlme_confirmation.status = LORAMAC_EVENT_INFO_STATUS_TX_TIMEOUT;
 
@@ -770,8 +837,15 @@ void LoRaMac::on_radio_tx_timeout(void)
 
 void LoRaMac::on_radio_rx_timeout(bool is_timeout)
 {
+    if (_params.rx_slot == RX_SLOT_WIN_BEACON
+            || _params.rx_slot == RX_SLOT_WIN_PING_SLOT) {
+        _lora_phy->put_radio_to_sleep();
+        _class_b.on_window_closed(_params.rx_slot, false);
+        return;
+    }
+
     _demod_ongoing = false;
-    if (_device_class == CLASS_A) {
+    if (!is_class_c()) {
         _lora_phy->put_radio_to_sleep();
     }
 
@@ -785,7 +859,7 @@ void LoRaMac::on_radio_rx_timeout(bool is_timeout)
                                     LORAMAC_EVENT_INFO_STATUS_RX1_TIMEOUT :
                                     LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
 
-        if (_device_class != CLASS_C) {
+        if (!is_class_c()) {
             if (_lora_time.get_elapsed_time(_params.timers.aggregated_last_tx_time) >= _params.rx_window2_delay) {
                 _lora_time.stop(_params.timers.rx_window2_timer);
             }
@@ -800,6 +874,15 @@ void LoRaMac::on_radio_rx_timeout(bool is_timeout)
         _mlme_confirmation.status = is_timeout ?
                                     LORAMAC_EVENT_INFO_STATUS_RX2_TIMEOUT :
                                     LORAMAC_EVENT_INFO_STATUS_RX2_ERROR;
+
+        // the acknowledgement was due in either window, the windows may
+        // have been too narrow
+        if (_params.is_node_ack_requested && is_timeout
+                && _params.rx_slot == RX_SLOT_WIN_2) {
+            _clock_estimator.on_rx_missed();
+        }
+
+        end_class_a_exchange();
     }
 }
 
@@ -898,12 +981,12 @@ void LoRaMac::open_rx1_window(void)
     _lora_time.stop(_params.timers.rx_window1_timer);
     _params.rx_slot = RX_SLOT_WIN_1;
 
-    channel_params_t *active_channel_list = _lora_phy->get_phy_channels();
     _params.rx_window1_config.channel = _params.channel;
-    _params.rx_window1_config.frequency = active_channel_list[_params.channel].frequency;
+    _params.rx_window1_config.frequency = _lora_phy->get_channel_frequency(_params.channel);
     // Apply the alternative RX 1 window frequency, if it is available
-    if (active_channel_list[_params.channel].rx1_frequency != 0) {
-        _params.rx_window1_config.frequency = active_channel_list[_params.channel].rx1_frequency;
+    const uint32_t rx1_frequency = _lora_phy->get_channel_rx1_frequency(_params.channel);
+    if (rx1_frequency != 0) {
+        _params.rx_window1_config.frequency = rx1_frequency;
     }
     _params.rx_window1_config.dr_offset = _params.sys_params.rx1_dr_offset;
     _params.rx_window1_config.dl_dwell_time = _params.sys_params.downlink_dwell_time;
@@ -911,7 +994,7 @@ void LoRaMac::open_rx1_window(void)
     _params.rx_window1_config.is_rx_continuous = false;
     _params.rx_window1_config.rx_slot = _params.rx_slot;
 
-    if (_device_class == CLASS_C) {
+    if (is_class_c()) {
         _lora_phy->put_radio_to_standby();
     }
 
@@ -938,7 +1021,7 @@ void LoRaMac::open_rx2_window()
     _params.rx_window2_config.dl_dwell_time = _params.sys_params.downlink_dwell_time;
     _params.rx_window2_config.is_repeater_supported = _params.is_repeater_supported;
 
-    if (get_device_class() == CLASS_C) {
+    if (is_class_c()) {
         _params.rx_window2_config.is_rx_continuous = true;
     } else {
         _params.rx_window2_config.is_rx_continuous = false;
@@ -956,6 +1039,88 @@ void LoRaMac::open_rx2_window()
     tr_debug("RX2 slot open, Freq = %lu", _params.rx_window2_config.frequency);
 }
 
+bool LoRaMac::open_class_b_window(rx_config_params_t *config)
+{
+    Lock lock(*this);
+
+    if (_class_a_exchange_ongoing) {
+        return false;
+    }
+
+    _params.rx_slot = config->rx_slot;
+
+    if (config->rx_slot == RX_SLOT_WIN_BEACON) {
+        _lora_phy->rx_beacon_config(config);
+    } else {
+        config->dl_dwell_time = _params.sys_params.downlink_dwell_time;
+        config->is_repeater_supported = _params.is_repeater_supported;
+        _mcps_indication.rx_datarate = config->datarate;
+        _lora_phy->rx_config(config);
+    }
+
+    _lora_phy->handle_receive();
+
+    return true;
+}
+
+void LoRaMac::close_class_b_window(void)
+{
+    Lock lock(*this);
+
+    if (_params.rx_slot == RX_SLOT_WIN_BEACON && !_class_a_exchange_ongoing) {
+        _lora_phy->put_radio_to_sleep();
+    }
+}
+
+void LoRaMac::track_rx_offset(uint16_t size, lorawan_time_t timestamp)
+{
+    const rx_config_params_t &config = (_params.rx_slot == RX_SLOT_WIN_1) ?
+                                       _params.rx_window1_config :
+                                       _params.rx_window2_config;
+    uint32_t delay = (_params.rx_slot == RX_SLOT_WIN_1) ?
+                     _params.rx_window1_delay : _params.rx_window2_delay;
+
+    // a Class C window is open long before the frame, it tells nothing
+    if (config.is_rx_continuous) {
+        return;
+    }
+
+    // the frame was due at the nominal delay, without the window offset
+    lorawan_time_t due = _params.timers.aggregated_last_tx_time
+                         + (delay - config.window_offset);
+    lorawan_time_t start = timestamp
+                           - _lora_phy->get_rx_time_on_air(config.modem_type, size);
+
+    _clock_estimator.add_rx_offset(config.datarate, (int32_t)(start - due));
+}
+
+void LoRaMac::handle_device_time_ans(uint32_t seconds, uint8_t fraction)
+{
+    // the answer refers to the end of the uplink which carried the request
+    lorawan_time_t at = _params.timers.aggregated_last_tx_time;
+    uint16_t ms = ((uint16_t) fraction * 1000) >> 8;
+
+    tr_debug("DeviceTimeAns: GPS time = %lu.%03u", (unsigned long) seconds, ms);
+
+    _lora_time.set_gps_time(seconds, ms, at);
+    _clock_estimator.add_time_reference(seconds, ms, at, LORAMAC_DEVICE_TIME_ACCURACY);
+
+    if (_device_time_handler) {
+        _device_time_handler();
+        _device_time_handler = NULL;
+    }
+}
+
+void LoRaMac::end_class_a_exchange(void)
+{
+    if (!_class_a_exchange_ongoing) {
+        return;
+    }
+
+    _class_a_exchange_ongoing = false;
+    _class_b.on_class_a_done();
+}
+
 void LoRaMac::on_ack_timeout_timer_event(void)
 {
     Lock lock(*this);
@@ -1051,11 +1216,19 @@ lorawan_status_t LoRaMac::send(loramac_mhdr_t *machdr, const uint8_t fport,
 
     fctrl.value = 0;
     fctrl.bits.fopts_len = 0;
-    fctrl.bits.fpending = 0;
+    // In uplinks this bit tells the network that ping slots are open
+    fctrl.bits.fpending = _class_b.is_ping_slot_ready();
     fctrl.bits.ack = false;
     fctrl.bits.adr_ack_req = false;
     fctrl.bits.adr = _params.sys_params.adr_on;
 
+    if (_class_b.needs_ping_slot_info()) {
+        _mac_commands.add_ping_slot_info_req(_class_b.get_ping_slot_periodicity());
+    }
+    if (_class_b.needs_beacon_timing()) {
+        _mac_commands.add_beacon_timing_req();
+    }
+
     lorawan_status_t status = prepare_frame(machdr, &fctrl, fport, fbuffer,
                                             fbuffer_size);
 
@@ -1136,10 +1309,12 @@ lorawan_status_t LoRaMac::schedule_tx()
     next_channel.joined = _is_nwk_joined;
     next_channel.last_aggregate_tx_time = _params.timers.aggregated_last_tx_time;
 
-    lorawan_status_t status = _lora_phy->set_next_channel(&next_channel,
-                                                          &channel,
-                                                          &backoff_time,
-                                                          &aggregated_timeoff);
+    lorawan_status_t status;
+    {
+        PROFILE_ZONE(PROFILE_SET_NEXT_CHANNEL);
+        status = _lora_phy->set_next_channel(&next_channel, &channel, &backoff_time,
+                                             &aggregated_timeoff);
+    }
 
     _params.channel = channel;
     _params.timers.aggregated_timeoff = aggregated_timeoff;
@@ -1167,13 +1342,19 @@ lorawan_status_t LoRaMac::schedule_tx()
              _params.channel, _params.sys_params.channel_data_rate, rx1_dr);
 
 
+    // the windows are timed from the end of the uplink, the drift over the
+    // RX delays is negligible; they are centred on where the downlinks of
+    // their datarate were seen to land
+    uint8_t rx2_dr = _params.sys_params.rx2_channel.datarate;
+
     _lora_phy->compute_rx_win_params(rx1_dr, MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
-                                     MBED_CONF_LORA_MAX_SYS_RX_ERROR,
+                                     _clock_estimator.get_rx_error(rx1_dr, 0),
+                                     _clock_estimator.get_rx_shift(rx1_dr),
                                      &_params.rx_window1_config);
 
-    _lora_phy->compute_rx_win_params(_params.sys_params.rx2_channel.datarate,
-                                     MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
-                                     MBED_CONF_LORA_MAX_SYS_RX_ERROR,
+    _lora_phy->compute_rx_win_params(rx2_dr, MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
+                                     _clock_estimator.get_rx_error(rx2_dr, 0),
+                                     _clock_estimator.get_rx_shift(rx2_dr),
                                      &_params.rx_window2_config);
 
     if (!_is_nwk_joined) {
@@ -1258,11 +1439,11 @@ void LoRaMac::reset_mac_parameters(void)
     _params.is_node_ack_requested = false;
     _params.is_srv_ack_requested = false;
 
-    multicast_params_t *cur = _params.multicast_channels;
-    while (cur != NULL) {
-        cur->dl_frame_counter = 0;
-        cur = cur->next;
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    for (uint8_t i = 0; i < _multicast_group_count; i++) {
+        _multicast_groups[_multicast_index[i]].dl_frame_counter = 0;
     }
+#endif
     _params.channel = 0;
     _params.last_channel_idx = _params.channel;
 
@@ -1379,6 +1560,21 @@ int16_t LoRaMac::prepare_ongoing_tx(const uint8_t port,
     return _ongoing_tx_msg.f_buffer_size;
 }
 
+uint8_t LoRaMac::get_current_max_tx_size(void)
+{
+    uint8_t fopts_len = _mac_commands.get_mac_cmd_length()
+                        + _mac_commands.get_repeat_commands_length();
+
+    // query with no FOpts, get_max_possible_tx_size() drops MAC answers
+    // which do not fit and they must survive until the next uplink
+    uint8_t max_size = get_max_possible_tx_size(0);
+    if (max_size >= fopts_len) {
+        max_size -= fopts_len;
+    }
+
+    return MIN(max_size, MBED_CONF_LORA_TX_MAX_SIZE);
+}
+
 lorawan_status_t LoRaMac::send_ongoing_tx()
 {
     lorawan_status_t status;
@@ -1429,9 +1625,24 @@ device_class_t LoRaMac::get_device_class() const
     return _device_class;
 }
 
-void LoRaMac::set_device_class(const device_class_t &device_class,
-                               mbed::Callback<void(void)>rx2_would_be_closure_handler)
+lorawan_status_t LoRaMac::set_device_class(const device_class_t &device_class,
+                                           mbed::Callback<void(void)>rx2_would_be_closure_handler,
+                                           mbed::Callback<void(lorawan_event_t)> class_b_event_handler)
 {
+    if (!MBED_CONF_LORA_CLASS_C && CLASS_C == device_class) {
+        return LORAWAN_STATUS_UNSUPPORTED;
+    }
+
+    if (CLASS_B == device_class) {
+        lorawan_status_t status = _class_b.start(_params.dev_addr,
+                                                 class_b_event_handler);
+        if (status != LORAWAN_STATUS_OK) {
+            return status;
+        }
+    } else {
+        _class_b.stop();
+    }
+
     _device_class = device_class;
     _rx2_would_be_closure_for_class_c = rx2_would_be_closure_handler;
 
@@ -1440,19 +1651,28 @@ void LoRaMac::set_device_class(const device_class_t &device_class,
     if (CLASS_A == _device_class) {
         tr_debug("Changing device class to -> CLASS_A");
         _lora_phy->put_radio_to_sleep();
-    } else if (CLASS_C == _device_class) {
+    } else if (CLASS_B == _device_class) {
+        tr_debug("Changing device class to -> CLASS_B");
+    } else if (is_class_c()) {
         _params.is_node_ack_requested = false;
         _lora_phy->put_radio_to_sleep();
         _lora_phy->compute_rx_win_params(_params.sys_params.rx2_channel.datarate,
                                          MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
-                                         MBED_CONF_LORA_MAX_SYS_RX_ERROR,
+                                         MBED_CONF_LORA_MAX_SYS_RX_ERROR, 0,
                                          &_params.rx_window2_config);
     }
 
-    if (CLASS_C == _device_class) {
+    if (is_class_c()) {
         tr_debug("Changing device class to -> CLASS_C");
         open_rx2_window();
     }
+
+    return LORAWAN_STATUS_OK;
+}
+
+void LoRaMac::get_class_b_status(lorawan_class_b_status_t &status)
+{
+    _class_b.get_status(status);
 }
 
 void LoRaMac::setup_link_check_request()
@@ -1464,6 +1684,12 @@ void LoRaMac::setup_link_check_request()
     _mac_commands.add_link_check_req();
 }
 
+void LoRaMac::setup_device_time_request(mbed::Callback<void(void)> synced)
+{
+    _device_time_handler = synced;
+    _mac_commands.add_device_time_req();
+}
+
 lorawan_status_t LoRaMac::prepare_join(const lorawan_connect_t *params, bool is_otaa)
 {
     if (params) {
@@ -1571,6 +1797,8 @@ lorawan_status_t LoRaMac::prepare_frame(loramac_mhdr_t *machdr,
                                         const void *fbuffer,
                                         uint16_t fbuffer_size)
 {
+    PROFILE_ZONE(PROFILE_PREPARE_FRAME);
+
     uint16_t i;
     uint8_t pkt_header_len = 0;
     uint32_t mic = 0;
@@ -1765,6 +1993,13 @@ lorawan_status_t LoRaMac::send_frame_on_channel(uint8_t channel)
         _params.join_request_trial_counter++;
     }
 
+    // the uplink preempts any Class B window, until its RX windows are over
+    if (_params.rx_slot == RX_SLOT_WIN_BEACON
+            || _params.rx_slot == RX_SLOT_WIN_PING_SLOT) {
+        _class_b.on_window_closed(_params.rx_slot, false);
+    }
+    _class_a_exchange_ongoing = true;
+
     _lora_phy->handle_send(_params.tx_buffer, _params.tx_buffer_len);
 
     return LORAWAN_STATUS_OK;
@@ -1800,6 +2035,10 @@ lorawan_status_t LoRaMac::initialize(EventQueue *queue,
     _rx2_closure_timer_for_class_c.timer_id = -1;
 
     _channel_plan.activate_channelplan_subsystem(_lora_phy);
+    _mac_commands.set_device_time_callback(mbed::callback(this, &LoRaMac::handle_device_time_ans));
+    _class_b.activate_class_b_subsystem(&_lora_time, _lora_phy, &_lora_crypto, &_clock_estimator,
+                                        mbed::callback(this, &LoRaMac::open_class_b_window),
+                                        mbed::callback(this, &LoRaMac::close_class_b_window));
 
     _device_class = CLASS_A;
 
@@ -1840,6 +2079,11 @@ lorawan_status_t LoRaMac::initialize(EventQueue *queue,
 
 void LoRaMac::disconnect()
 {
+    _class_b.stop();
+    if (_device_class == CLASS_B) {
+        _device_class = CLASS_A;
+    }
+
     _lora_time.stop(_params.timers.backoff_timer);
     _lora_time.stop(_params.timers.rx_window1_timer);
     _lora_time.stop(_params.timers.rx_window2_timer);
@@ -1920,7 +2164,186 @@ lorawan_status_t LoRaMac::remove_channel_plan()
 
 lorawan_status_t LoRaMac::get_channel_plan(lorawan_channelplan_t &plan)
 {
-    return _channel_plan.get_plan(plan, _lora_phy->get_phy_channels());
+    return _channel_plan.get_plan(plan);
+}
+
+uint32_t LoRaMac::get_session_snapshot_size()
+{
+    return sizeof(lorawan_session_snapshot_t)
+           + _lora_phy->get_phy_channels_size()
+           + sizeof(loraphy_rx1_overrides_t)
+           + _lora_phy->get_channel_mask_size() * sizeof(uint16_t);
+}
+
+lorawan_status_t LoRaMac::save_session(LoRaWANStorage &storage, uint32_t addr,
+                                       uint8_t connect_type)
+{
+    lorawan_session_snapshot_t snapshot;
+
+    if (!_is_nwk_joined) {
+        return LORAWAN_STATUS_NO_NETWORK_JOINED;
+    }
+
+    const loraphy_channel_t *channels = _lora_phy->get_phy_channels();
+    const loraphy_rx1_overrides_t *rx1_overrides = _lora_phy->get_rx1_overrides();
+    const uint16_t *mask = _lora_phy->get_channel_mask();
+    const uint32_t channels_size = _lora_phy->get_phy_channels_size();
+    const uint32_t overrides_size = sizeof(loraphy_rx1_overrides_t);
+    const uint32_t mask_size = _lora_phy->get_channel_mask_size() * sizeof(uint16_t);
+    const uint32_t erase_size = storage.get_erase_size();
+    const uint32_t area = ((get_session_snapshot_size() + erase_size - 1)
+                           / erase_size) * erase_size;
+
+    if (addr > storage.size() || area > storage.size() - addr) {
+        return LORAWAN_STATUS_LENGTH_ERROR;
+    }
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.magic = LORAWAN_SESSION_SNAPSHOT_MAGIC;
+    snapshot.version = LORAWAN_SESSION_SNAPSHOT_VERSION;
+    snapshot.body_size = channels_size + overrides_size + mask_size;
+    snapshot.dev_addr = _params.dev_addr;
+    snapshot.net_id = _params.net_id;
+    memcpy(snapshot.nwk_skey, _params.keys.nwk_skey, sizeof(snapshot.nwk_skey));
+    memcpy(snapshot.app_skey, _params.keys.app_skey, sizeof(snapshot.app_skey));
+    snapshot.ul_frame_counter = _params.ul_frame_counter;
+    snapshot.dl_frame_counter = _params.dl_frame_counter;
+    snapshot.adr_ack_counter = _params.adr_ack_counter;
+    snapshot.recv_delay1 = _params.sys_params.recv_delay1;
+    snapshot.recv_delay2 = _params.sys_params.recv_delay2;
+    snapshot.max_eirp = _params.sys_params.max_eirp;
+    snapshot.rx2_channel = _params.sys_params.rx2_channel;
+    snapshot.channel_data_rate = _params.sys_params.channel_data_rate;
+    snapshot.channel_tx_power = _params.sys_params.channel_tx_power;
+    snapshot.nb_trans = _params.sys_params.nb_trans;
+    snapshot.rx1_dr_offset = _params.sys_params.rx1_dr_offset;
+    snapshot.uplink_dwell_time = _params.sys_params.uplink_dwell_time;
+    snapshot.downlink_dwell_time = _params.sys_params.downlink_dwell_time;
+    snapshot.adr_on = _params.sys_params.adr_on;
+    snapshot.connect_type = connect_type;
+    snapshot.channel_count = _lora_phy->get_channel_list_size();
+    snapshot.mask_size = _lora_phy->get_channel_mask_size();
+    snapshot.region = _lora_phy->get_region();
+
+    uint32_t crc = lorawan_crc32_update(LORAWAN_CRC32_INIT, &snapshot, sizeof(snapshot));
+    crc = lorawan_crc32_update(crc, channels, channels_size);
+    crc = lorawan_crc32_update(crc, rx1_overrides, overrides_size);
+    crc = lorawan_crc32_update(crc, mask, mask_size);
+    snapshot.crc = lorawan_crc32_final(crc);
+
+    const uint32_t body_addr = addr + sizeof(snapshot);
+
+    // header last, it commits the snapshot
+    if (storage.erase(addr, area) != 0
+            || storage.program(channels, body_addr, channels_size) != 0
+            || storage.program(rx1_overrides, body_addr + channels_size, overrides_size) != 0
+            || storage.program(mask, body_addr + channels_size + overrides_size,
+                               mask_size) != 0
+            || storage.program(&snapshot, addr, sizeof(snapshot)) != 0) {
+        tr_error("Failed to save session");
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    tr_debug("Session saved, UpCnt=%lu, DownCnt=%lu",
+             snapshot.ul_frame_counter, snapshot.dl_frame_counter);
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaMac::restore_session(LoRaWANStorage &storage, uint32_t addr,
+                                          uint8_t connect_type)
+{
+    lorawan_session_snapshot_t snapshot;
+    uint8_t chunk[32];
+
+    if (storage.read(&snapshot, addr, sizeof(snapshot)) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    loraphy_rx1_overrides_t *rx1_overrides = _lora_phy->get_rx1_overrides();
+    const uint32_t channels_size = _lora_phy->get_phy_channels_size();
+    const uint32_t overrides_size = sizeof(loraphy_rx1_overrides_t);
+    const uint32_t mask_size = _lora_phy->get_channel_mask_size() * sizeof(uint16_t);
+
+    if (snapshot.magic != LORAWAN_SESSION_SNAPSHOT_MAGIC
+            || snapshot.version != LORAWAN_SESSION_SNAPSHOT_VERSION
+            || snapshot.connect_type != connect_type
+            || snapshot.channel_count != _lora_phy->get_channel_list_size()
+            || snapshot.mask_size != _lora_phy->get_channel_mask_size()
+            || snapshot.region != _lora_phy->get_region()
+            || snapshot.body_size != channels_size + overrides_size + mask_size) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    // validate the whole snapshot before touching any state
+    const uint32_t stored_crc = snapshot.crc;
+    snapshot.crc = 0;
+    uint32_t crc = lorawan_crc32_update(LORAWAN_CRC32_INIT, &snapshot, sizeof(snapshot));
+
+    for (uint32_t pos = 0; pos < snapshot.body_size; pos += sizeof(chunk)) {
+        const uint32_t len = MIN(sizeof(chunk), snapshot.body_size - pos);
+        if (storage.read(chunk, addr + sizeof(snapshot) + pos, len) != 0) {
+            return LORAWAN_STATUS_STORAGE_ERROR;
+        }
+        crc = lorawan_crc32_update(crc, chunk, len);
+    }
+
+    if (lorawan_crc32_final(crc) != stored_crc) {
+        tr_error("Session snapshot corrupted");
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    const uint32_t body_addr = addr + sizeof(snapshot);
+    if (storage.read(_lora_phy->get_phy_channels(), body_addr, channels_size) != 0
+            || storage.read(rx1_overrides, body_addr + channels_size, overrides_size) != 0
+            || storage.read(_lora_phy->get_channel_mask(),
+                            body_addr + channels_size + overrides_size, mask_size) != 0) {
+        // the channel plan may be half written, fall back to the defaults
+        memset(rx1_overrides, 0, overrides_size);
+        _lora_phy->reset_to_default_values(&_params, true);
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    _params.dev_addr = snapshot.dev_addr;
+    _params.net_id = snapshot.net_id;
+    memcpy(_params.keys.nwk_skey, snapshot.nwk_skey, sizeof(_params.keys.nwk_skey));
+    memcpy(_params.keys.app_skey, snapshot.app_skey, sizeof(_params.keys.app_skey));
+    _params.ul_frame_counter = snapshot.ul_frame_counter;
+    _params.dl_frame_counter = snapshot.dl_frame_counter;
+    _params.adr_ack_counter = snapshot.adr_ack_counter;
+    _params.sys_params.recv_delay1 = snapshot.recv_delay1;
+    _params.sys_params.recv_delay2 = snapshot.recv_delay2;
+    _params.sys_params.max_eirp = snapshot.max_eirp;
+    _params.sys_params.rx2_channel = snapshot.rx2_channel;
+    _params.sys_params.channel_data_rate = snapshot.channel_data_rate;
+    _params.sys_params.channel_tx_power = snapshot.channel_tx_power;
+    _params.sys_params.nb_trans = snapshot.nb_trans;
+    _params.sys_params.rx1_dr_offset = snapshot.rx1_dr_offset;
+    _params.sys_params.uplink_dwell_time = snapshot.uplink_dwell_time;
+    _params.sys_params.downlink_dwell_time = snapshot.downlink_dwell_time;
+    _params.sys_params.adr_on = snapshot.adr_on;
+
+    tr_debug("Session restored, DevAddr=0x%08lx, UpCnt=%lu, DownCnt=%lu",
+             _params.dev_addr, _params.ul_frame_counter, _params.dl_frame_counter);
+
+    return LORAWAN_STATUS_OK;
+}
+
+void LoRaMac::get_frame_counters(uint32_t &ul_counter, uint32_t &dl_counter)
+{
+    ul_counter = _params.ul_frame_counter;
+    dl_counter = _params.dl_frame_counter;
+}
+
+void LoRaMac::advance_frame_counters(uint32_t ul_counter, uint32_t dl_counter)
+{
+    _params.ul_frame_counter = MAX(_params.ul_frame_counter, ul_counter);
+    _params.dl_frame_counter = MAX(_params.dl_frame_counter, dl_counter);
+}
+
+uint32_t LoRaMac::get_dev_addr()
+{
+    return _params.dev_addr;
 }
 
 lorawan_status_t LoRaMac::remove_single_channel(uint8_t id)
@@ -1932,63 +2355,167 @@ lorawan_status_t LoRaMac::remove_single_channel(uint8_t id)
     return _channel_plan.remove_single_channel(id);
 }
 
-lorawan_status_t LoRaMac::multicast_channel_link(multicast_params_t *channel_param)
+lorawan_status_t LoRaMac::multicast_channel_link(const multicast_params_t *channel_param)
 {
-    if (channel_param == NULL) {
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    if (channel_param == NULL || channel_param->group_id > 3) {
         return LORAWAN_STATUS_PARAMETER_INVALID;
     }
     if (tx_ongoing()) {
         return LORAWAN_STATUS_BUSY;
     }
 
-    channel_param->dl_frame_counter = 0;
+    multicast_group_t *group = find_multicast_group(channel_param->address);
 
-    if (_params.multicast_channels == NULL) {
-        _params.multicast_channels = channel_param;
+    if (group != NULL) {
+        // relinking replaces the keys
+        _lora_crypto.free_payload_key(&group->app_skey_ctx);
     } else {
-        multicast_params_t *cur = _params.multicast_channels;
-        while (cur->next != NULL) {
-            cur = cur->next;
+        if (_multicast_group_count >= MBED_CONF_LORA_MULTICAST_GROUPS) {
+            return LORAWAN_STATUS_NO_OP;
+        }
+
+        uint8_t slot = 0;
+        while (_multicast_groups[slot].in_use) {
+            slot++;
+        }
+        group = &_multicast_groups[slot];
+
+        // insertion sort keeps the index ordered by address
+        uint8_t pos = _multicast_group_count;
+        while (pos > 0 && _multicast_groups[_multicast_index[pos - 1]].address
+                > channel_param->address) {
+            _multicast_index[pos] = _multicast_index[pos - 1];
+            pos--;
         }
-        cur->next = channel_param;
+        _multicast_index[pos] = slot;
+        _multicast_group_count++;
+    }
+
+    group->in_use = true;
+    group->address = channel_param->address;
+    group->dl_frame_counter = 0;
+    group->rx_count = 0;
+    group->group_id = channel_param->group_id;
+    memcpy(group->nwk_skey, channel_param->nwk_skey, sizeof(group->nwk_skey));
+
+    if (_lora_crypto.expand_payload_key(&group->app_skey_ctx, channel_param->app_skey,
+                                        sizeof(channel_param->app_skey) * 8) != 0) {
+        multicast_channel_unlink(group->address);
+        return LORAWAN_STATUS_CRYPTO_FAIL;
     }
 
     return LORAWAN_STATUS_OK;
+#else
+    (void) channel_param;
+    return LORAWAN_STATUS_UNSUPPORTED;
+#endif
 }
 
-lorawan_status_t LoRaMac::multicast_channel_unlink(multicast_params_t *channel_param)
+lorawan_status_t LoRaMac::multicast_channel_unlink(uint32_t address)
 {
-    if (channel_param == NULL) {
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    if (tx_ongoing()) {
+        return LORAWAN_STATUS_BUSY;
+    }
+
+    uint8_t pos = 0;
+    while (pos < _multicast_group_count
+            && _multicast_groups[_multicast_index[pos]].address != address) {
+        pos++;
+    }
+
+    if (pos == _multicast_group_count) {
         return LORAWAN_STATUS_PARAMETER_INVALID;
     }
 
-    if (tx_ongoing()) {
-        return LORAWAN_STATUS_BUSY;
+    multicast_group_t *group = &_multicast_groups[_multicast_index[pos]];
+    _lora_crypto.free_payload_key(&group->app_skey_ctx);
+    memset(group, 0, sizeof(multicast_group_t));
+
+    _multicast_group_count--;
+    for (; pos < _multicast_group_count; pos++) {
+        _multicast_index[pos] = _multicast_index[pos + 1];
     }
 
-    if (_params.multicast_channels != NULL) {
-        if (_params.multicast_channels == channel_param) {
-            _params.multicast_channels = channel_param->next;
-        } else {
-            multicast_params_t *cur = _params.multicast_channels;
+    return LORAWAN_STATUS_OK;
+#else
+    (void) address;
+    return LORAWAN_STATUS_UNSUPPORTED;
+#endif
+}
 
-            while (cur->next && cur->next != channel_param) {
-                cur = cur->next;
-            }
+lorawan_status_t LoRaMac::get_multicast_group_status(uint32_t address,
+                                                     lorawan_multicast_status_t &status)
+{
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    const multicast_group_t *group = find_multicast_group(address);
 
-            if (cur->next) {
-                cur->next = channel_param->next;
-            }
-        }
-        channel_param->next = NULL;
+    if (group == NULL) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
     }
 
+    status.dl_frame_counter = group->dl_frame_counter;
+    status.rx_count = group->rx_count;
+
     return LORAWAN_STATUS_OK;
+#else
+    (void) address;
+    (void) status;
+    return LORAWAN_STATUS_UNSUPPORTED;
+#endif
 }
 
-void LoRaMac::bind_phy(LoRaPHY &phy)
+multicast_group_t *LoRaMac::find_multicast_group(uint32_t address)
+{
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    uint8_t low = 0;
+    uint8_t high = _multicast_group_count;
+
+    while (low < high) {
+        const uint8_t mid = low + (high - low) / 2;
+        multicast_group_t *group = &_multicast_groups[_multicast_index[mid]];
+
+        if (group->address == address) {
+            return group;
+        } else if (group->address < address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+#else
+    (void) address;
+#endif
+
+    return NULL;
+}
+
+void LoRaMac::bind_phy(LoRaPHY_target &phy)
 {
     _lora_phy = &phy;
+
+    if (!_ev_queue) {
+        return;
+    }
+
+    // the PHY dependent part of initialize(), for a switch of region
+    _lora_phy->initialize(&_lora_time);
+    _channel_plan.activate_channelplan_subsystem(_lora_phy);
+    _class_b.bind_phy(_lora_phy);
+
+    _lora_phy->reset_to_default_values(&_params, true);
+    _params.sys_params.nb_trans = 1;
+
+    reset_mac_parameters();
+
+    // the window offsets were learnt by datarate of the former region
+    _clock_estimator.reset();
+
+    _lora_phy->setup_public_network_mode(_params.is_nwk_public);
+    _lora_phy->put_radio_to_sleep();
+
+    _params.sys_params.channel_data_rate = _lora_phy->get_default_max_tx_datarate();
 }
 
 uint8_t LoRaMac::get_QOS_level()
@@ -42,20 +42,57 @@
 
 #include "../../../events/EventQueue.h"
 
-#include "../phy/LoRaPHY.h"
+#include "../phy/loraphy_target.h"
 
 #include "../../system/LoRaWANTimer.h"
 #include "../../system/lorawan_data_structures.h"
+#include "../../system/LoRaWANStorage.h"
+#include "../../system/LoRaWANClockEstimator.h"
 
 #include "LoRaMacChannelPlan.h"
 #include "LoRaMacCommand.h"
 #include "LoRaMacCrypto.h"
+#include "LoRaMacClassB.h"
 #if MBED_CONF_RTOS_PRESENT
 #include "rtos/Mutex.h"
 #endif
 
 #include "../../../platform/ScopedLock.h"
 
+/**
+ * Entry of the multicast group table
+ */
+typedef struct {
+    /**
+     * Application session key, expanded once when the group is linked
+     */
+    mbedtls_aes_context app_skey_ctx;
+    /**
+     * Group address
+     */
+    uint32_t address;
+    /**
+     * Last downlink counter accepted for the group
+     */
+    uint32_t dl_frame_counter;
+    /**
+     * Number of frames accepted for the group
+     */
+    uint32_t rx_count;
+    /**
+     * Network session key, needed as such for the MIC
+     */
+    uint8_t nwk_skey[16];
+    /**
+     * McGroupID of the group
+     */
+    uint8_t group_id;
+    /**
+     * Entry holds a group
+     */
+    bool in_use;
+} multicast_group_t;
+
 /** LoRaMac Class
  * Implementation of LoRaWAN MAC layer
  */
@@ -154,6 +191,75 @@ public:
      */
     lorawan_status_t get_channel_plan(lorawan_channelplan_t &plan);
 
+    /**
+     * @brief   Saves the session to non-volatile storage.
+     *
+     * @details Writes a snapshot of the session keys, frame counters, ADR
+     *          state, RX parameters and the PHY channel plan and mask. The
+     *          header goes last, so a snapshot torn by a reset is never
+     *          taken for a valid one.
+     *
+     * @param   storage         Storage to write to.
+     * @param   addr            Address of the snapshot, aligned to an erase unit.
+     * @param   connect_type    LORAWAN_CONNECTION_OTAA or LORAWAN_CONNECTION_ABP.
+     *
+     * @return  `lorawan_status_t` The status of the operation. The possible values are:
+     *          \ref LORAWAN_STATUS_OK
+     *          \ref LORAWAN_STATUS_NO_NETWORK_JOINED
+     *          \ref LORAWAN_STATUS_LENGTH_ERROR if the snapshot does not fit
+     *          \ref LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t save_session(LoRaWANStorage &storage, uint32_t addr,
+                                  uint8_t connect_type);
+
+    /**
+     * @brief   Restores a session saved with save_session().
+     *
+     * @details The snapshot is validated as a whole before any state is
+     *          touched. Call after prepare_join(), join(false) then activates
+     *          the restored session without a Join Request.
+     *
+     * @param   storage         Storage to read from.
+     * @param   addr            Address of the snapshot.
+     * @param   connect_type    Expected connection type.
+     *
+     * @return  `lorawan_status_t` The status of the operation. The possible values are:
+     *          \ref LORAWAN_STATUS_OK
+     *          \ref LORAWAN_STATUS_STORAGE_ERROR if there is no valid snapshot
+     */
+    lorawan_status_t restore_session(LoRaWANStorage &storage, uint32_t addr,
+                                     uint8_t connect_type);
+
+    /**
+     * @brief   Size of a session snapshot with the current PHY.
+     *
+     * @return  Number of bytes.
+     */
+    uint32_t get_session_snapshot_size(void);
+
+    /**
+     * @brief   Gets the current frame counters.
+     *
+     * @param   ul_counter      [out] Counter of the next uplink.
+     * @param   dl_counter      [out] Counter of the last downlink.
+     */
+    void get_frame_counters(uint32_t &ul_counter, uint32_t &dl_counter);
+
+    /**
+     * @brief   Moves the frame counters forward, never backwards.
+     *
+     * @param   ul_counter      Lowest uplink counter to continue from.
+     * @param   dl_counter      Lowest downlink counter to continue from.
+     */
+    void advance_frame_counters(uint32_t ul_counter, uint32_t dl_counter);
+
+    /**
+     * @brief   Gets the device address of the session.
+     *
+     * @return  Device address.
+     */
+    uint32_t get_dev_addr(void);
+
     /**
      * @brief   Remove a given channel from the active plan.
      *
@@ -171,7 +277,10 @@ public:
     /**
      * @brief   LoRaMAC multicast channel link service.
      *
-     * @details Links a multicast channel into the linked list.
+     * @details Adds a multicast group to the group table. The parameters are
+     *          copied and the application key is expanded once here. Linking
+     *          an address which is already in the table replaces its keys and
+     *          restarts its downlink counter.
      *
      * @param [in] channel_param    The multicast channel parameters to link.
      *
@@ -179,28 +288,59 @@ public:
      *          \ref LORAWAN_STATUS_OK
      *          \ref LORAWAN_STATUS_BUSY
      *          \ref LORAWAN_STATUS_PARAMETER_INVALID
+     *          \ref LORAWAN_STATUS_NO_OP if the table is full
+     *          \ref LORAWAN_STATUS_CRYPTO_FAIL
+     *          \ref LORAWAN_STATUS_UNSUPPORTED if there are no multicast groups
      */
-    lorawan_status_t multicast_channel_link(multicast_params_t *channel_param);
+    lorawan_status_t multicast_channel_link(const multicast_params_t *channel_param);
 
     /**
      * @brief   LoRaMAC multicast channel unlink service.
      *
-     * @details Unlinks a multicast channel from the linked list.
+     * @details Removes a multicast group from the group table.
      *
-     * @param [in] channel_param    The multicast channel parameters to unlink.
+     * @param [in] address          Address of the group to unlink.
      *
      * @return  `lorawan_status_t` The status of the operation. The possible values are:
      *          \ref LORAWAN_STATUS_OK
      *          \ref LORAWAN_STATUS_BUSY
-     *          \ref LORAWAN_STATUS_PARAMETER_INVALID
+     *          \ref LORAWAN_STATUS_PARAMETER_INVALID if the group is not linked
+     *          \ref LORAWAN_STATUS_UNSUPPORTED if there are no multicast groups
+     */
+    lorawan_status_t multicast_channel_unlink(uint32_t address);
+
+    /**
+     * @brief   Gets the counters of a multicast group.
+     *
+     * @param [in] address          Address of the group.
+     * @param [out] status          Downlink counter and frames accepted.
+     *
+     * @return  `lorawan_status_t` The status of the operation. The possible values are:
+     *          \ref LORAWAN_STATUS_OK
+     *          \ref LORAWAN_STATUS_PARAMETER_INVALID if the group is not linked
+     *          \ref LORAWAN_STATUS_UNSUPPORTED if there are no multicast groups
      */
-    lorawan_status_t multicast_channel_unlink(multicast_params_t *channel_param);
+    lorawan_status_t get_multicast_group_status(uint32_t address,
+                                                lorawan_multicast_status_t &status);
+
+    /**
+     * @brief   Looks up a multicast group.
+     *
+     * @param [in] address          Group address.
+     *
+     * @return  The group or NULL if the address is not linked.
+     */
+    multicast_group_t *find_multicast_group(uint32_t address);
 
     /** Binds phy layer to MAC.
+     *
+     * Once initialized, the MAC layer may be bound to the PHY of another
+     * region while disconnected; its parameters are then reset to the
+     * defaults of that region.
      *
      * @param phy   LoRaPHY object
      */
-    void bind_phy(LoRaPHY &phy);
+    void bind_phy(LoRaPHY_target &phy);
 
     /**
      * @brief Schedules the frame for sending.
@@ -283,6 +423,14 @@ public:
     int16_t prepare_ongoing_tx(const uint8_t port, const uint8_t *data,
                                uint16_t length, uint8_t flags, uint8_t num_retries);
 
+    /**
+     * @brief get_current_max_tx_size Size of the biggest application payload
+     *        which fits in a single frame at the current datarate, taking
+     *        pending MAC commands into account.
+     * @return Number of bytes.
+     */
+    uint8_t get_current_max_tx_size(void);
+
     /**
      * @brief send_ongoing_tx Sends the ongoing_tx_msg
      * @return LORAWAN_STATUS_OK or a negative error code on failure.
@@ -295,14 +443,35 @@ public:
      */
     device_class_t get_device_class() const;
 
+    /**
+     * @brief is_class_c Checks whether the active device class is Class C,
+     *        never without lora.class-c, which leaves the Class C paths out
+     * @return True in Class C.
+     */
+    bool is_class_c() const
+    {
+        return MBED_CONF_LORA_CLASS_C && _device_class == CLASS_C;
+    }
+
     /**
      * @brief set_device_class Sets active device class.
      * @param device_class Device class to use.
      * @param rx2_would_be_closure_handler callback function to inform about
      *        would be closure of RX2 window
+     * @param class_b_event_handler callback function to inform about beacon
+     *        acquisition and loss
+     * @return LORAWAN_STATUS_OK, or LORAWAN_STATUS_UNSUPPORTED if Class B is
+     *         asked for and the region has no beacon.
      */
-    void set_device_class(const device_class_t &device_class,
-                          mbed::Callback<void(void)>rx2_would_be_closure_handler);
+    lorawan_status_t set_device_class(const device_class_t &device_class,
+                                      mbed::Callback<void(void)>rx2_would_be_closure_handler,
+                                      mbed::Callback<void(lorawan_event_t)> class_b_event_handler);
+
+    /**
+     * @brief get_class_b_status Takes a copy of the Class B status.
+     * @param status [out] Status.
+     */
+    void get_class_b_status(lorawan_class_b_status_t &status);
 
     /**
      * @brief setup_link_check_request Adds link check request command
@@ -310,6 +479,35 @@ public:
      */
     void setup_link_check_request();
 
+    /**
+     * @brief setup_device_time_request Adds device time request command
+     * to be put on next outgoing message (when it fits)
+     *
+     * @param synced    Called once DeviceTimeAns has set the GPS time
+     */
+    void setup_device_time_request(mbed::Callback<void(void)> synced);
+
+    /**
+     * @brief get_gps_time Reads the GPS time, as kept from the last
+     * DeviceTimeAns or beacon
+     *
+     * @param seconds   [out] Seconds since the GPS epoch
+     * @param ms        [out] Milliseconds within the second
+     *
+     * @return          false if the GPS time is unknown
+     */
+    bool get_gps_time(uint32_t &seconds, uint16_t &ms);
+
+    /**
+     * @brief get_clock_drift Reads the drift of the local clock, as measured
+     * from the time references
+     *
+     * @param ppm       [out] Drift in ppm, positive if the clock is fast
+     *
+     * @return          false if the drift is not measured yet
+     */
+    bool get_clock_drift(int32_t &ppm);
+
     /**
      * @brief prepare_join prepares arguments to be ready for join() call.
      * @param params Join parameters to use, if NULL, the default will be used.
@@ -333,9 +531,14 @@ public:
 
     /**
      * MAC operations upon reception
+     *
+     * The frame is decrypted in place, i.e., after this call 'payload'
+     * holds the plain text FRMPayload which the MCPS indication points to.
+     * The buffer must stay untouched until the indication is consumed.
+     * 'timestamp' is the time at which the radio reported the frame.
      */
-    void on_radio_rx_done(const uint8_t *const payload, uint16_t size,
-                          int16_t rssi, int8_t snr);
+    void on_radio_rx_done(uint8_t *const payload, uint16_t size,
+                          int16_t rssi, int8_t snr, lorawan_time_t timestamp);
 
     /**
      * MAC operations upon transmission timeout
@@ -472,12 +675,12 @@ private:
     /**
      * Handles a Join Accept frame
      */
-    void handle_join_accept_frame(const uint8_t *payload, uint16_t size);
+    void handle_join_accept_frame(uint8_t *payload, uint16_t size);
 
     /**
      * Handles data frames
      */
-    void handle_data_frame(const uint8_t *payload,  uint16_t size, uint8_t ptr_pos,
+    void handle_data_frame(uint8_t *payload,  uint16_t size, uint8_t ptr_pos,
                            uint8_t msg_type, int16_t rssi, int8_t snr);
 
     /**
@@ -506,9 +709,11 @@ private:
      * Decrypts and extracts data and MAC commands from the received encrypted
      * payload
      */
-    void extract_data_and_mac_commands(const uint8_t *payload, uint16_t size,
+    void extract_data_and_mac_commands(uint8_t *payload, uint16_t size,
                                        uint8_t fopts_len, uint8_t *nwk_skey,
-                                       uint8_t *app_skey, uint32_t address,
+                                       uint8_t *app_skey,
+                                       multicast_group_t *group,
+                                       uint32_t address,
                                        uint32_t downlink_frame_counter,
                                        int16_t rssi, int8_t snr);
     /**
@@ -532,6 +737,33 @@ private:
      */
     void open_rx2_window(void);
 
+    /**
+     * Opens a beacon window or a ping slot on behalf of the Class B subsystem.
+     * Refused while a Class A exchange is in progress.
+     */
+    bool open_class_b_window(rx_config_params_t *config);
+
+    /**
+     * Ends a continuous beacon search.
+     */
+    void close_class_b_window(void);
+
+    /**
+     * Handles DeviceTimeAns
+     */
+    void handle_device_time_ans(uint32_t seconds, uint8_t fraction);
+
+    /**
+     * Feeds the start offset of a Class A downlink to the clock estimator
+     */
+    void track_rx_offset(uint16_t size, lorawan_time_t timestamp);
+
+    /**
+     * Marks the end of an uplink and its receive windows, Class B may use
+     * the radio again.
+     */
+    void end_class_a_exchange(void);
+
     /**
      * A method to retry a CONFIRMED message after a particular time period
      * (ACK_TIMEOUT = TIME_IN_MS) if the ack was not received
@@ -592,6 +824,7 @@ private:
     void reset_mlme_confirmation(void);
     void reset_mcps_indication(void);
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
     /**
      * @brief set_tx_continuous_wave Puts the system in continuous transmission mode
      * @param [in] channel A Channel to use
@@ -603,6 +836,7 @@ private:
      */
     void set_tx_continuous_wave(uint8_t channel, int8_t datarate, int8_t tx_power,
                                 float max_eirp, float antenna_gain, uint16_t timeout);
+#endif
 
 private:
     typedef mbed::ScopedLock<LoRaMac> Lock;
@@ -610,15 +844,51 @@ private:
     rtos::Mutex _mutex;
 #endif
 
+    // The state looked at on every event comes first, within the reach of
+    // the short load and store encodings, the flags packed; the rest goes by
+    // alignment so that it leaves no holes.
+
     /**
-     * Timer subsystem handle
+     * LoRa PHY layer object storage
      */
-    LoRaWANTimeHandler _lora_time;
+    LoRaPHY_target *_lora_phy;
 
     /**
-     * LoRa PHY layer object storage
+     * EventQueue object storage
+     */
+    events::EventQueue *_ev_queue;
+
+    device_class_t _device_class;
+
+    uint8_t _prev_qos_level;
+
+    /**
+     * Number of linked multicast groups
+     */
+    uint8_t _multicast_group_count;
+
+    bool _is_nwk_joined : 1;
+
+    bool _can_cancel_tx : 1;
+
+    bool _continuous_rx2_window_open : 1;
+
+    bool _demod_ongoing : 1;
+
+    /**
+     * From the start of a transmission to the end of its receive windows
+     */
+    bool _class_a_exchange_ongoing : 1;
+
+    /**
+     * Central MAC layer data storage
+     */
+    loramac_protocol_params _params;
+
+    /**
+     * Timer subsystem handle
      */
-    LoRaPHY *_lora_phy;
+    LoRaWANTimeHandler _lora_time;
 
     /**
      * MAC command handle
@@ -636,14 +906,14 @@ private:
     LoRaMacCrypto _lora_crypto;
 
     /**
-     * Central MAC layer data storage
+     * Class B subsystem
      */
-    loramac_protocol_params _params;
+    LoRaMacClassB _class_b;
 
     /**
-     * EventQueue object storage
+     * Called once DeviceTimeAns is received
      */
-    events::EventQueue *_ev_queue;
+    mbed::Callback<void(void)> _device_time_handler;
 
     /**
      * Class C doesn't timeout in RX2 window as it is a continuous window.
@@ -690,17 +960,20 @@ private:
 
     loramac_tx_message_t _ongoing_tx_msg;
 
-    bool _is_nwk_joined;
-
-    bool _can_cancel_tx;
-
-    bool _continuous_rx2_window_open;
-
-    device_class_t _device_class;
-
-    uint8_t _prev_qos_level;
+    /**
+     * Learns the receive window timing error and the clock drift
+     */
+    LoRaWANClockEstimator _clock_estimator;
 
-    bool _demod_ongoing;
+    /**
+     * Multicast group table. Entries never move once linked, as the expanded
+     * keys must stay in place, _multicast_index keeps them sorted by address
+     * for a binary search on every downlink.
+     */
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    multicast_group_t _multicast_groups[MBED_CONF_LORA_MULTICAST_GROUPS];
+    uint8_t _multicast_index[MBED_CONF_LORA_MULTICAST_GROUPS];
+#endif
 };
 
 #endif // MBED_LORAWAN_MAC_H__
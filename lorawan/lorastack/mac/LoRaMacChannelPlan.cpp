@@ -33,7 +33,7 @@ LoRaMacChannelPlan::~LoRaMacChannelPlan()
 {
 }
 
-void LoRaMacChannelPlan::activate_channelplan_subsystem(LoRaPHY *phy)
+void LoRaMacChannelPlan::activate_channelplan_subsystem(LoRaPHY_target *phy)
 {
     _lora_phy = phy;
 }
@@ -44,7 +44,8 @@ lorawan_status_t LoRaMacChannelPlan::set_plan(const lorawan_channelplan_t &plan)
 
     uint8_t max_num_channels;
 
-    if (!_lora_phy->is_custom_channel_plan_supported()) {
+    if (!MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS || !LoRaPHY_target::custom_channelplans_supported
+            || !_lora_phy->is_custom_channel_plan_supported()) {
         return LORAWAN_STATUS_SERVICE_UNKNOWN;
     }
 
@@ -66,14 +67,14 @@ lorawan_status_t LoRaMacChannelPlan::set_plan(const lorawan_channelplan_t &plan)
     return LORAWAN_STATUS_OK;
 }
 
-lorawan_status_t LoRaMacChannelPlan::get_plan(lorawan_channelplan_t &plan,
-                                              const channel_params_t *channel_list)
+lorawan_status_t LoRaMacChannelPlan::get_plan(lorawan_channelplan_t &plan)
 {
     uint8_t max_num_channels;
     uint16_t *channel_mask;
     uint8_t count = 0;
 
-    if (!_lora_phy->is_custom_channel_plan_supported()) {
+    if (!MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS || !LoRaPHY_target::custom_channelplans_supported
+            || !_lora_phy->is_custom_channel_plan_supported()) {
         return LORAWAN_STATUS_SERVICE_UNKNOWN;
     }
 
@@ -89,12 +90,7 @@ lorawan_status_t LoRaMacChannelPlan::get_plan(lorawan_channelplan_t &plan,
 
         // otherwise add them to the channel_plan struct
         plan.channels[count].id = i;
-        plan.channels[count].ch_param.frequency = channel_list[i].frequency;
-        plan.channels[count].ch_param.dr_range.value = channel_list[i].dr_range.value;
-        plan.channels[count].ch_param.dr_range.fields.min = channel_list[i].dr_range.fields.min;
-        plan.channels[count].ch_param.dr_range.fields.max = channel_list[i].dr_range.fields.max;
-        plan.channels[count].ch_param.band = channel_list[i].band;
-        plan.channels[count].ch_param.rx1_frequency = channel_list[i].rx1_frequency;
+        _lora_phy->get_channel(i, &plan.channels[count].ch_param);
         count++;
     }
 
@@ -111,7 +107,8 @@ lorawan_status_t LoRaMacChannelPlan::remove_plan()
     uint16_t *channel_mask;
     uint16_t *default_channel_mask;
 
-    if (!_lora_phy->is_custom_channel_plan_supported()) {
+    if (!MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS || !LoRaPHY_target::custom_channelplans_supported
+            || !_lora_phy->is_custom_channel_plan_supported()) {
         return LORAWAN_STATUS_SERVICE_UNKNOWN;
     }
 
@@ -146,7 +143,8 @@ lorawan_status_t LoRaMacChannelPlan::remove_single_channel(uint8_t channel_id)
 {
     uint8_t max_num_channels;
 
-    if (!_lora_phy->is_custom_channel_plan_supported()) {
+    if (!MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS || !LoRaPHY_target::custom_channelplans_supported
+            || !_lora_phy->is_custom_channel_plan_supported()) {
         return LORAWAN_STATUS_SERVICE_UNKNOWN;
     }
 
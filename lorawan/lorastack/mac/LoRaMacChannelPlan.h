@@ -29,7 +29,7 @@ SPDX-License-Identifier: BSD-3-Clause
 #define MBED_LORAWAN_LORAMACCHANNELPLAN_H_
 
 #include "../../system/lorawan_data_structures.h"
-#include "../phy/LoRaPHY.h"
+#include "../phy/loraphy_target.h"
 
 class LoRaMacChannelPlan {
 
@@ -54,7 +54,7 @@ public:
      *
      * @param phy    pointer to PHY layer
      */
-    void activate_channelplan_subsystem(LoRaPHY *phy);
+    void activate_channelplan_subsystem(LoRaPHY_target *phy);
 
     /** Set a given channel plan
      *
@@ -76,12 +76,10 @@ public:
      * @param plan          a reference to application provided channel plan structure
      *                      which gets filled in with active channel plan data.
      *
-     * @param channel_list  pointer to structure containing channel information
-     *
      * @return              LORAWAN_STATUS_OK if everything goes well otherwise
      *                      a negative error code is returned.
      */
-    lorawan_status_t get_plan(lorawan_channelplan_t &plan, const channel_params_t *channel_list);
+    lorawan_status_t get_plan(lorawan_channelplan_t &plan);
 
     /** Remove the active channel plan
      *
@@ -106,7 +104,7 @@ private:
     /**
      * Local handles
      */
-    LoRaPHY *_lora_phy;
+    LoRaPHY_target *_lora_phy;
 };
 
 
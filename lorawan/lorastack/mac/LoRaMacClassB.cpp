@@ -0,0 +1,513 @@
+/**
+ * @file LoRaMacClassB.cpp
+ *
+ * @brief Class B beacon tracking and ping slot scheduling
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "LoRaMacClassB.h"
+#include "../../system/lorawan_crc.h"
+
+//#include "mbed-trace/mbed_trace.h"
+//#define TRACE_GROUP "LMACB"
+#include "../../../trace.h"
+
+#if (MBED_CONF_LORA_PING_SLOT_PERIODICITY > 7)
+#error "lora.ping-slot-periodicity must be 0 - 7"
+#endif
+
+/**
+ * The beacon is on air for well under half of the reserved time in all
+ * regions. If it has not been received by then, it was missed.
+ */
+#define BEACON_TIMEOUT              (LORAMAC_BEACON_RESERVED / 2)
+
+LoRaMacClassB::LoRaMacClassB()
+    : _lora_time(NULL),
+      _lora_phy(NULL),
+      _lora_crypto(NULL),
+      _clock(NULL),
+      _state(CLASS_B_STOPPED),
+      _cold_search(false),
+      _ping_slot_info_acked(false),
+      _beacon_channel(0),
+      _dev_addr(0),
+      _beacon_start(0),
+      _last_beacon_rx(0),
+      _last_uplink_end(0),
+      _beacon_time(0),
+      _beacon_frequency(0),
+      _ping_slot_frequency(0),
+      _ping_slot_datarate(0),
+      _periodicity(MBED_CONF_LORA_PING_SLOT_PERIODICITY),
+      _ping_offset(0),
+      _ping_slot_index(0),
+      _window_open(false),
+      _window_slot(RX_SLOT_WIN_BEACON),
+      _window_opened_at(0)
+{
+    memset(&_beacon_rx_config, 0, sizeof(_beacon_rx_config));
+    memset(&_ping_slot_rx_config, 0, sizeof(_ping_slot_rx_config));
+    memset(&_status, 0, sizeof(_status));
+}
+
+void LoRaMacClassB::activate_class_b_subsystem(LoRaWANTimeHandler *lora_time, LoRaPHY_target *phy,
+                                               LoRaMacCrypto *crypto, LoRaWANClockEstimator *clock,
+                                               mbed::Callback<bool(rx_config_params_t *)> open_window,
+                                               mbed::Callback<void(void)> close_window)
+{
+    _lora_time = lora_time;
+    _lora_phy = phy;
+    _lora_crypto = crypto;
+    _clock = clock;
+    _open_window = open_window;
+    _close_window = close_window;
+
+    _lora_time->init(_beacon_timer,
+                     mbed::callback(this, &LoRaMacClassB::open_beacon_window));
+    _lora_time->init(_beacon_timeout_timer,
+                     mbed::callback(this, &LoRaMacClassB::on_beacon_timeout));
+    _lora_time->init(_ping_slot_timer,
+                     mbed::callback(this, &LoRaMacClassB::open_ping_slot));
+
+    _ping_slot_datarate = _lora_phy->get_beacon_datarate();
+}
+
+void LoRaMacClassB::bind_phy(LoRaPHY_target *phy)
+{
+    _lora_phy = phy;
+    _ping_slot_datarate = _lora_phy->get_beacon_datarate();
+}
+
+lorawan_status_t LoRaMacClassB::start(uint32_t dev_addr,
+                                      mbed::Callback<void(lorawan_event_t)> event_handler)
+{
+    if (_lora_phy->get_beacon_size() == 0) {
+        return LORAWAN_STATUS_UNSUPPORTED;
+    }
+
+    if (_state != CLASS_B_STOPPED) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    _dev_addr = dev_addr;
+    _event_handler = event_handler;
+    _ping_slot_info_acked = false;
+    _beacon_channel = 0;
+
+    memset(&_status, 0, sizeof(_status));
+    _status.ping_period = (LORAMAC_PING_SLOT_COUNT >> (7 - _periodicity))
+                          * LORAMAC_PING_SLOT_WINDOW;
+
+    _state = CLASS_B_ACQUIRING;
+    start_cold_search();
+
+    return LORAWAN_STATUS_OK;
+}
+
+void LoRaMacClassB::stop()
+{
+    if (_state == CLASS_B_STOPPED) {
+        return;
+    }
+
+    _lora_time->stop(_beacon_timer);
+    _lora_time->stop(_beacon_timeout_timer);
+    _lora_time->stop(_ping_slot_timer);
+
+    if (_cold_search) {
+        _close_window();
+        on_window_closed(RX_SLOT_WIN_BEACON, false);
+        _cold_search = false;
+    }
+
+    _window_open = false;
+    _state = CLASS_B_STOPPED;
+    _status.beacon_locked = false;
+}
+
+bool LoRaMacClassB::is_active() const
+{
+    return _state != CLASS_B_STOPPED;
+}
+
+bool LoRaMacClassB::is_ping_slot_ready() const
+{
+    return _ping_slot_info_acked
+           && (_state == CLASS_B_LOCKED || _state == CLASS_B_BEACONLESS);
+}
+
+uint8_t LoRaMacClassB::get_ping_slot_periodicity() const
+{
+    return _periodicity;
+}
+
+bool LoRaMacClassB::needs_ping_slot_info() const
+{
+    return _state != CLASS_B_STOPPED && !_ping_slot_info_acked;
+}
+
+bool LoRaMacClassB::needs_beacon_timing() const
+{
+    return _state == CLASS_B_ACQUIRING && _cold_search;
+}
+
+void LoRaMacClassB::handle_ping_slot_info_ans()
+{
+    if (_state == CLASS_B_STOPPED || _ping_slot_info_acked) {
+        return;
+    }
+
+    _ping_slot_info_acked = true;
+
+    // pick up the remaining ping slots of the current period
+    if (_state != CLASS_B_ACQUIRING) {
+        schedule_ping_slot();
+    }
+}
+
+void LoRaMacClassB::handle_beacon_timing_ans(uint16_t delay, uint8_t channel)
+{
+    if (_state != CLASS_B_ACQUIRING) {
+        return;
+    }
+
+    lorawan_time_t now = _lora_time->get_current_time();
+    lorawan_time_t expected = _last_uplink_end
+                              + ((uint32_t) delay + 1) * LORAMAC_BEACON_TIMING_UNIT;
+    uint8_t channel_count = _lora_phy->get_beacon_channel_count();
+
+    channel %= channel_count;
+
+    // the answer may have arrived too late for the announced beacon
+    while ((int32_t)(expected - now) < 0) {
+        expected += LORAMAC_BEACON_INTERVAL;
+        channel = (channel + 1) % channel_count;
+    }
+
+    if (_cold_search) {
+        _lora_time->stop(_beacon_timeout_timer);
+        _close_window();
+        on_window_closed(RX_SLOT_WIN_BEACON, false);
+        _cold_search = false;
+    }
+
+    tr_debug("Beacon expected in %lu ms", (unsigned long)(expected - now));
+
+    _beacon_channel = channel;
+    schedule_beacon_window(expected, channel,
+                           MBED_CONF_LORA_MAX_SYS_RX_ERROR + LORAMAC_BEACON_TIMING_UNIT);
+}
+
+void LoRaMacClassB::set_ping_slot_channel(uint32_t frequency, uint8_t datarate)
+{
+    _ping_slot_frequency = frequency;
+    _ping_slot_datarate = datarate;
+}
+
+void LoRaMacClassB::set_beacon_frequency(uint32_t frequency)
+{
+    _beacon_frequency = frequency;
+}
+
+void LoRaMacClassB::on_beacon_received(const uint8_t *payload, uint16_t size,
+                                       int16_t rssi, int8_t snr,
+                                       lorawan_time_t timestamp)
+{
+    uint8_t beacon_size = _lora_phy->get_beacon_size();
+    uint8_t pos = _lora_phy->get_beacon_time_offset();
+    uint16_t crc;
+
+    if (_state == CLASS_B_STOPPED) {
+        return;
+    }
+
+    // The network common part, RFU and time, must be intact. A missed beacon
+    // is handled by the timeout, a search goes on.
+    if (size != beacon_size
+            || lorawan_crc16_ccitt(payload, pos + 4)
+            != (payload[pos + 4] | (payload[pos + 5] << 8))) {
+        tr_debug("Not a valid beacon");
+        if (_cold_search) {
+            open_window(&_beacon_rx_config);
+        }
+        return;
+    }
+
+    _lora_time->stop(_beacon_timer);
+    _lora_time->stop(_beacon_timeout_timer);
+    _cold_search = false;
+
+    _beacon_time = payload[pos] | (payload[pos + 1] << 8)
+                   | ((uint32_t) payload[pos + 2] << 16)
+                   | ((uint32_t) payload[pos + 3] << 24);
+
+    // the beacon period starts when the beacon starts to be transmitted
+    _beacon_start = timestamp - _lora_phy->get_rx_time_on_air(MODEM_LORA, size);
+    _last_beacon_rx = _beacon_start;
+
+    _lora_time->set_gps_time(_beacon_time, 0, _beacon_start);
+    _clock->add_time_reference(_beacon_time, 0, _beacon_start, 1);
+
+    _status.beacon_locked = true;
+    _status.beacon_time = _beacon_time;
+    _status.beacon_rssi = rssi;
+    _status.beacon_snr = snr;
+    _status.beacons_received++;
+
+    // the gateway specific part has its own CRC, it is optional to use
+    pos += 6;
+    crc = payload[size - 2] | (payload[size - 1] << 8);
+    if (lorawan_crc16_ccitt(&payload[pos], size - 2 - pos) == crc) {
+        _status.info_desc = payload[pos];
+        memcpy(_status.info, &payload[pos + 1], sizeof(_status.info));
+    }
+
+    tr_debug("Beacon received, time = %lu", (unsigned long) _beacon_time);
+
+    bool acquired = (_state == CLASS_B_ACQUIRING);
+    _state = CLASS_B_LOCKED;
+
+    start_beacon_period();
+
+    if (acquired && _event_handler) {
+        _event_handler(BEACON_LOCKED);
+    }
+}
+
+void LoRaMacClassB::on_window_closed(rx_slot_t slot, bool received)
+{
+    if (!_window_open || slot != _window_slot) {
+        return;
+    }
+
+    uint32_t radio_on = _lora_time->get_elapsed_time(_window_opened_at);
+    _window_open = false;
+
+    if (slot == RX_SLOT_WIN_PING_SLOT) {
+        _status.ping_radio_on_time += radio_on;
+        if (received) {
+            _status.ping_slot_frames++;
+        }
+    } else {
+        _status.beacon_radio_on_time += radio_on;
+    }
+}
+
+void LoRaMacClassB::on_uplink_done(lorawan_time_t timestamp)
+{
+    _last_uplink_end = timestamp;
+}
+
+void LoRaMacClassB::on_class_a_done()
+{
+    // the Class A exchange took the radio away from the beacon search
+    if (_cold_search && !_window_open) {
+        open_window(&_beacon_rx_config);
+    }
+}
+
+void LoRaMacClassB::get_status(lorawan_class_b_status_t &status) const
+{
+    status = _status;
+}
+
+void LoRaMacClassB::start_cold_search()
+{
+    uint8_t channel_count = _lora_phy->get_beacon_channel_count();
+
+    _beacon_rx_config.rx_slot = RX_SLOT_WIN_BEACON;
+    _lora_phy->compute_rx_win_params(_lora_phy->get_beacon_datarate(),
+                                     MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
+                                     MBED_CONF_LORA_MAX_SYS_RX_ERROR, 0,
+                                     &_beacon_rx_config);
+    _beacon_rx_config.frequency = _beacon_frequency ? _beacon_frequency :
+                                  _lora_phy->get_beacon_frequency(_beacon_channel);
+    _beacon_rx_config.is_rx_continuous = true;
+
+    _cold_search = true;
+    open_window(&_beacon_rx_config);
+
+    // a hopping beacon comes by every channel once per round
+    _lora_time->start(_beacon_timeout_timer,
+                      (_beacon_frequency ? 1 : channel_count) * LORAMAC_BEACON_INTERVAL
+                      + LORAMAC_BEACON_RESERVED);
+
+    tr_debug("Beacon search, Freq = %lu", _beacon_rx_config.frequency);
+}
+
+void LoRaMacClassB::start_beacon_period()
+{
+    uint16_t ping_period = LORAMAC_PING_SLOT_COUNT >> (7 - _periodicity);
+    uint16_t ping_nb = 1 << (7 - _periodicity);
+    uint8_t channel_count = _lora_phy->get_beacon_channel_count();
+    uint8_t channel = ((_beacon_time / (LORAMAC_BEACON_INTERVAL / 1000)) + 1)
+                      % channel_count;
+
+    _ping_slot_index = 0;
+    if (0 != _lora_crypto->compute_ping_offset(_beacon_time, _dev_addr,
+                                               ping_period, &_ping_offset)) {
+        tr_error("Ping offset computation failed");
+        _ping_slot_index = ping_nb;
+    }
+
+    schedule_ping_slot();
+
+    lorawan_time_t expected = _beacon_start + LORAMAC_BEACON_INTERVAL;
+    schedule_beacon_window(expected, channel,
+                           get_rx_error(_lora_phy->get_beacon_datarate(), expected));
+}
+
+void LoRaMacClassB::schedule_beacon_window(lorawan_time_t expected, uint8_t channel,
+                                           uint32_t rx_error)
+{
+    lorawan_time_t now = _lora_time->get_current_time();
+
+    _beacon_rx_config.rx_slot = RX_SLOT_WIN_BEACON;
+    _lora_phy->compute_rx_win_params(_lora_phy->get_beacon_datarate(),
+                                     MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
+                                     rx_error, 0, &_beacon_rx_config);
+    _beacon_rx_config.frequency = _beacon_frequency ? _beacon_frequency :
+                                  _lora_phy->get_beacon_frequency(channel);
+    _beacon_rx_config.is_rx_continuous = false;
+
+    int32_t open_in = (int32_t)(expected + _beacon_rx_config.window_offset - now);
+    int32_t timeout_in = (int32_t)(expected + BEACON_TIMEOUT - now);
+
+    _lora_time->start(_beacon_timer, MAX(open_in, 0));
+    _lora_time->start(_beacon_timeout_timer, MAX(timeout_in, 0));
+}
+
+void LoRaMacClassB::schedule_ping_slot()
+{
+    uint16_t ping_period = LORAMAC_PING_SLOT_COUNT >> (7 - _periodicity);
+    uint16_t ping_nb = 1 << (7 - _periodicity);
+    uint8_t channel_count = _lora_phy->get_beacon_channel_count();
+    lorawan_time_t now = _lora_time->get_current_time();
+
+    _lora_time->stop(_ping_slot_timer);
+
+    if (!is_ping_slot_ready()) {
+        return;
+    }
+
+    _ping_slot_rx_config.rx_slot = RX_SLOT_WIN_PING_SLOT;
+    _ping_slot_rx_config.frequency = _ping_slot_frequency;
+    if (_ping_slot_frequency == 0) {
+        uint8_t channel = (_dev_addr + (_beacon_time / (LORAMAC_BEACON_INTERVAL / 1000)))
+                          % channel_count;
+        _ping_slot_rx_config.frequency = _lora_phy->get_beacon_frequency(channel);
+    }
+    _ping_slot_rx_config.is_rx_continuous = false;
+
+    for (; _ping_slot_index < ping_nb; _ping_slot_index++) {
+        lorawan_time_t slot_start = _beacon_start + LORAMAC_BEACON_RESERVED
+                                    + (_ping_offset + (uint32_t) _ping_slot_index * ping_period)
+                                    * LORAMAC_PING_SLOT_WINDOW;
+
+        _lora_phy->compute_rx_win_params(_ping_slot_datarate,
+                                         MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH,
+                                         get_rx_error(_ping_slot_datarate, slot_start), 0,
+                                         &_ping_slot_rx_config);
+
+        int32_t open_in = (int32_t)(slot_start + _ping_slot_rx_config.window_offset - now);
+        if (open_in >= 0) {
+            _lora_time->start(_ping_slot_timer, open_in);
+            return;
+        }
+    }
+
+    // no more ping slots before the next beacon
+}
+
+void LoRaMacClassB::open_beacon_window()
+{
+    _lora_time->stop(_beacon_timer);
+
+    open_window(&_beacon_rx_config);
+
+    tr_debug("Beacon window open, Freq = %lu", _beacon_rx_config.frequency);
+}
+
+void LoRaMacClassB::on_beacon_timeout()
+{
+    _lora_time->stop(_beacon_timeout_timer);
+    _lora_time->stop(_beacon_timer);
+
+    if (_state == CLASS_B_ACQUIRING) {
+        if (_cold_search) {
+            tr_debug("No beacon found");
+            lose_beacon();
+        } else {
+            // the beacon announced by BeaconTimingAns did not show up
+            start_cold_search();
+        }
+        return;
+    }
+
+    _status.beacons_missed++;
+
+    // carry on with the beacon period the missed beacon would have started
+    _beacon_start += LORAMAC_BEACON_INTERVAL;
+    _beacon_time += LORAMAC_BEACON_INTERVAL / 1000;
+
+    if ((uint32_t)(_beacon_start - _last_beacon_rx)
+            >= (uint32_t) MBED_CONF_LORA_BEACONLESS_PERIOD * 1000) {
+        tr_debug("Beacon-less period expired");
+        lose_beacon();
+        return;
+    }
+
+    tr_debug("Beacon missed");
+
+    _state = CLASS_B_BEACONLESS;
+    start_beacon_period();
+}
+
+void LoRaMacClassB::open_ping_slot()
+{
+    _lora_time->stop(_ping_slot_timer);
+
+    if (open_window(&_ping_slot_rx_config)) {
+        _status.ping_slots_opened++;
+    } else {
+        _status.ping_slots_skipped++;
+    }
+
+    _ping_slot_index++;
+    schedule_ping_slot();
+}
+
+void LoRaMacClassB::lose_beacon()
+{
+    stop();
+
+    if (_event_handler) {
+        _event_handler(BEACON_LOST);
+    }
+}
+
+uint32_t LoRaMacClassB::get_rx_error(uint8_t datarate, lorawan_time_t at) const
+{
+    // the drift is the estimated one once time references have been seen,
+    // MBED_CONF_LORA_CLASS_B_CLOCK_DRIFT until then. There is no shift, the
+    // windows are timed from a beacon whose start was derived the same way
+    // as the one of the frames.
+    return _clock->get_rx_error(datarate, at - _last_beacon_rx);
+}
+
+bool LoRaMacClassB::open_window(rx_config_params_t *config)
+{
+    if (!_open_window(config)) {
+        return false;
+    }
+
+    _window_open = true;
+    _window_slot = config->rx_slot;
+    _window_opened_at = _lora_time->get_current_time();
+
+    return true;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file LoRaMacClassB.h
+ *
+ * @brief Class B beacon tracking and ping slot scheduling
+ *
+ * The gateways broadcast a beacon every 128 seconds, at GPS times which are
+ * multiples of 128. A Class B device tracks the beacon and opens short
+ * receive windows, ping slots, at times derived from the beacon:
+ *
+ *     |<- reserved ->|<------------ 4096 slots of 30 ms ------------>|
+ *     +--------------+--------+---+---------+---+---------+---+------+
+ *     |    beacon    |        |PS |         |PS |         |PS |      |
+ *     +--------------+--------+---+---------+---+---------+---+------+
+ *                    |offset->|<-- period ->|<-- period ->|
+ *
+ * The device announces its ping slot periodicity 'p' with PingSlotInfoReq,
+ * it then gets 2^(7 - p) ping slots per beacon period, 2^(5 + p) slots
+ * apart. The offset of the first one is randomised per period and per device
+ * so that devices do not collide.
+ *
+ * The beacon is first acquired either from BeaconTimingAns or by listening
+ * continuously on the beacon channel. Every received beacon re-synchronises
+ * the local clock and the GPS time, and is a time reference for the clock
+ * estimator. When beacons are missed, the device keeps opening ping slots on
+ * the predicted schedule with receive windows widened for the drift of its
+ * clock, and gives up after MBED_CONF_LORA_BEACONLESS_PERIOD seconds.
+ *
+ * This class only decides when and where to listen. The radio stays owned by
+ * LoRaMac which opens the windows on request, unless a Class A exchange is
+ * in progress, which always takes precedence.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_LORAMACCLASSB_H_
+#define MBED_LORAWAN_LORAMACCLASSB_H_
+
+#include "../../system/lorawan_data_structures.h"
+#include "../../system/LoRaWANTimer.h"
+#include "../../system/LoRaWANClockEstimator.h"
+#include "../phy/loraphy_target.h"
+#include "LoRaMacCrypto.h"
+
+/**
+ * Beacon period (ms)
+ */
+#define LORAMAC_BEACON_INTERVAL         128000
+
+/**
+ * Time (ms) reserved for the beacon at the start of a period
+ */
+#define LORAMAC_BEACON_RESERVED         2120
+
+/**
+ * Number of ping slots in a beacon period
+ */
+#define LORAMAC_PING_SLOT_COUNT         4096
+
+/**
+ * Duration of a ping slot (ms)
+ */
+#define LORAMAC_PING_SLOT_WINDOW        30
+
+/**
+ * Unit of the delay carried by BeaconTimingAns (ms)
+ */
+#define LORAMAC_BEACON_TIMING_UNIT      30
+
+/**
+ * Class B tracking state
+ */
+typedef enum {
+    CLASS_B_STOPPED,
+    /**
+     * Looking for the first beacon
+     */
+    CLASS_B_ACQUIRING,
+    /**
+     * The last beacon was received
+     */
+    CLASS_B_LOCKED,
+    /**
+     * The last beacon was missed, running on the predicted schedule
+     */
+    CLASS_B_BEACONLESS
+} class_b_state_t;
+
+class LoRaMacClassB {
+
+public:
+
+    /** Constructor
+     *
+     * Sets local handles to NULL. These handles will be set when the subsystem
+     * is activated by the MAC layer.
+     */
+    LoRaMacClassB();
+
+    /** Activates the Class B subsystem
+     *
+     * @param lora_time     Timer subsystem of the MAC layer
+     * @param phy           PHY layer
+     * @param crypto        Crypto subsystem of the MAC layer
+     * @param clock         Clock estimator of the MAC layer
+     * @param open_window   Opens a receive window, returns false if the radio
+     *                      is busy with a Class A exchange
+     * @param close_window  Ends a continuous beacon search
+     */
+    void activate_class_b_subsystem(LoRaWANTimeHandler *lora_time, LoRaPHY_target *phy,
+                                    LoRaMacCrypto *crypto, LoRaWANClockEstimator *clock,
+                                    mbed::Callback<bool(rx_config_params_t *)> open_window,
+                                    mbed::Callback<void(void)> close_window);
+
+    /** Binds the PHY layer of another region, while stopped
+     *
+     * @param phy           PHY layer
+     */
+    void bind_phy(LoRaPHY_target *phy);
+
+    /** Starts beacon acquisition
+     *
+     * @param dev_addr      Device address, randomises the ping slots
+     * @param event_handler Receives BEACON_LOCKED once the beacon is acquired
+     *                      and BEACON_LOST if Class B is given up
+     *
+     * @return              LORAWAN_STATUS_OK, or LORAWAN_STATUS_UNSUPPORTED if
+     *                      the region has no beacon
+     */
+    lorawan_status_t start(uint32_t dev_addr,
+                           mbed::Callback<void(lorawan_event_t)> event_handler);
+
+    /** Stops beacon tracking and ping slots
+     */
+    void stop();
+
+    /** Class B is enabled, whether or not the beacon is tracked
+     */
+    bool is_active() const;
+
+    /** Ping slots are being opened
+     *
+     * Uplinks then carry the Class B bit.
+     */
+    bool is_ping_slot_ready() const;
+
+    /** Ping slot periodicity to announce with PingSlotInfoReq
+     */
+    uint8_t get_ping_slot_periodicity() const;
+
+    /** The network has not yet acknowledged the ping slot periodicity
+     */
+    bool needs_ping_slot_info() const;
+
+    /** The beacon timing is unknown and should be asked for
+     */
+    bool needs_beacon_timing() const;
+
+    /** Handles PingSlotInfoAns
+     */
+    void handle_ping_slot_info_ans();
+
+    /** Handles BeaconTimingAns
+     *
+     * @param delay         Time to the next beacon from the end of the last
+     *                      uplink, in LORAMAC_BEACON_TIMING_UNIT minus one
+     * @param channel       Channel of the next beacon
+     */
+    void handle_beacon_timing_ans(uint16_t delay, uint8_t channel);
+
+    /** Handles an accepted PingSlotChannelReq
+     *
+     * @param frequency     Ping slot frequency, 0 for the default channel(s)
+     * @param datarate      Ping slot datarate
+     */
+    void set_ping_slot_channel(uint32_t frequency, uint8_t datarate);
+
+    /** Handles an accepted BeaconFreqReq
+     *
+     * @param frequency     Beacon frequency, 0 for the default channel(s)
+     */
+    void set_beacon_frequency(uint32_t frequency);
+
+    /** Handles a frame received in a beacon window
+     *
+     * @param payload       Frame
+     * @param size          Size of the frame
+     * @param rssi          RSSI of the frame
+     * @param snr           SNR of the frame
+     * @param timestamp     Time at which the radio reported the frame
+     */
+    void on_beacon_received(const uint8_t *payload, uint16_t size,
+                            int16_t rssi, int8_t snr, lorawan_time_t timestamp);
+
+    /** A receive window opened on behalf of Class B has ended
+     *
+     * @param slot          RX_SLOT_WIN_BEACON or RX_SLOT_WIN_PING_SLOT
+     * @param received      A frame was received
+     */
+    void on_window_closed(rx_slot_t slot, bool received);
+
+    /** An uplink has been sent
+     *
+     * @param timestamp     Time at which the transmission ended
+     */
+    void on_uplink_done(lorawan_time_t timestamp);
+
+    /** A Class A exchange has ended and the radio is available again
+     */
+    void on_class_a_done();
+
+    /** Takes a copy of the status
+     *
+     * @param status        [out] Status
+     */
+    void get_status(lorawan_class_b_status_t &status) const;
+
+private:
+    /**
+     * Listens continuously on the beacon channel for a while
+     */
+    void start_cold_search();
+
+    /**
+     * Derives the ping slots from the current beacon period and schedules
+     * the beacon opening the next one
+     */
+    void start_beacon_period();
+
+    /**
+     * Schedules a beacon window
+     */
+    void schedule_beacon_window(lorawan_time_t expected, uint8_t channel,
+                                uint32_t rx_error);
+
+    /**
+     * Schedules the next ping slot of the current beacon period
+     */
+    void schedule_ping_slot();
+
+    /**
+     * Timer callbacks
+     */
+    void open_beacon_window();
+    void on_beacon_timeout();
+    void open_ping_slot();
+
+    /**
+     * Gives up Class B
+     */
+    void lose_beacon();
+
+    /**
+     * Timing error (ms) of a window, widened for the clock drift since the
+     * last beacon
+     */
+    uint32_t get_rx_error(uint8_t datarate, lorawan_time_t at) const;
+
+    /**
+     * Opens a window and keeps track of the radio-on time
+     */
+    bool open_window(rx_config_params_t *config);
+
+    LoRaWANTimeHandler *_lora_time;
+    LoRaPHY_target *_lora_phy;
+    LoRaMacCrypto *_lora_crypto;
+    LoRaWANClockEstimator *_clock;
+
+    mbed::Callback<bool(rx_config_params_t *)> _open_window;
+    mbed::Callback<void(void)> _close_window;
+    mbed::Callback<void(lorawan_event_t)> _event_handler;
+
+    /**
+     * Opens the next beacon window
+     */
+    timer_event_t _beacon_timer;
+
+    /**
+     * Declares the expected beacon missed, or ends the cold search
+     */
+    timer_event_t _beacon_timeout_timer;
+
+    /**
+     * Opens the next ping slot
+     */
+    timer_event_t _ping_slot_timer;
+
+    class_b_state_t _state;
+
+    bool _cold_search;
+    bool _ping_slot_info_acked;
+
+    /**
+     * Beacon channel to search on while acquiring
+     */
+    uint8_t _beacon_channel;
+
+    uint32_t _dev_addr;
+
+    /**
+     * Local time at which the current beacon period started, and the last
+     * received beacon
+     */
+    lorawan_time_t _beacon_start;
+    lorawan_time_t _last_beacon_rx;
+
+    /**
+     * End of the last uplink, BeaconTimingAns is relative to it
+     */
+    lorawan_time_t _last_uplink_end;
+
+    /**
+     * GPS time of the current beacon period
+     */
+    uint32_t _beacon_time;
+
+    /**
+     * Set by the network, 0 when the PHY defaults apply
+     */
+    uint32_t _beacon_frequency;
+    uint32_t _ping_slot_frequency;
+    uint8_t _ping_slot_datarate;
+
+    uint8_t _periodicity;
+    uint16_t _ping_offset;
+    uint16_t _ping_slot_index;
+
+    rx_config_params_t _beacon_rx_config;
+    rx_config_params_t _ping_slot_rx_config;
+
+    /**
+     * The window being timed for the radio-on statistics
+     */
+    bool _window_open;
+    rx_slot_t _window_slot;
+    lorawan_time_t _window_opened_at;
+
+    lorawan_class_b_status_t _status;
+};
+
+#endif /* MBED_LORAWAN_LORAMACCLASSB_H_ */
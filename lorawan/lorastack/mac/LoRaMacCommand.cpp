@@ -24,6 +24,7 @@ SPDX-License-Identifier: BSD-3-Clause
 
 #include "LoRaMacCommand.h"
 #include "LoRaMac.h"
+#include "LoRaMacClassB.h"
 
 //#include "mbed-trace/mbed_trace.h"
 //#define TRACE_GROUP "LMACC"
@@ -68,6 +69,7 @@ void LoRaMacCommand::parse_mac_commands_to_repeat()
         switch (mac_cmd_buffer[i]) {
             // STICKY
             case MOTE_MAC_DL_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
             case MOTE_MAC_RX_PARAM_SETUP_ANS: { // 1 byte payload
                 mac_cmd_buffer_to_repeat[cmd_cnt++] = mac_cmd_buffer[i++];
                 mac_cmd_buffer_to_repeat[cmd_cnt++] = mac_cmd_buffer[i];
@@ -84,12 +86,16 @@ void LoRaMacCommand::parse_mac_commands_to_repeat()
                 break;
             }
             case MOTE_MAC_LINK_ADR_ANS:
-            case MOTE_MAC_NEW_CHANNEL_ANS: { // 1 byte payload
+            case MOTE_MAC_NEW_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
+            case MOTE_MAC_BEACON_FREQ_ANS: { // 1 byte payload
                 i++;
                 break;
             }
             case MOTE_MAC_TX_PARAM_SETUP_ANS:
             case MOTE_MAC_DUTY_CYCLE_ANS:
+            case MOTE_MAC_BEACON_TIMING_REQ:
+            case MOTE_MAC_DEVICE_TIME_REQ:
             case MOTE_MAC_LINK_CHECK_REQ: { // 0 byte payload
                 break;
             }
@@ -132,7 +138,8 @@ lorawan_status_t LoRaMacCommand::process_mac_commands(const uint8_t *payload, ui
                                                       uint8_t commands_size, uint8_t snr,
                                                       loramac_mlme_confirm_t &mlme_conf,
                                                       lora_mac_system_params_t &mac_sys_params,
-                                                      LoRaPHY &lora_phy)
+                                                      LoRaPHY_target &lora_phy,
+                                                      LoRaMacClassB &class_b)
 {
     uint8_t status = 0;
     lorawan_status_t ret_value = LORAWAN_STATUS_OK;
@@ -235,7 +242,10 @@ lorawan_status_t LoRaMacCommand::process_mac_commands(const uint8_t *payload, ui
                 chParam.rx1_frequency = 0;
                 chParam.dr_range.value = payload[mac_index++];
 
-                status = lora_phy.request_new_channel(channel_id, &chParam);
+                status = 0;
+                if (LoRaPHY_target::custom_channelplans_supported) {
+                    status = lora_phy.request_new_channel(channel_id, &chParam);
+                }
 
                 ret_value = add_new_channel_ans(status);
             }
@@ -269,7 +279,8 @@ lorawan_status_t LoRaMacCommand::process_mac_commands(const uint8_t *payload, ui
                 max_eirp = eirpDwellTime & 0x0F;
 
                 // Check the status for correctness
-                if (lora_phy.accept_tx_param_setup_req(ul_dwell_time, dl_dwell_time)) {
+                if (LoRaPHY_target::tx_param_setup_req_supported
+                        && lora_phy.accept_tx_param_setup_req(ul_dwell_time, dl_dwell_time)) {
                     // Accept command
                     mac_sys_params.uplink_dwell_time = ul_dwell_time;
                     mac_sys_params.downlink_dwell_time = dl_dwell_time;
@@ -287,11 +298,92 @@ lorawan_status_t LoRaMacCommand::process_mac_commands(const uint8_t *payload, ui
                 rx1_frequency |= (uint32_t) payload[mac_index++] << 8;
                 rx1_frequency |= (uint32_t) payload[mac_index++] << 16;
                 rx1_frequency *= 100;
-                status = lora_phy.dl_channel_request(channel_id, rx1_frequency);
+                status = 0;
+                if (LoRaPHY_target::dl_channel_req_supported) {
+                    status = lora_phy.dl_channel_request(channel_id, rx1_frequency);
+                }
 
                 ret_value = add_dl_channel_ans(status);
             }
             break;
+            case SRV_MAC_DEVICE_TIME_ANS: {
+                uint32_t seconds;
+                uint8_t fraction;
+
+                seconds = (uint32_t) payload[mac_index++];
+                seconds |= (uint32_t) payload[mac_index++] << 8;
+                seconds |= (uint32_t) payload[mac_index++] << 16;
+                seconds |= (uint32_t) payload[mac_index++] << 24;
+                fraction = payload[mac_index++];
+
+                if (_device_time_cb) {
+                    _device_time_cb(seconds, fraction);
+                }
+            }
+            break;
+            case SRV_MAC_PING_SLOT_INFO_ANS:
+                class_b.handle_ping_slot_info_ans();
+                break;
+            case SRV_MAC_PING_SLOT_CHANNEL_REQ: {
+                rx_param_setup_req_t ping_slot_channel;
+
+                ping_slot_channel.frequency = (uint32_t) payload[mac_index++];
+                ping_slot_channel.frequency |= (uint32_t) payload[mac_index++] << 8;
+                ping_slot_channel.frequency |= (uint32_t) payload[mac_index++] << 16;
+                ping_slot_channel.frequency *= 100;
+                ping_slot_channel.datarate = payload[mac_index++] & 0x0F;
+                ping_slot_channel.dr_offset = mac_sys_params.rx1_dr_offset;
+
+                // Status: Datarate OK, Channel frequency OK
+                status = lora_phy.accept_rx_param_setup_req(&ping_slot_channel) & 0x03;
+
+                // A frequency of 0 restores the default channel
+                if (ping_slot_channel.frequency == 0) {
+                    status |= 0x01;
+                }
+
+                if (status == 0x03) {
+                    class_b.set_ping_slot_channel(ping_slot_channel.frequency,
+                                                  ping_slot_channel.datarate);
+                }
+                ret_value = add_ping_slot_channel_ans(status);
+            }
+            break;
+            case SRV_MAC_BEACON_TIMING_ANS: {
+                uint16_t delay;
+                uint8_t channel;
+
+                delay = (uint16_t) payload[mac_index++];
+                delay |= (uint16_t) payload[mac_index++] << 8;
+                channel = payload[mac_index++];
+
+                class_b.handle_beacon_timing_ans(delay, channel);
+            }
+            break;
+            case SRV_MAC_BEACON_FREQ_REQ: {
+                rx_param_setup_req_t beacon_channel;
+
+                beacon_channel.frequency = (uint32_t) payload[mac_index++];
+                beacon_channel.frequency |= (uint32_t) payload[mac_index++] << 8;
+                beacon_channel.frequency |= (uint32_t) payload[mac_index++] << 16;
+                beacon_channel.frequency *= 100;
+                beacon_channel.datarate = lora_phy.get_beacon_datarate();
+                beacon_channel.dr_offset = mac_sys_params.rx1_dr_offset;
+
+                // Status: Beacon frequency OK
+                status = lora_phy.accept_rx_param_setup_req(&beacon_channel) & 0x01;
+
+                // A frequency of 0 restores the default channel
+                if (beacon_channel.frequency == 0) {
+                    status = 0x01;
+                }
+
+                if (status == 0x01) {
+                    class_b.set_beacon_frequency(beacon_channel.frequency);
+                }
+                ret_value = add_beacon_freq_ans(status);
+            }
+            break;
             default:
                 // Unknown command. ABORT MAC commands processing
                 tr_error("Invalid MAC command (0x%X)!", payload[mac_index]);
@@ -312,6 +404,11 @@ void LoRaMacCommand::set_batterylevel_callback(mbed::Callback<uint8_t(void)> bat
     _battery_level_cb = battery_level;
 }
 
+void LoRaMacCommand::set_device_time_callback(mbed::Callback<void(uint32_t, uint8_t)> device_time)
+{
+    _device_time_cb = device_time;
+}
+
 lorawan_status_t LoRaMacCommand::add_link_check_req()
 {
     lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
@@ -323,6 +420,39 @@ lorawan_status_t LoRaMacCommand::add_link_check_req()
     return ret;
 }
 
+lorawan_status_t LoRaMacCommand::add_ping_slot_info_req(uint8_t periodicity)
+{
+    lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
+    if (cmd_buffer_remaining() > 1) {
+        mac_cmd_buffer[mac_cmd_buf_idx++] = MOTE_MAC_PING_SLOT_INFO_REQ;
+        mac_cmd_buffer[mac_cmd_buf_idx++] = periodicity & 0x07;
+        ret = LORAWAN_STATUS_OK;
+    }
+    return ret;
+}
+
+lorawan_status_t LoRaMacCommand::add_beacon_timing_req()
+{
+    lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
+    if (cmd_buffer_remaining() > 0) {
+        mac_cmd_buffer[mac_cmd_buf_idx++] = MOTE_MAC_BEACON_TIMING_REQ;
+        // No payload for this command
+        ret = LORAWAN_STATUS_OK;
+    }
+    return ret;
+}
+
+lorawan_status_t LoRaMacCommand::add_device_time_req()
+{
+    lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
+    if (cmd_buffer_remaining() > 0) {
+        mac_cmd_buffer[mac_cmd_buf_idx++] = MOTE_MAC_DEVICE_TIME_REQ;
+        // No payload for this command
+        ret = LORAWAN_STATUS_OK;
+    }
+    return ret;
+}
+
 lorawan_status_t LoRaMacCommand::add_link_adr_ans(uint8_t status)
 {
     lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
@@ -422,3 +552,29 @@ lorawan_status_t LoRaMacCommand::add_dl_channel_ans(uint8_t status)
     }
     return ret;
 }
+
+lorawan_status_t LoRaMacCommand::add_ping_slot_channel_ans(uint8_t status)
+{
+    lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
+    if (cmd_buffer_remaining() > 1) {
+        mac_cmd_buffer[mac_cmd_buf_idx++] = MOTE_MAC_PING_SLOT_CHANNEL_ANS;
+        // Status: Datarate OK, Channel frequency OK
+        mac_cmd_buffer[mac_cmd_buf_idx++] = status;
+        // This is a sticky MAC command answer. Setup indication
+        sticky_mac_cmd = true;
+        ret = LORAWAN_STATUS_OK;
+    }
+    return ret;
+}
+
+lorawan_status_t LoRaMacCommand::add_beacon_freq_ans(uint8_t status)
+{
+    lorawan_status_t ret = LORAWAN_STATUS_LENGTH_ERROR;
+    if (cmd_buffer_remaining() > 1) {
+        mac_cmd_buffer[mac_cmd_buf_idx++] = MOTE_MAC_BEACON_FREQ_ANS;
+        // Status: Beacon frequency OK
+        mac_cmd_buffer[mac_cmd_buf_idx++] = status;
+        ret = LORAWAN_STATUS_OK;
+    }
+    return ret;
+}
@@ -42,7 +42,7 @@
 
 #include <stdint.h>
 #include "../../system/lorawan_data_structures.h"
-#include "../phy/LoRaPHY.h"
+#include "../phy/loraphy_target.h"
 
 /*!
  * Maximum MAC commands buffer size
@@ -50,6 +50,7 @@
 #define LORA_MAC_COMMAND_MAX_LENGTH                 128
 
 class LoRaMac;
+class LoRaMacClassB;
 
 /** LoRaMacCommand Class
  * Helper class for LoRaMac layer to handle any MAC commands
@@ -121,7 +122,8 @@ public:
                                           uint8_t commands_size, uint8_t snr,
                                           loramac_mlme_confirm_t &mlme_conf,
                                           lora_mac_system_params_t &mac_params,
-                                          LoRaPHY &lora_phy);
+                                          LoRaPHY_target &lora_phy,
+                                          LoRaMacClassB &class_b);
 
     /**
      * @brief Adds a new LinkCheckReq MAC command to be sent.
@@ -131,12 +133,45 @@ public:
      */
     lorawan_status_t add_link_check_req();
 
+    /**
+     * @brief Adds a new PingSlotInfoReq MAC command to be sent.
+     *
+     * @param [in] periodicity  Ping slot periodicity, 0 - 7
+     *
+     * @return status  Function status: LORAWAN_STATUS_OK: OK,
+     *                                  LORAWAN_STATUS_LENGTH_ERROR: Buffer full
+     */
+    lorawan_status_t add_ping_slot_info_req(uint8_t periodicity);
+
+    /**
+     * @brief Adds a new BeaconTimingReq MAC command to be sent.
+     *
+     * @return status  Function status: LORAWAN_STATUS_OK: OK,
+     *                                  LORAWAN_STATUS_LENGTH_ERROR: Buffer full
+     */
+    lorawan_status_t add_beacon_timing_req();
+
+    /**
+     * @brief Adds a new DeviceTimeReq MAC command to be sent.
+     *
+     * @return status  Function status: LORAWAN_STATUS_OK: OK,
+     *                                  LORAWAN_STATUS_LENGTH_ERROR: Buffer full
+     */
+    lorawan_status_t add_device_time_req();
+
     /**
      * @brief Set battery level query callback method
      *        If callback is not set, BAT_LEVEL_NO_MEASURE is returned.
      */
     void set_batterylevel_callback(mbed::Callback<uint8_t(void)> battery_level);
 
+    /**
+     * @brief Set DeviceTimeAns callback method
+     *        Receives the GPS time, in seconds and 1/256 s, at the end of
+     *        the uplink which carried DeviceTimeReq.
+     */
+    void set_device_time_callback(mbed::Callback<void(uint32_t, uint8_t)> device_time);
+
 private:
     /**
      * @brief Get the remaining size of the MAC command buffer
@@ -220,6 +255,26 @@ private:
      */
     lorawan_status_t add_dl_channel_ans(uint8_t status);
 
+    /**
+     * @brief Adds a new PingSlotChannelAns MAC command to be sent.
+     *
+     * @param [in] status Status bits
+     *
+     * @return status  Function status: LORAWAN_STATUS_OK: OK,
+     *                                  LORAWAN_STATUS_LENGTH_ERROR: Buffer full
+     */
+    lorawan_status_t add_ping_slot_channel_ans(uint8_t status);
+
+    /**
+     * @brief Adds a new BeaconFreqAns MAC command to be sent.
+     *
+     * @param [in] status Status bits
+     *
+     * @return status  Function status: LORAWAN_STATUS_OK: OK,
+     *                                  LORAWAN_STATUS_LENGTH_ERROR: Buffer full
+     */
+    lorawan_status_t add_beacon_freq_ans(uint8_t status);
+
 private:
     /**
       * Indicates if there are any pending sticky MAC commands
@@ -248,6 +303,7 @@ private:
     uint8_t mac_cmd_buffer_to_repeat[LORA_MAC_COMMAND_MAX_LENGTH];
 
     mbed::Callback<uint8_t(void)> _battery_level_cb;
+    mbed::Callback<void(uint32_t, uint8_t)> _device_time_cb;
 };
 
 #endif //__LORAMACCOMMAND_H__
@@ -29,6 +29,7 @@
 #include "LoRaMacCrypto.h"
 #include "../../system/lorawan_data_structures.h"
 #include "mbedtls/platform.h"
+#include "platform/profile.h"
 #include "trace.h"
 
 
@@ -56,6 +57,8 @@ int LoRaMacCrypto::compute_mic(const uint8_t *buffer, uint16_t size,
                                uint32_t address, uint8_t dir, uint32_t seq_counter,
                                uint32_t *mic)
 {
+    PROFILE_ZONE(PROFILE_COMPUTE_MIC);
+
     uint8_t computed_mic[16] = {};
     uint8_t mic_block_b0[16] = {};
     int ret = 0;
@@ -76,6 +79,16 @@ int LoRaMacCrypto::compute_mic(const uint8_t *buffer, uint16_t size,
 
     mic_block_b0[15] = size & 0xFF;
 
+#if MBED_CONF_LORA_STATIC_MEMORY
+    ret = compute_cmac(key, key_length, mic_block_b0, buffer, size & 0xFF, computed_mic);
+    if (0 == ret) {
+        *mic = (uint32_t)((uint32_t) computed_mic[3] << 24
+                          | (uint32_t) computed_mic[2] << 16
+                          | (uint32_t) computed_mic[1] << 8 | (uint32_t) computed_mic[0]);
+    }
+
+    return ret;
+#else
     mbedtls_cipher_init(aes_cmac_ctx);
 
     const mbedtls_cipher_info_t *cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
@@ -116,6 +129,7 @@ int LoRaMacCrypto::compute_mic(const uint8_t *buffer, uint16_t size,
 exit:
     mbedtls_cipher_free(aes_cmac_ctx);
     return ret;
+#endif
 }
 
 int LoRaMacCrypto::encrypt_payload(const uint8_t *buffer, uint16_t size,
@@ -123,12 +137,7 @@ int LoRaMacCrypto::encrypt_payload(const uint8_t *buffer, uint16_t size,
                                    uint32_t address, uint8_t dir, uint32_t seq_counter,
                                    uint8_t *enc_buffer)
 {
-    uint16_t i;
-    uint8_t bufferIndex = 0;
-    uint16_t ctr = 1;
     int ret = 0;
-    uint8_t a_block[16] = {};
-    uint8_t s_block[16] = {};
 
     mbedtls_aes_init(&aes_ctx);
     ret = mbedtls_aes_setkey_enc(&aes_ctx, key, key_length);
@@ -136,6 +145,56 @@ int LoRaMacCrypto::encrypt_payload(const uint8_t *buffer, uint16_t size,
         goto exit;
     }
 
+    ret = crypt_payload(buffer, size, &aes_ctx, address, dir, seq_counter,
+                        enc_buffer);
+
+exit:
+    mbedtls_aes_free(&aes_ctx);
+    return ret;
+}
+
+int LoRaMacCrypto::decrypt_payload(const uint8_t *buffer, uint16_t size,
+                                   const uint8_t *key, uint32_t key_length,
+                                   uint32_t address, uint8_t dir, uint32_t seq_counter,
+                                   uint8_t *dec_buffer)
+{
+    return encrypt_payload(buffer, size, key, key_length, address, dir, seq_counter,
+                           dec_buffer);
+}
+
+int LoRaMacCrypto::expand_payload_key(mbedtls_aes_context *key_ctx,
+                                      const uint8_t *key, uint32_t key_length)
+{
+    mbedtls_aes_init(key_ctx);
+    return mbedtls_aes_setkey_enc(key_ctx, key, key_length);
+}
+
+void LoRaMacCrypto::free_payload_key(mbedtls_aes_context *key_ctx)
+{
+    mbedtls_aes_free(key_ctx);
+}
+
+int LoRaMacCrypto::decrypt_payload(const uint8_t *buffer, uint16_t size,
+                                   mbedtls_aes_context *key_ctx,
+                                   uint32_t address, uint8_t dir, uint32_t seq_counter,
+                                   uint8_t *dec_buffer)
+{
+    return crypt_payload(buffer, size, key_ctx, address, dir, seq_counter,
+                         dec_buffer);
+}
+
+int LoRaMacCrypto::crypt_payload(const uint8_t *buffer, uint16_t size,
+                                 mbedtls_aes_context *key_ctx,
+                                 uint32_t address, uint8_t dir, uint32_t seq_counter,
+                                 uint8_t *out_buffer)
+{
+    uint16_t i;
+    uint8_t bufferIndex = 0;
+    uint16_t ctr = 1;
+    int ret = 0;
+    uint8_t a_block[16] = {};
+    uint8_t s_block[16] = {};
+
     a_block[0] = 0x01;
     a_block[5] = dir;
 
@@ -152,14 +211,14 @@ int LoRaMacCrypto::encrypt_payload(const uint8_t *buffer, uint16_t size,
     while (size >= 16) {
         a_block[15] = ((ctr) & 0xFF);
         ctr++;
-        ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, a_block,
+        ret = mbedtls_aes_crypt_ecb(key_ctx, MBEDTLS_AES_ENCRYPT, a_block,
                                     s_block);
         if (0 != ret) {
-            goto exit;
+            return ret;
         }
 
         for (i = 0; i < 16; i++) {
-            enc_buffer[bufferIndex + i] = buffer[bufferIndex + i] ^ s_block[i];
+            out_buffer[bufferIndex + i] = buffer[bufferIndex + i] ^ s_block[i];
         }
         size -= 16;
         bufferIndex += 16;
@@ -167,31 +226,20 @@ int LoRaMacCrypto::encrypt_payload(const uint8_t *buffer, uint16_t size,
 
     if (size > 0) {
         a_block[15] = ((ctr) & 0xFF);
-        ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, a_block,
+        ret = mbedtls_aes_crypt_ecb(key_ctx, MBEDTLS_AES_ENCRYPT, a_block,
                                     s_block);
         if (0 != ret) {
-            goto exit;
+            return ret;
         }
 
         for (i = 0; i < size; i++) {
-            enc_buffer[bufferIndex + i] = buffer[bufferIndex + i] ^ s_block[i];
+            out_buffer[bufferIndex + i] = buffer[bufferIndex + i] ^ s_block[i];
         }
     }
 
-exit:
-    mbedtls_aes_free(&aes_ctx);
     return ret;
 }
 
-int LoRaMacCrypto::decrypt_payload(const uint8_t *buffer, uint16_t size,
-                                   const uint8_t *key, uint32_t key_length,
-                                   uint32_t address, uint8_t dir, uint32_t seq_counter,
-                                   uint8_t *dec_buffer)
-{
-    return encrypt_payload(buffer, size, key, key_length, address, dir, seq_counter,
-                           dec_buffer);
-}
-
 int LoRaMacCrypto::compute_join_frame_mic(const uint8_t *buffer, uint16_t size,
                                           const uint8_t *key, uint32_t key_length,
                                           uint32_t *mic)
@@ -199,6 +247,16 @@ int LoRaMacCrypto::compute_join_frame_mic(const uint8_t *buffer, uint16_t size,
     uint8_t computed_mic[16] = {};
     int ret = 0;
 
+#if MBED_CONF_LORA_STATIC_MEMORY
+    ret = compute_cmac(key, key_length, NULL, buffer, size & 0xFF, computed_mic);
+    if (0 == ret) {
+        *mic = (uint32_t)((uint32_t) computed_mic[3] << 24
+                          | (uint32_t) computed_mic[2] << 16
+                          | (uint32_t) computed_mic[1] << 8 | (uint32_t) computed_mic[0]);
+    }
+
+    return ret;
+#else
     mbedtls_cipher_init(aes_cmac_ctx);
     const mbedtls_cipher_info_t *cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
 
@@ -233,7 +291,89 @@ int LoRaMacCrypto::compute_join_frame_mic(const uint8_t *buffer, uint16_t size,
 exit:
     mbedtls_cipher_free(aes_cmac_ctx);
     return ret;
+#endif
+}
+
+#if MBED_CONF_LORA_STATIC_MEMORY
+/**
+ * Doubles a CMAC subkey in GF(2^128)
+ */
+static void cmac_double(uint8_t *subkey)
+{
+    uint8_t msb = subkey[0] & 0x80;
+
+    for (uint8_t i = 0; i < 15; i++) {
+        subkey[i] = (subkey[i] << 1) | (subkey[i + 1] >> 7);
+    }
+    subkey[15] <<= 1;
+
+    if (msb) {
+        subkey[15] ^= 0x87;
+    }
+}
+
+int LoRaMacCrypto::compute_cmac(const uint8_t *key, uint32_t key_length,
+                                const uint8_t *block_b0, const uint8_t *buffer, uint16_t size,
+                                uint8_t *cmac)
+{
+    uint8_t subkey[16] = {};
+    uint8_t state[16] = {};
+    uint32_t length = (block_b0 ? 16 : 0) + size;
+    uint32_t nb_blocks = length ? (length + 15) / 16 : 1;
+    int ret = 0;
+
+    mbedtls_aes_init(&aes_ctx);
+
+    ret = mbedtls_aes_setkey_enc(&aes_ctx, key, key_length);
+    if (0 != ret) {
+        goto exit;
+    }
+
+    // K1, from the cipher of the zero block
+    ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, subkey, subkey);
+    if (0 != ret) {
+        goto exit;
+    }
+    cmac_double(subkey);
+
+    for (uint32_t n = 0; n < nb_blocks; n++) {
+        uint32_t block_size = (n + 1 < nb_blocks) ? 16 : length - n * 16;
+
+        for (uint32_t i = 0; i < block_size; i++) {
+            uint32_t index = n * 16 + i;
+
+            if (!block_b0) {
+                state[i] ^= buffer[index];
+            } else {
+                state[i] ^= index < 16 ? block_b0[index] : buffer[index - 16];
+            }
+        }
+
+        // the last block is xored with K1 if complete, or padded and
+        // xored with K2
+        if (n + 1 == nb_blocks) {
+            if (block_size < 16) {
+                state[block_size] ^= 0x80;
+                cmac_double(subkey);
+            }
+            for (uint8_t i = 0; i < 16; i++) {
+                state[i] ^= subkey[i];
+            }
+        }
+
+        ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, state, state);
+        if (0 != ret) {
+            goto exit;
+        }
+    }
+
+    memcpy(cmac, state, sizeof(state));
+
+exit:
+    mbedtls_aes_free(&aes_ctx);
+    return ret;
 }
+#endif
 
 int LoRaMacCrypto::decrypt_join_frame(const uint8_t *buffer, uint16_t size,
                                       const uint8_t *key, uint32_t key_length,
@@ -295,6 +435,43 @@ int LoRaMacCrypto::compute_skeys_for_join_frame(const uint8_t *key, uint32_t key
     memcpy(nonce + 7, p_dev_nonce, 2);
     ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, nonce, app_skey);
 
+exit:
+    mbedtls_aes_free(&aes_ctx);
+    return ret;
+}
+
+int LoRaMacCrypto::compute_ping_offset(uint32_t beacon_time, uint32_t address,
+                                       uint16_t ping_period, uint16_t *ping_offset)
+{
+    static const uint8_t zero_key[16] = { 0 };
+    uint8_t block[16];
+    uint8_t rand[16];
+    int ret = 0;
+
+    mbedtls_aes_init(&aes_ctx);
+
+    ret = mbedtls_aes_setkey_enc(&aes_ctx, zero_key, sizeof(zero_key) * 8);
+    if (0 != ret) {
+        goto exit;
+    }
+
+    memset(block, 0, sizeof(block));
+    block[0] = beacon_time & 0xFF;
+    block[1] = (beacon_time >> 8) & 0xFF;
+    block[2] = (beacon_time >> 16) & 0xFF;
+    block[3] = (beacon_time >> 24) & 0xFF;
+    block[4] = address & 0xFF;
+    block[5] = (address >> 8) & 0xFF;
+    block[6] = (address >> 16) & 0xFF;
+    block[7] = (address >> 24) & 0xFF;
+
+    ret = mbedtls_aes_crypt_ecb(&aes_ctx, MBEDTLS_AES_ENCRYPT, block, rand);
+    if (0 != ret) {
+        goto exit;
+    }
+
+    *ping_offset = (rand[0] + (rand[1] * 256)) % ping_period;
+
 exit:
     mbedtls_aes_free(&aes_ctx);
     return ret;
@@ -341,6 +518,27 @@ int LoRaMacCrypto::decrypt_payload(const uint8_t *, uint16_t, const uint8_t *, u
     return LORAWAN_STATUS_CRYPTO_FAIL;
 }
 
+int LoRaMacCrypto::expand_payload_key(mbedtls_aes_context *, const uint8_t *, uint32_t)
+{
+    MBED_ASSERT(0 && "[LoRaCrypto] Must enable AES, CMAC & CIPHER from mbedTLS");
+
+    // Never actually reaches here
+    return LORAWAN_STATUS_CRYPTO_FAIL;
+}
+
+void LoRaMacCrypto::free_payload_key(mbedtls_aes_context *)
+{
+}
+
+int LoRaMacCrypto::decrypt_payload(const uint8_t *, uint16_t, mbedtls_aes_context *, uint32_t,
+                                   uint8_t, uint32_t, uint8_t *)
+{
+    MBED_ASSERT(0 && "[LoRaCrypto] Must enable AES, CMAC & CIPHER from mbedTLS");
+
+    // Never actually reaches here
+    return LORAWAN_STATUS_CRYPTO_FAIL;
+}
+
 int LoRaMacCrypto::compute_join_frame_mic(const uint8_t *, uint16_t, const uint8_t *, uint32_t, uint32_t *)
 {
     MBED_ASSERT(0 && "[LoRaCrypto] Must enable AES, CMAC & CIPHER from mbedTLS");
@@ -366,4 +564,12 @@ int LoRaMacCrypto::compute_skeys_for_join_frame(const uint8_t *, uint32_t, const
     return LORAWAN_STATUS_CRYPTO_FAIL;
 }
 
+int LoRaMacCrypto::compute_ping_offset(uint32_t, uint32_t, uint16_t, uint16_t *)
+{
+    MBED_ASSERT(0 && "[LoRaCrypto] Must enable AES, CMAC & CIPHER from mbedTLS");
+
+    // Never actually reaches here
+    return LORAWAN_STATUS_CRYPTO_FAIL;
+}
+
 #endif
@@ -39,6 +39,7 @@ SPDX-License-Identifier: BSD-3-Clause
 //#include "../../../mbedtls/inc/mbedtls/config.h"
 #include "mbedtls/aes.h"
 #include "mbedtls/cmac.h"
+#include "mbed_config.h"
 
 
 class LoRaMacCrypto {
@@ -101,7 +102,8 @@ public:
      * @param [in]  address         - Frame address
      * @param [in]  dir             - Frame direction [0: uplink, 1: downlink]
      * @param [in]  seq_counter     - Frame sequence counter
-     * @param [out] dec_buffer      - Decrypted buffer
+     * @param [out] dec_buffer      - Decrypted buffer, may be the same as 'buffer'
+     *                                for in place decryption
      *
      * @return                        0 if successful, or a cipher specific error code
      */
@@ -110,6 +112,45 @@ public:
                         uint32_t address, uint8_t dir, uint32_t seq_counter,
                         uint8_t *dec_buffer);
 
+    /**
+     * Expands a payload key once, so that it can be used for any number of
+     * frames without running the AES key schedule again
+     *
+     * @param [out] key_ctx         - Context receiving the expanded key
+     * @param [in]  key             - AES key to be used
+     * @param [in]  key_length      - Length of the key (bits)
+     *
+     * @return                        0 if successful, or a cipher specific error code
+     */
+    int expand_payload_key(mbedtls_aes_context *key_ctx,
+                           const uint8_t *key, uint32_t key_length);
+
+    /**
+     * Releases a key expanded by expand_payload_key()
+     *
+     * @param [in]  key_ctx         - Expanded key
+     */
+    void free_payload_key(mbedtls_aes_context *key_ctx);
+
+    /**
+     * Performs payload decryption with a pre-expanded key
+     *
+     * @param [in]  buffer          - Data buffer
+     * @param [in]  size            - Data buffer size
+     * @param [in]  key_ctx         - Key expanded by expand_payload_key()
+     * @param [in]  address         - Frame address
+     * @param [in]  dir             - Frame direction [0: uplink, 1: downlink]
+     * @param [in]  seq_counter     - Frame sequence counter
+     * @param [out] dec_buffer      - Decrypted buffer, may be the same as 'buffer'
+     *                                for in place decryption
+     *
+     * @return                        0 if successful, or a cipher specific error code
+     */
+    int decrypt_payload(const uint8_t *buffer, uint16_t size,
+                        mbedtls_aes_context *key_ctx,
+                        uint32_t address, uint8_t dir, uint32_t seq_counter,
+                        uint8_t *dec_buffer);
+
     /**
      * Computes the LoRaMAC Join Request frame MIC field
      *
@@ -133,7 +174,8 @@ public:
      * @param [in]  size            - Data buffer size
      * @param [in]  key             - AES key to be used
      * @param [in]  key_length      - Length of the key (bits)
-     * @param [out] dec_buffer      - Decrypted buffer
+     * @param [out] dec_buffer      - Decrypted buffer, may be the same as 'buffer'
+     *                                for in place decryption
      *
      * @return                        0 if successful, or a cipher specific error code
      */
@@ -157,16 +199,50 @@ public:
                                      const uint8_t *app_nonce, uint16_t dev_nonce,
                                      uint8_t *nwk_skey, uint8_t *app_skey);
 
+    /**
+     * Computes the Class B ping slot offset for a beacon period
+     *
+     * @param [in]  beacon_time     - Time carried by the beacon opening the period
+     * @param [in]  address         - Device address
+     * @param [in]  ping_period     - Number of slots between two ping slots
+     * @param [out] ping_offset     - Offset of the first ping slot, in slots
+     *
+     * @return                        0 if successful, or a cipher specific error code
+     */
+    int compute_ping_offset(uint32_t beacon_time, uint32_t address,
+                            uint16_t ping_period, uint16_t *ping_offset);
+
 private:
+    /**
+     * Runs the payload key stream over 'buffer' with an expanded key
+     */
+    int crypt_payload(const uint8_t *buffer, uint16_t size,
+                      mbedtls_aes_context *key_ctx,
+                      uint32_t address, uint8_t dir, uint32_t seq_counter,
+                      uint8_t *out_buffer);
+
+#if MBED_CONF_LORA_STATIC_MEMORY
+    /**
+     * AES-CMAC (RFC 4493) of 'block_b0', if not NULL, followed by 'buffer',
+     * on the AES context: the mbedTLS cipher layer allocates its contexts
+     * from the heap
+     */
+    int compute_cmac(const uint8_t *key, uint32_t key_length,
+                     const uint8_t *block_b0, const uint8_t *buffer, uint16_t size,
+                     uint8_t *cmac);
+#endif
+
     /**
      * AES computation context variable
      */
     mbedtls_aes_context aes_ctx;
 
+#if !MBED_CONF_LORA_STATIC_MEMORY
     /**
      * CMAC computation context variable
      */
     mbedtls_cipher_context_t aes_cmac_ctx[1];
+#endif
 };
 
 #endif // MBED_LORAWAN_MAC_LORAMAC_CRYPTO_H__
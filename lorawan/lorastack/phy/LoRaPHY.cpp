@@ -34,7 +34,26 @@ SPDX-License-Identifier: BSD-3-Clause
 #define BACKOFF_DC_24_HOURS     10000
 #define MAX_PREAMBLE_LENGTH     8.0f
 #define TICK_GRANULARITY_JITTER 1.0f
+#define BEACON_PREAMBLE_LENGTH  10
+// Time, CRC, GwSpecific and CRC fields of a beacon
+#define BEACON_FIXED_SIZE       15
 #define CHANNELS_IN_MASK        16
+// Step of the channel frequencies kept, as in the MAC commands
+#define FREQUENCY_STEP          100
+
+static uint32_t unpack_frequency(const uint8_t *frequency)
+{
+    return ((uint32_t) frequency[0] | ((uint32_t) frequency[1] << 8)
+            | ((uint32_t) frequency[2] << 16)) * FREQUENCY_STEP;
+}
+
+static void pack_frequency(uint8_t *frequency, uint32_t hz)
+{
+    hz /= FREQUENCY_STEP;
+    frequency[0] = (uint8_t) hz;
+    frequency[1] = (uint8_t)(hz >> 8);
+    frequency[2] = (uint8_t)(hz >> 16);
+}
 
 LoRaPHY::LoRaPHY()
     : _radio(NULL),
@@ -175,9 +194,11 @@ bool LoRaPHY::verify_channel_DR(uint16_t *channel_mask, int8_t dr)
 
     for (uint8_t i = 0; i < phy_params.max_channel_cnt; i++) {
         if (mask_bit_test(channel_mask, i)) {
+            dr_range_t dr_range = get_channel_dr_range(i);
+
             // Check datarate validity for enabled channels
-            if (val_in_range(dr, (phy_params.channels.channel_list[i].dr_range.fields.min & 0x0F),
-                             (phy_params.channels.channel_list[i].dr_range.fields.max & 0x0F))) {
+            if (val_in_range(dr, (dr_range.fields.min & 0x0F),
+                             (dr_range.fields.max & 0x0F))) {
                 // At least 1 channel has been found we can return OK.
                 return true;
             }
@@ -252,15 +273,15 @@ void LoRaPHY::copy_channel_mask(uint16_t *dest_mask, uint16_t *src_mask, uint8_t
 void LoRaPHY::set_last_tx_done(uint8_t channel, bool joined, lorawan_time_t last_tx_done_time)
 {
     band_t *band_table = (band_t *) phy_params.bands.table;
-    channel_params_t *channel_list = phy_params.channels.channel_list;
+    uint8_t band_idx = get_channel_band(channel);
 
     if (joined == true) {
-        band_table[channel_list[channel].band].last_tx_time = last_tx_done_time;
+        band_table[band_idx].last_tx_time = last_tx_done_time;
         return;
     }
 
-    band_table[channel_list[channel].band].last_tx_time = last_tx_done_time;
-    band_table[channel_list[channel].band].last_join_tx_time = last_tx_done_time;
+    band_table[band_idx].last_tx_time = last_tx_done_time;
+    band_table[band_idx].last_join_tx_time = last_tx_done_time;
 
 }
 
@@ -405,7 +426,7 @@ float LoRaPHY::compute_symb_timeout_fsk(uint8_t phy_dr)
 
 
 void LoRaPHY::get_rx_window_params(float t_symb, uint8_t min_rx_symb,
-                                   float error_fudge, float wakeup_time,
+                                   float error_fudge, float rx_shift, float wakeup_time,
                                    uint32_t *window_length, uint32_t *window_length_ms,
                                    int32_t *window_offset,
                                    uint8_t phy_dr)
@@ -413,14 +434,15 @@ void LoRaPHY::get_rx_window_params(float t_symb, uint8_t min_rx_symb,
     float target_rx_window_offset;
     float window_len_in_ms;
 
-    if (phy_params.fsk_supported && phy_dr == phy_params.max_rx_datarate) {
+    if (MBED_CONF_LORA_FSK && phy_params.fsk_supported && phy_dr == phy_params.max_rx_datarate) {
         min_rx_symb = MAX_PREAMBLE_LENGTH;
     }
 
     // We wish to be as close as possible to the actual start of data, i.e.,
     // we are interested in the preamble symbols which are at the tail of the
-    // preamble sequence.
-    target_rx_window_offset = (MAX_PREAMBLE_LENGTH - min_rx_symb) * t_symb; //in ms
+    // preamble sequence. Frames observed to start late or early move the
+    // target along.
+    target_rx_window_offset = (MAX_PREAMBLE_LENGTH - min_rx_symb) * t_symb + rx_shift; //in ms
 
     // Actual window offset in ms in response to timing error fudge factor and
     // radio wakeup/turned around time.
@@ -431,7 +453,7 @@ void LoRaPHY::get_rx_window_params(float t_symb, uint8_t min_rx_symb,
                                              ((2 * error_fudge) + wakeup_time + TICK_GRANULARITY_JITTER));
 
     // how early we might start reception relative to transmit start (so negative if before transmit starts)
-    float earliest_possible_start_time = *window_offset - error_fudge - TICK_GRANULARITY_JITTER;
+    float earliest_possible_start_time = *window_offset - rx_shift - error_fudge - TICK_GRANULARITY_JITTER;
 
     // time in (ms) we may have to wait for the other side to start transmission
     float possible_wait_for_transmit = -earliest_possible_start_time;
@@ -495,15 +517,16 @@ uint8_t LoRaPHY::enabled_channel_count(uint8_t datarate,
 
     for (uint8_t i = 0; i < phy_params.max_channel_cnt; i++) {
         if (mask_bit_test(channel_mask, i)) {
+            dr_range_t dr_range = get_channel_dr_range(i);
 
-            if (val_in_range(datarate, phy_params.channels.channel_list[i].dr_range.fields.min,
-                             phy_params.channels.channel_list[i].dr_range.fields.max) == 0) {
+            if (val_in_range(datarate, dr_range.fields.min,
+                             dr_range.fields.max) == 0) {
                 // data rate range invalid for this channel
                 continue;
             }
 
             band_t *band_table = (band_t *) phy_params.bands.table;
-            if (band_table[phy_params.channels.channel_list[i].band].off_time > 0) {
+            if (band_table[get_channel_band(i)].off_time > 0) {
                 // Check if the band is available for transmission
                 delay_transmission++;
                 continue;
@@ -656,11 +679,140 @@ uint8_t LoRaPHY::get_max_nb_channels()
     return phy_params.max_channel_cnt;
 }
 
-channel_params_t *LoRaPHY::get_phy_channels()
+const loraphy_channel_grid_t *LoRaPHY::lookup_grid(uint8_t &channel) const
+{
+    for (uint8_t i = 0; i < phy_params.channels.grid_count; i++) {
+        if (channel < phy_params.channels.grids[i].count) {
+            return &phy_params.channels.grids[i];
+        }
+        channel -= phy_params.channels.grids[i].count;
+    }
+
+    return NULL;
+}
+
+uint32_t LoRaPHY::get_channel_frequency(uint8_t channel) const
+{
+    if (phy_params.channels.channel_list) {
+        return unpack_frequency(phy_params.channels.channel_list[channel].frequency);
+    }
+
+    const loraphy_channel_grid_t *grid = lookup_grid(channel);
+    return grid ? grid->first + channel * grid->spacing : 0;
+}
+
+uint32_t LoRaPHY::get_channel_rx1_frequency(uint8_t channel) const
+{
+    const loraphy_rx1_overrides_t *overrides = &phy_params.channels.rx1_overrides;
+
+    for (uint8_t i = 0; i < overrides->count; i++) {
+        if (overrides->list[i].channel == channel) {
+            return unpack_frequency(overrides->list[i].frequency);
+        }
+    }
+
+    return 0;
+}
+
+dr_range_t LoRaPHY::get_channel_dr_range(uint8_t channel) const
+{
+    if (phy_params.channels.channel_list) {
+        return phy_params.channels.channel_list[channel].dr_range;
+    }
+
+    const loraphy_channel_grid_t *grid = lookup_grid(channel);
+    dr_range_t none = { 0 };
+    return grid ? grid->dr_range : none;
+}
+
+uint8_t LoRaPHY::get_channel_band(uint8_t channel) const
+{
+    if (phy_params.channels.channel_list) {
+        return phy_params.channels.channel_list[channel].band;
+    }
+
+    return 0;
+}
+
+void LoRaPHY::get_channel(uint8_t channel, channel_params_t *params) const
+{
+    params->frequency = get_channel_frequency(channel);
+    params->rx1_frequency = get_channel_rx1_frequency(channel);
+    params->dr_range = get_channel_dr_range(channel);
+    params->band = get_channel_band(channel);
+}
+
+loraphy_channel_t *LoRaPHY::get_phy_channels()
 {
     return phy_params.channels.channel_list;
 }
 
+uint32_t LoRaPHY::get_phy_channels_size()
+{
+    if (!phy_params.channels.channel_list) {
+        return 0;
+    }
+
+    return phy_params.channels.channel_list_size * sizeof(loraphy_channel_t);
+}
+
+loraphy_rx1_overrides_t *LoRaPHY::get_rx1_overrides()
+{
+    return &phy_params.channels.rx1_overrides;
+}
+
+void LoRaPHY::pack_channel(loraphy_channel_t *channel, const channel_params_t *params)
+{
+    pack_frequency(channel->frequency, params->frequency);
+    channel->dr_range = params->dr_range;
+    channel->band = params->band;
+}
+
+bool LoRaPHY::set_rx1_override(uint8_t channel, uint32_t frequency)
+{
+    loraphy_rx1_overrides_t *overrides = &phy_params.channels.rx1_overrides;
+    uint8_t i = 0;
+
+    while (i < overrides->count && overrides->list[i].channel != channel) {
+        i++;
+    }
+
+    if (frequency == 0) {
+        if (i < overrides->count) {
+            // keep the list packed
+            overrides->list[i] = overrides->list[--overrides->count];
+        }
+        return true;
+    }
+
+    if (i == overrides->count) {
+        if (overrides->count == LORAPHY_MAX_RX1_OVERRIDES) {
+            return false;
+        }
+        overrides->count++;
+    }
+
+    overrides->list[i].channel = channel;
+    pack_frequency(overrides->list[i].frequency, frequency);
+
+    return true;
+}
+
+uint8_t LoRaPHY::get_channel_list_size()
+{
+    return phy_params.channels.channel_list_size;
+}
+
+lorawan_region_t LoRaPHY::get_region()
+{
+    return (lorawan_region_t) phy_params.region;
+}
+
+uint8_t LoRaPHY::get_channel_mask_size()
+{
+    return phy_params.channels.mask_size;
+}
+
 bool LoRaPHY::is_custom_channel_plan_supported()
 {
     return phy_params.custom_channelplans_supported;
@@ -826,7 +978,7 @@ bool LoRaPHY::get_next_ADR(bool restore_channel_mask, int8_t &dr_out,
 }
 
 void LoRaPHY::compute_rx_win_params(int8_t datarate, uint8_t min_rx_symbols,
-                                    uint32_t rx_error,
+                                    uint32_t rx_error, int32_t rx_shift,
                                     rx_config_params_t *rx_conf_params)
 {
     float t_symbol = 0.0;
@@ -836,7 +988,8 @@ void LoRaPHY::compute_rx_win_params(int8_t datarate, uint8_t min_rx_symbols,
 
     rx_conf_params->bandwidth = get_bandwidth(rx_conf_params->datarate);
 
-    if (phy_params.fsk_supported && rx_conf_params->datarate == phy_params.max_rx_datarate) {
+    if (MBED_CONF_LORA_FSK && phy_params.fsk_supported
+            && rx_conf_params->datarate == phy_params.max_rx_datarate) {
         // FSK
         t_symbol = compute_symb_timeout_fsk(((uint8_t *)phy_params.datarates.table)[rx_conf_params->datarate]);
     } else {
@@ -846,10 +999,11 @@ void LoRaPHY::compute_rx_win_params(int8_t datarate, uint8_t min_rx_symbols,
     }
 
     if (rx_conf_params->rx_slot == RX_SLOT_WIN_1) {
-        rx_conf_params->frequency = phy_params.channels.channel_list[rx_conf_params->channel].frequency;
+        rx_conf_params->frequency = get_channel_frequency(rx_conf_params->channel);
     }
 
-    get_rx_window_params(t_symbol, min_rx_symbols, (float) rx_error, MBED_CONF_LORA_WAKEUP_TIME,
+    get_rx_window_params(t_symbol, min_rx_symbols, (float) rx_error, (float) rx_shift,
+                         MBED_CONF_LORA_WAKEUP_TIME,
                          &rx_conf_params->window_timeout, &rx_conf_params->window_timeout_ms,
                          &rx_conf_params->window_offset,
                          rx_conf_params->datarate);
@@ -866,6 +1020,56 @@ uint32_t LoRaPHY::get_rx_time_on_air(uint8_t modem, uint16_t pkt_len)
     return toa;
 }
 
+uint8_t LoRaPHY::get_beacon_size()
+{
+    if (phy_params.beacon_frequency == 0) {
+        return 0;
+    }
+
+    return BEACON_FIXED_SIZE + phy_params.beacon_rfu1_size
+           + phy_params.beacon_rfu2_size;
+}
+
+uint8_t LoRaPHY::get_beacon_time_offset()
+{
+    return phy_params.beacon_rfu1_size;
+}
+
+uint8_t LoRaPHY::get_beacon_datarate()
+{
+    return phy_params.beacon_datarate;
+}
+
+uint8_t LoRaPHY::get_beacon_channel_count()
+{
+    return MAX(phy_params.beacon_channel_count, 1);
+}
+
+uint32_t LoRaPHY::get_beacon_frequency(uint8_t channel)
+{
+    return phy_params.beacon_frequency
+           + (uint32_t) channel * phy_params.beacon_channel_spacing;
+}
+
+bool LoRaPHY::rx_beacon_config(rx_config_params_t *rx_conf)
+{
+    uint8_t phy_dr = ((uint8_t *) phy_params.datarates.table)[rx_conf->datarate];
+
+    _radio->lock();
+
+    _radio->set_channel(rx_conf->frequency);
+
+    rx_conf->modem_type = MODEM_LORA;
+    _radio->set_rx_config(MODEM_LORA, rx_conf->bandwidth, phy_dr, 1, 0,
+                          BEACON_PREAMBLE_LENGTH, rx_conf->window_timeout,
+                          true, get_beacon_size(), false, 0, 0,
+                          false, rx_conf->is_rx_continuous);
+
+    _radio->unlock();
+
+    return true;
+}
+
 bool LoRaPHY::rx_config(rx_config_params_t *rx_conf)
 {
     uint8_t dr = rx_conf->datarate;
@@ -884,7 +1088,7 @@ bool LoRaPHY::rx_config(rx_config_params_t *rx_conf)
     _radio->set_channel(rx_conf->frequency);
 
     // Radio configuration
-    if (dr == DR_7 && phy_params.fsk_supported) {
+    if (MBED_CONF_LORA_FSK && dr == DR_7 && phy_params.fsk_supported) {
         rx_conf->modem_type = MODEM_FSK;
         _radio->set_rx_config((radio_modems_t) rx_conf->modem_type, 50000, phy_dr * 1000, 0, 83333, MAX_PREAMBLE_LENGTH,
                               rx_conf->window_timeout, false, 0, true, 0, 0,
@@ -915,8 +1119,7 @@ bool LoRaPHY::tx_config(tx_config_params_t *tx_conf, int8_t *tx_power,
 {
     radio_modems_t modem;
     int8_t phy_dr = ((uint8_t *)phy_params.datarates.table)[tx_conf->datarate];
-    channel_params_t *list = phy_params.channels.channel_list;
-    uint8_t band_idx = list[tx_conf->channel].band;
+    uint8_t band_idx = get_channel_band(tx_conf->channel);
     band_t *bands = (band_t *)phy_params.bands.table;
 
     // limit TX power if set to too much
@@ -932,9 +1135,10 @@ bool LoRaPHY::tx_config(tx_config_params_t *tx_conf, int8_t *tx_power,
     _radio->lock();
 
     // Setup the radio frequency
-    _radio->set_channel(list[tx_conf->channel].frequency);
+    _radio->set_channel(get_channel_frequency(tx_conf->channel));
 
-    if (tx_conf->datarate == phy_params.max_tx_datarate) {
+    if (MBED_CONF_LORA_FSK && phy_params.fsk_supported
+            && tx_conf->datarate == phy_params.max_tx_datarate) {
         // High Speed FSK channel
         modem = MODEM_FSK;
         _radio->set_tx_config(modem, phy_tx_power, 25000, bandwidth,
@@ -1010,7 +1214,7 @@ uint8_t LoRaPHY::link_ADR_request(adr_req_params_t *link_adr_req,
 
                 // turn on all channels if channel mask control is 6
                 if (adr_settings.ch_mask_ctrl == 6) {
-                    if (phy_params.channels.channel_list[i].frequency != 0) {
+                    if (get_channel_frequency(i) != 0) {
                         mask_bit_set(temp_channel_mask, i);
                     }
 
@@ -1020,7 +1224,7 @@ uint8_t LoRaPHY::link_ADR_request(adr_req_params_t *link_adr_req,
                 // if channel mask control is 0, we test the bits and
                 // frequencies and change the status if we find a discrepancy
                 if ((mask_bit_test(temp_channel_mask, i)) &&
-                        (phy_params.channels.channel_list[i].frequency == 0)) {
+                        (get_channel_frequency(i) == 0)) {
                     // Trying to enable an undefined channel
                     status &= 0xFE; // Channel mask KO
                 }
@@ -1157,13 +1361,13 @@ uint8_t LoRaPHY::dl_channel_request(uint8_t channel_id, uint32_t rx1_frequency)
     }
 
     // Verify if an uplink frequency exists
-    if (phy_params.channels.channel_list[channel_id].frequency == 0) {
+    if (get_channel_frequency(channel_id) == 0) {
         status &= 0xFD;
     }
 
-    // Apply Rx1 frequency, if the status is OK
-    if (status == 0x03) {
-        phy_params.channels.channel_list[channel_id].rx1_frequency = rx1_frequency;
+    // Apply Rx1 frequency, if the status is OK and there is room for it
+    if (status == 0x03 && !set_rx1_override(channel_id, rx1_frequency)) {
+        status &= 0xFE;
     }
 
     return status;
@@ -1221,9 +1425,8 @@ void LoRaPHY::calculate_backoff(bool joined, bool last_tx_was_join_req, bool dc_
                                 lorawan_time_t elapsed_time, lorawan_time_t tx_toa)
 {
     band_t *band_table = (band_t *) phy_params.bands.table;
-    channel_params_t *channel_list = phy_params.channels.channel_list;
 
-    uint8_t band_idx = channel_list[channel].band;
+    uint8_t band_idx = get_channel_band(channel);
     uint16_t duty_cycle = band_table[band_idx].duty_cycle;
     uint16_t join_duty_cycle = 0;
 
@@ -1366,14 +1569,16 @@ lorawan_status_t LoRaPHY::add_channel(const channel_params_t *new_channel,
         }
 
         // We are not allowed to change the frequency
-        if (new_channel->frequency != phy_params.channels.channel_list[id].frequency) {
+        if (new_channel->frequency != get_channel_frequency(id)) {
             freq_invalid = true;
         }
     }
 
-    // Check frequency
+    // Check frequency, which is kept in steps of 100 Hz
     if (!freq_invalid) {
         if (new_channel->band >= phy_params.bands.size
+                || new_channel->frequency % FREQUENCY_STEP != 0
+                || new_channel->rx1_frequency % FREQUENCY_STEP != 0
                 || verify_frequency_for_band(new_channel->frequency,
                                              new_channel->band) == false) {
             freq_invalid = true;
@@ -1389,13 +1594,11 @@ lorawan_status_t LoRaPHY::add_channel(const channel_params_t *new_channel,
         return LORAWAN_STATUS_DATARATE_INVALID;
     }
 
-    if (freq_invalid) {
+    if (freq_invalid || !set_rx1_override(id, new_channel->rx1_frequency)) {
         return LORAWAN_STATUS_FREQUENCY_INVALID;
     }
 
-    memmove(&(phy_params.channels.channel_list[id]), new_channel, sizeof(channel_params_t));
-
-    phy_params.channels.channel_list[id].band = new_channel->band;
+    pack_channel(&phy_params.channels.channel_list[id], new_channel);
 
     mask_bit_set(phy_params.channels.mask, id);
 
@@ -1412,27 +1615,28 @@ bool LoRaPHY::remove_channel(uint8_t channel_id)
 
 
     // Remove the channel from the list of channels
-    const channel_params_t empty_channel = { 0, 0, {0}, 0 };
-    phy_params.channels.channel_list[channel_id] = empty_channel;
+    memset(&phy_params.channels.channel_list[channel_id], 0, sizeof(loraphy_channel_t));
+    set_rx1_override(channel_id, 0);
 
     return disable_channel(phy_params.channels.mask, channel_id,
                            phy_params.max_channel_cnt);
 }
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
 void LoRaPHY::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_frequency)
 {
     band_t *bands_table = (band_t *) phy_params.bands.table;
-    channel_params_t *channels = phy_params.channels.channel_list;
+    uint8_t band_idx = get_channel_band(params->channel);
 
-    if (params->tx_power > bands_table[channels[params->channel].band].max_tx_pwr) {
-        params->tx_power = bands_table[channels[params->channel].band].max_tx_pwr;
+    if (params->tx_power > bands_table[band_idx].max_tx_pwr) {
+        params->tx_power = bands_table[band_idx].max_tx_pwr;
     }
 
     int8_t phy_tx_power = 0;
     uint32_t frequency  = 0;
 
     if (given_frequency == 0) {
-        frequency = channels[params->channel].frequency;
+        frequency = get_channel_frequency(params->channel);
     } else {
         frequency = given_frequency;
     }
@@ -1449,6 +1653,7 @@ void LoRaPHY::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_frequenc
     _radio->set_tx_continuous_wave(frequency, phy_tx_power, params->timeout);
     _radio->unlock();
 }
+#endif
 
 uint8_t LoRaPHY::apply_DR_offset(int8_t dr, int8_t dr_offset)
 {
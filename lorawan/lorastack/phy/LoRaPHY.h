@@ -203,6 +203,17 @@ public:
      */
     virtual bool rx_config(rx_config_params_t *config);
 
+    /** Configure radio reception of a Class B beacon.
+     *
+     * Beacons are sent in implicit header mode without a radio CRC and with
+     * non-inverted IQ.
+     *
+     * @param [in] config    A pointer to the RX configuration.
+     *
+     * @return True, if the configuration was applied successfully.
+     */
+    bool rx_beacon_config(rx_config_params_t *config);
+
     /** Computing Receive Windows
      *
      * The algorithm tries to calculate the length of receive windows (i.e.,
@@ -276,12 +287,16 @@ public:
      *                              in a [-rxError : +rxError] ms interval around
      *                              RxOffset.
      *
+     * @param [in] rx_shift         The observed delay, in milliseconds, of the
+     *                              frames with respect to their nominal start.
+     *                              The interval is centred on it.
+     *
      * @param [out] rx_conf_params  Pointer to the structure that needs to be
      *                              filled with receive window parameters.
      *
      */
     virtual void compute_rx_win_params(int8_t datarate, uint8_t min_rx_symbols,
-                                       uint32_t rx_error,
+                                       uint32_t rx_error, int32_t rx_shift,
                                        rx_config_params_t *rx_conf_params);
 
     /** Configure radio transmission.
@@ -397,6 +412,7 @@ public:
      */
     virtual bool remove_channel(uint8_t channel_id);
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
     /** Puts the radio into continuous wave mode.
      *
      * @param [in] continuous_wave   A pointer to the function parameters.
@@ -405,6 +421,7 @@ public:
      */
     virtual void set_tx_cont_mode(cw_mode_params_t *continuous_wave,
                                   uint32_t frequency = 0);
+#endif
 
     /** Computes new data rate according to the given offset
      *
@@ -509,10 +526,75 @@ public:
     uint8_t get_max_nb_channels();
 
     /**
-     * @brief get_phy_channels Gets PHY channels
-     * @return PHY channels
+     * @brief get_channel_frequency Gets the frequency of a channel
+     * @param channel Channel index
+     * @return Frequency in Hz, 0 if the channel is not defined
+     */
+    uint32_t get_channel_frequency(uint8_t channel) const;
+
+    /**
+     * @brief get_channel_rx1_frequency Gets the alternative RX1 frequency of a channel
+     * @param channel Channel index
+     * @return Frequency in Hz, 0 if RX1 uses the uplink frequency
+     */
+    uint32_t get_channel_rx1_frequency(uint8_t channel) const;
+
+    /**
+     * @brief get_channel_dr_range Gets the datarates of a channel
+     * @param channel Channel index
+     * @return Datarate range
+     */
+    dr_range_t get_channel_dr_range(uint8_t channel) const;
+
+    /**
+     * @brief get_channel_band Gets the band of a channel
+     * @param channel Channel index
+     * @return Band index
      */
-    channel_params_t *get_phy_channels();
+    uint8_t get_channel_band(uint8_t channel) const;
+
+    /**
+     * @brief get_channel Gets a channel
+     * @param channel Channel index
+     * @param params Filled with the channel, a frequency of 0 if it is not defined
+     */
+    void get_channel(uint8_t channel, channel_params_t *params) const;
+
+    /**
+     * @brief get_phy_channels Gets the channels the PHY keeps in RAM
+     * @return Channel list, NULL if the channels are on fixed grids
+     */
+    loraphy_channel_t *get_phy_channels();
+
+    /**
+     * @brief get_phy_channels_size Gets the size of the channel list in RAM
+     * @return Size in bytes, 0 if the channels are on fixed grids
+     */
+    uint32_t get_phy_channels_size();
+
+    /**
+     * @brief get_rx1_overrides Gets the alternative RX1 frequencies
+     * @return Alternative RX1 frequencies
+     */
+    loraphy_rx1_overrides_t *get_rx1_overrides();
+
+    /**
+     * @brief get_channel_list_size Gets the number of entries in the channel list
+     * @return Number of entries
+     */
+    uint8_t get_channel_list_size();
+
+    /**
+     * @brief get_region Gets the region the PHY implements
+     * @return A lorawan_region_t
+     */
+    lorawan_region_t get_region();
+
+    /**
+     * @brief get_channel_mask_size Gets the size of the channel mask
+     * @return Number of 16-bit words in the mask
+     */
+    uint8_t get_channel_mask_size();
 
     /**
      * @brief is_custom_channel_plan_supported Checks if custom channel plan is supported
@@ -520,12 +602,55 @@ public:
      */
     bool is_custom_channel_plan_supported();
 
+    /**
+     * What a region may support, known at build time. A region class hides
+     * these with its own values, which its constructor copies to phy_params,
+     * so that code calling the region class, rather than LoRaPHY, can leave
+     * out what the region never does. Through LoRaPHY anything is possible
+     * and checked at run time.
+     */
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = true;
+
     /**
      * @brief get_rx_time_on_air(...) calculates the time the received spent on air
      * @return time spent on air in milliseconds
      */
     uint32_t get_rx_time_on_air(uint8_t modem, uint16_t pkt_len);
 
+    /**
+     * @brief get_beacon_size Gets the size of a Class B beacon
+     * @return Beacon size in bytes, 0 if the region has no Class B support
+     */
+    uint8_t get_beacon_size();
+
+    /**
+     * @brief get_beacon_time_offset Gets the position of the time field in a beacon
+     * @return Offset of the time field in bytes
+     */
+    uint8_t get_beacon_time_offset();
+
+    /**
+     * @brief get_beacon_datarate Gets the datarate of beacons and ping slots
+     * @return Beacon datarate
+     */
+    uint8_t get_beacon_datarate();
+
+    /**
+     * @brief get_beacon_channel_count Gets the number of beacon channels
+     * @return Number of channels the beacon and ping slots hop over
+     */
+    uint8_t get_beacon_channel_count();
+
+    /**
+     * @brief get_beacon_frequency Gets the frequency of a beacon channel
+     * @param channel Channel index, less than get_beacon_channel_count()
+     * @return Frequency in Hz
+     */
+    uint32_t get_beacon_frequency(uint8_t channel);
+
 public: //Verifiers
 
     /**
@@ -577,6 +702,17 @@ protected:
      */
     virtual bool verify_frequency_for_band(uint32_t freq, uint8_t band) const;
 
+    /**
+     * Packs a channel into the channel list, without its RX1 frequency.
+     */
+    static void pack_channel(loraphy_channel_t *channel, const channel_params_t *params);
+
+    /**
+     * Sets the alternative RX1 frequency of a channel, 0 to remove it.
+     * Returns false if there are already as many as can be kept.
+     */
+    bool set_rx1_override(uint8_t channel, uint32_t frequency);
+
     /**
      * Verifies, if a value is in a given range.
      */
@@ -631,7 +767,7 @@ protected:
      * Computes the RX window timeout and the RX window offset.
      */
     void get_rx_window_params(float t_symbol, uint8_t min_rx_symbols,
-                              float rx_error, float wakeup_time,
+                              float rx_error, float rx_shift, float wakeup_time,
                               uint32_t *window_length, uint32_t *window_length_ms,
                               int32_t *window_offset,
                               uint8_t phy_dr);
@@ -664,6 +800,11 @@ protected:
 
 private:
 
+    /**
+     * Finds the grid of a channel of a fixed plan, and its index on the grid.
+     */
+    const loraphy_channel_grid_t *lookup_grid(uint8_t &channel) const;
+
     /**
      * Computes the symbol time for LoRa modulation.
      */
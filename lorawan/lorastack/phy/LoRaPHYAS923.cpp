@@ -48,9 +48,13 @@
 #define AS923_TX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define AS923_TX_MAX_DATARATE                       DR_7
+#else
+#define AS923_TX_MAX_DATARATE                       DR_6
+#endif
 
 /*!
  * Minimal datarate that can be used by the node
@@ -58,9 +62,13 @@
 #define AS923_RX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define AS923_RX_MAX_DATARATE                       DR_7
+#else
+#define AS923_RX_MAX_DATARATE                       DR_6
+#endif
 
 /*!
  * Default datarate used by the node
@@ -184,6 +192,22 @@
  */
 #define AS923_RX_WND_2_DR                           DR_2
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define AS923_BEACON_FREQ                           923400000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define AS923_BEACON_DR                             DR_3
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define AS923_BEACON_RFU1_SIZE                      2
+#define AS923_BEACON_RFU2_SIZE                      0
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -247,10 +271,8 @@ LoRaPHYAS923::LoRaPHYAS923()
 
     // Default Channels are always enabled in the channel list,
     // rest will be added later
-    channels[0] = AS923_LC1;
-    channels[0].band = 0;
-    channels[1] = AS923_LC2;
-    channels[1].band = 0;
+    pack_channel(&channels[0], &AS923_LC1);
+    pack_channel(&channels[1], &AS923_LC2);
 
     // Initialize the default channel mask
     default_channel_mask[0] = LC(1) + LC(2);
@@ -289,11 +311,12 @@ LoRaPHYAS923::LoRaPHYAS923()
     phy_params.dwell_limit_datarate = AS923_DWELL_LIMIT_DATARATE;
 
     phy_params.duty_cycle_enabled = AS923_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = true;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = true;
-    phy_params.cflist_supported = true;
-    phy_params.dl_channel_req_supported = true;
-    phy_params.custom_channelplans_supported = true;
+    phy_params.region = LORAWAN_REGION_AS923;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = AS923_NUMB_DEFAULT_CHANNELS;
     phy_params.max_channel_cnt = AS923_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = AS923_NUMB_CHANNELS_CF_LIST;
@@ -324,6 +347,11 @@ LoRaPHYAS923::LoRaPHYAS923()
     phy_params.ack_timeout_rnd = AS923_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = AS923_RX_WND_2_DR;
     phy_params.rx_window2_frequency = AS923_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = AS923_BEACON_FREQ;
+    phy_params.beacon_datarate = AS923_BEACON_DR;
+    phy_params.beacon_rfu1_size = AS923_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = AS923_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = 1;
 }
 
 LoRaPHYAS923::~LoRaPHYAS923()
@@ -381,7 +409,7 @@ lorawan_status_t LoRaPHYAS923::set_next_channel(channel_selection_params_t *next
             // If the channel is free, we can stop the LBT mechanism
 
             if (_radio->perform_carrier_sense(MODEM_LORA,
-                                              channels[next_channel_idx].frequency,
+                                              get_channel_frequency(next_channel_idx),
                                               AS923_RSSI_FREE_TH,
                                               AS923_CARRIER_SENSE_TIME) == true) {
                 // Free channel found
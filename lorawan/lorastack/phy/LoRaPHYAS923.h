@@ -48,12 +48,17 @@
 
 #define AS923_CHANNEL_MASK_SIZE                    1
 
-class LoRaPHYAS923 : public LoRaPHY {
+class LoRaPHYAS923 final : public LoRaPHY {
 
 public:
     LoRaPHYAS923();
     virtual ~LoRaPHYAS923();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = true;
+
     virtual int8_t get_alternate_DR(uint8_t nb_trials);
 
     virtual lorawan_status_t set_next_channel(channel_selection_params_t *nextChanParams,
@@ -63,7 +68,7 @@ public:
     virtual uint8_t apply_DR_offset(int8_t dr, int8_t drOffset);
 
 private:
-    channel_params_t channels[AS923_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[AS923_MAX_NB_CHANNELS];
     band_t bands[AS923_MAX_NB_BANDS];
     uint16_t channel_mask[AS923_CHANNEL_MASK_SIZE];
     uint16_t default_channel_mask[AS923_CHANNEL_MASK_SIZE];
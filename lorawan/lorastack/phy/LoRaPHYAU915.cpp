@@ -163,6 +163,28 @@
  */
 #define AU915_RX_WND_2_DR                           DR_8
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define AU915_BEACON_FREQ                           923300000
+
+/*!
+ * Number of beacon channels and their spacing in Hz.
+ */
+#define AU915_BEACON_CHANNELS                       8
+#define AU915_BEACON_CHANNEL_SPACING                600000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define AU915_BEACON_DR                             DR_8
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define AU915_BEACON_RFU1_SIZE                      3
+#define AU915_BEACON_RFU2_SIZE                      1
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -230,25 +252,19 @@ static const uint16_t fsb_mask[] = MBED_CONF_LORA_FSB_MASK;
 
 static const uint16_t full_channel_mask [] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x00FF};
 
+/*!
+ * Channels: 64 of 125 kHz from 915.2 MHz, upstream only, then 8 of 500 kHz
+ * from 915.9 MHz, upstream and downstream
+ */
+static const loraphy_channel_grid_t channel_grids_AU915[] = {
+    { 915200000, 200000, AU915_MAX_NB_CHANNELS - 8, { (DR_5 << 4) | DR_0 } },
+    { 915900000, 1600000, 8, { (DR_6 << 4) | DR_6 } }
+};
+
 LoRaPHYAU915::LoRaPHYAU915()
 {
     bands[0] = AU915_BAND0;
 
-    // Activate Channels
-    // 125 kHz channels Upstream only
-    for (uint8_t i = 0; i < AU915_MAX_NB_CHANNELS - 8; i++) {
-        channels[i].frequency = 915200000 + i * 200000;
-        channels[i].dr_range.value = (DR_5 << 4) | DR_0;
-        channels[i].band = 0;
-    }
-    // 500 kHz channels
-    // Upstream and downstream both
-    for (uint8_t i = AU915_MAX_NB_CHANNELS - 8; i < AU915_MAX_NB_CHANNELS; i++) {
-        channels[i].frequency = 915900000 + (i - (AU915_MAX_NB_CHANNELS - 8)) * 1600000;
-        channels[i].dr_range.value = (DR_6 << 4) | DR_6;
-        channels[i].band = 0;
-    }
-
     // Initialize channels default mask
     // All channels are default channels here
     // Join request needs to alternate between 125 KHz and 500 KHz channels
@@ -270,7 +286,8 @@ LoRaPHYAU915::LoRaPHYAU915()
     copy_channel_mask(current_channel_mask, channel_mask, AU915_CHANNEL_MASK_SIZE);
 
     // set default channels
-    phy_params.channels.channel_list = channels;
+    phy_params.channels.grids = channel_grids_AU915;
+    phy_params.channels.grid_count = sizeof(channel_grids_AU915) / sizeof(channel_grids_AU915[0]);
     phy_params.channels.channel_list_size = AU915_MAX_NB_CHANNELS;
     phy_params.channels.mask = channel_mask;
     phy_params.channels.default_mask = default_channel_mask;
@@ -300,9 +317,11 @@ LoRaPHYAU915::LoRaPHYAU915()
     phy_params.dwell_limit_datarate = AU915_DEFAULT_DATARATE;
 
     phy_params.duty_cycle_enabled = AU915_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = false;
-    phy_params.custom_channelplans_supported = false;
-    phy_params.cflist_supported = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.region = LORAWAN_REGION_AU915;
+    phy_params.cflist_supported = cflist_supported;
     phy_params.fsk_supported = false;
 
     phy_params.default_channel_cnt = AU915_MAX_NB_CHANNELS;
@@ -335,6 +354,12 @@ LoRaPHYAU915::LoRaPHYAU915()
     phy_params.ack_timeout_rnd = AU915_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = AU915_RX_WND_2_DR;
     phy_params.rx_window2_frequency = AU915_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = AU915_BEACON_FREQ;
+    phy_params.beacon_datarate = AU915_BEACON_DR;
+    phy_params.beacon_rfu1_size = AU915_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = AU915_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = AU915_BEACON_CHANNELS;
+    phy_params.beacon_channel_spacing = AU915_BEACON_CHANNEL_SPACING;
 }
 
 LoRaPHYAU915::~LoRaPHYAU915()
@@ -388,8 +413,8 @@ bool LoRaPHYAU915::tx_config(tx_config_params_t *params, int8_t *tx_power,
 {
     int8_t phy_dr = datarates_AU915[params->datarate];
 
-    if (params->tx_power > bands[channels[params->channel].band].max_tx_pwr) {
-        params->tx_power = bands[channels[params->channel].band].max_tx_pwr;
+    if (params->tx_power > bands[get_channel_band(params->channel)].max_tx_pwr) {
+        params->tx_power = bands[get_channel_band(params->channel)].max_tx_pwr;
     }
 
     uint32_t bandwidth = get_bandwidth(params->datarate);
@@ -403,7 +428,7 @@ bool LoRaPHYAU915::tx_config(tx_config_params_t *params, int8_t *tx_power,
 
     _radio->lock();
 
-    _radio->set_channel(channels[params->channel].frequency);
+    _radio->set_channel(get_channel_frequency(params->channel));
 
     _radio->set_tx_config(MODEM_LORA, phy_tx_power, 0, bandwidth, phy_dr, 1, 8,
                           false, true, 0, 0, false, 3000);
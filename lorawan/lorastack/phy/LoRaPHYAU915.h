@@ -50,13 +50,18 @@
 
 #define AU915_CHANNEL_MASK_SIZE                    5
 
-class LoRaPHYAU915 : public LoRaPHY {
+class LoRaPHYAU915 final : public LoRaPHY {
 
 public:
 
     LoRaPHYAU915();
     virtual ~LoRaPHYAU915();
 
+    static constexpr bool cflist_supported = false;
+    static constexpr bool custom_channelplans_supported = false;
+    static constexpr bool dl_channel_req_supported = false;
+    static constexpr bool tx_param_setup_req_supported = false;
+
     virtual bool rx_config(rx_config_params_t *config);
 
     virtual bool tx_config(tx_config_params_t *config, int8_t *txPower,
@@ -101,11 +106,6 @@ private:
 
 private:
 
-    /*!
-     * LoRaMAC channels
-     */
-    channel_params_t channels[AU915_MAX_NB_CHANNELS];
-
     /*!
      * LoRaMac bands
      */
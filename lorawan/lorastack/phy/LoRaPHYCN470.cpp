@@ -203,6 +203,13 @@ static const uint8_t max_payloads_CN470[] = {51, 51, 51, 115, 222, 222};
  */
 static const uint8_t max_payloads_with_repeater_CN470[] = {51, 51, 51, 115, 222, 222};
 
+/*!
+ * Channels: 96 of 125 kHz from 470.3 MHz
+ */
+static const loraphy_channel_grid_t channel_grids_CN470[] = {
+    { 470300000, 200000, CN470_MAX_NB_CHANNELS, { (DR_5 << 4) | DR_0 } }
+};
+
 
 LoRaPHYCN470::LoRaPHYCN470()
 {
@@ -210,14 +217,6 @@ LoRaPHYCN470::LoRaPHYCN470()
 
     bands[0] = CN470_BAND0;
 
-    // Channels
-    // 125 kHz channels
-    for (uint8_t i = 0; i < CN470_MAX_NB_CHANNELS; i++) {
-        channels[i].frequency = 470300000 + i * 200000;
-        channels[i].dr_range.value = (DR_5 << 4) | DR_0;
-        channels[i].band = 0;
-    }
-
     // Initialize the channels default mask
     for (uint8_t i = 0; i < CN470_CHANNEL_MASK_SIZE; i++) {
         default_channel_mask[i] = 0xFFFF & fsb_mask[i];
@@ -227,7 +226,8 @@ LoRaPHYCN470::LoRaPHYCN470()
     copy_channel_mask(channel_mask, default_channel_mask, CN470_CHANNEL_MASK_SIZE);
 
     // set default channels
-    phy_params.channels.channel_list = channels;
+    phy_params.channels.grids = channel_grids_CN470;
+    phy_params.channels.grid_count = sizeof(channel_grids_CN470) / sizeof(channel_grids_CN470[0]);
     phy_params.channels.channel_list_size = CN470_MAX_NB_CHANNELS;
     phy_params.channels.mask = channel_mask;
     phy_params.channels.default_mask = default_channel_mask;
@@ -258,11 +258,12 @@ LoRaPHYCN470::LoRaPHYCN470()
     // set initial and default parameters
     phy_params.duty_cycle_enabled = CN470_DUTY_CYCLE_ENABLED;
 
-    phy_params.accept_tx_param_setup_req = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = false;
-    phy_params.cflist_supported = false;
-    phy_params.dl_channel_req_supported = false;
-    phy_params.custom_channelplans_supported = false;
+    phy_params.region = LORAWAN_REGION_CN470;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
 
     phy_params.default_channel_cnt = CN470_MAX_NB_CHANNELS;
     phy_params.max_channel_cnt = CN470_MAX_NB_CHANNELS;
@@ -412,8 +413,8 @@ bool LoRaPHYCN470::tx_config(tx_config_params_t *config, int8_t *tx_power,
 {
     int8_t phy_dr = datarates_CN470[config->datarate];
 
-    if (config->tx_power > bands[channels[config->channel].band].max_tx_pwr) {
-        config->tx_power = bands[channels[config->channel].band].max_tx_pwr;
+    if (config->tx_power > bands[get_channel_band(config->channel)].max_tx_pwr) {
+        config->tx_power = bands[get_channel_band(config->channel)].max_tx_pwr;
     }
 
     int8_t phy_tx_power = 0;
@@ -425,7 +426,7 @@ bool LoRaPHYCN470::tx_config(tx_config_params_t *config, int8_t *tx_power,
     // acquire lock to radio
     _radio->lock();
 
-    _radio->set_channel(channels[config->channel].frequency);
+    _radio->set_channel(get_channel_frequency(config->channel));
 
     _radio->set_tx_config(MODEM_LORA, phy_tx_power, 0, 0, phy_dr, 1,
                           MBED_CONF_LORA_UPLINK_PREAMBLE_LENGTH, false, true,
@@ -496,7 +497,7 @@ uint8_t LoRaPHYCN470::link_ADR_request(adr_req_params_t *params,
             for (uint8_t i = 0; i < 16; i++) {
 
                 if (((adr_settings.channel_mask & (1 << i)) != 0) &&
-                        (channels[adr_settings.ch_mask_ctrl * 16 + i].frequency == 0)) {
+                        (get_channel_frequency(adr_settings.ch_mask_ctrl * 16 + i) == 0)) {
                     // Trying to enable an undefined channel
                     status &= 0xFE; // Channel mask KO
                 }
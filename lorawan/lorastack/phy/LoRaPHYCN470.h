@@ -51,13 +51,18 @@
 #define CN470_CHANNEL_MASK_SIZE                     6
 
 
-class LoRaPHYCN470 : public LoRaPHY {
+class LoRaPHYCN470 final : public LoRaPHY {
 
 public:
 
     LoRaPHYCN470();
     virtual ~LoRaPHYCN470();
 
+    static constexpr bool cflist_supported = false;
+    static constexpr bool custom_channelplans_supported = false;
+    static constexpr bool dl_channel_req_supported = false;
+    static constexpr bool tx_param_setup_req_supported = false;
+
     virtual lorawan_status_t set_next_channel(channel_selection_params_t *params,
                                               uint8_t *channel, lorawan_time_t *time,
                                               lorawan_time_t *aggregate_timeoff);
@@ -75,11 +80,6 @@ public:
 
 private:
 
-    /*!
-     * LoRaMAC channels
-     */
-    channel_params_t channels[CN470_MAX_NB_CHANNELS];
-
     /*!
      * LoRaMac bands
      */
@@ -48,9 +48,13 @@
 #define CN779_TX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define CN779_TX_MAX_DATARATE                       DR_7
+#else
+#define CN779_TX_MAX_DATARATE                       DR_6
+#endif
 
 /*!
  * Minimal datarate that can be used by the node
@@ -58,9 +62,13 @@
 #define CN779_RX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define CN779_RX_MAX_DATARATE                       DR_7
+#else
+#define CN779_RX_MAX_DATARATE                       DR_6
+#endif
 
 #define CN779_DEFAULT_MAX_DATARATE                  DR_5
 
@@ -181,6 +189,22 @@
  */
 #define CN779_RX_WND_2_DR                           DR_0
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define CN779_BEACON_FREQ                           785000000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define CN779_BEACON_DR                             DR_3
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define CN779_BEACON_RFU1_SIZE                      2
+#define CN779_BEACON_RFU2_SIZE                      0
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -235,12 +259,9 @@ LoRaPHYCN779::LoRaPHYCN779()
     bands[0] = CN779_BAND0;
 
     // Channels
-    channels[0] = CN779_LC1;
-    channels[0].band = 0;
-    channels[1] = CN779_LC2;
-    channels[1].band = 0;
-    channels[2] = CN779_LC3;
-    channels[2].band = 0;
+    pack_channel(&channels[0], &CN779_LC1);
+    pack_channel(&channels[1], &CN779_LC2);
+    pack_channel(&channels[2], &CN779_LC3);
 
     // Initialize the channels default mask
     default_channel_mask[0] = LC(1) + LC(2) + LC(3);
@@ -278,11 +299,12 @@ LoRaPHYCN779::LoRaPHYCN779()
 
     // set initial and default parameters
     phy_params.duty_cycle_enabled = CN779_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = true;
-    phy_params.cflist_supported = true;
-    phy_params.dl_channel_req_supported = true;
-    phy_params.custom_channelplans_supported = true;
+    phy_params.region = LORAWAN_REGION_CN779;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = CN779_NUMB_DEFAULT_CHANNELS;
     phy_params.max_channel_cnt = CN779_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = CN779_NUMB_CHANNELS_CF_LIST;
@@ -313,6 +335,11 @@ LoRaPHYCN779::LoRaPHYCN779()
     phy_params.ack_timeout_rnd = CN779_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = CN779_RX_WND_2_DR;
     phy_params.rx_window2_frequency = CN779_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = CN779_BEACON_FREQ;
+    phy_params.beacon_datarate = CN779_BEACON_DR;
+    phy_params.beacon_rfu1_size = CN779_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = CN779_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = 1;
 }
 
 LoRaPHYCN779::~LoRaPHYCN779()
@@ -43,18 +43,23 @@
 #define CN779_CHANNEL_MASK_SIZE                     1
 
 
-class LoRaPHYCN779 : public LoRaPHY {
+class LoRaPHYCN779 final : public LoRaPHY {
 
 public:
 
     LoRaPHYCN779();
     virtual ~LoRaPHYCN779();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = false;
+
 private:
     /*!
      * LoRaMAC channels
      */
-    channel_params_t channels[CN779_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[CN779_MAX_NB_CHANNELS];
 
     /*!
      * LoRaMac bands
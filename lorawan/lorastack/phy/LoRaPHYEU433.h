@@ -49,18 +49,23 @@
 #define EU433_CHANNEL_MASK_SIZE                    1
 
 
-class LoRaPHYEU433 : public LoRaPHY {
+class LoRaPHYEU433 final : public LoRaPHY {
 
 public:
 
     LoRaPHYEU433();
     virtual ~LoRaPHYEU433();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = false;
+
 private:
     /*!
      * LoRaMAC channels
      */
-    channel_params_t channels[EU433_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[EU433_MAX_NB_CHANNELS];
 
     /*!
      * LoRaMac bands
@@ -48,9 +48,13 @@
 #define EU868_TX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define EU868_TX_MAX_DATARATE                       DR_7
+#else
+#define EU868_TX_MAX_DATARATE                       DR_6
+#endif
 
 /*!
  * Minimal datarate that can be used by the node
@@ -58,9 +62,13 @@
 #define EU868_RX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define EU868_RX_MAX_DATARATE                       DR_7
+#else
+#define EU868_RX_MAX_DATARATE                       DR_6
+#endif
 
 /*!
  * Default datarate used by the node
@@ -178,6 +186,22 @@
  */
 #define EU868_RX_WND_2_DR          DR_0
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define EU868_BEACON_FREQ          869525000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define EU868_BEACON_DR            DR_3
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define EU868_BEACON_RFU1_SIZE     2
+#define EU868_BEACON_RFU2_SIZE     0
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -266,12 +290,9 @@ LoRaPHYEU868::LoRaPHYEU868()
     bands[5] = EU868_BAND5;
 
     // Default Channels are always enabled, rest will be added later
-    channels[0] = EU868_LC1;
-    channels[0].band = 1;
-    channels[1] = EU868_LC2;
-    channels[1].band = 1;
-    channels[2] = EU868_LC3;
-    channels[2].band = 1;
+    pack_channel(&channels[0], &EU868_LC1);
+    pack_channel(&channels[1], &EU868_LC2);
+    pack_channel(&channels[2], &EU868_LC3);
 
     // Initialize the channels default mask
     default_channel_mask[0] = LC(1) + LC(2) + LC(3);
@@ -309,11 +330,12 @@ LoRaPHYEU868::LoRaPHYEU868()
 
     // set initial and default parameters
     phy_params.duty_cycle_enabled = EU868_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = true;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = true;
-    phy_params.cflist_supported = true;
-    phy_params.dl_channel_req_supported = true;
-    phy_params.custom_channelplans_supported = true;
+    phy_params.region = LORAWAN_REGION_EU868;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = EU868_NUMB_DEFAULT_CHANNELS;
     phy_params.max_channel_cnt = EU868_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = EU868_NUMB_CHANNELS_CF_LIST;
@@ -344,6 +366,11 @@ LoRaPHYEU868::LoRaPHYEU868()
     phy_params.ack_timeout_rnd = EU868_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = EU868_RX_WND_2_DR;
     phy_params.rx_window2_frequency = EU868_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = EU868_BEACON_FREQ;
+    phy_params.beacon_datarate = EU868_BEACON_DR;
+    phy_params.beacon_rfu1_size = EU868_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = EU868_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = 1;
 }
 
 LoRaPHYEU868::~LoRaPHYEU868()
@@ -53,17 +53,22 @@
 
 #define EU868_CHANNEL_MASK_SIZE                    1
 
-class LoRaPHYEU868 : public LoRaPHY {
+class LoRaPHYEU868 final : public LoRaPHY {
 
 public:
     LoRaPHYEU868();
     virtual ~LoRaPHYEU868();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = true;
+
 private:
     /*!
      * LoRaMAC channels
      */
-    channel_params_t channels[EU868_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[EU868_MAX_NB_CHANNELS];
 
     /*!
      * LoRaMac bands
@@ -49,9 +49,13 @@
 #define IN865_TX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define IN865_TX_MAX_DATARATE                       DR_7
+#else
+#define IN865_TX_MAX_DATARATE                       DR_5
+#endif
 
 /*!
  * Minimal datarate that can be used by the node
@@ -59,9 +63,13 @@
 #define IN865_RX_MIN_DATARATE                       DR_0
 
 /*!
- * Maximal datarate that can be used by the node
+ * Maximal datarate that can be used by the node, DR_7 is FSK
  */
+#if MBED_CONF_LORA_FSK
 #define IN865_RX_MAX_DATARATE                       DR_7
+#else
+#define IN865_RX_MAX_DATARATE                       DR_5
+#endif
 
 /*!
  * Default datarate used by the node
@@ -178,6 +186,22 @@
  */
 #define IN865_RX_WND_2_DR                           DR_2
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define IN865_BEACON_FREQ                           866550000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define IN865_BEACON_DR                             DR_4
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define IN865_BEACON_RFU1_SIZE                      1
+#define IN865_BEACON_RFU2_SIZE                      3
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -237,12 +261,9 @@ LoRaPHYIN865::LoRaPHYIN865()
     bands[0] = IN865_BAND0;
 
     // Default Channels are always enabled, rest will be added later
-    channels[0] = IN865_LC1;
-    channels[0].band = 0;
-    channels[1] = IN865_LC2;
-    channels[1].band = 0;
-    channels[2] = IN865_LC3;
-    channels[2].band = 0;
+    pack_channel(&channels[0], &IN865_LC1);
+    pack_channel(&channels[1], &IN865_LC2);
+    pack_channel(&channels[2], &IN865_LC3);
 
     // Initialize the channels default mask
     default_channel_mask[0] = LC(1) + LC(2) + LC(3);
@@ -280,11 +301,12 @@ LoRaPHYIN865::LoRaPHYIN865()
 
     // set initial and default parameters
     phy_params.duty_cycle_enabled = IN865_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = true;
-    phy_params.cflist_supported = true;
-    phy_params.dl_channel_req_supported = true;
-    phy_params.custom_channelplans_supported = true;
+    phy_params.region = LORAWAN_REGION_IN865;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = IN865_NUMB_DEFAULT_CHANNELS;
     phy_params.max_channel_cnt = IN865_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = IN865_NUMB_CHANNELS_CF_LIST;
@@ -315,6 +337,11 @@ LoRaPHYIN865::LoRaPHYIN865()
     phy_params.ack_timeout_rnd = IN865_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = IN865_RX_WND_2_DR;
     phy_params.rx_window2_frequency = IN865_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = IN865_BEACON_FREQ;
+    phy_params.beacon_datarate = IN865_BEACON_DR;
+    phy_params.beacon_rfu1_size = IN865_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = IN865_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = 1;
 }
 
 LoRaPHYIN865::~LoRaPHYIN865()
@@ -49,20 +49,25 @@
 #define IN865_CHANNEL_MASK_SIZE                    1
 
 
-class LoRaPHYIN865 : public LoRaPHY {
+class LoRaPHYIN865 final : public LoRaPHY {
 
 public:
 
     LoRaPHYIN865();
     virtual ~LoRaPHYIN865();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = false;
+
     virtual uint8_t apply_DR_offset(int8_t dr, int8_t dr_offset);
 
 private:
     /*!
      * LoRaMAC channels
      */
-    channel_params_t channels[IN865_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[IN865_MAX_NB_CHANNELS];
 
     /*!
      * LoRaMac bands
@@ -182,6 +182,22 @@
  */
 #define KR920_RX_WND_2_DR                           DR_0
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define KR920_BEACON_FREQ                           923100000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define KR920_BEACON_DR                             DR_3
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define KR920_BEACON_RFU1_SIZE                      2
+#define KR920_BEACON_RFU2_SIZE                      0
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -246,12 +262,9 @@ LoRaPHYKR920::LoRaPHYKR920()
     bands[0] = KR920_BAND0;
 
     // Channels
-    channels[0] = KR920_LC1;
-    channels[0].band = 0;
-    channels[1] = KR920_LC2;
-    channels[1].band = 0;
-    channels[2] = KR920_LC3;
-    channels[2].band = 0;
+    pack_channel(&channels[0], &KR920_LC1);
+    pack_channel(&channels[1], &KR920_LC2);
+    pack_channel(&channels[2], &KR920_LC3);
 
     // Initialize the channels default mask
     default_channel_mask[0] = LC(1) + LC(2) + LC(3);
@@ -289,11 +302,12 @@ LoRaPHYKR920::LoRaPHYKR920()
 
     // set initial and default parameters
     phy_params.duty_cycle_enabled = KR920_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = false;
-    phy_params.cflist_supported = true;
-    phy_params.dl_channel_req_supported = true;
-    phy_params.custom_channelplans_supported = true;
+    phy_params.region = LORAWAN_REGION_KR920;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = KR920_NUMB_DEFAULT_CHANNELS;
     phy_params.max_channel_cnt = KR920_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = KR920_NUMB_CHANNELS_CF_LIST;
@@ -324,6 +338,11 @@ LoRaPHYKR920::LoRaPHYKR920()
     phy_params.ack_timeout_rnd = KR920_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = KR920_RX_WND_2_DR;
     phy_params.rx_window2_frequency = KR920_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = KR920_BEACON_FREQ;
+    phy_params.beacon_datarate = KR920_BEACON_DR;
+    phy_params.beacon_rfu1_size = KR920_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = KR920_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = 1;
 }
 
 LoRaPHYKR920::~LoRaPHYKR920()
@@ -372,12 +391,12 @@ bool LoRaPHYKR920::tx_config(tx_config_params_t *config, int8_t *tx_power,
 {
     int8_t phy_dr = datarates_KR920[config->datarate];
 
-    if (config->tx_power > bands[channels[config->channel].band].max_tx_pwr) {
-        config->tx_power = bands[channels[config->channel].band].max_tx_pwr;
+    if (config->tx_power > bands[get_channel_band(config->channel)].max_tx_pwr) {
+        config->tx_power = bands[get_channel_band(config->channel)].max_tx_pwr;
     }
 
     uint32_t bandwidth = get_bandwidth(config->datarate);
-    float max_eirp = get_max_eirp(channels[config->channel].frequency);
+    float max_eirp = get_max_eirp(get_channel_frequency(config->channel));
     int8_t phy_tx_power = 0;
 
     // Take the minimum between the max_eirp and txConfig->MaxEirp.
@@ -390,7 +409,7 @@ bool LoRaPHYKR920::tx_config(tx_config_params_t *config, int8_t *tx_power,
     // Setup the radio frequency
     _radio->lock();
 
-    _radio->set_channel(channels[config->channel].frequency);
+    _radio->set_channel(get_channel_frequency(config->channel));
 
     _radio->set_tx_config(MODEM_LORA, phy_tx_power, 0, bandwidth, phy_dr, 1, 8,
                           false, true, 0, 0, false, 3000);
@@ -450,7 +469,7 @@ lorawan_status_t LoRaPHYKR920::set_next_channel(channel_selection_params_t *para
             _radio->lock();
 
             if (_radio->perform_carrier_sense(MODEM_LORA,
-                                              channels[next_channel_idx].frequency,
+                                              get_channel_frequency(next_channel_idx),
                                               KR920_RSSI_FREE_TH,
                                               KR920_CARRIER_SENSE_TIME) == true) {
                 // Free channel found
@@ -480,17 +499,18 @@ lorawan_status_t LoRaPHYKR920::set_next_channel(channel_selection_params_t *para
     }
 }
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
 void LoRaPHYKR920::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_frequency)
 {
     (void)given_frequency;
 
-    if (params->tx_power > bands[channels[params->channel].band].max_tx_pwr) {
-        params->tx_power = bands[channels[params->channel].band].max_tx_pwr;
+    if (params->tx_power > bands[get_channel_band(params->channel)].max_tx_pwr) {
+        params->tx_power = bands[get_channel_band(params->channel)].max_tx_pwr;
     }
 
-    float max_eirp = get_max_eirp(channels[params->channel].frequency);
+    float max_eirp = get_max_eirp(get_channel_frequency(params->channel));
     int8_t phy_tx_power = 0;
-    uint32_t frequency = channels[params->channel].frequency;
+    uint32_t frequency = get_channel_frequency(params->channel);
 
     // Take the minimum between the max_eirp and params->max_eirp.
     // The value of params->max_eirp could have changed during runtime,
@@ -504,4 +524,5 @@ void LoRaPHYKR920::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_fre
     _radio->set_tx_continuous_wave(frequency, phy_tx_power, params->timeout);
     _radio->unlock();
 }
+#endif
 
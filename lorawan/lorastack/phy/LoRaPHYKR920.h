@@ -49,13 +49,18 @@
 #define KR920_CHANNEL_MASK_SIZE                    1
 
 
-class LoRaPHYKR920 : public LoRaPHY {
+class LoRaPHYKR920 final : public LoRaPHY {
 
 public:
 
     LoRaPHYKR920();
     virtual ~LoRaPHYKR920();
 
+    static constexpr bool cflist_supported = true;
+    static constexpr bool custom_channelplans_supported = true;
+    static constexpr bool dl_channel_req_supported = true;
+    static constexpr bool tx_param_setup_req_supported = false;
+
     virtual bool verify_frequency_for_band(uint32_t freq, uint8_t band) const;
 
     virtual bool tx_config(tx_config_params_t *config, int8_t *tx_power,
@@ -65,8 +70,10 @@ public:
                                               lorawan_time_t *time,
                                               lorawan_time_t *aggregate_timeOff);
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
     virtual void set_tx_cont_mode(cw_mode_params_t *continuousWave,
                                   uint32_t frequency = 0);
+#endif
 
 
 private:
@@ -76,7 +83,7 @@ private:
     /**
      * LoRaMAC channels
      */
-    channel_params_t channels[KR920_MAX_NB_CHANNELS];
+    loraphy_channel_t channels[KR920_MAX_NB_CHANNELS];
 
     /**
      * LoRaMac bands
@@ -158,6 +158,28 @@
  */
 #define US915_RX_WND_2_DR                           DR_8
 
+/*!
+ * Class B beacon and default ping slot channel frequency definition.
+ */
+#define US915_BEACON_FREQ                           923300000
+
+/*!
+ * Number of beacon channels and their spacing in Hz.
+ */
+#define US915_BEACON_CHANNELS                       8
+#define US915_BEACON_CHANNEL_SPACING                600000
+
+/*!
+ * Class B beacon and default ping slot datarate definition.
+ */
+#define US915_BEACON_DR                             DR_8
+
+/*!
+ * Size of the RFU fields before and after the fixed fields of a beacon.
+ */
+#define US915_BEACON_RFU1_SIZE                      5
+#define US915_BEACON_RFU2_SIZE                      3
+
 /*!
  * Band 0 definition
  * { DutyCycle, TxMaxPower, LastJoinTxDoneTime, LastTxDoneTime, TimeOff }
@@ -210,6 +232,15 @@ static const uint8_t max_payloads_US915[] = {11, 53, 125, 242, 242, 0, 0, 0, 53,
  */
 static const uint8_t max_payloads_with_repeater_US915[] = {11, 53, 125, 242, 242, 0, 0, 0, 33, 109, 222, 222, 222, 222, 0, 0};
 
+/*!
+ * Channels: 64 of 125 kHz from 902.3 MHz, then 8 of 500 kHz from 903.0 MHz,
+ * all upstream
+ */
+static const loraphy_channel_grid_t channel_grids_US915[] = {
+    { 902300000, 200000, US915_MAX_NB_CHANNELS - 8, { (DR_3 << 4) | DR_0 } },
+    { 903000000, 1600000, 8, { (DR_4 << 4) | DR_4 } }
+};
+
 static const uint16_t fsb_mask[] = MBED_CONF_LORA_FSB_MASK;
 static const uint16_t full_channel_mask [] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x00FF};
 
@@ -217,20 +248,6 @@ LoRaPHYUS915::LoRaPHYUS915()
 {
     bands[0] = US915_BAND0;
 
-    // Channels
-    // 125 kHz channels - Upstream
-    for (uint8_t i = 0; i < US915_MAX_NB_CHANNELS - 8; i++) {
-        channels[i].frequency = 902300000 + i * 200000;
-        channels[i].dr_range.value = (DR_3 << 4) | DR_0;
-        channels[i].band = 0;
-    }
-    // 500 kHz channels - Upstream
-    for (uint8_t i = US915_MAX_NB_CHANNELS - 8; i < US915_MAX_NB_CHANNELS; i++) {
-        channels[i].frequency = 903000000 + (i - (US915_MAX_NB_CHANNELS - 8)) * 1600000;
-        channels[i].dr_range.value = (DR_4 << 4) | DR_4;
-        channels[i].band = 0;
-    }
-
     // Fill-up default channel mask and apply FSB mask too
     fill_channel_mask_with_fsb(full_channel_mask, fsb_mask,
                                default_channel_mask, US915_CHANNEL_MASK_SIZE);
@@ -247,7 +264,8 @@ LoRaPHYUS915::LoRaPHYUS915()
     copy_channel_mask(current_channel_mask, channel_mask, US915_CHANNEL_MASK_SIZE);
 
     // set default channels
-    phy_params.channels.channel_list = channels;
+    phy_params.channels.grids = channel_grids_US915;
+    phy_params.channels.grid_count = sizeof(channel_grids_US915) / sizeof(channel_grids_US915[0]);
     phy_params.channels.channel_list_size = US915_MAX_NB_CHANNELS;
     phy_params.channels.mask = channel_mask;
     phy_params.channels.default_mask = default_channel_mask;
@@ -277,11 +295,12 @@ LoRaPHYUS915::LoRaPHYUS915()
 
     // set initial and default parameters
     phy_params.duty_cycle_enabled = US915_DUTY_CYCLE_ENABLED;
-    phy_params.accept_tx_param_setup_req = false;
+    phy_params.accept_tx_param_setup_req = tx_param_setup_req_supported;
     phy_params.fsk_supported = false;
-    phy_params.cflist_supported = false;
-    phy_params.dl_channel_req_supported = false;
-    phy_params.custom_channelplans_supported = false;
+    phy_params.region = LORAWAN_REGION_US915;
+    phy_params.cflist_supported = cflist_supported;
+    phy_params.dl_channel_req_supported = dl_channel_req_supported;
+    phy_params.custom_channelplans_supported = custom_channelplans_supported;
     phy_params.default_channel_cnt = US915_MAX_NB_CHANNELS;
     phy_params.max_channel_cnt = US915_MAX_NB_CHANNELS;
     phy_params.cflist_channel_cnt = 0;
@@ -312,6 +331,12 @@ LoRaPHYUS915::LoRaPHYUS915()
     phy_params.ack_timeout_rnd = US915_ACK_TIMEOUT_RND;
     phy_params.rx_window2_datarate = US915_RX_WND_2_DR;
     phy_params.rx_window2_frequency = US915_RX_WND_2_FREQ;
+    phy_params.beacon_frequency = US915_BEACON_FREQ;
+    phy_params.beacon_datarate = US915_BEACON_DR;
+    phy_params.beacon_rfu1_size = US915_BEACON_RFU1_SIZE;
+    phy_params.beacon_rfu2_size = US915_BEACON_RFU2_SIZE;
+    phy_params.beacon_channel_count = US915_BEACON_CHANNELS;
+    phy_params.beacon_channel_spacing = US915_BEACON_CHANNEL_SPACING;
 }
 
 LoRaPHYUS915::~LoRaPHYUS915()
@@ -414,7 +439,7 @@ bool LoRaPHYUS915::tx_config(tx_config_params_t *config, int8_t *tx_power,
 {
     int8_t phy_dr = datarates_US915[config->datarate];
     int8_t tx_power_limited = limit_tx_power(config->tx_power,
-                                             bands[channels[config->channel].band].max_tx_pwr,
+                                             bands[get_channel_band(config->channel)].max_tx_pwr,
                                              config->datarate);
 
     uint32_t bandwidth = get_bandwidth(config->datarate);
@@ -425,7 +450,7 @@ bool LoRaPHYUS915::tx_config(tx_config_params_t *config, int8_t *tx_power,
 
     _radio->lock();
 
-    _radio->set_channel(channels[config->channel].frequency);
+    _radio->set_channel(get_channel_frequency(config->channel));
 
     _radio->set_tx_config(MODEM_LORA, phy_tx_power, 0, bandwidth, phy_dr, 1,
                           MBED_CONF_LORA_UPLINK_PREAMBLE_LENGTH,
@@ -661,15 +686,16 @@ lorawan_status_t LoRaPHYUS915::set_next_channel(channel_selection_params_t *para
     }
 }
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
 void LoRaPHYUS915::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_frequency)
 {
     (void)given_frequency;
 
     int8_t tx_power_limited = limit_tx_power(params->tx_power,
-                                             bands[channels[params->channel].band].max_tx_pwr,
+                                             bands[get_channel_band(params->channel)].max_tx_pwr,
                                              params->datarate);
     int8_t phyTxPower = 0;
-    uint32_t frequency = channels[params->channel].frequency;
+    uint32_t frequency = get_channel_frequency(params->channel);
 
     // Calculate physical TX power
     phyTxPower = compute_tx_power(tx_power_limited, US915_DEFAULT_MAX_ERP, 0);
@@ -680,6 +706,7 @@ void LoRaPHYUS915::set_tx_cont_mode(cw_mode_params_t *params, uint32_t given_fre
 
     _radio->unlock();
 }
+#endif
 
 uint8_t LoRaPHYUS915::apply_DR_offset(int8_t dr, int8_t dr_offset)
 {
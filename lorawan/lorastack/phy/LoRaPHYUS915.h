@@ -49,13 +49,18 @@
 #define US915_CHANNEL_MASK_SIZE                    5
 
 
-class LoRaPHYUS915 : public LoRaPHY {
+class LoRaPHYUS915 final : public LoRaPHY {
 
 public:
 
     LoRaPHYUS915();
     virtual ~LoRaPHYUS915();
 
+    static constexpr bool cflist_supported = false;
+    static constexpr bool custom_channelplans_supported = false;
+    static constexpr bool dl_channel_req_supported = false;
+    static constexpr bool tx_param_setup_req_supported = false;
+
     virtual void restore_default_channels();
 
     virtual bool rx_config(rx_config_params_t *config);
@@ -75,8 +80,10 @@ public:
     virtual lorawan_status_t set_next_channel(channel_selection_params_t *params, uint8_t *channel,
                                               lorawan_time_t *time, lorawan_time_t *aggregate_timeOff);
 
+#if MBED_CONF_LORA_CONTINUOUS_WAVE
     virtual void set_tx_cont_mode(cw_mode_params_t *continuousWave,
                                   uint32_t frequency = 0);
+#endif
 
     virtual uint8_t apply_DR_offset(int8_t dr, int8_t dr_offset);
 
@@ -105,11 +112,6 @@ private:
     int8_t limit_tx_power(int8_t tx_power, int8_t max_band_tx_power,
                           int8_t datarate);
 
-    /*!
-     * LoRaMAC channels
-     */
-    channel_params_t channels[US915_MAX_NB_CHANNELS];
-
     /*!
      * LoRaMac bands
      */
@@ -488,16 +488,68 @@ typedef struct {
     uint8_t size;
 } loraphy_table_t;
 
+/*!
+ * Most channels with an alternative RX1 frequency at a time
+ */
+#ifndef LORAPHY_MAX_RX1_OVERRIDES
+#define LORAPHY_MAX_RX1_OVERRIDES   4
+#endif
+
+/*!
+ * A channel of a region whose channels are defined one by one, as the PHY
+ * keeps it. The frequency is in units of 100 Hz, the step of the MAC
+ * commands, little endian, 0 if the channel is not defined.
+ */
+typedef struct {
+    uint8_t frequency[3];
+    dr_range_t dr_range;
+    uint8_t band;
+} loraphy_channel_t;
+
+/*!
+ * Channels of a fixed channel plan, 'count' of them from 'first' Hz on,
+ * 'spacing' Hz apart, all in band 0 with the same datarates. Their
+ * frequencies are computed, not stored.
+ */
+typedef struct {
+    uint32_t first;
+    uint32_t spacing;
+    uint8_t count;
+    dr_range_t dr_range;
+} loraphy_channel_grid_t;
+
+/*!
+ * Alternative RX1 frequency of a channel, in units of 100 Hz
+ */
+typedef struct {
+    uint8_t channel;
+    uint8_t frequency[3];
+} loraphy_rx1_override_t;
+
+/*!
+ * The few channels with an alternative RX1 frequency
+ */
+typedef struct {
+    uint8_t count;
+    loraphy_rx1_override_t list[LORAPHY_MAX_RX1_OVERRIDES];
+} loraphy_rx1_overrides_t;
+
 /*!
  * Contains information regarding channel configuration of
  * a given PHY
+ *
+ * The channels are either in 'channel_list', for regions taking custom
+ * channels, or on the 'grids', NULL otherwise.
  */
 typedef struct {
-    uint8_t channel_list_size;
-    uint8_t  mask_size;
     uint16_t *mask;
     uint16_t *default_mask;
-    channel_params_t *channel_list;
+    loraphy_channel_t *channel_list;
+    const loraphy_channel_grid_t *grids;
+    loraphy_rx1_overrides_t rx1_overrides;
+    uint8_t channel_list_size;
+    uint8_t  mask_size;
+    uint8_t grid_count;
 } loraphy_channels_t;
 
 /*!
@@ -511,6 +563,14 @@ typedef struct {
     bool custom_channelplans_supported;
     bool dl_channel_req_supported;
 
+    bool ul_dwell_time_setting : 1;
+    bool dl_dwell_time_setting : 1;
+
+    /*!
+     * Region, a lorawan_region_t
+     */
+    uint8_t region;
+
     uint8_t default_channel_cnt;
     uint8_t cflist_channel_cnt;
     uint8_t max_channel_cnt;
@@ -530,6 +590,7 @@ typedef struct {
     uint8_t max_rx1_dr_offset;
     uint8_t default_rx1_dr_offset;
     uint8_t dwell_limit_datarate;
+    uint8_t rx_window2_datarate;
 
     uint16_t max_rx_window;
     uint16_t recv_delay1;
@@ -544,9 +605,23 @@ typedef struct {
     float default_max_eirp;
     float default_antenna_gain;
 
-    uint8_t rx_window2_datarate;
     uint32_t rx_window2_frequency;
 
+    /*!
+     * Class B beacon. A beacon carries 'beacon_rfu1_size' RFU bytes before
+     * and 'beacon_rfu2_size' RFU bytes after the fixed fields. Regions which
+     * hop the beacon use 'beacon_channel_count' channels starting at
+     * 'beacon_frequency', 'beacon_channel_spacing' Hz apart. Ping slots use
+     * the same channels and datarate by default. A 'beacon_frequency' of 0
+     * means the region has no Class B support.
+     */
+    uint32_t beacon_frequency;
+    uint32_t beacon_channel_spacing;
+    uint8_t beacon_datarate;
+    uint8_t beacon_rfu1_size;
+    uint8_t beacon_rfu2_size;
+    uint8_t beacon_channel_count;
+
     loraphy_table_t bands;
     loraphy_table_t bandwidths;
     loraphy_table_t datarates;
@@ -554,11 +629,6 @@ typedef struct {
     loraphy_table_t payloads_with_repeater;
 
     loraphy_channels_t channels;
-
-
-    unsigned ul_dwell_time_setting : 1;
-    unsigned dl_dwell_time_setting : 1;
-
 } loraphy_params_t;
 
 
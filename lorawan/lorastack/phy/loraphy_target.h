@@ -18,6 +18,8 @@
 #ifndef LORAPHY_TARGET
 #define LORAPHY_TARGET
 
+#include "mbed_config.h"
+
 #ifdef MBED_CONF_LORA_PHY
 
 #define LORA_REGION_EU868           0x10
@@ -78,6 +80,47 @@
 #else
 #error "Invalid region configuration, update mbed_app.json with correct MBED_CONF_LORA_PHY value"
 #endif //MBED_CONF_LORA_PHY == VALUE
+
+// The PHY class the stack calls. With static dispatch, the region class
+// itself, which is final: calls into it are bound at build time and the MAC
+// leaves out what the region does not support. Otherwise LoRaPHY, so that
+// any region can be given at run time.
+#if MBED_CONF_LORA_PHY_STATIC_DISPATCH
+typedef LoRaPHY_region LoRaPHY_target;
+#else
+typedef LoRaPHY LoRaPHY_target;
+#endif
+
+// Every region, for LoRaWANInterface::set_region(). The regional tables are
+// const, in flash; the PHY object holds the mutable state of one region at a
+// time, in storage sized for the largest.
+#if MBED_CONF_LORA_MULTI_REGION
+#if MBED_CONF_LORA_PHY_STATIC_DISPATCH
+#error "lora.multi-region needs lora.phy-static-dispatch off"
+#endif
+#include "lorawan/lorastack/phy/LoRaPHYEU868.h"
+#include "lorawan/lorastack/phy/LoRaPHYAS923.h"
+#include "lorawan/lorastack/phy/LoRaPHYAU915.h"
+#include "lorawan/lorastack/phy/LoRaPHYCN470.h"
+#include "lorawan/lorastack/phy/LoRaPHYCN779.h"
+#include "lorawan/lorastack/phy/LoRaPHYEU433.h"
+#include "lorawan/lorastack/phy/LoRaPHYIN865.h"
+#include "lorawan/lorastack/phy/LoRaPHYKR920.h"
+#include "lorawan/lorastack/phy/LoRaPHYUS915.h"
+
+typedef union {
+    uint64_t align;
+    uint8_t eu868[sizeof(LoRaPHYEU868)];
+    uint8_t as923[sizeof(LoRaPHYAS923)];
+    uint8_t au915[sizeof(LoRaPHYAU915)];
+    uint8_t cn470[sizeof(LoRaPHYCN470)];
+    uint8_t cn779[sizeof(LoRaPHYCN779)];
+    uint8_t eu433[sizeof(LoRaPHYEU433)];
+    uint8_t in865[sizeof(LoRaPHYIN865)];
+    uint8_t kr920[sizeof(LoRaPHYKR920)];
+    uint8_t us915[sizeof(LoRaPHYUS915)];
+} loraphy_region_storage_t;
+#endif
 #else
 #error "Must set LoRa PHY layer parameters."
 #endif //MBED_CONF_LORA_PHY
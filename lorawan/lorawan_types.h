@@ -105,7 +105,8 @@ typedef enum lorawan_status {
     LORAWAN_STATUS_NO_CHANNEL_FOUND = -1021,       /**< None of the channels is enabled at the moment*/
     LORAWAN_STATUS_NO_FREE_CHANNEL_FOUND = -1022,  /**< None of the enabled channels is ready for another TX (duty cycle limited)*/
     LORAWAN_STATUS_METADATA_NOT_AVAILABLE = -1023, /**< Meta-data after an RX or TX is stale*/
-    LORAWAN_STATUS_ALREADY_CONNECTED = -1024              /**< The device has already joined a network*/
+    LORAWAN_STATUS_ALREADY_CONNECTED = -1024,             /**< The device has already joined a network*/
+    LORAWAN_STATUS_STORAGE_ERROR = -1025                  /**< Non-volatile storage failed or holds no valid data*/
 } lorawan_status_t;
 
 /** The lorawan_connect_otaa structure.
@@ -205,6 +206,15 @@ typedef struct lorawan_connect {
  * UPLINK_REQUIRED      - Stack indicates application that some uplink needed
  * AUTOMATIC_UPLINK_ERROR - Stack tried automatically send uplink but some error occurred.
  *                          Application should initiate uplink as soon as possible.
+ * UPLINK_EXPIRED       - A message queued with queue_send() passed its deadline before
+ *                        it could be transmitted and was discarded.
+ * BEACON_LOCKED        - A Class B device acquired the network beacon, ping slots
+ *                        are open from now on.
+ * BEACON_LOST          - A Class B device could not acquire the beacon, or went
+ *                        without one for too long. The device is back in Class A.
+ * FRAG_SESSION_COMPLETE - A data block sent with the Fragmented Data Block Transport
+ *                         is complete in the fragmentation storage.
+ * DEVICE_TIME_SYNCED   - DeviceTimeAns was received, the GPS time is available.
  *
  */
 typedef enum lora_events {
@@ -222,6 +232,11 @@ typedef enum lora_events {
     JOIN_FAILURE,
     UPLINK_REQUIRED,
     AUTOMATIC_UPLINK_ERROR,
+    UPLINK_EXPIRED,
+    BEACON_LOCKED,
+    BEACON_LOST,
+    FRAG_SESSION_COMPLETE,
+    DEVICE_TIME_SYNCED,
 } lorawan_event_t;
 
 /**
@@ -243,7 +258,16 @@ typedef enum lora_events {
  * 'battery_level' callback goes in the down direction, i.e., it informs
  * the stack about the battery level by calling a function provided
  * by the upper layers.
+ *
+ * 'rx_frame' callback is an alternative to the RX_DONE event followed by
+ * receive(). The stack hands the application a read-only view of the
+ * decrypted payload without copying it. See 'lorawan_rx_frame_t'.
+ *
+ * 'uplink_status' callback tells the application which message, queued
+ * using queue_send(), an outcome belongs to.
  */
+struct lorawan_rx_frame;
+
 typedef struct {
     /**
      * Mandatory. Event Callback must be provided
@@ -269,6 +293,26 @@ typedef struct {
      *     255     The end-device was not able to measure the battery level.
      */
     mbed::Callback<uint8_t(void)> battery_level;
+
+    /**
+     * This callback is optional. If set, received application payloads are
+     * delivered through it instead of the RX_DONE event and receive() API.
+     *
+     * The frame stays owned by the stack and the application must hand it back
+     * using LoRaWANInterface::release_rx_frame() once done with it.
+     */
+    mbed::Callback<void(const struct lorawan_rx_frame &)> rx_frame;
+
+    /**
+     * This callback is optional
+     *
+     * Called once per message queued with queue_send() when it leaves the
+     * queue. The first parameter is the message identifier returned by
+     * queue_send(), the second one is the outcome, i.e., TX_DONE, TX_TIMEOUT,
+     * TX_ERROR, TX_CRYPTO_ERROR, TX_SCHEDULING_ERROR or UPLINK_EXPIRED. The same
+     * outcome is also posted through the 'events' callback.
+     */
+    mbed::Callback<void(int16_t, lorawan_event_t)> uplink_status;
 } lorawan_app_callbacks_t;
 
 /**
@@ -615,6 +659,21 @@ typedef enum lorawan_connect_type {
     LORAWAN_CONNECTION_ABP          /**< Activation By Personalization */
 } lorawan_connect_type_t;
 
+/**
+ * Enumeration for LoRaWAN regional parameters, with the values of "lora.phy".
+ */
+typedef enum lorawan_region {
+    LORAWAN_REGION_EU868 = 0x10,    /**< Europe 863-870 MHz */
+    LORAWAN_REGION_AS923 = 0x11,    /**< Asia 923 MHz */
+    LORAWAN_REGION_AU915 = 0x12,    /**< Australia 915-928 MHz */
+    LORAWAN_REGION_CN470 = 0x13,    /**< China 470-510 MHz */
+    LORAWAN_REGION_CN779 = 0x14,    /**< China 779-787 MHz */
+    LORAWAN_REGION_EU433 = 0x15,    /**< Europe 433 MHz */
+    LORAWAN_REGION_IN865 = 0x16,    /**< India 865-867 MHz */
+    LORAWAN_REGION_KR920 = 0x17,    /**< South Korea 920-923 MHz */
+    LORAWAN_REGION_US915 = 0x18     /**< United States 902-928 MHz */
+} lorawan_region_t;
+
 
 /**
  * Meta-data collection for a transmission
@@ -674,6 +733,179 @@ typedef struct {
      * Time spent on air by the RX frame
      */
     uint32_t rx_toa;
+    /**
+     * Time of reception (ms), taken when the radio reported the frame
+     */
+    uint32_t timestamp;
 } lorawan_rx_metadata;
 
+/**
+ * Class B beacon and ping slot status
+ */
+typedef struct {
+    /**
+     * True while the device tracks the beacon, even if the most recent ones
+     * were missed
+     */
+    bool beacon_locked;
+    /**
+     * GPS time (seconds) carried by the last received beacon
+     */
+    uint32_t beacon_time;
+    /**
+     * RSSI of the last received beacon
+     */
+    int16_t beacon_rssi;
+    /**
+     * SNR of the last received beacon
+     */
+    int8_t beacon_snr;
+    /**
+     * Gateway specific info descriptor of the last received beacon
+     */
+    uint8_t info_desc;
+    /**
+     * Gateway specific info of the last received beacon, e.g. its coordinates
+     */
+    uint8_t info[6];
+    /**
+     * Beacons received since Class B was enabled
+     */
+    uint32_t beacons_received;
+    /**
+     * Beacons missed since Class B was enabled
+     */
+    uint32_t beacons_missed;
+    /**
+     * Ping slot windows opened
+     */
+    uint32_t ping_slots_opened;
+    /**
+     * Ping slots skipped because a Class A exchange was in progress
+     */
+    uint32_t ping_slots_skipped;
+    /**
+     * Frames received in ping slots
+     */
+    uint32_t ping_slot_frames;
+    /**
+     * Time between two ping slots (ms). The worst case downlink latency
+     * once the frame is queued at the network server.
+     */
+    uint32_t ping_period;
+    /**
+     * Time (ms) the radio spent listening for beacons
+     */
+    uint32_t beacon_radio_on_time;
+    /**
+     * Time (ms) the radio spent listening in ping slots
+     */
+    uint32_t ping_radio_on_time;
+} lorawan_class_b_status_t;
+
+/**
+ * Multicast group status
+ */
+typedef struct {
+    /**
+     * Last downlink counter accepted for the group
+     */
+    uint32_t dl_frame_counter;
+    /**
+     * Frames accepted for the group since it was added
+     */
+    uint32_t rx_count;
+} lorawan_multicast_status_t;
+
+/**
+ * Fragmentation session status
+ */
+typedef struct {
+    /**
+     * A session has been set up by the network
+     */
+    bool active;
+    /**
+     * The whole data block is in the storage
+     */
+    bool complete;
+    /**
+     * More fragments were lost than can be recovered
+     */
+    bool out_of_memory;
+    /**
+     * Session index given by the network, 0 - 3
+     */
+    uint8_t frag_index;
+    /**
+     * Multicast groups whose fragments the session takes, a bit by McGroupID
+     */
+    uint8_t mc_group_mask;
+    /**
+     * Number of uncoded fragments of the block
+     */
+    uint16_t nb_frag;
+    /**
+     * Size of a fragment
+     */
+    uint8_t frag_size;
+    /**
+     * Number of padding bytes at the end of the last fragment
+     */
+    uint8_t padding;
+    /**
+     * Free form descriptor of the block, e.g. a firmware version
+     */
+    uint32_t descriptor;
+    /**
+     * Fragments received, coded ones included
+     */
+    uint16_t nb_received;
+    /**
+     * Uncoded fragments lost and not recovered yet
+     */
+    uint16_t nb_missing;
+    /**
+     * Address of the block in the fragmentation storage
+     */
+    uint32_t addr;
+    /**
+     * Size of the block without padding
+     */
+    uint32_t size;
+} lorawan_frag_status_t;
+
+/**
+ * Read-only view of a received application payload
+ *
+ * 'buffer' points directly into a slot of the stack's RX frame ring where the
+ * frame was decrypted in place. It stays valid until the application calls
+ * LoRaWANInterface::release_rx_frame() with it. A held frame occupies its
+ * slot, so it must be released as soon as possible to keep the ring from
+ * filling up.
+ */
+typedef struct lorawan_rx_frame {
+    /**
+     * Decrypted application payload
+     */
+    const uint8_t *buffer;
+    /**
+     * Size of the payload in bytes
+     */
+    uint16_t size;
+    /**
+     * The port on which the payload was received
+     */
+    uint8_t port;
+    /**
+     * Message flags, i.e., MSG_UNCONFIRMED_FLAG, MSG_CONFIRMED_FLAG,
+     * MSG_MULTICAST_FLAG or MSG_PROPRIETARY_FLAG
+     */
+    int flags;
+    /**
+     * Meta-data for the reception
+     */
+    lorawan_rx_metadata metadata;
+} lorawan_rx_frame_t;
+
 #endif /* MBED_LORAWAN_TYPES_H_ */
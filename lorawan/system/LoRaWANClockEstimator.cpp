@@ -0,0 +1,196 @@
+/**
+ * @file LoRaWANClockEstimator.cpp
+ *
+ * @brief Online estimate of the receive window timing error and of the
+ *        drift of the local clock
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "LoRaWANClockEstimator.h"
+#include "trace.h"
+
+/**
+ * Weight of the moving averages, a new sample counts for 1/8 once enough
+ * have been seen; before that all samples count the same
+ */
+#define CLOCK_AVERAGE_WEIGHT        8
+
+/**
+ * Offset samples needed before the offset bound is trusted
+ */
+#define CLOCK_MIN_OFFSET_SAMPLES    4
+
+/**
+ * Margin of the drift bound, in mean absolute deviations
+ */
+#define CLOCK_DRIFT_MARGIN          3
+
+/**
+ * Two time references must be apart by at least their accuracy times this,
+ * their accuracy then weighs for at most 2 ppm
+ */
+#define CLOCK_REFERENCE_SPAN        500000
+
+/**
+ * Drifts above this are taken for a jump of either clock
+ */
+#define CLOCK_MAX_DRIFT             1000
+
+static uint8_t stats_index(uint8_t datarate)
+{
+    return datarate < CLOCK_DATARATES ? datarate : CLOCK_DATARATES - 1;
+}
+
+LoRaWANClockEstimator::LoRaWANClockEstimator()
+{
+    reset();
+}
+
+void LoRaWANClockEstimator::reset()
+{
+    memset(_offset, 0, sizeof(_offset));
+    _drift_samples = 0;
+    _drift_mean = 0;
+    _drift_dev = 0;
+    _ref_valid = false;
+    _ref_seconds = 0;
+    _ref_ms = 0;
+    _ref_local = 0;
+}
+
+void LoRaWANClockEstimator::add_rx_offset(uint8_t datarate, int32_t offset)
+{
+    offset_stats_t &stats = _offset[stats_index(datarate)];
+    int32_t sample = offset * 16;
+    int32_t error = sample - stats.mean;
+    int32_t weight = stats.samples < CLOCK_AVERAGE_WEIGHT ?
+                     stats.samples + 1 : CLOCK_AVERAGE_WEIGHT;
+
+    if (stats.samples == 0) {
+        stats.mean = sample;
+        stats.dev = 0;
+    } else {
+        stats.mean += error / weight;
+        stats.dev += (abs(error) - stats.dev) / weight;
+    }
+
+    if (stats.samples < CLOCK_AVERAGE_WEIGHT) {
+        stats.samples++;
+    }
+}
+
+void LoRaWANClockEstimator::on_rx_missed()
+{
+    tr_debug("Downlink missed, RX windows back to the worst case");
+
+    for (uint8_t i = 0; i < CLOCK_DATARATES; i++) {
+        _offset[i].samples = 0;
+    }
+}
+
+int32_t LoRaWANClockEstimator::get_rx_shift(uint8_t datarate) const
+{
+    const offset_stats_t &stats = get_offset_stats(datarate);
+
+    if (stats.samples < CLOCK_MIN_OFFSET_SAMPLES) {
+        return 0;
+    }
+
+    // rounded to the nearest ms
+    return (stats.mean + (stats.mean < 0 ? -8 : 8)) / 16;
+}
+
+void LoRaWANClockEstimator::add_time_reference(uint32_t gps_seconds, uint16_t gps_ms,
+                                               lorawan_time_t local, uint16_t accuracy)
+{
+    if (_ref_valid) {
+        int64_t gps_elapsed = ((int64_t) gps_seconds - _ref_seconds) * 1000
+                              + ((int32_t) gps_ms - _ref_ms);
+        int32_t local_elapsed = (int32_t)(local - _ref_local);
+        // otherwise either clock went back or the tick wrapped, start over
+        bool ordered = gps_elapsed > 0 && local_elapsed > 0 && gps_elapsed < INT32_MAX;
+
+        if (ordered && gps_elapsed < (int64_t) accuracy * CLOCK_REFERENCE_SPAN) {
+            // too close to tell, wait for a later one
+            return;
+        }
+
+        if (ordered) {
+            int64_t drift = (local_elapsed - gps_elapsed) * 16000000 / gps_elapsed;
+
+            if (drift < -CLOCK_MAX_DRIFT * 16 || drift > CLOCK_MAX_DRIFT * 16) {
+                tr_debug("Time reference off by %ld ms, ignored",
+                         (long)(local_elapsed - gps_elapsed));
+            } else if (_drift_samples == 0) {
+                _drift_mean = (int32_t) drift;
+                // the sample is only as good as the references
+                _drift_dev = (int32_t)((int64_t) accuracy * 16000000 / gps_elapsed);
+                _drift_samples++;
+            } else {
+                int32_t error = (int32_t) drift - _drift_mean;
+                int32_t weight = _drift_samples < CLOCK_AVERAGE_WEIGHT ?
+                                 _drift_samples + 1 : CLOCK_AVERAGE_WEIGHT;
+                _drift_mean += error / weight;
+                _drift_dev += (abs(error) - _drift_dev) / weight;
+                if (_drift_samples < CLOCK_AVERAGE_WEIGHT) {
+                    _drift_samples++;
+                }
+            }
+        }
+    }
+
+    _ref_valid = true;
+    _ref_seconds = gps_seconds;
+    _ref_ms = gps_ms;
+    _ref_local = local;
+}
+
+bool LoRaWANClockEstimator::has_drift() const
+{
+    return _drift_samples > 0;
+}
+
+int32_t LoRaWANClockEstimator::get_drift() const
+{
+    return _drift_mean / 16;
+}
+
+uint32_t LoRaWANClockEstimator::get_drift_bound(uint32_t fallback) const
+{
+    if (!has_drift()) {
+        return fallback;
+    }
+
+    return (abs(_drift_mean) + CLOCK_DRIFT_MARGIN * _drift_dev) / 16 + 1;
+}
+
+uint32_t LoRaWANClockEstimator::get_rx_error(uint8_t datarate, uint32_t interval) const
+{
+    const offset_stats_t &stats = get_offset_stats(datarate);
+    uint32_t error = MBED_CONF_LORA_MAX_SYS_RX_ERROR;
+
+    if (stats.samples >= CLOCK_MIN_OFFSET_SAMPLES) {
+        // the shift is rounded, hence the extra ms
+        error = MBED_CONF_LORA_RX_WINDOW_MARGIN * stats.dev / 16 + 1;
+        if (error < MBED_CONF_LORA_MIN_SYS_RX_ERROR) {
+            error = MBED_CONF_LORA_MIN_SYS_RX_ERROR;
+        } else if (error > MBED_CONF_LORA_MAX_SYS_RX_ERROR) {
+            error = MBED_CONF_LORA_MAX_SYS_RX_ERROR;
+        }
+    }
+
+    // in ppm, rounded up
+    uint64_t drift = (uint64_t) interval * get_drift_bound(MBED_CONF_LORA_CLASS_B_CLOCK_DRIFT);
+
+    return error + (uint32_t)((drift + 999999) / 1000000);
+}
+
+const LoRaWANClockEstimator::offset_stats_t &
+LoRaWANClockEstimator::get_offset_stats(uint8_t datarate) const
+{
+    return _offset[stats_index(datarate)];
+}
@@ -0,0 +1,145 @@
+/**
+ * @file LoRaWANClockEstimator.h
+ *
+ * @brief Online estimate of the receive window timing error and of the
+ *        drift of the local clock
+ *
+ * Receive windows are widened by a timing error bound so that the preamble
+ * of a downlink cannot be missed. Without knowledge of the clock, the bound
+ * has to cover the worst case, MBED_CONF_LORA_MAX_SYS_RX_ERROR.
+ *
+ * Two things are tracked instead:
+ *
+ *  - the offset at which Class A downlinks actually start with respect to the
+ *    RX1/RX2 delays, which covers the timer resolution, the interrupt
+ *    latencies and the error of the time on air the start is derived from.
+ *    The latter depends on the datarate, so the offset is tracked per
+ *    datarate. Its mean and mean absolute deviation are smoothed with an
+ *    exponentially weighted moving average. Windows are shifted by the mean
+ *    and widened by MBED_CONF_LORA_RX_WINDOW_MARGIN deviations around it.
+ *
+ *  - the drift of the local clock in ppm, from pairs of GPS time references
+ *    (DeviceTimeAns, beacons) far enough apart for their own accuracy not to
+ *    matter. It widens windows which are opened long after the last time
+ *    reference, like ping slots.
+ *
+ * A missed RX2 window where a downlink was due restarts the offset estimates
+ * of all datarates from the worst case, so a change in the timing is never
+ * tracked down from below.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_CLOCK_ESTIMATOR_H__
+#define MBED_LORAWAN_SYS_CLOCK_ESTIMATOR_H__
+
+#include <stdint.h>
+#include "lorawan_data_structures.h"
+
+/**
+ * Datarates tracked, indices above are folded onto the last one
+ */
+#define CLOCK_DATARATES             16
+
+class LoRaWANClockEstimator {
+public:
+    LoRaWANClockEstimator();
+
+    /** Forgets everything learnt so far
+     */
+    void reset();
+
+    /** Adds the start offset of a Class A downlink
+     *
+     * @param datarate      Datarate of the frame
+     * @param offset        Time (ms) at which the frame started, relative to
+     *                      the nominal start of its receive window
+     */
+    void add_rx_offset(uint8_t datarate, int32_t offset);
+
+    /** A receive window expected to carry a downlink saw nothing
+     */
+    void on_rx_missed();
+
+    /** Shift of a Class A receive window
+     *
+     * @param datarate      Datarate of the window
+     *
+     * @return              Mean offset (ms) of the downlinks, 0 until enough
+     *                      of them were seen
+     */
+    int32_t get_rx_shift(uint8_t datarate) const;
+
+    /** Adds a GPS time reference
+     *
+     * @param gps_seconds   GPS time, seconds
+     * @param gps_ms        GPS time, milliseconds within the second
+     * @param local         Local time the GPS time refers to
+     * @param accuracy      Accuracy (ms) of the reference
+     */
+    void add_time_reference(uint32_t gps_seconds, uint16_t gps_ms,
+                            lorawan_time_t local, uint16_t accuracy);
+
+    /** The drift has been measured
+     */
+    bool has_drift() const;
+
+    /** Measured drift of the local clock
+     *
+     * @return              Drift in ppm, positive if the local clock is fast
+     */
+    int32_t get_drift() const;
+
+    /** Bound of the drift of the local clock
+     *
+     * @param fallback      Bound (ppm) to return while the drift is unknown
+     *
+     * @return              Bound in ppm
+     */
+    uint32_t get_drift_bound(uint32_t fallback) const;
+
+    /** Timing error bound of a receive window, around its shift
+     *
+     * @param datarate      Datarate of the window
+     * @param interval      Time (ms) between the timing reference of the
+     *                      window and its opening
+     *
+     * @return              Error (ms), within MBED_CONF_LORA_MIN_SYS_RX_ERROR
+     *                      and MBED_CONF_LORA_MAX_SYS_RX_ERROR for the offset
+     *                      part, plus the drift over the interval
+     */
+    uint32_t get_rx_error(uint8_t datarate, uint32_t interval) const;
+
+private:
+    /**
+     * Offset statistics of a datarate, ms in 1/16 units. The deviation, never
+     * negative, shares its word with the sample count.
+     */
+    typedef struct {
+        int32_t mean;
+        int32_t dev : 24;
+        uint32_t samples : 8;
+    } offset_stats_t;
+
+    const offset_stats_t &get_offset_stats(uint8_t datarate) const;
+
+    offset_stats_t _offset[CLOCK_DATARATES];
+
+    /**
+     * Last time reference
+     */
+    uint32_t _ref_seconds;
+    lorawan_time_t _ref_local;
+    uint16_t _ref_ms;
+    bool _ref_valid;
+
+    /**
+     * Drift statistics, ppm in 1/16 units
+     */
+    uint8_t _drift_samples;
+    int32_t _drift_mean;
+    int32_t _drift_dev;
+};
+
+#endif /* MBED_LORAWAN_SYS_CLOCK_ESTIMATOR_H__ */
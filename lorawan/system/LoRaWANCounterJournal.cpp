@@ -0,0 +1,257 @@
+/**
+ * @file LoRaWANCounterJournal.cpp
+ *
+ * @brief Wear-levelled journal of LoRaWAN frame counters
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "LoRaWANCounterJournal.h"
+#include "lorawan_crc.h"
+#include "trace.h"
+
+LoRaWANCounterJournal::LoRaWANCounterJournal()
+    : _storage(NULL),
+      _addr(0),
+      _unit_size(0),
+      _unit_count(0),
+      _records_per_unit(0),
+      _unit(0),
+      _slot(0),
+      _latest_unit(0),
+      _spare_dirty(false),
+      _valid(false)
+{
+    memset(&_latest, 0, sizeof(_latest));
+}
+
+lorawan_status_t LoRaWANCounterJournal::mount(LoRaWANStorage *storage,
+                                              uint32_t addr, uint32_t size)
+{
+    lorawan_fcnt_record_t record;
+    uint32_t fill = 0;
+
+    unmount();
+
+    if (!storage || storage->get_erase_size() < sizeof(lorawan_fcnt_record_t)) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    _unit_size = storage->get_erase_size();
+    _unit_count = size / _unit_size;
+
+    if (addr % _unit_size || _unit_count < 2) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    _storage = storage;
+    _addr = addr;
+    _records_per_unit = _unit_size / sizeof(lorawan_fcnt_record_t);
+
+    // the newest intact record wins, torn ones fail their CRC
+    for (uint32_t unit = 0; unit < _unit_count; unit++) {
+        for (uint32_t slot = 0; slot < _records_per_unit; slot++) {
+            if (_storage->read(&record, unit_addr(unit) + slot * sizeof(record),
+                               sizeof(record)) != 0) {
+                unmount();
+                return LORAWAN_STATUS_STORAGE_ERROR;
+            }
+
+            if (record.crc != record_crc(record)) {
+                continue;
+            }
+
+            if (!_valid || (int32_t)(record.seq - _latest.seq) > 0) {
+                _valid = true;
+                _latest = record;
+                _latest_unit = unit;
+                _unit = unit;
+                _slot = slot + 1;
+            }
+        }
+    }
+
+    if (!_valid) {
+        _unit = 0;
+        _slot = 0;
+    }
+
+    // skip anything programmed after the newest record, e.g. a torn one
+    while (_slot < _records_per_unit) {
+        if (_storage->read(&record, unit_addr(_unit) + _slot * sizeof(record),
+                           sizeof(record)) != 0) {
+            unmount();
+            return LORAWAN_STATUS_STORAGE_ERROR;
+        }
+
+        const uint8_t *bytes = (const uint8_t *) &record;
+        bool erased = true;
+        for (uint32_t i = 0; i < sizeof(record); i++) {
+            erased = erased && bytes[i] == 0xFF;
+        }
+
+        if (erased) {
+            break;
+        }
+        _slot++;
+        fill++;
+    }
+
+    if (fill) {
+        tr_debug("Counter journal: skipped %lu torn record(s)", fill);
+    }
+
+    // mount time is the place for erasing, never the uplink path
+    const uint32_t spare = (_unit + 1) % _unit_count;
+    if (!is_unit_erased(spare)
+            && _storage->erase(unit_addr(spare), _unit_size) != 0) {
+        unmount();
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    if (!_valid && _slot > 0 && _slot == _records_per_unit) {
+        if (_storage->erase(unit_addr(_unit), _unit_size) != 0) {
+            unmount();
+            return LORAWAN_STATUS_STORAGE_ERROR;
+        }
+        _slot = 0;
+    }
+
+    return LORAWAN_STATUS_OK;
+}
+
+void LoRaWANCounterJournal::unmount()
+{
+    _storage = NULL;
+    _valid = false;
+    _spare_dirty = false;
+    _unit = 0;
+    _slot = 0;
+}
+
+bool LoRaWANCounterJournal::is_mounted() const
+{
+    return _storage != NULL;
+}
+
+bool LoRaWANCounterJournal::get_counters(uint32_t dev_addr, uint32_t &ul_counter,
+                                         uint32_t &dl_counter) const
+{
+    if (!_valid || _latest.dev_addr != dev_addr) {
+        return false;
+    }
+
+    ul_counter = _latest.ul_limit;
+    dl_counter = _latest.dl_counter;
+
+    return true;
+}
+
+bool LoRaWANCounterJournal::is_reserved(uint32_t dev_addr, uint32_t ul_counter) const
+{
+    return _valid && _latest.dev_addr == dev_addr && ul_counter < _latest.ul_limit;
+}
+
+lorawan_status_t LoRaWANCounterJournal::reserve(uint32_t dev_addr, uint32_t ul_counter,
+                                                uint32_t dl_counter)
+{
+    lorawan_fcnt_record_t record;
+
+    if (!_storage) {
+        return LORAWAN_STATUS_NOT_INITIALIZED;
+    }
+
+    if (_slot == _records_per_unit) {
+        if (_spare_dirty) {
+            return LORAWAN_STATUS_BUSY;
+        }
+        // the spare is erased, move on and let maintain() free the next one
+        _unit = (_unit + 1) % _unit_count;
+        _slot = 0;
+        _spare_dirty = true;
+    }
+
+    record.seq = _valid ? _latest.seq + 1 : 0;
+    record.dev_addr = dev_addr;
+    record.ul_limit = ul_counter + MBED_CONF_LORA_FCNT_JOURNAL_BLOCK;
+    record.dl_counter = dl_counter;
+    record.crc = record_crc(record);
+
+    const uint32_t addr = unit_addr(_unit) + _slot * sizeof(record);
+
+    // the slot is used up even if programming fails half way
+    _slot++;
+
+    if (_storage->program(&record, addr, sizeof(record)) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    _latest = record;
+    _latest_unit = _unit;
+    _valid = true;
+
+    return LORAWAN_STATUS_OK;
+}
+
+bool LoRaWANCounterJournal::needs_maintenance() const
+{
+    return _storage && _spare_dirty;
+}
+
+lorawan_status_t LoRaWANCounterJournal::maintain()
+{
+    if (!needs_maintenance()) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    const uint32_t spare = (_unit + 1) % _unit_count;
+
+    // with two units, the spare is the unit holding the newest record until
+    // a record makes it to the current one: the first program there failed
+    if (_valid && spare == _latest_unit) {
+        return LORAWAN_STATUS_BUSY;
+    }
+
+    if (_storage->erase(unit_addr(spare), _unit_size) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    _spare_dirty = false;
+
+    return LORAWAN_STATUS_OK;
+}
+
+uint32_t LoRaWANCounterJournal::unit_addr(uint32_t unit) const
+{
+    return _addr + unit * _unit_size;
+}
+
+bool LoRaWANCounterJournal::is_unit_erased(uint32_t unit)
+{
+    uint8_t chunk[32];
+
+    for (uint32_t pos = 0; pos < _unit_size; pos += sizeof(chunk)) {
+        const uint32_t len = (_unit_size - pos) < sizeof(chunk) ?
+                             (_unit_size - pos) : sizeof(chunk);
+
+        if (_storage->read(chunk, unit_addr(unit) + pos, len) != 0) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < len; i++) {
+            if (chunk[i] != 0xFF) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+uint32_t LoRaWANCounterJournal::record_crc(const lorawan_fcnt_record_t &record)
+{
+    return lorawan_crc32_final(lorawan_crc32_update(LORAWAN_CRC32_INIT, &record,
+                                                    sizeof(record) - sizeof(record.crc)));
+}
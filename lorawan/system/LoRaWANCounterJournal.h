@@ -0,0 +1,152 @@
+/**
+ * @file LoRaWANCounterJournal.h
+ *
+ * @brief Wear-levelled journal of LoRaWAN frame counters
+ *
+ * A session can only be resumed safely if the uplink frame counter never
+ * goes back, but writing it on every uplink would wear out the flash and
+ * stall the TX path. The journal therefore reserves uplink counters in
+ * blocks of MBED_CONF_LORA_FCNT_JOURNAL_BLOCK: a record stores the first
+ * counter beyond the reserved block, and a resumed session continues from
+ * there. Hence there is one write per block of uplinks, and up to a block
+ * of counters is skipped on restore. The downlink counter is written along.
+ *
+ * Records are appended to the erase units of the journal area in turn,
+ * which levels the wear. Each record carries a sequence number and a CRC.
+ * Mounting recovers the newest intact record, so a record torn by a reset
+ * is simply ignored. The erase unit following the one being written is
+ * always kept erased, so an append never has to erase. Freeing the next
+ * unit is left to maintain(), to be called outside the uplink path.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_COUNTER_JOURNAL_H__
+#define MBED_LORAWAN_SYS_COUNTER_JOURNAL_H__
+
+#include <stdint.h>
+#include "lorawan_data_structures.h"
+#include "LoRaWANStorage.h"
+
+/**
+ * A frame counter record as kept in storage
+ */
+typedef struct {
+    /**
+     * Sequence number, the highest one is the newest record
+     */
+    uint32_t seq;
+    /**
+     * Device address the counters belong to
+     */
+    uint32_t dev_addr;
+    /**
+     * First uplink counter beyond the reserved block
+     */
+    uint32_t ul_limit;
+    /**
+     * Downlink counter when the record was written
+     */
+    uint32_t dl_counter;
+    /**
+     * CRC-32 over the fields above
+     */
+    uint32_t crc;
+} lorawan_fcnt_record_t;
+
+class LoRaWANCounterJournal {
+public:
+    LoRaWANCounterJournal();
+
+    /** Mounts the journal and recovers the newest record
+     *
+     * May erase, never call it on the uplink path.
+     *
+     * @param storage       Storage holding the journal
+     * @param addr          Start of the journal area, aligned to an erase unit
+     * @param size          Size of the journal area, at least two erase units
+     *
+     * @return              LORAWAN_STATUS_OK, LORAWAN_STATUS_PARAMETER_INVALID
+     *                      if the area is too small or misaligned, or
+     *                      LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t mount(LoRaWANStorage *storage, uint32_t addr, uint32_t size);
+
+    /** Detaches the journal from its storage
+     */
+    void unmount();
+
+    /** Checks if the journal is mounted
+     */
+    bool is_mounted() const;
+
+    /** Gets the counters to resume from
+     *
+     * @param dev_addr      Device address of the session being resumed
+     * @param ul_counter    [out] Uplink counter to continue from
+     * @param dl_counter    [out] Last known downlink counter
+     *
+     * @return              true if the journal holds counters for 'dev_addr'
+     */
+    bool get_counters(uint32_t dev_addr, uint32_t &ul_counter,
+                      uint32_t &dl_counter) const;
+
+    /** Checks if an uplink counter is already covered by a reservation
+     *
+     * @param dev_addr      Device address
+     * @param ul_counter    Uplink counter about to be used
+     */
+    bool is_reserved(uint32_t dev_addr, uint32_t ul_counter) const;
+
+    /** Reserves a block of uplink counters
+     *
+     * Only programs, it never erases.
+     *
+     * @param dev_addr      Device address
+     * @param ul_counter    First uplink counter of the block
+     * @param dl_counter    Current downlink counter
+     *
+     * @return              LORAWAN_STATUS_OK, LORAWAN_STATUS_BUSY if the next
+     *                      erase unit has not been freed by maintain() yet,
+     *                      or LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t reserve(uint32_t dev_addr, uint32_t ul_counter,
+                             uint32_t dl_counter);
+
+    /** Checks if maintain() has work to do
+     */
+    bool needs_maintenance() const;
+
+    /** Erases the unit following the one being written
+     *
+     * The unit holding the newest record is never erased.
+     *
+     * @return              LORAWAN_STATUS_OK, LORAWAN_STATUS_BUSY if the unit
+     *                      to erase still holds the newest record, to be
+     *                      tried again once a record is reserved, or
+     *                      LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t maintain();
+
+private:
+    uint32_t unit_addr(uint32_t unit) const;
+    bool is_unit_erased(uint32_t unit);
+    static uint32_t record_crc(const lorawan_fcnt_record_t &record);
+
+    LoRaWANStorage *_storage;
+    uint32_t _addr;
+    uint32_t _unit_size;
+    uint32_t _unit_count;
+    uint32_t _records_per_unit;
+
+    uint32_t _unit;
+    uint32_t _slot;
+    uint32_t _latest_unit;
+    bool _spare_dirty;
+
+    bool _valid;
+    lorawan_fcnt_record_t _latest;
+};
+
+#endif /* MBED_LORAWAN_SYS_COUNTER_JOURNAL_H__ */
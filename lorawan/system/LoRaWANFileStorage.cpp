@@ -0,0 +1,153 @@
+/**
+ * @file LoRaWANFileStorage.cpp
+ *
+ * @brief LoRaWAN session storage backed by a file
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "LoRaWANFileStorage.h"
+
+#define FILE_STORAGE_CHUNK          64
+
+LoRaWANFileStorage::LoRaWANFileStorage(const char *path, uint32_t size,
+                                       uint32_t erase_size)
+    : _path(path),
+      _file(NULL),
+      _size(size),
+      _erase_size(erase_size)
+{
+}
+
+LoRaWANFileStorage::~LoRaWANFileStorage()
+{
+    deinit();
+}
+
+int LoRaWANFileStorage::init()
+{
+    if (_file) {
+        return 0;
+    }
+
+    if (_erase_size == 0 || _size % _erase_size) {
+        return -1;
+    }
+
+    _file = fopen(_path, "r+b");
+    if (_file) {
+        fseek(_file, 0, SEEK_END);
+        if ((uint32_t) ftell(_file) >= _size) {
+            return 0;
+        }
+        fclose(_file);
+    }
+
+    // missing or short file, start from fully erased storage
+    _file = fopen(_path, "w+b");
+    if (!_file) {
+        return -1;
+    }
+
+    return erase(0, _size);
+}
+
+void LoRaWANFileStorage::deinit()
+{
+    if (_file) {
+        fclose(_file);
+        _file = NULL;
+    }
+}
+
+int LoRaWANFileStorage::read(void *buffer, uint32_t addr, uint32_t size)
+{
+    if (!_file || !is_valid_range(addr, size)) {
+        return -1;
+    }
+
+    if (fseek(_file, addr, SEEK_SET) != 0
+            || fread(buffer, 1, size, _file) != size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int LoRaWANFileStorage::program(const void *buffer, uint32_t addr, uint32_t size)
+{
+    uint8_t chunk[FILE_STORAGE_CHUNK];
+    const uint8_t *data = (const uint8_t *) buffer;
+
+    if (!_file || !is_valid_range(addr, size)) {
+        return -1;
+    }
+
+    while (size > 0) {
+        const uint32_t len = size < sizeof(chunk) ? size : sizeof(chunk);
+
+        if (read(chunk, addr, len) != 0) {
+            return -1;
+        }
+
+        // like NOR flash, programming can only clear bits
+        for (uint32_t i = 0; i < len; i++) {
+            chunk[i] &= data[i];
+        }
+
+        if (fseek(_file, addr, SEEK_SET) != 0
+                || fwrite(chunk, 1, len, _file) != len) {
+            return -1;
+        }
+
+        data += len;
+        addr += len;
+        size -= len;
+    }
+
+    return fflush(_file) == 0 ? 0 : -1;
+}
+
+int LoRaWANFileStorage::erase(uint32_t addr, uint32_t size)
+{
+    uint8_t chunk[FILE_STORAGE_CHUNK];
+
+    if (!_file || !is_valid_range(addr, size)
+            || addr % _erase_size || size % _erase_size) {
+        return -1;
+    }
+
+    memset(chunk, 0xFF, sizeof(chunk));
+
+    if (fseek(_file, addr, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    while (size > 0) {
+        const uint32_t len = size < sizeof(chunk) ? size : sizeof(chunk);
+
+        if (fwrite(chunk, 1, len, _file) != len) {
+            return -1;
+        }
+        size -= len;
+    }
+
+    return fflush(_file) == 0 ? 0 : -1;
+}
+
+uint32_t LoRaWANFileStorage::get_erase_size() const
+{
+    return _erase_size;
+}
+
+uint32_t LoRaWANFileStorage::size() const
+{
+    return _size;
+}
+
+bool LoRaWANFileStorage::is_valid_range(uint32_t addr, uint32_t size) const
+{
+    return addr <= _size && size <= _size - addr;
+}
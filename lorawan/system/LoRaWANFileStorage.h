@@ -0,0 +1,57 @@
+/**
+ * @file LoRaWANFileStorage.h
+ *
+ * @brief LoRaWAN session storage backed by a file
+ *
+ * Emulates a NOR flash in a regular file. Meant for hosts where the stack
+ * runs against a simulated radio, but works on any target which has a file
+ * system behind stdio.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_FILE_STORAGE_H__
+#define MBED_LORAWAN_SYS_FILE_STORAGE_H__
+
+#include <stdio.h>
+#include "LoRaWANStorage.h"
+
+class LoRaWANFileStorage : public LoRaWANStorage {
+public:
+    /** Constructor
+     *
+     * @param path          Path of the backing file
+     * @param size          Size of the emulated storage
+     * @param erase_size    Size of an erase unit
+     */
+    LoRaWANFileStorage(const char *path, uint32_t size, uint32_t erase_size);
+
+    virtual ~LoRaWANFileStorage();
+
+    /** Opens the backing file, creating it in erased state if needed
+     *
+     * @return              0 on success, negative on failure
+     */
+    int init();
+
+    /** Closes the backing file
+     */
+    void deinit();
+
+    virtual int read(void *buffer, uint32_t addr, uint32_t size);
+    virtual int program(const void *buffer, uint32_t addr, uint32_t size);
+    virtual int erase(uint32_t addr, uint32_t size);
+    virtual uint32_t get_erase_size() const;
+    virtual uint32_t size() const;
+
+private:
+    bool is_valid_range(uint32_t addr, uint32_t size) const;
+
+    const char *_path;
+    FILE *_file;
+    uint32_t _size;
+    uint32_t _erase_size;
+};
+
+#endif /* MBED_LORAWAN_SYS_FILE_STORAGE_H__ */
@@ -0,0 +1,400 @@
+/**
+ * @file LoRaWANFragDecoder.cpp
+ *
+ * @brief Forward error correction decoder of the LoRaWAN Fragmented Data
+ *        Block Transport
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "LoRaWANFragDecoder.h"
+#include "trace.h"
+
+/**
+ * Index of the lowest bit set in a non-zero word
+ */
+static uint8_t lowest_bit(uint32_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(word);
+#else
+    uint8_t bit = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * PRBS23 generator of the parity matrix, x^23 + x^5 + 1
+ */
+static uint32_t prbs23(uint32_t x)
+{
+    uint32_t b0 = x & 0x01;
+    uint32_t b1 = (x & 0x20) >> 5;
+    return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+LoRaWANFragDecoder::LoRaWANFragDecoder()
+{
+    reset();
+}
+
+void LoRaWANFragDecoder::reset()
+{
+    _storage = NULL;
+    _addr = 0;
+    _size = 0;
+    _nb_frag = 0;
+    _frag_size = 0;
+    _active = false;
+    _complete = false;
+    _coding = false;
+    _out_of_memory = false;
+    _nb_received = 0;
+    _nb_uncoded = 0;
+    _nb_unknown = 0;
+    _nb_pivot = 0;
+    _row_words = 0;
+    memset(_received, 0, sizeof(_received));
+    memset(_pivot, 0, sizeof(_pivot));
+    memset(_late, 0, sizeof(_late));
+}
+
+lorawan_status_t LoRaWANFragDecoder::setup(LoRaWANStorage *storage, uint32_t addr,
+                                           uint32_t size, uint16_t nb_frag,
+                                           uint8_t frag_size)
+{
+    reset();
+
+    if (!storage || nb_frag == 0 || frag_size == 0
+            || nb_frag > MBED_CONF_LORA_FRAG_MAX_FRAGMENTS
+            || frag_size > MBED_CONF_LORA_FRAG_MAX_SIZE
+            || (uint32_t) nb_frag * frag_size > size
+            || addr % storage->get_erase_size()) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    // fragments are programmed in place, the area must start out erased
+    size -= size % storage->get_erase_size();
+    if (storage->erase(addr, size) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    _storage = storage;
+    _addr = addr;
+    _size = size;
+    _nb_frag = nb_frag;
+    _frag_size = frag_size;
+    _active = true;
+
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANFragDecoder::process(uint16_t index, const uint8_t *data)
+{
+    if (!_active) {
+        return LORAWAN_STATUS_NO_OP;
+    }
+
+    if (index == 0) {
+        return LORAWAN_STATUS_PARAMETER_INVALID;
+    }
+
+    if (_complete || _out_of_memory) {
+        return LORAWAN_STATUS_OK;
+    }
+
+    uint16_t frag = index - 1;
+
+    if (index <= _nb_frag) {
+        if (_received[frag / 32] & (1UL << (frag % 32))) {
+            return LORAWAN_STATUS_OK;
+        }
+
+        if (!_coding) {
+            _nb_received++;
+            if (_storage->program(data, block_addr(frag), _frag_size) != 0) {
+                return LORAWAN_STATUS_STORAGE_ERROR;
+            }
+
+            _received[frag / 32] |= 1UL << (frag % 32);
+            if (++_nb_uncoded == _nb_frag) {
+                _complete = true;
+            }
+            return LORAWAN_STATUS_OK;
+        }
+
+        // A late uncoded fragment is an unknown already, its place in the
+        // block is written by the back substitution. It is a row with a
+        // single bit, folded in once.
+        int col = find_unknown(frag);
+        if (col < 0 || (_late[col / 32] & (1UL << (col % 32)))) {
+            return LORAWAN_STATUS_OK;
+        }
+
+        _late[col / 32] |= 1UL << (col % 32);
+        _nb_received++;
+
+        memset(_row, 0, sizeof(_row));
+        _row[col / 32] = 1UL << (col % 32);
+        memcpy(_payload, data, _frag_size);
+
+        return eliminate();
+    }
+
+    _nb_received++;
+
+    if (!_coding) {
+        freeze_unknowns();
+        if (_out_of_memory || _complete) {
+            return LORAWAN_STATUS_OK;
+        }
+    }
+
+    get_parity_line(index - _nb_frag);
+    memcpy(_payload, data, _frag_size);
+    memset(_row, 0, sizeof(_row));
+
+    // received fragments are XORed out, lost ones go to the row
+    uint16_t col = 0;
+    for (uint16_t w = 0; w < (_nb_frag + 31) / 32; w++) {
+        uint32_t known = _line[w] & _received[w];
+        uint32_t lost = ~_received[w];
+
+        while (known) {
+            uint8_t bit = lowest_bit(known);
+            known &= known - 1;
+            if (xor_from_storage(block_addr(w * 32 + bit)) != LORAWAN_STATUS_OK) {
+                return LORAWAN_STATUS_STORAGE_ERROR;
+            }
+        }
+
+        // unknowns are numbered in fragment order, count the lost
+        // fragments below each one to get its column
+        if (w == (_nb_frag - 1) / 32 && (_nb_frag % 32)) {
+            lost &= (1UL << (_nb_frag % 32)) - 1;
+        }
+
+        uint32_t line = _line[w] & lost;
+        while (lost) {
+            uint8_t bit = lowest_bit(lost);
+            lost &= lost - 1;
+            if (line & (1UL << bit)) {
+                _row[col / 32] |= 1UL << (col % 32);
+            }
+            col++;
+        }
+    }
+
+    return eliminate();
+}
+
+bool LoRaWANFragDecoder::is_active() const
+{
+    return _active;
+}
+
+bool LoRaWANFragDecoder::is_complete() const
+{
+    return _complete;
+}
+
+bool LoRaWANFragDecoder::is_out_of_memory() const
+{
+    return _out_of_memory;
+}
+
+uint16_t LoRaWANFragDecoder::get_nb_received() const
+{
+    return _nb_received;
+}
+
+uint16_t LoRaWANFragDecoder::get_nb_missing() const
+{
+    if (!_active || _complete) {
+        return 0;
+    }
+
+    return _coding ? _nb_unknown : _nb_frag - _nb_uncoded;
+}
+
+void LoRaWANFragDecoder::freeze_unknowns()
+{
+    _coding = true;
+    _nb_unknown = _nb_frag - _nb_uncoded;
+
+    if (_nb_unknown == 0) {
+        _complete = true;
+        return;
+    }
+
+    if (_nb_unknown > MBED_CONF_LORA_FRAG_MAX_REDUNDANCY
+            || (uint32_t)(_nb_frag + _nb_unknown) * _frag_size > _size) {
+        tr_error("%d fragments lost, cannot recover", _nb_unknown);
+        _out_of_memory = true;
+        return;
+    }
+
+    uint16_t col = 0;
+    for (uint16_t frag = 0; frag < _nb_frag; frag++) {
+        if (!(_received[frag / 32] & (1UL << (frag % 32)))) {
+            _unknown[col++] = frag;
+        }
+    }
+
+    _row_words = (_nb_unknown + 31) / 32;
+    _nb_pivot = 0;
+    memset(_pivot, 0, sizeof(_pivot));
+    memset(_late, 0, sizeof(_late));
+
+    tr_debug("Coded fragments start, %d fragments lost", _nb_unknown);
+}
+
+int LoRaWANFragDecoder::find_unknown(uint16_t frag) const
+{
+    int low = 0;
+    int high = _nb_unknown - 1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (_unknown[mid] == frag) {
+            return mid;
+        } else if (_unknown[mid] < frag) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+void LoRaWANFragDecoder::get_parity_line(uint16_t n)
+{
+    uint32_t m = _nb_frag;
+    // the generator is biased modulo a power of two
+    uint32_t modulo = m + (((m & (m - 1)) == 0) ? 1 : 0);
+    uint32_t x = 1 + 1001 * (uint32_t) n;
+
+    memset(_line, 0, sizeof(_line));
+
+    for (uint16_t nb_coeff = 0; nb_coeff < m / 2; nb_coeff++) {
+        uint32_t r;
+        do {
+            x = prbs23(x);
+            r = x % modulo;
+        } while (r >= m);
+
+        _line[r / 32] |= 1UL << (r % 32);
+    }
+}
+
+lorawan_status_t LoRaWANFragDecoder::eliminate()
+{
+    for (uint8_t w = 0; w < _row_words; w++) {
+        while (_row[w]) {
+            uint16_t col = w * 32 + lowest_bit(_row[w]);
+
+            if (!(_pivot[w] & (1UL << (col % 32)))) {
+                // a new row, kept for its lowest unknown
+                memcpy(matrix_row(col), &_row[w], (_row_words - w) * sizeof(uint32_t));
+                if (_storage->program(_payload, scratch_addr(col), _frag_size) != 0) {
+                    return LORAWAN_STATUS_STORAGE_ERROR;
+                }
+
+                _pivot[w] |= 1UL << (col % 32);
+                if (++_nb_pivot == _nb_unknown) {
+                    return solve();
+                }
+                return LORAWAN_STATUS_OK;
+            }
+
+            // kept rows have nothing below their unknown
+            const uint32_t *pivot = matrix_row(col);
+            for (uint8_t i = w; i < _row_words; i++) {
+                _row[i] ^= pivot[i - w];
+            }
+
+            if (xor_from_storage(scratch_addr(col)) != LORAWAN_STATUS_OK) {
+                return LORAWAN_STATUS_STORAGE_ERROR;
+            }
+        }
+    }
+
+    // linearly dependent on the rows kept so far
+    return LORAWAN_STATUS_OK;
+}
+
+lorawan_status_t LoRaWANFragDecoder::solve()
+{
+    for (int col = _nb_unknown - 1; col >= 0; col--) {
+        const uint32_t *row = matrix_row(col);
+        uint8_t first = col / 32;
+
+        if (_storage->read(_payload, scratch_addr(col), _frag_size) != 0) {
+            return LORAWAN_STATUS_STORAGE_ERROR;
+        }
+
+        // the unknowns above are solved already
+        for (uint8_t w = first; w < _row_words; w++) {
+            uint32_t bits = row[w - first];
+            if (w == first) {
+                bits &= ~((2UL << (col % 32)) - 1);
+            }
+
+            while (bits) {
+                uint8_t bit = lowest_bit(bits);
+                bits &= bits - 1;
+                if (xor_from_storage(block_addr(_unknown[w * 32 + bit])) != LORAWAN_STATUS_OK) {
+                    return LORAWAN_STATUS_STORAGE_ERROR;
+                }
+            }
+        }
+
+        if (_storage->program(_payload, block_addr(_unknown[col]), _frag_size) != 0) {
+            return LORAWAN_STATUS_STORAGE_ERROR;
+        }
+    }
+
+    _complete = true;
+    tr_debug("Block recovered");
+
+    return LORAWAN_STATUS_OK;
+}
+
+uint32_t *LoRaWANFragDecoder::matrix_row(uint16_t col)
+{
+    // rows before 'col' each drop one word per 32 columns
+    uint32_t q = col / 32;
+    uint32_t dropped = 32 * q * (q - 1) / 2 + q * (col - 32 * q);
+
+    return &_matrix[(uint32_t) col * _row_words - dropped];
+}
+
+uint32_t LoRaWANFragDecoder::block_addr(uint16_t frag) const
+{
+    return _addr + (uint32_t) frag * _frag_size;
+}
+
+uint32_t LoRaWANFragDecoder::scratch_addr(uint16_t col) const
+{
+    return block_addr(_nb_frag) + (uint32_t) col * _frag_size;
+}
+
+lorawan_status_t LoRaWANFragDecoder::xor_from_storage(uint32_t addr)
+{
+    if (_storage->read(_scratch, addr, _frag_size) != 0) {
+        return LORAWAN_STATUS_STORAGE_ERROR;
+    }
+
+    for (uint8_t i = 0; i < _frag_size; i++) {
+        _payload[i] ^= _scratch[i];
+    }
+
+    return LORAWAN_STATUS_OK;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file LoRaWANFragDecoder.h
+ *
+ * @brief Forward error correction decoder of the LoRaWAN Fragmented Data
+ *        Block Transport
+ *
+ * A data block is cut into M fragments of equal size which are sent first,
+ * followed by coded fragments. Coded fragment M + n is the XOR of about M/2
+ * uncoded fragments, picked by a parity matrix row derived from 'n' with a
+ * PRBS23 generator. Any M independent fragments restore the block.
+ *
+ * Uncoded fragments go straight to their place in the storage. When the
+ * first coded fragment arrives, the uncoded fragments lost so far are the
+ * unknowns, and each coded fragment is folded in on arrival:
+ *
+ *  - the received fragments it covers are XORed out of its payload,
+ *  - the remaining row, a bitset over the unknowns, is reduced against the
+ *    rows kept so far, a word at a time,
+ *  - if anything is left, it is kept as the row of its lowest unknown.
+ *
+ * Kept rows never change, so they form an upper triangular matrix which is
+ * stored packed, and their payloads are programmed once to a scratch area
+ * following the block. Once there is a row per unknown, back substitution
+ * writes the lost fragments into the block.
+ *
+ * RAM use is bounded at build time by MBED_CONF_LORA_FRAG_MAX_FRAGMENTS,
+ * MBED_CONF_LORA_FRAG_MAX_SIZE and MBED_CONF_LORA_FRAG_MAX_REDUNDANCY, the
+ * largest number of lost fragments which can be recovered.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_FRAG_DECODER_H__
+#define MBED_LORAWAN_SYS_FRAG_DECODER_H__
+
+#include <stdint.h>
+#include "lorawan_data_structures.h"
+#include "LoRaWANStorage.h"
+
+#if (MBED_CONF_LORA_FRAG_MAX_REDUNDANCY % 32) || (MBED_CONF_LORA_FRAG_MAX_FRAGMENTS % 32)
+#error "lora.frag-max-redundancy and lora.frag-max-fragments must be multiples of 32"
+#endif
+
+/**
+ * Words of a bitset over the fragments of a block
+ */
+#define FRAG_LINE_WORDS         (MBED_CONF_LORA_FRAG_MAX_FRAGMENTS / 32)
+
+/**
+ * Words of a bitset over the unknowns
+ */
+#define FRAG_ROW_WORDS          (MBED_CONF_LORA_FRAG_MAX_REDUNDANCY / 32)
+
+/**
+ * Words of the packed upper triangular matrix, row 'c' only keeps the words
+ * from c / 32 onwards
+ */
+#define FRAG_MATRIX_WORDS       (32 * FRAG_ROW_WORDS * (FRAG_ROW_WORDS + 1) / 2)
+
+class LoRaWANFragDecoder {
+public:
+    LoRaWANFragDecoder();
+
+    /** Starts a new block, any previous one is dropped
+     *
+     * Erases the storage area, do not call it on the radio path.
+     *
+     * @param storage       Storage receiving the block
+     * @param addr          Start of the area, aligned to an erase unit
+     * @param size          Size of the area. The block takes the first
+     *                      nb_frag * frag_size bytes, the rest is scratch
+     *                      space for a row per lost fragment.
+     * @param nb_frag       Number of uncoded fragments, M
+     * @param frag_size     Size of a fragment
+     *
+     * @return              LORAWAN_STATUS_OK, LORAWAN_STATUS_PARAMETER_INVALID
+     *                      if a bound is exceeded or the block does not fit,
+     *                      or LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t setup(LoRaWANStorage *storage, uint32_t addr, uint32_t size,
+                           uint16_t nb_frag, uint8_t frag_size);
+
+    /** Drops the block
+     */
+    void reset();
+
+    /** Folds a fragment in
+     *
+     * Duplicates, and fragments arriving once the block is restored or has
+     * become unrecoverable, are ignored.
+     *
+     * @param index         Fragment number N, 1 to M for uncoded fragments,
+     *                      above M for coded ones
+     * @param data          Fragment, frag_size bytes
+     *
+     * @return              LORAWAN_STATUS_OK, LORAWAN_STATUS_PARAMETER_INVALID
+     *                      for fragment number 0, LORAWAN_STATUS_NO_OP if there
+     *                      is no block, or LORAWAN_STATUS_STORAGE_ERROR
+     */
+    lorawan_status_t process(uint16_t index, const uint8_t *data);
+
+    /** A block is being received
+     */
+    bool is_active() const;
+
+    /** The whole block is in the storage
+     */
+    bool is_complete() const;
+
+    /** More fragments were lost than can be recovered
+     */
+    bool is_out_of_memory() const;
+
+    /** Number of fragments received, coded ones included
+     */
+    uint16_t get_nb_received() const;
+
+    /** Number of uncoded fragments lost and not recovered yet
+     */
+    uint16_t get_nb_missing() const;
+
+private:
+    /**
+     * Takes the lost fragments as the unknowns, on the first coded fragment
+     */
+    void freeze_unknowns();
+
+    /**
+     * Column of a lost fragment, -1 if not lost
+     */
+    int find_unknown(uint16_t frag) const;
+
+    /**
+     * Builds the parity matrix row of coded fragment M + n into _line
+     */
+    void get_parity_line(uint16_t n);
+
+    /**
+     * Reduces _row and _payload against the kept rows
+     */
+    lorawan_status_t eliminate();
+
+    /**
+     * Recovers the lost fragments once all rows are there
+     */
+    lorawan_status_t solve();
+
+    uint32_t *matrix_row(uint16_t col);
+
+    uint32_t block_addr(uint16_t frag) const;
+    uint32_t scratch_addr(uint16_t col) const;
+
+    lorawan_status_t xor_from_storage(uint32_t addr);
+
+    LoRaWANStorage *_storage;
+    uint32_t _addr;
+    uint32_t _size;
+
+    uint16_t _nb_frag;
+    uint8_t _frag_size;
+    uint8_t _row_words;
+
+    bool _active;
+    bool _complete;
+    bool _coding;
+    bool _out_of_memory;
+
+    uint16_t _nb_received;
+    uint16_t _nb_uncoded;
+
+    /**
+     * Unknowns, and the number of rows kept for them so far
+     */
+    uint16_t _nb_unknown;
+    uint16_t _nb_pivot;
+
+    /**
+     * Uncoded fragments received
+     */
+    uint32_t _received[FRAG_LINE_WORDS];
+
+    /**
+     * Parity matrix row of the coded fragment being folded in
+     */
+    uint32_t _line[FRAG_LINE_WORDS];
+
+    /**
+     * Fragment number, 0-based, of each unknown in ascending order
+     */
+    uint16_t _unknown[MBED_CONF_LORA_FRAG_MAX_REDUNDANCY];
+
+    /**
+     * Columns which have a row
+     */
+    uint32_t _pivot[FRAG_ROW_WORDS];
+
+    /**
+     * Unknowns whose uncoded fragment came late
+     */
+    uint32_t _late[FRAG_ROW_WORDS];
+
+    uint32_t _matrix[FRAG_MATRIX_WORDS];
+
+    uint32_t _row[FRAG_ROW_WORDS];
+    uint8_t _payload[MBED_CONF_LORA_FRAG_MAX_SIZE];
+    uint8_t _scratch[MBED_CONF_LORA_FRAG_MAX_SIZE];
+};
+
+#endif /* MBED_LORAWAN_SYS_FRAG_DECODER_H__ */
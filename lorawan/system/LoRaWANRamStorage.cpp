@@ -0,0 +1,117 @@
+/**
+ * @file LoRaWANRamStorage.cpp
+ *
+ * @brief LoRaWAN session storage emulated in RAM
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "LoRaWANRamStorage.h"
+
+LoRaWANRamStorage::LoRaWANRamStorage(uint8_t *buffer, uint32_t size,
+                                     uint32_t erase_size)
+    : _buffer(buffer),
+      _size(size),
+      _erase_size(erase_size),
+      _power_loss_armed(false),
+      _write_budget(0),
+      _powered_off(false)
+{
+}
+
+void LoRaWANRamStorage::inject_power_loss(uint32_t bytes)
+{
+    _power_loss_armed = true;
+    _write_budget = bytes;
+}
+
+void LoRaWANRamStorage::restore_power()
+{
+    _power_loss_armed = false;
+    _powered_off = false;
+}
+
+bool LoRaWANRamStorage::is_powered_off() const
+{
+    return _powered_off;
+}
+
+int LoRaWANRamStorage::read(void *buffer, uint32_t addr, uint32_t size)
+{
+    if (!is_valid_range(addr, size)) {
+        return -1;
+    }
+
+    memcpy(buffer, &_buffer[addr], size);
+
+    return 0;
+}
+
+int LoRaWANRamStorage::program(const void *buffer, uint32_t addr, uint32_t size)
+{
+    const uint8_t *data = (const uint8_t *) buffer;
+
+    if (!is_valid_range(addr, size)) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (!consume_budget()) {
+            return -1;
+        }
+        // like NOR flash, programming can only clear bits
+        _buffer[addr + i] &= data[i];
+    }
+
+    return 0;
+}
+
+int LoRaWANRamStorage::erase(uint32_t addr, uint32_t size)
+{
+    if (!is_valid_range(addr, size) || addr % _erase_size || size % _erase_size) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (!consume_budget()) {
+            return -1;
+        }
+        _buffer[addr + i] = 0xFF;
+    }
+
+    return 0;
+}
+
+uint32_t LoRaWANRamStorage::get_erase_size() const
+{
+    return _erase_size;
+}
+
+uint32_t LoRaWANRamStorage::size() const
+{
+    return _size;
+}
+
+bool LoRaWANRamStorage::is_valid_range(uint32_t addr, uint32_t size) const
+{
+    return addr <= _size && size <= _size - addr;
+}
+
+bool LoRaWANRamStorage::consume_budget()
+{
+    if (_powered_off) {
+        return false;
+    }
+
+    if (_power_loss_armed) {
+        if (_write_budget == 0) {
+            _powered_off = true;
+            return false;
+        }
+        _write_budget--;
+    }
+
+    return true;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file LoRaWANRamStorage.h
+ *
+ * @brief LoRaWAN session storage emulated in RAM
+ *
+ * Behaves like a NOR flash held in a caller provided buffer. A power loss can
+ * be injected: once the given number of bytes has been programmed or erased,
+ * the operation in progress stops half way and every later write fails, just
+ * as if the device had been reset in the middle of it. Reading still works,
+ * so that a fresh mount can check what survived.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_RAM_STORAGE_H__
+#define MBED_LORAWAN_SYS_RAM_STORAGE_H__
+
+#include "LoRaWANStorage.h"
+
+class LoRaWANRamStorage : public LoRaWANStorage {
+public:
+    /** Constructor
+     *
+     * @param buffer        Memory backing the storage
+     * @param size          Size of 'buffer', a multiple of 'erase_size'
+     * @param erase_size    Size of an erase unit
+     */
+    LoRaWANRamStorage(uint8_t *buffer, uint32_t size, uint32_t erase_size);
+
+    /** Injects a power loss
+     *
+     * @param bytes         Number of bytes which still get written, 0 cuts
+     *                      the power before the next write
+     */
+    void inject_power_loss(uint32_t bytes);
+
+    /** Restores the power after an injected power loss
+     */
+    void restore_power();
+
+    /** Checks if the injected power loss has struck
+     */
+    bool is_powered_off() const;
+
+    virtual int read(void *buffer, uint32_t addr, uint32_t size);
+    virtual int program(const void *buffer, uint32_t addr, uint32_t size);
+    virtual int erase(uint32_t addr, uint32_t size);
+    virtual uint32_t get_erase_size() const;
+    virtual uint32_t size() const;
+
+private:
+    bool is_valid_range(uint32_t addr, uint32_t size) const;
+    bool consume_budget(void);
+
+    uint8_t *_buffer;
+    uint32_t _size;
+    uint32_t _erase_size;
+    bool _power_loss_armed;
+    uint32_t _write_budget;
+    bool _powered_off;
+};
+
+#endif /* MBED_LORAWAN_SYS_RAM_STORAGE_H__ */
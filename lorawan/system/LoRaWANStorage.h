@@ -0,0 +1,73 @@
+/**
+ * @file LoRaWANStorage.h
+ *
+ * @brief Non-volatile storage interface for LoRaWAN session state
+ *
+ * The stack persists its session through this interface, so that any
+ * non-volatile memory can be plugged in: internal flash, an external SPI
+ * flash or a file on a host. It follows NOR flash semantics:
+ *
+ *  - erase() sets a whole number of erase units to 0xFF,
+ *  - program() can only clear bits of erased memory,
+ *  - read() can read any range.
+ *
+ * All methods return 0 on success and a negative value on failure.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_STORAGE_H__
+#define MBED_LORAWAN_SYS_STORAGE_H__
+
+#include <stdint.h>
+
+class LoRaWANStorage {
+public:
+    virtual ~LoRaWANStorage() {}
+
+    /** Reads data from the storage
+     *
+     * @param buffer        Buffer receiving the data
+     * @param addr          Address to read from
+     * @param size          Number of bytes to read
+     *
+     * @return              0 on success, negative on failure
+     */
+    virtual int read(void *buffer, uint32_t addr, uint32_t size) = 0;
+
+    /** Programs data to erased storage
+     *
+     * @param buffer        Data to program
+     * @param addr          Address to program to
+     * @param size          Number of bytes to program
+     *
+     * @return              0 on success, negative on failure
+     */
+    virtual int program(const void *buffer, uint32_t addr, uint32_t size) = 0;
+
+    /** Erases storage
+     *
+     * @param addr          Address of the first erase unit, aligned to
+     *                      get_erase_size()
+     * @param size          Number of bytes to erase, a multiple of
+     *                      get_erase_size()
+     *
+     * @return              0 on success, negative on failure
+     */
+    virtual int erase(uint32_t addr, uint32_t size) = 0;
+
+    /** Size of an erase unit
+     *
+     * @return              Size in bytes
+     */
+    virtual uint32_t get_erase_size() const = 0;
+
+    /** Total size of the storage
+     *
+     * @return              Size in bytes
+     */
+    virtual uint32_t size() const = 0;
+};
+
+#endif /* MBED_LORAWAN_SYS_STORAGE_H__ */
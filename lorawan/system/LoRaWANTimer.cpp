@@ -22,7 +22,7 @@ SPDX-License-Identifier: BSD-3-Clause
 #include "trace.h"
 
 LoRaWANTimeHandler::LoRaWANTimeHandler()
-    : _queue(NULL)
+    : _queue(NULL), _gps_time(0), _gps_ref(0), _gps_valid(false)
 {
 }
 
@@ -63,3 +63,27 @@ void LoRaWANTimeHandler::stop(timer_event_t &obj)
     _queue->cancel(obj.timer_id);
     obj.timer_id = 0;
 }
+
+void LoRaWANTimeHandler::set_gps_time(uint32_t seconds, uint16_t ms, lorawan_time_t at)
+{
+    _gps_time = (uint64_t) seconds * 1000 + ms;
+    _gps_ref = at;
+    _gps_valid = true;
+}
+
+bool LoRaWANTimeHandler::get_gps_time(uint32_t &seconds, uint16_t &ms)
+{
+    if (!_gps_valid) {
+        return false;
+    }
+
+    // moves the reference along so that only one wrap has to be covered
+    lorawan_time_t now = get_current_time();
+    _gps_time += (lorawan_time_t)(now - _gps_ref);
+    _gps_ref = now;
+
+    seconds = (uint32_t)(_gps_time / 1000);
+    ms = (uint16_t)(_gps_time % 1000);
+
+    return true;
+}
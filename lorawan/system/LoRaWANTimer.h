@@ -76,8 +76,34 @@ public:
      */
     void stop(timer_event_t &obj);
 
+    /** Sets the GPS time.
+     *
+     * @param [in] seconds  GPS time, seconds since the GPS epoch.
+     * @param [in] ms       GPS time, milliseconds within the second.
+     * @param [in] at       Local time the GPS time refers to.
+     */
+    void set_gps_time(uint32_t seconds, uint16_t ms, lorawan_time_t at);
+
+    /** Reads the current GPS time.
+     *
+     * The time is kept from the local clock since it was last set, which has
+     * to happen at least once per wrap of the local time.
+     *
+     * @param [out] seconds GPS time, seconds since the GPS epoch.
+     * @param [out] ms      GPS time, milliseconds within the second.
+     * @return              false if the GPS time was never set.
+     */
+    bool get_gps_time(uint32_t &seconds, uint16_t &ms);
+
 private:
     events::EventQueue *_queue;
+
+    /**
+     * GPS time (ms) at local time _gps_ref
+     */
+    uint64_t _gps_time;
+    lorawan_time_t _gps_ref;
+    bool _gps_valid;
 };
 
 #endif // MBED_LORAWAN_SYS_TIMER_H__
@@ -0,0 +1,48 @@
+/**
+ * @file lorawan_crc.cpp
+ *
+ * @brief CRC-32 for records the stack keeps in non-volatile storage and
+ *        CRC-16 for Class B beacons
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lorawan_crc.h"
+
+#define CRC32_POLYNOMIAL            0xEDB88320UL
+#define CRC16_POLYNOMIAL            0x1021
+
+uint32_t lorawan_crc32_update(uint32_t crc, const void *data, uint32_t size)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    // bitwise, records are small and rarely written
+    while (size--) {
+        crc ^= *bytes++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (CRC32_POLYNOMIAL & (0 - (crc & 1)));
+        }
+    }
+
+    return crc;
+}
+
+uint32_t lorawan_crc32_final(uint32_t crc)
+{
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+uint16_t lorawan_crc16_ccitt(const uint8_t *data, uint16_t size)
+{
+    uint16_t crc = 0;
+
+    while (size--) {
+        crc ^= (uint16_t) *data++ << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLYNOMIAL : (crc << 1);
+        }
+    }
+
+    return crc;
+}
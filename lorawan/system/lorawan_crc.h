@@ -0,0 +1,52 @@
+/**
+ * @file lorawan_crc.h
+ *
+ * @brief CRC-32 for records the stack keeps in non-volatile storage and
+ *        CRC-16 for Class B beacons
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_CRC_H__
+#define MBED_LORAWAN_SYS_CRC_H__
+
+#include <stdint.h>
+
+/**
+ * Initial value of a CRC computed in pieces
+ */
+#define LORAWAN_CRC32_INIT          0xFFFFFFFFUL
+
+/** Feeds data into a running CRC-32 (IEEE 802.3)
+ *
+ * Start from LORAWAN_CRC32_INIT and pass the result of lorawan_crc32_update()
+ * through lorawan_crc32_final() once all data has been fed.
+ *
+ * @param crc           Running CRC
+ * @param data          Data
+ * @param size          Size of the data
+ *
+ * @return              Updated running CRC
+ */
+uint32_t lorawan_crc32_update(uint32_t crc, const void *data, uint32_t size);
+
+/** Finalizes a running CRC-32
+ *
+ * @param crc           Running CRC
+ *
+ * @return              CRC-32 of the data fed
+ */
+uint32_t lorawan_crc32_final(uint32_t crc);
+
+/** Computes the CRC-16 (CCITT, polynomial 0x1021, initial value 0) which
+ * protects the fields of a Class B beacon
+ *
+ * @param data          Data
+ * @param size          Size of the data
+ *
+ * @return              CRC-16 of the data
+ */
+uint16_t lorawan_crc16_ccitt(const uint8_t *data, uint16_t size);
+
+#endif /* MBED_LORAWAN_SYS_CRC_H__ */
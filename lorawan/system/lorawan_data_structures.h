@@ -151,21 +151,17 @@ typedef enum {
     /*!
      * LoRaMAC class b ping slot window
      */
-    RX_SLOT_WIN_PING_SLOT
+    RX_SLOT_WIN_PING_SLOT,
+    /*!
+     * LoRaMAC class b beacon window
+     */
+    RX_SLOT_WIN_BEACON
 } rx_slot_t;
 
 /*!
  * The global MAC layer parameters.
  */
 typedef struct {
-    /*!
-     * The TX power in channels.
-     */
-    int8_t channel_tx_power;
-    /*!
-     * The data rate in channels.
-     */
-    int8_t channel_data_rate;
     /*!
      * LoRaMac maximum time a reception window stays open.
      */
@@ -186,6 +182,30 @@ typedef struct {
      * Join accept delay 1.
      */
     uint32_t join_accept_delay2;
+    /*!
+     * LoRaMAC 2nd reception window settings.
+     */
+    rx2_channel_params rx2_channel;
+    /*!
+     * The maximum possible EIRP.
+     */
+    float max_eirp;
+    /*!
+     * The antenna gain of the node.
+     */
+    float antenna_gain;
+    /*!
+     * Aggregated duty cycle management
+     */
+    uint16_t aggregated_duty_cycle;
+    /*!
+     * The TX power in channels.
+     */
+    int8_t channel_tx_power;
+    /*!
+     * The data rate in channels.
+     */
+    int8_t channel_data_rate;
     /*!
      * The number of uplink messages repetitions for QOS set by network server
      * in LinkADRReq mac command (unconfirmed messages only).
@@ -195,10 +215,6 @@ typedef struct {
      * The datarate offset between uplink and downlink on first window.
      */
     uint8_t rx1_dr_offset;
-    /*!
-     * LoRaMAC 2nd reception window settings.
-     */
-    rx2_channel_params rx2_channel;
     /*!
      * The uplink dwell time configuration. 0: No limit, 1: 400ms
      */
@@ -207,25 +223,11 @@ typedef struct {
      * The downlink dwell time configuration. 0: No limit, 1: 400ms
      */
     uint8_t downlink_dwell_time;
-    /*!
-     * The maximum possible EIRP.
-     */
-    float max_eirp;
-    /*!
-     * The antenna gain of the node.
-     */
-    float antenna_gain;
-
     /*!
      * Maximum duty cycle
      * \remark Possibility to shutdown the device.
      */
     uint8_t max_duty_cycle;
-    /*!
-     * Aggregated duty cycle management
-     */
-    uint16_t aggregated_duty_cycle;
-
     /*!
      * LoRaMac ADR control status
      */
@@ -234,6 +236,9 @@ typedef struct {
 
 /*!
  * LoRaMAC multicast channel parameter.
+ *
+ * The parameters are copied into the MAC's multicast group table when the
+ * group is linked, the structure need not outlive the call.
  */
 typedef struct multicast_params_s {
     /*!
@@ -253,9 +258,11 @@ typedef struct multicast_params_s {
      */
     uint32_t dl_frame_counter;
     /*!
-     * A reference pointer to the next multicast channel parameters in the list.
+     * McGroupID, 0 - 3, given by the network when it set the group up.
+     * Fragmentation sessions take the group's fragments if their
+     * McGroupBitMask has its bit.
      */
-    struct multicast_params_s *next;
+    uint8_t group_id;
 } multicast_params_t;
 
 /*!
@@ -339,7 +346,27 @@ typedef enum {
     /*!
      * DlChannelAns
      */
-    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A
+    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A,
+    /*!
+     * DeviceTimeReq
+     */
+    MOTE_MAC_DEVICE_TIME_REQ         = 0x0D,
+    /*!
+     * PingSlotInfoReq
+     */
+    MOTE_MAC_PING_SLOT_INFO_REQ      = 0x10,
+    /*!
+     * PingSlotChannelAns
+     */
+    MOTE_MAC_PING_SLOT_CHANNEL_ANS   = 0x11,
+    /*!
+     * BeaconTimingReq
+     */
+    MOTE_MAC_BEACON_TIMING_REQ       = 0x12,
+    /*!
+     * BeaconFreqAns
+     */
+    MOTE_MAC_BEACON_FREQ_ANS         = 0x13
 } mote_mac_cmds_t;
 
 /*!
@@ -384,6 +411,26 @@ typedef enum {
      * DlChannelReq
      */
     SRV_MAC_DL_CHANNEL_REQ           = 0x0A,
+    /*!
+     * DeviceTimeAns
+     */
+    SRV_MAC_DEVICE_TIME_ANS          = 0x0D,
+    /*!
+     * PingSlotInfoAns
+     */
+    SRV_MAC_PING_SLOT_INFO_ANS       = 0x10,
+    /*!
+     * PingSlotChannelReq
+     */
+    SRV_MAC_PING_SLOT_CHANNEL_REQ    = 0x11,
+    /*!
+     * BeaconTimingAns
+     */
+    SRV_MAC_BEACON_TIMING_ANS        = 0x12,
+    /*!
+     * BeaconFreqReq
+     */
+    SRV_MAC_BEACON_FREQ_REQ          = 0x13,
 } server_mac_cmds_t;
 
 /*!
@@ -621,9 +668,10 @@ typedef struct {
  */
 typedef struct {
     /*!
-     * True if an MCPS indication was pending
+     * A pointer to the received data stream. Points into the reception
+     * buffer owned by the stack, where the frame was decrypted in place.
      */
-    bool pending;
+    const uint8_t *buffer;
     /*!
      * MCPS-Indication type.
      */
@@ -633,63 +681,67 @@ typedef struct {
      */
     loramac_event_info_status_t status;
     /*!
-     * Multicast.
-     */
-    uint8_t multicast;
-    /*!
-     * The application port.
+     * The receive window.
+     *
+     * [0: Rx window 1, 1: Rx window 2]
      */
-    uint8_t port;
+    rx_slot_t rx_slot;
     /*!
-     * The downlink datarate.
+     * The downlink counter value for the received frame.
      */
-    uint8_t rx_datarate;
+    uint32_t dl_frame_counter;
     /*!
-     * Frame pending status.
+     * The downlink channel
      */
-    uint8_t fpending_status;
+    uint32_t channel;
     /*!
-     * A pointer to the received data stream.
+     * The time on air of the received frame.
      */
-    const uint8_t *buffer;
+    lorawan_time_t rx_toa;
     /*!
      * The size of the received data stream.
      */
     uint16_t buffer_size;
-    /*!
-     * Indicates, if data is available.
-     */
-    bool is_data_recvd;
     /*!
      * The RSSI of the received packet.
      */
     int16_t rssi;
     /*!
-     * The SNR of the received packet.
+     * True if an MCPS indication was pending
      */
-    int8_t snr;
+    bool pending;
     /*!
-     * The receive window.
-     *
-     * [0: Rx window 1, 1: Rx window 2]
+     * Multicast.
      */
-    rx_slot_t rx_slot;
+    uint8_t multicast;
     /*!
-     * Set if an acknowledgement was received.
+     * McGroupID of the multicast group the frame was sent to.
      */
-    bool is_ack_recvd;
+    uint8_t multicast_group;
     /*!
-     * The downlink counter value for the received frame.
+     * The application port.
      */
-    uint32_t dl_frame_counter;
+    uint8_t port;
     /*!
-     * The downlink channel
+     * The downlink datarate.
      */
-    uint32_t channel;
+    uint8_t rx_datarate;
     /*!
-     * The time on air of the received frame.
+     * Frame pending status.
      */
-    lorawan_time_t rx_toa;
+    uint8_t fpending_status;
+    /*!
+     * Indicates, if data is available.
+     */
+    bool is_data_recvd;
+    /*!
+     * The SNR of the received packet.
+     */
+    int8_t snr;
+    /*!
+     * Set if an acknowledgement was received.
+     */
+    bool is_ack_recvd;
 } loramac_mcps_indication_t;
 
 /*!
@@ -789,10 +841,6 @@ typedef struct {
  * LoRaMAC MLME-Confirm primitive.
  */
 typedef struct {
-    /*!
-     * Indicates if a request is pending or not
-     */
-    bool pending;
     /*!
      * The previously performed MLME-Request. i.e., the request type
      * for which the confirmation is being generated
@@ -806,6 +854,10 @@ typedef struct {
      * The transmission time on air of the frame.
      */
     lorawan_time_t tx_toa;
+    /*!
+     * Indicates if a request is pending or not
+     */
+    bool pending;
     /*!
      * The demodulation margin. Contains the link margin [dB] of the last LinkCheckReq
      * successfully received.
@@ -855,21 +907,27 @@ typedef enum device_states {
  */
 typedef struct {
 
+    /**
+     * Message type
+     */
+    mcps_type_t type;
+    /** Payload size.
+     *
+     * The size of the frame payload.
+     */
+    uint16_t f_buffer_size;
+    /**
+     * Pending data size
+     */
+    uint16_t pending_size;
     /**
      * TX Ongoing flag
      */
     bool tx_ongoing;
-
     /**
      * Application Port Number
      */
     uint8_t port;
-
-    /**
-     * Message type
-     */
-    mcps_type_t type;
-
     /*!
      * Frame port field. Must be set if the payload is not empty. Use the
      * application-specific frame port values: [1...223].
@@ -877,7 +935,6 @@ typedef struct {
      * LoRaWAN Specification V1.0.2, chapter 4.3.2.
      */
     uint8_t fport;
-
     /*!
      * Uplink datarate, if ADR is off.
      */
@@ -913,25 +970,55 @@ typedef struct {
      * range is 1:15. Data rates will NOT be adapted according to chapter 18.4.
      */
     uint8_t nb_trials;
-
     /** Payload data
      *
      * Base pointer to the buffer
      */
     uint8_t f_buffer[MBED_CONF_LORA_TX_MAX_SIZE];
+} loramac_tx_message_t;
 
-    /** Payload size.
-     *
-     * The size of the frame payload.
+/** uplink_queue_entry_t
+ *
+ * A message waiting in the uplink queue of the stack.
+ */
+typedef struct {
+    /**
+     * Application payload
      */
-    uint16_t f_buffer_size;
-
+    uint8_t data[MBED_CONF_LORA_TX_MAX_SIZE];
     /**
-     * Pending data size
+     * Size of the payload
      */
-    uint16_t pending_size;
-
-} loramac_tx_message_t;
+    uint16_t length;
+    /**
+     * Identifier reported back to the application
+     */
+    int16_t id;
+    /**
+     * Application port
+     */
+    uint8_t port;
+    /**
+     * Message flags, MSG_UNCONFIRMED_FLAG, MSG_CONFIRMED_FLAG or MSG_PROPRIETARY_FLAG
+     */
+    uint8_t flags;
+    /**
+     * Messages with a higher priority are sent first
+     */
+    uint8_t priority;
+    /**
+     * Indicates if the entry is taken
+     */
+    bool in_use;
+    /**
+     * Order of arrival, breaks ties between equal priorities
+     */
+    uint32_t seq;
+    /**
+     * Time after which the message is discarded if not yet sent, 0 if none
+     */
+    lorawan_time_t expiry;
+} uplink_queue_entry_t;
 
 /** lora_mac_rx_message_type_t
  *
@@ -958,13 +1045,60 @@ typedef union {
  * A structure representing a structure for an RX message.
  */
 typedef struct {
-    bool receive_ready;
     rx_msg_type type;
     rx_message_u msg;
     uint16_t pending_size;
     uint16_t prev_read_size;
+    bool receive_ready;
 } loramac_rx_message_t;
 
+/** rx_frame_state_t
+ *
+ * Life cycle of a slot in the RX frame ring.
+ */
+typedef enum {
+    RX_FRAME_FREE = 0,  /**< Slot can take a new frame */
+    RX_FRAME_PENDING,   /**< Frame copied from the radio, waiting to be processed */
+    RX_FRAME_HELD       /**< Decrypted payload is held by the application */
+} rx_frame_state_t;
+
+/** rx_frame_slot_t
+ *
+ * A slot in the RX frame ring. The radio interrupt copies a frame in here
+ * together with its reception parameters, and the frame is decrypted in
+ * place later on when the event queue gets to it.
+ */
+typedef struct {
+    /**
+     * Raw frame, decrypted in place while being processed
+     */
+    uint8_t payload[LORAMAC_PHY_MAXPAYLOAD];
+    /**
+     * Size of the frame
+     */
+    uint16_t size;
+    /**
+     * RSSI of the frame
+     */
+    int16_t rssi;
+    /**
+     * SNR of the frame
+     */
+    int8_t snr;
+    /**
+     * Slot state, updated from interrupt context, see rx_frame_state_t
+     */
+    volatile uint8_t state;
+    /**
+     * Order of arrival
+     */
+    uint32_t seq;
+    /**
+     * Time of reception, taken in the radio interrupt
+     */
+    lorawan_time_t timestamp;
+} rx_frame_slot_t;
+
 /** LoRaWAN session
  *
  * A structure for keeping session details.
@@ -992,29 +1126,135 @@ typedef struct lorawan_session {
 } lorawan_session_t;
 
 /*!
- * The parameter structure for the function for regional rx configuration.
+ * Identifies a session snapshot in non-volatile storage
+ */
+#define LORAWAN_SESSION_SNAPSHOT_MAGIC      0x4C57534EUL
+
+/*!
+ * Layout version of lorawan_session_snapshot_t, bump on any change
+ */
+#define LORAWAN_SESSION_SNAPSHOT_VERSION    3
+
+/*!
+ * Session snapshot header
+ *
+ * Written to non-volatile storage so that the device can resume its session
+ * after a reset instead of joining again. The header is followed by the PHY
+ * channel list, as the PHY keeps it in RAM and empty for fixed channel plans,
+ * the alternative RX1 frequencies and the channel mask, 'body_size' bytes in
+ * total.
  */
 typedef struct {
     /*!
-     * Type of modulation used (LoRa or FSK)
+     * LORAWAN_SESSION_SNAPSHOT_MAGIC
      */
-    uint8_t modem_type;
+    uint32_t magic;
     /*!
-     * The RX channel.
+     * LORAWAN_SESSION_SNAPSHOT_VERSION
      */
-    uint8_t channel;
+    uint16_t version;
     /*!
-     * The RX datarate index.
+     * Size of the channel list, RX1 frequencies and mask following the header
      */
-    uint8_t datarate;
+    uint16_t body_size;
     /*!
-     * The RX bandwidth.
+     * CRC-32 over the header, with this field set to 0, and the body
      */
-    uint8_t bandwidth;
+    uint32_t crc;
     /*!
-     * The RX datarate offset.
+     * Device address
      */
-    int8_t dr_offset;
+    uint32_t dev_addr;
+    /*!
+     * Network ID
+     */
+    uint32_t net_id;
+    /*!
+     * Network session key
+     */
+    uint8_t nwk_skey[16];
+    /*!
+     * Application session key
+     */
+    uint8_t app_skey[16];
+    /*!
+     * Uplink frame counter
+     */
+    uint32_t ul_frame_counter;
+    /*!
+     * Downlink frame counter
+     */
+    uint32_t dl_frame_counter;
+    /*!
+     * ADR acknowledgement counter
+     */
+    uint32_t adr_ack_counter;
+    /*!
+     * Receive delay 1
+     */
+    uint32_t recv_delay1;
+    /*!
+     * Receive delay 2
+     */
+    uint32_t recv_delay2;
+    /*!
+     * Maximum EIRP
+     */
+    float max_eirp;
+    /*!
+     * RX2 channel
+     */
+    rx2_channel_params rx2_channel;
+    /*!
+     * Current datarate
+     */
+    int8_t channel_data_rate;
+    /*!
+     * Current TX power
+     */
+    int8_t channel_tx_power;
+    /*!
+     * Number of repetitions of unconfirmed uplinks
+     */
+    uint8_t nb_trans;
+    /*!
+     * RX1 datarate offset
+     */
+    uint8_t rx1_dr_offset;
+    /*!
+     * Uplink dwell time setting
+     */
+    uint8_t uplink_dwell_time;
+    /*!
+     * Downlink dwell time setting
+     */
+    uint8_t downlink_dwell_time;
+    /*!
+     * ADR enabled
+     */
+    uint8_t adr_on;
+    /*!
+     * Connection type, LORAWAN_CONNECTION_OTAA or LORAWAN_CONNECTION_ABP
+     */
+    uint8_t connect_type;
+    /*!
+     * Number of entries in the channel list
+     */
+    uint8_t channel_count;
+    /*!
+     * Number of 16-bit words in the channel mask
+     */
+    uint8_t mask_size;
+    /*!
+     * Region of the channels, a lorawan_region_t
+     */
+    uint8_t region;
+} lorawan_session_snapshot_t;
+
+/*!
+ * The parameter structure for the function for regional rx configuration.
+ */
+typedef struct {
     /*!
      * The RX frequency.
      */
@@ -1031,6 +1271,30 @@ typedef struct {
      * The RX window offset
      */
     int32_t window_offset;
+    /*!
+     * Sets the RX window.
+     */
+    rx_slot_t rx_slot;
+    /*!
+     * Type of modulation used (LoRa or FSK)
+     */
+    uint8_t modem_type;
+    /*!
+     * The RX channel.
+     */
+    uint8_t channel;
+    /*!
+     * The RX datarate index.
+     */
+    uint8_t datarate;
+    /*!
+     * The RX bandwidth.
+     */
+    uint8_t bandwidth;
+    /*!
+     * The RX datarate offset.
+     */
+    int8_t dr_offset;
     /*!
      * The downlink dwell time.
      */
@@ -1043,10 +1307,6 @@ typedef struct {
      * Set to true, if RX should be continuous.
      */
     bool is_rx_continuous;
-    /*!
-     * Sets the RX window.
-     */
-    rx_slot_t rx_slot;
 } rx_config_params_t;
 
 /*!
@@ -1139,147 +1399,111 @@ typedef struct {
      * Holds the type of current Receive window slot
      */
     rx_slot_t rx_slot;
-
     /*!
      * Indicates if the node is connected to a private or public network
      */
-    bool is_nwk_public;
-
+    bool is_nwk_public : 1;
     /*!
      * Indicates if the node supports repeaters
      */
-    bool is_repeater_supported;
-
+    bool is_repeater_supported : 1;
     /*!
      * Used for test purposes. Disables the opening of the reception windows.
      */
-    bool is_rx_window_enabled;
-
+    bool is_rx_window_enabled : 1;
     /*!
      * Indicates if the MAC layer has already joined a network.
      */
-    bool is_nwk_joined;
-
+    bool is_nwk_joined : 1;
     /*!
      * If the node has sent a FRAME_TYPE_DATA_CONFIRMED_UP this variable indicates
      * if the nodes needs to manage the server acknowledgement.
      */
-    bool is_node_ack_requested;
-
+    bool is_node_ack_requested : 1;
     /*!
      * If the server has sent a FRAME_TYPE_DATA_CONFIRMED_DOWN this variable indicates
      * if the ACK bit must be set for the next transmission
      */
-    bool is_srv_ack_requested;
-
+    bool is_srv_ack_requested : 1;
     /*!
      * Enables/Disables duty cycle management (Test only)
      */
-    bool is_dutycycle_on;
-
+    bool is_dutycycle_on : 1;
     /*!
      * Set to true, if the last uplink was a join request
      */
-    bool is_last_tx_join_request;
-
+    bool is_last_tx_join_request : 1;
     /*!
      * Indicates if the AckTimeout timer has expired or not
      */
-    bool is_ack_retry_timeout_expired;
-
+    bool is_ack_retry_timeout_expired : 1;
     /*!
      * Current channel index
      */
     uint8_t channel;
-
     /*!
      * Current channel index
      */
     uint8_t last_channel_idx;
-
     /*!
      * Uplink messages repetitions counter
      */
     uint8_t ul_nb_rep_counter;
-
-    /*!
-     * TX buffer used for encrypted outgoing frames
-     */
-    uint8_t tx_buffer[LORAMAC_PHY_MAXPAYLOAD];
-
-    /*!
-     * Length of TX buffer
-     */
-    uint16_t tx_buffer_len;
-
-    /*!
-     * Used for storing decrypted RX data.
-     */
-    uint8_t rx_buffer[LORAMAC_PHY_MAXPAYLOAD];
-
-    /*!
-     * Length of the RX buffer
-     */
-    uint8_t rx_buffer_len;
-
     /*!
      * Number of trials to get a frame acknowledged
      */
     uint8_t max_ack_timeout_retries;
-
     /*!
      * Number of trials to get a frame acknowledged
      */
     uint8_t ack_timeout_retry_counter;
-
     /*!
      * Maximum number of trials for the Join Request
      */
     uint8_t max_join_request_trials;
-
     /*!
      * Number of trials for the Join Request
      */
     uint8_t join_request_trial_counter;
-
     /*!
-     * Mac keys
+     * TX buffer used for encrypted outgoing frames
      */
-    loramac_keys keys;
-
+    uint8_t tx_buffer[LORAMAC_PHY_MAXPAYLOAD];
+    /*!
+     * Length of TX buffer
+     */
+    uint16_t tx_buffer_len;
     /*!
      * Device nonce is a random value extracted by issuing a sequence of RSSI
      * measurements
      */
     uint16_t dev_nonce;
-
+    /*!
+     * Mac keys
+     */
+    loramac_keys keys;
     /*!
      * Network ID ( 3 bytes )
      */
     uint32_t net_id;
-
     /*!
      * Mote Address
      */
     uint32_t dev_addr;
-
     /*!
      * LoRaMAC frame counter. Each time a packet is sent the counter is incremented.
      * Only the 16 LSB bits are sent
      */
     uint32_t ul_frame_counter;
-
     /*!
      * LoRaMAC frame counter. Each time a packet is received the counter is incremented.
      * Only the 16 LSB bits are received
      */
     uint32_t dl_frame_counter;
-
     /*!
      * Counts the number of missed ADR acknowledgements
      */
     uint32_t adr_ack_counter;
-
     /*!
      * LoRaMac reception windows delay
      * \remark normal frame: RxWindowXDelay = ReceiveDelayX - Offset
@@ -1287,28 +1511,19 @@ typedef struct {
      */
     uint32_t rx_window1_delay;
     uint32_t rx_window2_delay;
-
     /*!
      * Timer objects and stored values
      */
     lorawan_timers timers;
-
     /*!
      * LoRaMac parameters
      */
     lora_mac_system_params_t sys_params;
-
     /*!
      * Receive Window configurations for PHY layer
      */
     rx_config_params_t rx_window1_config;
     rx_config_params_t rx_window2_config;
-
-    /*!
-     * Multicast channels linked list
-     */
-    multicast_params_t *multicast_channels;
-
 } loramac_protocol_params;
 
 #endif /* LORAWAN_SYSTEM_LORAWAN_DATA_STRUCTURES_H_ */
@@ -0,0 +1,78 @@
+/**
+ * @file lorawan_tlv.cpp
+ *
+ * @brief Compact TLV framing for aggregated uplink records
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "lorawan_tlv.h"
+
+uint16_t lorawan_tlv_encoded_size(uint8_t length)
+{
+    if (length == 0 || length > LORAWAN_TLV_MAX_SHORT_LENGTH) {
+        return 2 + length;
+    }
+
+    return 1 + length;
+}
+
+bool lorawan_tlv_encode(uint8_t *buffer, uint16_t size, uint16_t *offset,
+                        uint8_t tag, const uint8_t *value, uint8_t length)
+{
+    uint16_t pos = *offset;
+
+    if (tag > LORAWAN_TLV_MAX_TAG) {
+        return false;
+    }
+
+    if (pos + lorawan_tlv_encoded_size(length) > size) {
+        return false;
+    }
+
+    if (length == 0 || length > LORAWAN_TLV_MAX_SHORT_LENGTH) {
+        buffer[pos++] = tag << 4;
+        buffer[pos++] = length;
+    } else {
+        buffer[pos++] = (tag << 4) | length;
+    }
+
+    if (length > 0) {
+        memcpy(&buffer[pos], value, length);
+        pos += length;
+    }
+
+    *offset = pos;
+    return true;
+}
+
+int lorawan_tlv_decode(const uint8_t *buffer, uint16_t size, uint16_t *offset,
+                       lorawan_tlv_record_t *record)
+{
+    uint16_t pos = *offset;
+
+    if (pos >= size) {
+        return 0;
+    }
+
+    record->tag = buffer[pos] >> 4;
+    record->length = buffer[pos++] & 0x0F;
+
+    if (record->length == 0) {
+        if (pos >= size) {
+            return -1;
+        }
+        record->length = buffer[pos++];
+    }
+
+    if (pos + record->length > size) {
+        return -1;
+    }
+
+    record->value = &buffer[pos];
+    *offset = pos + record->length;
+
+    return 1;
+}
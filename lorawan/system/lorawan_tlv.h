@@ -0,0 +1,98 @@
+/**
+ * @file lorawan_tlv.h
+ *
+ * @brief Compact TLV framing for aggregated uplink records
+ *
+ * Several small application records are packed into a single FRMPayload.
+ * Each record is encoded as a header byte followed by the value:
+ *
+ *      7     4 3     0
+ *     +-------+-------+----------------+-----------------+
+ *     |  tag  |  len  | [length byte]  |      value      |
+ *     +-------+-------+----------------+-----------------+
+ *
+ * 'tag' identifies the record type (0 - 15). 'len' carries the length of the
+ * value (1 - 15). If 'len' is 0, the length is carried in the byte following
+ * the header instead (0 - 255). A typical 3 - 8 byte sensor reading thus
+ * costs a single byte of framing.
+ *
+ * This file has no dependency on the rest of the stack, so that the very same
+ * decoder can be built into the network backend.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SYS_TLV_H__
+#define MBED_LORAWAN_SYS_TLV_H__
+
+#include <stdint.h>
+
+/**
+ * Highest tag value a record can carry
+ */
+#define LORAWAN_TLV_MAX_TAG                 0x0F
+
+/**
+ * Longest value which fits in the header byte
+ */
+#define LORAWAN_TLV_MAX_SHORT_LENGTH        0x0F
+
+/**
+ * A record extracted from a packed payload
+ */
+typedef struct {
+    /**
+     * Record type
+     */
+    uint8_t tag;
+    /**
+     * Length of the value
+     */
+    uint8_t length;
+    /**
+     * Points to the value inside the packed payload
+     */
+    const uint8_t *value;
+} lorawan_tlv_record_t;
+
+/** Size of a record once encoded
+ *
+ * @param length        Length of the value
+ *
+ * @return              Number of bytes the record takes in a packed payload
+ */
+uint16_t lorawan_tlv_encoded_size(uint8_t length);
+
+/** Appends a record to a packed payload
+ *
+ * @param buffer        Packed payload
+ * @param size          Total size of 'buffer'
+ * @param offset        [in/out] Current fill level of 'buffer', advanced past
+ *                      the new record on success
+ * @param tag           Record type, 0 - LORAWAN_TLV_MAX_TAG
+ * @param value         Record value
+ * @param length        Length of the value
+ *
+ * @return              true if the record was appended, false if it does not
+ *                      fit or the tag is out of range
+ */
+bool lorawan_tlv_encode(uint8_t *buffer, uint16_t size, uint16_t *offset,
+                        uint8_t tag, const uint8_t *value, uint8_t length);
+
+/** Extracts the next record from a packed payload
+ *
+ * Start with *offset set to 0 and call repeatedly until it returns 0.
+ *
+ * @param buffer        Packed payload
+ * @param size          Size of the packed payload
+ * @param offset        [in/out] Read position, advanced past the record
+ * @param record        [out] The record, pointing into 'buffer'
+ *
+ * @return              1 if a record was extracted, 0 at the end of the payload,
+ *                      -1 if the payload is malformed
+ */
+int lorawan_tlv_decode(const uint8_t *buffer, uint16_t size, uint16_t *offset,
+                       lorawan_tlv_record_t *record);
+
+#endif /* MBED_LORAWAN_SYS_TLV_H__ */
@@ -48,30 +48,52 @@
 #define MBED_CONF_APP_LORA_SPI_SCLK                                           12                                                                                                // set by application[EFM32GG11]
 #define MBED_CONF_APP_LORA_TCXO                                               NC                                                                                                 // set by application[EFM32GG11]
 #define MBED_CONF_APP_LORA_TXCTL                                              NC                                                                                                 // set by application[EFM32GG11]
+#define MBED_CONF_EVENTS_STATIC_MEMORY                                        1                                                                                                  // set by application[*]
 #define MBED_CONF_LORA_ADR_ON                                                 1                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_APPLICATION_EUI                                        { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10 }                                                 // set by application[*]
 #define MBED_CONF_LORA_APPLICATION_KEY                                        { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10 } // set by application[*]
 #define MBED_CONF_LORA_APPSKEY                                                { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10 }   // set by library:lora
 #define MBED_CONF_LORA_APP_PORT                                               15                                                                                                 // set by library:lora
+#define MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE                              10000                                                                                              // set by library:lora
 #define MBED_CONF_LORA_AUTOMATIC_UPLINK_MESSAGE                               1                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_BEACONLESS_PERIOD                                      7200                                                                                               // set by library:lora
+#define MBED_CONF_LORA_CLASS_B_CLOCK_DRIFT                                    30                                                                                                 // set by library:lora
+#define MBED_CONF_LORA_CLASS_C                                                1                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_CONTINUOUS_WAVE                                        1                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS                                   1                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_DEVICE_ADDRESS                                         0x00000010                                                                                         // set by library:lora
 #define MBED_CONF_LORA_DEVICE_EUI                                             { 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0xfe, 0x69 }                                                 // set by application[*]
 #define MBED_CONF_LORA_DEVICE_SELECT                                          0
 #define MBED_CONF_LORA_DOWNLINK_PREAMBLE_LENGTH                               5                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_DUTY_CYCLE_ON                                          1                                                                                                  // set by application[*]
 #define MBED_CONF_LORA_DUTY_CYCLE_ON_JOIN                                     1                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_FCNT_JOURNAL_BLOCK                                     32                                                                                                 // set by library:lora
+#define MBED_CONF_LORA_FRAG_MAX_FRAGMENTS                                     2048                                                                                               // set by library:lora
+#define MBED_CONF_LORA_FRAG_MAX_REDUNDANCY                                    256                                                                                                // set by library:lora
+#define MBED_CONF_LORA_FRAG_MAX_SIZE                                          232                                                                                                // set by library:lora
+#define MBED_CONF_LORA_FRAG_PORT                                              201                                                                                                // set by library:lora
 #define MBED_CONF_LORA_FREQ_SELECT                                            0
 #define MBED_CONF_LORA_FSB_MASK                                               {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x00FF}                                                           // set by library:lora
 #define MBED_CONF_LORA_FSB_MASK_CHINA                                         {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF}                                                   // set by library:lora
+#define MBED_CONF_LORA_FSK                                                    1                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_LBT_ON                                                 0                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_MAX_SYS_RX_ERROR                                       100                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_MIN_SYS_RX_ERROR                                       10                                                                                                 // set by library:lora
+#define MBED_CONF_LORA_MULTICAST_GROUPS                                       8                                                                                                    // set by library:lora
+#define MBED_CONF_LORA_MULTI_REGION                                           0                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_NB_TRIALS                                              12                                                                                                 // set by library:lora
 #define MBED_CONF_LORA_NWKSKEY                                                { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10 }   // set by library:lora
 #define MBED_CONF_LORA_OVER_THE_AIR_ACTIVATION                                1                                                                                                  // set by application[*]
 #define MBED_CONF_LORA_PHY                                                    EU868                                                                                              // set by application[*]
+#define MBED_CONF_LORA_PHY_STATIC_DISPATCH                                    1                                                                                                  // set by application[*]
+#define MBED_CONF_LORA_PING_SLOT_PERIODICITY                                  7                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_PUBLIC_NETWORK                                         0                                                                                                  // set by application[*]
+#define MBED_CONF_LORA_RX_RING_SLOTS                                          2                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_RX_WINDOW_MARGIN                                       4                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_STATIC_MEMORY                                          1                                                                                                  // set by application[*]
 #define MBED_CONF_LORA_TX_MAX_SIZE                                            255                                                                                                 // set by library:lora
 #define MBED_CONF_LORA_UPLINK_PREAMBLE_LENGTH                                 8                                                                                                  // set by library:lora
+#define MBED_CONF_LORA_UPLINK_QUEUE_SIZE                                      4                                                                                                  // set by library:lora
 #define MBED_CONF_LORA_WAKEUP_TIME                                            5                                                                                                  // set by library:lora
 #define MBED_CONF_SX126X_LORA_DRIVER_BOOST_RX                                 0                                                                                                  // set by library:SX126X-lora-driver
 #define MBED_CONF_SX126X_LORA_DRIVER_BUFFER_SIZE                              255                                                                                                // set by library:SX126X-lora-driver
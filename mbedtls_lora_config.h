@@ -35,6 +35,10 @@
 // Other LoRa applications might need different configurations.
 #define MBEDTLS_AES_FEWER_TABLES
 
+// The tables in flash rather than generated in RAM at the first key set,
+// with 2 KB of the stack of the LoRa task
+#define MBEDTLS_AES_ROM_TABLES
+
 #undef MBEDTLS_GCM_C
 #undef MBEDTLS_CHACHA20_C
 #undef MBEDTLS_CHACHAPOLY_C
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "platform/console_ring.h"
+#include "platform/mbed_critical.h"
+
+#if (CONSOLE_RING_SIZE & (CONSOLE_RING_SIZE - 1)) != 0 || CONSOLE_RING_SIZE < 64
+#error "CONSOLE_RING_SIZE must be a power of two, 64 at least"
+#endif
+
+#define CONSOLE_RING_MASK       (CONSOLE_RING_SIZE - 1)
+
+/* Longest line telling of dropped bytes */
+#define CONSOLE_RING_MARKER_MAX 48
+
+static char console_ring[CONSOLE_RING_SIZE];
+
+/* Bytes written and taken so far, the ring index is their low bits. The head
+ * is moved by the writers in a critical section, the tail by the reader. */
+static uint32_t console_head;
+static uint32_t console_tail;
+
+/* Dropped since the last write that fitted, and since the start */
+static uint32_t console_dropped_pending;
+static uint32_t console_dropped;
+
+static uint32_t console_peak;
+
+static bool (*console_wait)(void);
+
+void console_ring_set_wait(bool (*wait)(void))
+{
+    console_wait = wait;
+}
+
+/**
+ * Formats the line telling of dropped bytes
+ */
+static uint32_t console_marker(char *marker, uint32_t dropped)
+{
+    static const char prefix[] = "\r\n[console: ";
+    static const char suffix[] = " bytes dropped]\r\n";
+    char digits[10];
+    uint32_t nb_digits = 0;
+    uint32_t length = 0;
+
+    do {
+        digits[nb_digits++] = '0' + dropped % 10;
+        dropped /= 10;
+    } while (dropped);
+
+    memcpy(marker, prefix, sizeof(prefix) - 1);
+    length += sizeof(prefix) - 1;
+    while (nb_digits) {
+        marker[length++] = digits[--nb_digits];
+    }
+    memcpy(&marker[length], suffix, sizeof(suffix) - 1);
+    length += sizeof(suffix) - 1;
+
+    return length;
+}
+
+/**
+ * Copies bytes at the head, which is not moved on
+ */
+static void console_put(uint32_t head, const char *data, uint32_t size)
+{
+    uint32_t index = head & CONSOLE_RING_MASK;
+    uint32_t first = CONSOLE_RING_SIZE - index;
+
+    if (first > size) {
+        first = size;
+    }
+
+    memcpy(&console_ring[index], data, first);
+    memcpy(console_ring, data + first, size - first);
+}
+
+size_t console_ring_write(const char *data, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size) {
+        char marker[CONSOLE_RING_MARKER_MAX];
+        uint32_t marker_length = 0;
+
+        core_util_critical_section_enter();
+
+        uint32_t head = console_head;
+        uint32_t space = CONSOLE_RING_SIZE - (head - __atomic_load_n(&console_tail, __ATOMIC_ACQUIRE));
+        uint32_t wanted = size - written;
+
+        if (console_dropped_pending) {
+            marker_length = console_marker(marker, console_dropped_pending);
+        }
+
+        // whole, unless waiting for the rest is allowed
+        uint32_t needed = console_wait ? 1 : wanted;
+
+        if (marker_length + needed <= space) {
+            uint32_t chunk = space - marker_length;
+            if (chunk > wanted) {
+                chunk = wanted;
+            }
+
+            console_put(head, marker, marker_length);
+            console_put(head + marker_length, data + written, chunk);
+            head += marker_length + chunk;
+            __atomic_store_n(&console_head, head, __ATOMIC_RELEASE);
+
+            console_dropped_pending = 0;
+            written += chunk;
+
+            uint32_t used = CONSOLE_RING_SIZE - space + marker_length + chunk;
+            if (used > console_peak) {
+                __atomic_store_n(&console_peak, used, __ATOMIC_RELAXED);
+            }
+
+            core_util_critical_section_exit();
+            continue;
+        }
+
+        core_util_critical_section_exit();
+
+        if (console_wait && console_wait()) {
+            continue;
+        }
+
+        core_util_critical_section_enter();
+        console_dropped_pending += wanted;
+        __atomic_store_n(&console_dropped, console_dropped + wanted, __ATOMIC_RELAXED);
+        core_util_critical_section_exit();
+        break;
+    }
+
+    return written;
+}
+
+size_t console_ring_peek(const char **data)
+{
+    uint32_t tail = console_tail;
+    uint32_t used = __atomic_load_n(&console_head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t index = tail & CONSOLE_RING_MASK;
+
+    *data = &console_ring[index];
+
+    return used < CONSOLE_RING_SIZE - index ? used : CONSOLE_RING_SIZE - index;
+}
+
+void console_ring_consume(size_t size)
+{
+    __atomic_store_n(&console_tail, console_tail + size, __ATOMIC_RELEASE);
+}
+
+size_t console_ring_drain(size_t (*sink)(const char *data, size_t size))
+{
+    size_t total = 0;
+    const char *data;
+    size_t size;
+
+    while ((size = console_ring_peek(&data)) != 0) {
+        size_t taken = sink(data, size);
+
+        console_ring_consume(taken);
+        total += taken;
+
+        if (taken < size) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+uint32_t console_ring_get_dropped(void)
+{
+    return __atomic_load_n(&console_dropped, __ATOMIC_RELAXED);
+}
+
+uint32_t console_ring_get_peak(void)
+{
+    return __atomic_load_n(&console_peak, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __MBED_CONSOLE_RING_H__
+#define __MBED_CONSOLE_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \addtogroup platform */
+/** @{*/
+/**
+ * \defgroup platform_console_ring console transmit ring
+ * @{
+ *
+ * Buffered console output. Writers copy their bytes to a RAM ring in a
+ * critical section and return; a single reader, a low priority task or the
+ * completion of a DMA transfer, moves them on to the port when it has the
+ * time to.
+ *
+ * A write that does not fit is dropped whole, so that lines are never
+ * spliced, unless a wait function is set and lets the writer wait for room.
+ * The bytes dropped are counted, and the next write that fits is preceded
+ * in the ring by a line telling how many were lost at that point.
+ */
+
+/**
+ * Bytes of the ring, a power of two
+ */
+#ifndef CONSOLE_RING_SIZE
+#define CONSOLE_RING_SIZE       1024
+#endif
+
+/** Sets what a writer does when the ring is full
+ *
+ * @param wait      Waits for the reader to make room, returning true, or
+ *                  returns false at once if the writer cannot wait, e.g. in
+ *                  an interrupt; NULL to drop
+ */
+void console_ring_set_wait(bool (*wait)(void));
+
+/** Writes bytes to the ring
+ *
+ * @param data      Bytes to write
+ * @param size      Number of bytes
+ *
+ * @return          Number of bytes written, the rest was dropped
+ */
+size_t console_ring_write(const char *data, size_t size);
+
+/** Gets the oldest bytes of the ring, from the single reader
+ *
+ * The bytes are contiguous, which is the first part of what is pending when
+ * the ring wraps. They stay in the ring until console_ring_consume().
+ *
+ * @param data      Set to the first byte
+ *
+ * @return          Number of bytes, 0 if the ring is empty
+ */
+size_t console_ring_peek(const char **data);
+
+/** Frees the bytes given by console_ring_peek() that were output
+ *
+ * @param size      Number of bytes, at most what console_ring_peek() gave
+ */
+void console_ring_consume(size_t size);
+
+/** Outputs what the ring holds, from the single reader
+ *
+ * @param sink      Outputs bytes, returning how many it took; the drain
+ *                  stops when it takes fewer than it is given
+ *
+ * @return          Number of bytes output
+ */
+size_t console_ring_drain(size_t (*sink)(const char *data, size_t size));
+
+/** Number of bytes dropped as the ring was full, since the start
+ */
+uint32_t console_ring_get_dropped(void);
+
+/** Most bytes the ring has held, to size it
+ */
+uint32_t console_ring_get_peak(void);
+
+/** @}*/
+/** @}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,14 +23,20 @@
 
 static uint32_t critical_section_reentrancy_counter = 0;
 
+// interrupt state on entry to the outermost critical section
+static CORE_irqState_t critical_section_irq_state;
+
 void core_util_critical_section_enter(void)
 {
-	CORE_DECLARE_IRQ_STATE;
-    CORE_ENTER_CRITICAL();
+    CORE_irqState_t irq_state = CORE_EnterCritical();
 
     // If the reentrancy counter overflows something has gone badly wrong.
     MBED_ASSERT(critical_section_reentrancy_counter < UINT32_MAX);
 
+    if (critical_section_reentrancy_counter == 0) {
+        critical_section_irq_state = irq_state;
+    }
+
     ++critical_section_reentrancy_counter;
 }
 
@@ -45,7 +51,6 @@ void core_util_critical_section_exit(void)
     --critical_section_reentrancy_counter;
 
     if (critical_section_reentrancy_counter == 0) {
-    	CORE_DECLARE_IRQ_STATE;
-    	CORE_EXIT_CRITICAL();
+        CORE_ExitCritical(critical_section_irq_state);
     }
 }
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "platform/profile.h"
+
+#if PROFILE_ENABLED
+
+#if defined(__arm__)
+#include "platform/mbed_critical.h"
+#endif
+
+static const char *profile_names[PROFILE_ZONES] = {
+    "prepare_frame",
+    "compute_mic",
+    "set_next_channel",
+    "handle_dio1_irq",
+    "process_reception",
+    "state_controller",
+    "equeue_dispatch",
+};
+
+static profile_stats_t profile_table[PROFILE_ZONES];
+
+void profile_record(profile_zone_t zone, uint32_t time)
+{
+    profile_stats_t *stats = &profile_table[zone];
+
+#if defined(__arm__)
+    // tasks and interrupts, a 64-bit total is not atomic
+    core_util_critical_section_enter();
+    stats->count++;
+    stats->total += time;
+    if (stats->count == 1 || time < stats->min) {
+        stats->min = time;
+    }
+    if (time > stats->max) {
+        stats->max = time;
+    }
+    core_util_critical_section_exit();
+#else
+    // the threads of the fleet simulation, each field on its own; a min of 0
+    // is unset, a run of no time counts as 1
+    uint32_t min = __atomic_load_n(&stats->min, __ATOMIC_RELAXED);
+    while ((min == 0 || time < min)
+            && !__atomic_compare_exchange_n(&stats->min, &min, time ? time : 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    uint32_t max = __atomic_load_n(&stats->max, __ATOMIC_RELAXED);
+    while (time > max
+            && !__atomic_compare_exchange_n(&stats->max, &max, time, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    __atomic_fetch_add(&stats->total, time, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->count, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+void profile_get(profile_zone_t zone, profile_stats_t *stats)
+{
+#if defined(__arm__)
+    core_util_critical_section_enter();
+    *stats = profile_table[zone];
+    core_util_critical_section_exit();
+#else
+    stats->count = __atomic_load_n(&profile_table[zone].count, __ATOMIC_RELAXED);
+    stats->min = __atomic_load_n(&profile_table[zone].min, __ATOMIC_RELAXED);
+    stats->max = __atomic_load_n(&profile_table[zone].max, __ATOMIC_RELAXED);
+    stats->total = __atomic_load_n(&profile_table[zone].total, __ATOMIC_RELAXED);
+#endif
+}
+
+void profile_reset(void)
+{
+    for (int i = 0; i < PROFILE_ZONES; i++) {
+#if defined(__arm__)
+        core_util_critical_section_enter();
+        memset(&profile_table[i], 0, sizeof(profile_table[i]));
+        core_util_critical_section_exit();
+#else
+        __atomic_store_n(&profile_table[i].count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&profile_table[i].min, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&profile_table[i].max, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&profile_table[i].total, 0, __ATOMIC_RELAXED);
+#endif
+    }
+}
+
+void profile_dump(void)
+{
+    printf("%-18s %10s %10s %10s %10s %14s  (%s)\r\n", "zone", "count", "min", "mean", "max",
+           "total", PROFILE_UNIT);
+
+    for (int i = 0; i < PROFILE_ZONES; i++) {
+        profile_stats_t stats;
+        profile_get((profile_zone_t) i, &stats);
+
+        if (stats.count == 0) {
+            continue;
+        }
+
+        printf("%-18s %10lu %10lu %10lu %10lu %14llu\r\n", profile_names[i],
+               (unsigned long) stats.count, (unsigned long) stats.min,
+               (unsigned long)(stats.total / stats.count), (unsigned long) stats.max,
+               (unsigned long long) stats.total);
+    }
+}
+
+const char *profile_zone_name(profile_zone_t zone)
+{
+    return zone < PROFILE_ZONES ? profile_names[zone] : "";
+}
+
+#endif
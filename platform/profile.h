@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __MBED_PROFILE_H__
+#define __MBED_PROFILE_H__
+
+#include <stdint.h>
+
+/**
+ * Zones are timed, off unless set
+ */
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED         0
+#endif
+
+#if PROFILE_ENABLED
+#if defined(__arm__)
+#include "em_device.h"
+#else
+#include <time.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \addtogroup platform */
+/** @{*/
+/**
+ * \defgroup platform_profile hot path profiler
+ * @{
+ *
+ * Named zones of the stack, each timed whenever it runs, with the number of
+ * runs and the least, most and total time accumulated in a static table
+ * that profile_dump() prints. Zones nest, the time of a zone includes the
+ * zones it calls.
+ *
+ * On the target, the time is in core cycles, from the DWT cycle counter
+ * which must be enabled (DWT_CTRL_CYCCNTENA); on the host, in nanoseconds
+ * of CLOCK_MONOTONIC.
+ */
+
+typedef enum {
+    PROFILE_PREPARE_FRAME,
+    PROFILE_COMPUTE_MIC,
+    PROFILE_SET_NEXT_CHANNEL,
+    PROFILE_HANDLE_DIO1_IRQ,
+    PROFILE_PROCESS_RECEPTION,
+    PROFILE_STATE_CONTROLLER,
+    PROFILE_EQUEUE_DISPATCH,
+    PROFILE_ZONES
+} profile_zone_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} profile_stats_t;
+
+#if defined(__arm__)
+#define PROFILE_UNIT            "cycles"
+#else
+#define PROFILE_UNIT            "ns"
+#endif
+
+#if PROFILE_ENABLED
+
+/** Current time, in PROFILE_UNIT, wrapping
+ */
+static inline uint32_t profile_now(void)
+{
+#if defined(__arm__)
+    return DWT->CYCCNT;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t) now.tv_sec * 1000000000u + now.tv_nsec);
+#endif
+}
+
+/** Accounts a run of a zone
+ *
+ * @param zone      Zone
+ * @param time      Time it took, in PROFILE_UNIT
+ */
+void profile_record(profile_zone_t zone, uint32_t time);
+
+/** Gets what a zone accumulated
+ *
+ * @param zone      Zone
+ * @param stats     Copy of its figures, min is 0 if it never ran
+ */
+void profile_get(profile_zone_t zone, profile_stats_t *stats);
+
+/** Clears every zone
+ */
+void profile_reset(void);
+
+/** Prints every zone that ran, with printf
+ */
+void profile_dump(void);
+
+/** Name of a zone
+ */
+const char *profile_zone_name(profile_zone_t zone);
+
+/** Times the rest of a C block as a zone, up to PROFILE_END() */
+#define PROFILE_BEGIN(zone)     uint32_t _profile_start_##zone = profile_now()
+#define PROFILE_END(zone)       profile_record(zone, profile_now() - _profile_start_##zone)
+
+#else
+
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+
+#endif
+
+/** @}*/
+/** @}*/
+
+#ifdef __cplusplus
+}
+
+#if PROFILE_ENABLED
+
+/** Times a zone until the end of the scope
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(profile_zone_t zone)
+        : _zone(zone), _start(profile_now())
+    {
+    }
+
+    ~ProfileScope()
+    {
+        profile_record(_zone, profile_now() - _start);
+    }
+
+private:
+    profile_zone_t _zone;
+    uint32_t _start;
+};
+
+#define PROFILE_CAT_(a, b)      a##b
+#define PROFILE_CAT(a, b)       PROFILE_CAT_(a, b)
+
+/** Times the rest of the enclosing C++ scope as a zone */
+#define PROFILE_ZONE(zone)      ProfileScope PROFILE_CAT(_profile_scope_, __LINE__)(zone)
+
+#else
+
+#define PROFILE_ZONE(zone)
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include "platform/stack_watch.h"
+
+#if STACK_WATCH_ENABLED
+
+typedef struct {
+    const char *name;
+    const volatile uint32_t *base;
+    uint32_t words;
+} stack_watch_entry_t;
+
+static stack_watch_entry_t stack_watch_table[STACK_WATCH_STACKS];
+static int stack_watch_count;
+
+int stack_watch_add(const char *name, void *base, size_t size)
+{
+    if (stack_watch_count == STACK_WATCH_STACKS) {
+        return -1;
+    }
+
+    stack_watch_entry_t *entry = &stack_watch_table[stack_watch_count];
+    uint32_t *word = (uint32_t *) base;
+
+    entry->name = name;
+    entry->base = word;
+    entry->words = size / sizeof(uint32_t);
+
+    for (uint32_t i = 0; i < entry->words; i++) {
+        word[i] = STACK_WATCH_PAINT;
+    }
+
+    return stack_watch_count++;
+}
+
+void stack_watch_get(int index, stack_watch_stats_t *stats)
+{
+    const stack_watch_entry_t *entry = &stack_watch_table[index];
+    uint32_t untouched = 0;
+
+    // from the far end, the task writing at the other
+    while (untouched < entry->words && entry->base[untouched] == STACK_WATCH_PAINT) {
+        untouched++;
+    }
+
+    stats->name = entry->name;
+    stats->size = entry->words * sizeof(uint32_t);
+    stats->high_water = (entry->words - untouched) * sizeof(uint32_t);
+}
+
+void stack_watch_dump(void)
+{
+    printf("%-18s %10s %10s %6s\r\n", "stack", "size", "high", "used");
+
+    for (int i = 0; i < stack_watch_count; i++) {
+        stack_watch_stats_t stats;
+        stack_watch_get(i, &stats);
+
+        printf("%-18s %10lu %10lu %5lu%%%s\r\n", stats.name, (unsigned long) stats.size,
+               (unsigned long) stats.high_water,
+               (unsigned long)(stats.high_water * 100 / stats.size),
+               stats.high_water == stats.size ? " overflow" : "");
+    }
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __MBED_STACK_WATCH_H__
+#define __MBED_STACK_WATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Task stacks are painted and watched, on unless cleared
+ */
+#ifndef STACK_WATCH_ENABLED
+#define STACK_WATCH_ENABLED     1
+#endif
+
+/**
+ * Number of stacks that can be watched
+ */
+#ifndef STACK_WATCH_STACKS
+#define STACK_WATCH_STACKS      6
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \addtogroup platform */
+/** @{*/
+/**
+ * \defgroup platform_stack_watch task stack high-water marks
+ * @{
+ *
+ * A stack is painted with a pattern before its task is created; the task
+ * overwrites it as its stack grows, and the pattern left at the far end
+ * tells how deep it ever went. The stacks grow down, from the end of their
+ * array towards the start, as on Cortex-M.
+ *
+ * The mark is a lower bound: a frame that reserves words without writing
+ * them, or writes the pattern itself, goes unseen. A stack that reaches its
+ * start has overflowed, or is about to.
+ */
+
+/**
+ * Word the stacks are painted with
+ */
+#define STACK_WATCH_PAINT       0xDEADBEEFu
+
+typedef struct {
+    const char *name;
+    uint32_t size;          /**< Bytes of the stack */
+    uint32_t high_water;    /**< Most bytes it held */
+} stack_watch_stats_t;
+
+#if STACK_WATCH_ENABLED
+
+/** Paints a stack and watches it, before its task is created
+ *
+ * The task must be created without having its stack cleared, e.g. without
+ * OS_OPT_TASK_STK_CLR.
+ *
+ * @param name      Name of the task, kept
+ * @param base      Start of the stack, its lowest address, word aligned
+ * @param size      Bytes of the stack
+ *
+ * @return          Index of the stack, -1 if STACK_WATCH_STACKS are watched
+ */
+int stack_watch_add(const char *name, void *base, size_t size);
+
+/** Gets the high-water mark of a stack
+ *
+ * @param index     Index given by stack_watch_add()
+ * @param stats     Its figures
+ */
+void stack_watch_get(int index, stack_watch_stats_t *stats);
+
+/** Prints every stack, with printf
+ */
+void stack_watch_dump(void);
+
+#endif
+
+/** @}*/
+/** @}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
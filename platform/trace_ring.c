@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stddef.h>
+#include "platform/trace_ring.h"
+
+#if (TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) != 0
+#error "TRACE_RING_SIZE must be a power of two"
+#endif
+
+#define TRACE_RING_MASK     (TRACE_RING_SIZE - 1)
+
+/* Defined by the linker for the section of the format strings, if any
+ * call site traces to the ring */
+extern const char __start_lorawan_trace[] __attribute__((weak));
+
+/* A word is 0 until the record it belongs to is written, the header last,
+ * and the reader clears the words it took before moving the tail on */
+static uint32_t trace_ring[TRACE_RING_SIZE];
+
+/* Words reserved and taken so far, the ring index is their low bits */
+static uint32_t trace_head;
+static uint32_t trace_tail;
+
+static uint32_t trace_dropped;
+static uint32_t trace_dropped_total;
+
+bool trace_ring_enabled;
+static uint32_t (*trace_clock)(void);
+
+void trace_ring_set_enabled(bool enabled)
+{
+    __atomic_store_n(&trace_ring_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+void trace_ring_set_clock(uint32_t (*clock)(void))
+{
+    trace_clock = clock;
+}
+
+void trace_ring_write(uint8_t level, const char *format, const uint32_t *args, uint8_t nargs)
+{
+    uint32_t words = 2 + nargs;
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+
+    do {
+        uint32_t tail = __atomic_load_n(&trace_tail, __ATOMIC_ACQUIRE);
+
+        if (head + words - tail > TRACE_RING_SIZE) {
+            __atomic_fetch_add(&trace_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&trace_head, &head, head + words, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    trace_ring[(head + 1) & TRACE_RING_MASK] = trace_clock ? trace_clock() : 0;
+    for (uint8_t i = 0; i < nargs; i++) {
+        trace_ring[(head + 2 + i) & TRACE_RING_MASK] = args[i];
+    }
+
+    // the record is complete once its header is there
+    __atomic_store_n(&trace_ring[head & TRACE_RING_MASK],
+                     TRACE_RING_HEADER(level, nargs, format - __start_lorawan_trace),
+                     __ATOMIC_RELEASE);
+}
+
+uint32_t trace_ring_read(uint32_t *words, uint32_t size)
+{
+    uint32_t tail = trace_tail;
+    uint32_t count = 0;
+
+    if (size < TRACE_RING_MAX_ARGS + 2) {
+        return 0;
+    }
+
+    uint32_t dropped = __atomic_exchange_n(&trace_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) {
+        trace_dropped_total += dropped;
+        words[count++] = TRACE_RING_HEADER(TRACE_RING_LEVEL_ERROR, 1, TRACE_RING_ID_DROPPED);
+        words[count++] = trace_clock ? trace_clock() : 0;
+        words[count++] = dropped;
+    }
+
+    while (true) {
+        uint32_t header = __atomic_load_n(&trace_ring[tail & TRACE_RING_MASK], __ATOMIC_ACQUIRE);
+
+        // empty, or the next record is still being written
+        if (header == 0) {
+            break;
+        }
+
+        uint32_t length = 2 + TRACE_RING_HEADER_NARGS(header);
+        if (count + length > size) {
+            break;
+        }
+
+        for (uint32_t i = 0; i < length; i++) {
+            words[count++] = trace_ring[(tail + i) & TRACE_RING_MASK];
+            trace_ring[(tail + i) & TRACE_RING_MASK] = 0;
+        }
+
+        tail += length;
+    }
+
+    __atomic_store_n(&trace_tail, tail, __ATOMIC_RELEASE);
+
+    return count;
+}
+
+uint32_t trace_ring_get_dropped(void)
+{
+    return trace_dropped_total + __atomic_load_n(&trace_dropped, __ATOMIC_RELAXED);
+}
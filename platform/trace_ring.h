@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef __MBED_TRACE_RING_H__
+#define __MBED_TRACE_RING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \addtogroup platform */
+/** @{*/
+/**
+ * \defgroup platform_trace_ring binary trace ring
+ * @{
+ *
+ * Deferred, binary tracing. A call site does not format anything: its format
+ * string is placed at build time in the TRACE_RING_SECTION section, and the
+ * record written to RAM is the offset of the string in the section, a
+ * timestamp and the arguments as raw 32-bit words. Writers reserve their
+ * record with a compare-and-swap, so tasks and interrupts trace without a
+ * lock and without waiting on any output.
+ *
+ * A single reader, typically a low priority task, drains the ring with
+ * trace_ring_read() and pushes the words to a debug port. The section is
+ * extracted from the image after the build, e.g.
+ *
+ *   arm-none-eabi-objcopy -O binary --only-section=lorawan_trace app.axf app.trace
+ *
+ * and the host decoder, sim/trace_decode.cpp, turns the words back into text
+ * with it.
+ *
+ * Records are TRACE_RING_HEADER, the timestamp and the arguments. Arguments
+ * are cast to 32 bits: %s prints the address, not the string.
+ */
+
+/**
+ * Words of the ring, a power of two
+ */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE         1024
+#endif
+
+/**
+ * Arguments of a record, at most
+ */
+#define TRACE_RING_MAX_ARGS     8
+
+/**
+ * Name of the section of the format strings, with the __start_ symbol the
+ * linker defines for it
+ */
+#define TRACE_RING_SECTION      "lorawan_trace"
+
+/**
+ * Levels, as in trace.h
+ */
+#define TRACE_RING_LEVEL_ERROR  1
+#define TRACE_RING_LEVEL_INFO   2
+#define TRACE_RING_LEVEL_DEBUG  3
+
+/**
+ * First word of a record: a magic nibble, the level, the number of arguments
+ * and the offset of the format string
+ */
+#define TRACE_RING_MAGIC        0xA0000000u
+#define TRACE_RING_HEADER(level, nargs, id) \
+    (TRACE_RING_MAGIC | ((uint32_t)(level) << 26) | ((uint32_t)(nargs) << 22) | (uint32_t)(id))
+#define TRACE_RING_HEADER_VALID(header)     (((header) & 0xF0000000u) == TRACE_RING_MAGIC)
+#define TRACE_RING_HEADER_LEVEL(header)     (((header) >> 26) & 0x3)
+#define TRACE_RING_HEADER_NARGS(header)     (((header) >> 22) & 0xF)
+#define TRACE_RING_HEADER_ID(header)        ((header) & 0x3FFFFF)
+
+/**
+ * Identifier of the record telling how many were dropped since the previous
+ * read, its argument
+ */
+#define TRACE_RING_ID_DROPPED   0x3FFFFF
+
+/** Enables or disables tracing, disabled until told otherwise
+ */
+void trace_ring_set_enabled(bool enabled);
+
+/**
+ * Tracing is enabled, tested by the call sites before anything else
+ */
+extern bool trace_ring_enabled;
+
+/** Sets what the records are timestamped with
+ *
+ * @param clock     Returns the time, in any unit, NULL for 0
+ */
+void trace_ring_set_clock(uint32_t (*clock)(void));
+
+/** Writes a record, see TRACE_RING_LOG()
+ *
+ * @param level     TRACE_RING_LEVEL_...
+ * @param format    Format string, in TRACE_RING_SECTION
+ * @param args      Arguments
+ * @param nargs     Number of arguments, up to TRACE_RING_MAX_ARGS
+ */
+void trace_ring_write(uint8_t level, const char *format, const uint32_t *args, uint8_t nargs);
+
+/** Takes the complete records out of the ring, from a single reader
+ *
+ * Records are never split. A record of TRACE_RING_ID_DROPPED comes first if
+ * records were dropped as the ring was full.
+ *
+ * @param words     Buffer for the records
+ * @param size      Size of the buffer, in words, TRACE_RING_MAX_ARGS + 2 at
+ *                  least
+ *
+ * @return          Number of words written to the buffer
+ */
+uint32_t trace_ring_read(uint32_t *words, uint32_t size);
+
+/** Number of records dropped as the ring was full, since the start
+ */
+uint32_t trace_ring_get_dropped(void);
+
+/** @}*/
+/** @}*/
+
+#define TRACE_RING_STR_(x)          #x
+#define TRACE_RING_STR(x)           TRACE_RING_STR_(x)
+#define TRACE_RING_CAT_(a, b)       a##b
+#define TRACE_RING_CAT(a, b)        TRACE_RING_CAT_(a, b)
+
+#define TRACE_RING_NARGS(...) \
+    TRACE_RING_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define TRACE_RING_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...)  n
+
+#define TRACE_RING_WORD(x)          ((uint32_t)(uintptr_t)(x))
+#define TRACE_RING_WORDS0()
+#define TRACE_RING_WORDS1(a)        TRACE_RING_WORD(a)
+#define TRACE_RING_WORDS2(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS1(__VA_ARGS__)
+#define TRACE_RING_WORDS3(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS2(__VA_ARGS__)
+#define TRACE_RING_WORDS4(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS3(__VA_ARGS__)
+#define TRACE_RING_WORDS5(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS4(__VA_ARGS__)
+#define TRACE_RING_WORDS6(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS5(__VA_ARGS__)
+#define TRACE_RING_WORDS7(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS6(__VA_ARGS__)
+#define TRACE_RING_WORDS8(a, ...)   TRACE_RING_WORD(a), TRACE_RING_WORDS7(__VA_ARGS__)
+
+/** Traces a message
+ *
+ * The format string, prefixed with the file and line, goes to
+ * TRACE_RING_SECTION; only its offset is written to the ring.
+ */
+#define TRACE_RING_LOG(level, format, ...)                                          \
+    do {                                                                            \
+        static const char _trace_format[]                                           \
+            __attribute__((section(TRACE_RING_SECTION), used, aligned(1))) =        \
+                __FILE__ ":" TRACE_RING_STR(__LINE__) "\x1f" format;                \
+        if (__atomic_load_n(&trace_ring_enabled, __ATOMIC_RELAXED)) {               \
+            const uint32_t _trace_args[] = {                                        \
+                0, TRACE_RING_CAT(TRACE_RING_WORDS, TRACE_RING_NARGS(__VA_ARGS__))(__VA_ARGS__) \
+            };                                                                      \
+            trace_ring_write(level, _trace_format, &_trace_args[1],                 \
+                             TRACE_RING_NARGS(__VA_ARGS__));                        \
+        }                                                                           \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
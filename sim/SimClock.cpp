@@ -0,0 +1,246 @@
+/**
+ * @file SimClock.cpp
+ *
+ * @brief Virtual clock of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "SimClock.h"
+#include "sim_random.h"
+#include "events/equeue/equeue_platform.h"
+
+using namespace events;
+
+/**
+ * Heap position of a queue with nothing queued
+ */
+#define SOURCE_IDLE                 0xFFFFFFFF
+
+SimClock::SimClock(uint32_t max_queues)
+    : _max_queues(max_queues),
+      _nb_queues(0),
+      _heap_size(0),
+      _dispatch_count(0)
+{
+    _sources = new Source[max_queues];
+    _heap = new Source *[max_queues];
+}
+
+SimClock::~SimClock()
+{
+    for (uint32_t i = 0; i < _nb_queues; i++) {
+        if (_sources[i].queue) {
+            _sources[i].queue->background(NULL);
+        }
+    }
+
+    delete[] _sources;
+    delete[] _heap;
+}
+
+bool SimClock::add(EventQueue &queue, unsigned int *random)
+{
+    Source *source = NULL;
+
+    for (uint32_t i = 0; i < _nb_queues && !source; i++) {
+        if (!_sources[i].queue) {
+            source = &_sources[i];
+        }
+    }
+
+    if (!source) {
+        if (_nb_queues == _max_queues) {
+            return false;
+        }
+        source = &_sources[_nb_queues++];
+    }
+
+    source->clock = this;
+    source->queue = &queue;
+    source->random = random;
+    source->deadline = 0;
+    source->position = SOURCE_IDLE;
+
+    // told at once if something is queued already
+    queue.background(mbed::callback(source, &Source::on_deadline));
+
+    return true;
+}
+
+void SimClock::remove(EventQueue &queue)
+{
+    for (uint32_t i = 0; i < _nb_queues; i++) {
+        Source *source = &_sources[i];
+
+        if (source->queue == &queue) {
+            queue.background(NULL);
+            heap_remove(source);
+            source->queue = NULL;
+        }
+    }
+}
+
+lorawan_time_t SimClock::now() const
+{
+    return equeue_tick();
+}
+
+void SimClock::run_for(uint32_t ms)
+{
+    lorawan_time_t end = now() + ms;
+
+    do {
+        dispatch();
+    } while (advance(end));
+}
+
+bool SimClock::run_until(mbed::Callback<bool()> done, uint32_t limit)
+{
+    lorawan_time_t end = now() + limit;
+
+    while (true) {
+        dispatch();
+        if (done()) {
+            return true;
+        }
+        if (!advance(end)) {
+            return false;
+        }
+    }
+}
+
+uint32_t SimClock::get_dispatch_count() const
+{
+    return _dispatch_count;
+}
+
+void SimClock::Source::on_deadline(int ms)
+{
+    clock->update(this, ms);
+}
+
+void SimClock::update(Source *source, int ms)
+{
+    if (ms < 0) {
+        heap_remove(source);
+        return;
+    }
+
+    source->deadline = now() + ms;
+
+    if (source->position == SOURCE_IDLE) {
+        source->position = _heap_size++;
+        heap_set(source->position, source);
+    }
+
+    heap_up(source->position);
+    heap_down(source->position);
+}
+
+void SimClock::dispatch()
+{
+    lorawan_time_t tick = now();
+
+    while (_heap_size && (int32_t)(_heap[0]->deadline - tick) <= 0) {
+        Source *source = _heap[0];
+
+        // the queue reports its next deadline at the end of the dispatch,
+        // unless it is left empty
+        heap_remove(source);
+        unsigned int *previous = sim_rand_select(source->random);
+        source->queue->dispatch(0);
+        sim_rand_select(previous);
+        _dispatch_count++;
+    }
+}
+
+bool SimClock::advance(lorawan_time_t end)
+{
+    int32_t left = (int32_t)(end - now());
+
+    if (left <= 0) {
+        return false;
+    }
+
+    if (!_heap_size || (int32_t)(_heap[0]->deadline - end) >= 0) {
+        equeue_sim_advance(left);
+        return false;
+    }
+
+    equeue_sim_advance(_heap[0]->deadline - now());
+
+    return true;
+}
+
+void SimClock::heap_remove(Source *source)
+{
+    uint32_t position = source->position;
+
+    if (position == SOURCE_IDLE) {
+        return;
+    }
+
+    source->position = SOURCE_IDLE;
+
+    if (position == --_heap_size) {
+        return;
+    }
+
+    heap_set(position, _heap[_heap_size]);
+    heap_up(position);
+    heap_down(position);
+}
+
+void SimClock::heap_up(uint32_t position)
+{
+    while (position > 0) {
+        uint32_t parent = (position - 1) / 2;
+        if (!heap_before(_heap[position], _heap[parent])) {
+            return;
+        }
+        Source *source = _heap[parent];
+        heap_set(parent, _heap[position]);
+        heap_set(position, source);
+        position = parent;
+    }
+}
+
+void SimClock::heap_down(uint32_t position)
+{
+    while (true) {
+        uint32_t first = position;
+        uint32_t left = 2 * position + 1;
+        uint32_t right = left + 1;
+
+        if (left < _heap_size && heap_before(_heap[left], _heap[first])) {
+            first = left;
+        }
+        if (right < _heap_size && heap_before(_heap[right], _heap[first])) {
+            first = right;
+        }
+        if (first == position) {
+            return;
+        }
+
+        Source *source = _heap[first];
+        heap_set(first, _heap[position]);
+        heap_set(position, source);
+        position = first;
+    }
+}
+
+void SimClock::heap_set(uint32_t position, Source *source)
+{
+    _heap[position] = source;
+    source->position = position;
+}
+
+bool SimClock::heap_before(const Source *a, const Source *b) const
+{
+    int32_t diff = (int32_t)(a->deadline - b->deadline);
+
+    // ties go to the queue added first, so runs are repeatable
+    return diff < 0 || (diff == 0 && a < b);
+}
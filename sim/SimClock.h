@@ -0,0 +1,136 @@
+/**
+ * @file SimClock.h
+ *
+ * @brief Virtual clock of the host simulation
+ *
+ * The simulation builds the event queue for EQUEUE_PLATFORM_SIM, whose tick
+ * only moves when told to. The clock dispatches the queues of the simulation
+ * which have something due, then jumps straight to the next deadline, so an
+ * hour of LoRaWAN traffic runs in as long as it takes to execute the
+ * callbacks.
+ *
+ * The next deadline of a queue is learnt through EventQueue::background(),
+ * which is told about it at the end of every dispatch and whenever an event
+ * is posted ahead of the current head. Queues are kept in a binary heap on
+ * their deadline, so thousands of devices, each with a queue of its own,
+ * cost a logarithm per dispatch.
+ *
+ * The tick is per thread: a clock and its queues must stay on one thread.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_CLOCK_H__
+#define MBED_LORAWAN_SIM_CLOCK_H__
+
+#include <stdint.h>
+#include "events/EventQueue.h"
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+#include "lorawan/system/lorawan_data_structures.h"
+
+class SimClock : private mbed::NonCopyable<SimClock> {
+public:
+    /** Creates a clock
+     *
+     * @param max_queues    Queues which can be added
+     */
+    SimClock(uint32_t max_queues = 1);
+
+    ~SimClock();
+
+    /** Drives a queue
+     *
+     * @param random        State rand() works on while the queue is
+     *                      dispatched, see sim_rand_select(), NULL for the
+     *                      one of the thread
+     *
+     * @return              false if there are too many queues
+     */
+    bool add(events::EventQueue &queue, unsigned int *random = NULL);
+
+    /** Stops driving a queue, e.g. to drop a device, whose slot can then be
+     * added again
+     */
+    void remove(events::EventQueue &queue);
+
+    /** Current virtual time (ms)
+     */
+    lorawan_time_t now() const;
+
+    /** Runs the simulation for a while
+     *
+     * Events due at the end are left for the next run.
+     *
+     * @param ms            Virtual time (ms) to run for
+     */
+    void run_for(uint32_t ms);
+
+    /** Runs the simulation until a condition holds
+     *
+     * The condition is checked after every dispatch.
+     *
+     * @param done          Condition
+     * @param limit         Virtual time (ms) to give up after
+     *
+     * @return              true if the condition holds, false if the time
+     *                      limit was reached first
+     */
+    bool run_until(mbed::Callback<bool()> done, uint32_t limit);
+
+    /** Number of times a queue was dispatched so far
+     */
+    uint32_t get_dispatch_count() const;
+
+private:
+    /**
+     * A queue and its deadline
+     */
+    class Source {
+    public:
+        void on_deadline(int ms);
+
+        SimClock *clock;
+        /**
+         * NULL once removed
+         */
+        events::EventQueue *queue;
+        unsigned int *random;
+        lorawan_time_t deadline;
+        /**
+         * Position in the heap, SOURCE_IDLE if nothing is queued
+         */
+        uint32_t position;
+    };
+
+    void update(Source *source, int ms);
+
+    /**
+     * Runs the queues which have something due
+     */
+    void dispatch();
+
+    /**
+     * Moves the tick to the next deadline, or to 'end' if that comes first,
+     * false if it got to 'end'
+     */
+    bool advance(lorawan_time_t end);
+
+    void heap_remove(Source *source);
+    void heap_up(uint32_t position);
+    void heap_down(uint32_t position);
+    void heap_set(uint32_t position, Source *source);
+    bool heap_before(const Source *a, const Source *b) const;
+
+    Source *_sources;
+    uint32_t _max_queues;
+    uint32_t _nb_queues;
+
+    Source **_heap;
+    uint32_t _heap_size;
+
+    uint32_t _dispatch_count;
+};
+
+#endif /* MBED_LORAWAN_SIM_CLOCK_H__ */
@@ -0,0 +1,637 @@
+/**
+ * @file SimFleet.cpp
+ *
+ * @brief Many devices around a gateway, simulated across threads
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/aes.h"
+#include "SimFleet.h"
+#include "SimClock.h"
+#include "SimKeys.h"
+#include "SimLink.h"
+#include "SimNode.h"
+#include "SimTransmitter.h"
+
+/**
+ * Frames a worker can put on air per device and window
+ */
+#define FLEET_FRAMES_PER_NODE       2
+
+/**
+ * Frames kept by the medium of a worker, above its devices
+ */
+#define FLEET_AIR_FRAMES            64
+
+/**
+ * The devices of a worker
+ */
+class SimFleet::Worker {
+public:
+    /**
+     * A device and the application it runs
+     */
+    class Device {
+    public:
+        void join();
+        void generate();
+        void on_event(lorawan_event_t event);
+        void on_connected();
+        lorawan_time_t next_delay();
+
+        SimFleet *fleet;
+        SimNode *node;
+        sim_fleet_node_stats_t *stats;
+        uint32_t random;
+        /**
+         * Kept for the stack, which holds on to it while joining
+         */
+        uint8_t dev_eui[8];
+        uint8_t app_key[16];
+        lorawan_time_t join_start;
+        /**
+         * Time the message being sent was generated at
+         */
+        lorawan_time_t generated_at;
+        bool sending;
+    };
+
+    bool start();
+    void run();
+    void stop();
+
+    void on_frame(const air_frame_t &frame);
+
+    SimFleet *fleet;
+    pthread_t thread;
+    /**
+     * Devices are the ones of index 'first' + k * 'stride'
+     */
+    uint32_t first;
+    uint32_t stride;
+    uint32_t nb_devices;
+
+    SimClock *clock;
+    VirtualAir *air;
+    Device *devices;
+    bool started;
+
+    /**
+     * Puts the downlinks of the gateway on the medium
+     */
+    events::EventQueue *queue;
+    unsigned char *queue_buffer;
+    SimTransmitter *transmitter;
+
+    /**
+     * Frames put on air during the current window
+     */
+    air_frame_t *outbox;
+    uint32_t max_outbox;
+    uint32_t nb_outbox;
+    uint32_t outbox_overflow;
+};
+
+static uint8_t fleet_payload[255];
+
+/**
+ * xorshift32 of a device, never 0
+ */
+static uint32_t fleet_random(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static uint32_t fleet_seed(uint32_t seed, uint32_t index)
+{
+    uint32_t state = (seed ^ (index * 2654435761u)) | 1;
+
+    // a few rounds so neighbouring devices drift apart
+    for (uint8_t i = 0; i < 4; i++) {
+        fleet_random(state);
+    }
+
+    return state;
+}
+
+/**
+ * Uniform in ]0, 1]
+ */
+static float fleet_uniform(uint32_t &state)
+{
+    return (fleet_random(state) >> 8) * (1.0f / 16777216.0f) + (1.0f / 16777216.0f);
+}
+
+/**
+ * Highest datarate reaching the gateway with FLEET_LINK_MARGIN to spare
+ */
+static uint8_t fleet_datarate(float x, float y, float gw_x, float gw_y)
+{
+    air_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.modem = MODEM_LORA;
+    frame.power = FLEET_TX_POWER;
+    frame.x = x;
+    frame.y = y;
+
+    float power = SimLink::get_rx_power(frame, gw_x, gw_y);
+
+    // DR_5 is SF7 on every 125 kHz region
+    for (uint8_t dr = DR_5; dr > DR_0; dr--) {
+        frame.datarate = 12 - dr;
+        if (power >= SimLink::get_sensitivity(frame) + FLEET_LINK_MARGIN) {
+            return dr;
+        }
+    }
+
+    return DR_0;
+}
+
+/**
+ * DevEUI of a device, its index, and its AppKey, so it takes no join accept
+ * meant for another
+ */
+static void fleet_otaa_keys(uint32_t index, uint8_t *dev_eui, uint8_t *app_key)
+{
+    memset(dev_eui, 0, 4);
+    dev_eui[4] = index >> 24;
+    dev_eui[5] = index >> 16;
+    dev_eui[6] = index >> 8;
+    dev_eui[7] = index;
+
+    memcpy(app_key, sim_app_key, 16);
+    for (uint8_t i = 0; i < 8; i++) {
+        app_key[8 + i] ^= dev_eui[i];
+    }
+}
+
+SimFleet::SimFleet(const sim_fleet_config_t &config)
+    : _config(config),
+      _gateway(0, 0),
+      _server(_gateway, config.nb_nodes),
+      _started(false),
+      _nb_downlinks(0)
+{
+    if (_config.nb_threads == 0) {
+        _config.nb_threads = 1;
+    }
+    if (_config.nb_threads > _config.nb_nodes) {
+        _config.nb_threads = _config.nb_nodes ? _config.nb_nodes : 1;
+    }
+
+    _stats = new sim_fleet_node_stats_t[_config.nb_nodes];
+    memset(_stats, 0, _config.nb_nodes * sizeof(sim_fleet_node_stats_t));
+
+    uint32_t random = fleet_seed(_config.seed, 0xFFFFFFFF);
+
+    for (uint32_t i = 0; i < _config.nb_nodes; i++) {
+        // uniform over the disc
+        float r = _config.radius * sqrtf(fleet_uniform(random));
+        float angle = 2.0f * (float) M_PI * fleet_uniform(random);
+
+        _stats[i].x = r * cosf(angle);
+        _stats[i].y = r * sinf(angle);
+        _stats[i].datarate = _config.datarate != FLEET_DATARATE_AUTO ? _config.datarate
+                             : fleet_datarate(_stats[i].x, _stats[i].y,
+                                              _gateway.get_x(), _gateway.get_y());
+
+        // the index of a device on the network server is its own
+        if (_config.network && _config.otaa) {
+            uint8_t dev_eui[8];
+            uint8_t app_key[16];
+            fleet_otaa_keys(i, dev_eui, app_key);
+            _server.add_otaa_device(dev_eui, app_key);
+        } else if (_config.network) {
+            _server.add_abp_device(0x26000000 + i, sim_nwk_skey, sim_app_skey);
+        }
+    }
+
+    _server.set_adr(_config.adr);
+
+    _workers = new Worker[_config.nb_threads];
+    _max_frames = 0;
+
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        Worker &worker = _workers[i];
+        worker.fleet = this;
+        worker.first = i;
+        worker.stride = _config.nb_threads;
+        worker.nb_devices = (_config.nb_nodes - i + _config.nb_threads - 1) / _config.nb_threads;
+        worker.clock = NULL;
+        worker.air = NULL;
+        worker.devices = NULL;
+        worker.started = false;
+        worker.queue = NULL;
+        worker.queue_buffer = NULL;
+        worker.transmitter = NULL;
+        worker.max_outbox = worker.nb_devices * FLEET_FRAMES_PER_NODE;
+        worker.outbox = new air_frame_t[worker.max_outbox];
+        worker.nb_outbox = 0;
+        worker.outbox_overflow = 0;
+        _max_frames += worker.max_outbox;
+    }
+
+    _frames = new air_frame_t[_max_frames];
+
+    _gateway.set_listener(mbed::callback(this, &SimFleet::on_fate));
+    _gateway.set_transmitter(mbed::callback(this, &SimFleet::broadcast));
+}
+
+SimFleet::~SimFleet()
+{
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        delete[] _workers[i].outbox;
+    }
+
+    delete[] _workers;
+    delete[] _frames;
+    delete[] _stats;
+}
+
+bool SimFleet::run()
+{
+    // the AES tables are built on first use, not while the workers race
+    // for it
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, fleet_payload, 128);
+    mbedtls_aes_free(&aes);
+
+    pthread_barrier_init(&_barrier, NULL, _config.nb_threads + 1);
+
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        pthread_create(&_workers[i].thread, NULL, &SimFleet::worker_main, &_workers[i]);
+    }
+
+    // every worker started its devices, or none runs
+    pthread_barrier_wait(&_barrier);
+    bool started = true;
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        started = started && _workers[i].started;
+    }
+    _started = started;
+    pthread_barrier_wait(&_barrier);
+
+    if (_started) {
+        for (uint32_t end = 0; end < _config.duration;) {
+            end += _config.window;
+            if (end > _config.duration) {
+                end = _config.duration;
+            }
+
+            pthread_barrier_wait(&_barrier);
+            merge(end);
+            pthread_barrier_wait(&_barrier);
+        }
+    }
+
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        pthread_join(_workers[i].thread, NULL);
+    }
+
+    pthread_barrier_destroy(&_barrier);
+
+    return _started;
+}
+
+const sim_fleet_config_t &SimFleet::get_config() const
+{
+    return _config;
+}
+
+const sim_fleet_node_stats_t &SimFleet::get_node_stats(uint32_t index) const
+{
+    return _stats[index];
+}
+
+void SimFleet::get_total_stats(sim_fleet_node_stats_t &total) const
+{
+    memset(&total, 0, sizeof(total));
+
+    for (uint32_t i = 0; i < _config.nb_nodes; i++) {
+        const sim_fleet_node_stats_t &node = _stats[i];
+
+        total.generated += node.generated;
+        total.skipped += node.skipped;
+        total.sent += node.sent;
+        total.failed += node.failed;
+        total.delivered += node.delivered;
+        for (uint8_t fate = 0; fate < GATEWAY_FATES; fate++) {
+            total.lost[fate] += node.lost[fate];
+        }
+        total.latency_sum += node.latency_sum;
+        total.latency_count += node.latency_count;
+        if (node.latency_max > total.latency_max) {
+            total.latency_max = node.latency_max;
+        }
+        total.airtime += node.airtime;
+    }
+}
+
+const VirtualGateway &SimFleet::get_gateway() const
+{
+    return _gateway;
+}
+
+const VirtualNetworkServer &SimFleet::get_server() const
+{
+    return _server;
+}
+
+uint32_t SimFleet::get_overflow_count() const
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        count += _workers[i].outbox_overflow;
+    }
+
+    return count;
+}
+
+void *SimFleet::worker_main(void *arg)
+{
+    Worker *worker = static_cast<Worker *>(arg);
+    SimFleet *fleet = worker->fleet;
+
+    worker->started = worker->start();
+
+    pthread_barrier_wait(&fleet->_barrier);
+    pthread_barrier_wait(&fleet->_barrier);
+
+    if (fleet->_started) {
+        worker->run();
+    }
+
+    worker->stop();
+
+    return NULL;
+}
+
+static int frame_order(const void *a, const void *b)
+{
+    const air_frame_t *fa = static_cast<const air_frame_t *>(a);
+    const air_frame_t *fb = static_cast<const air_frame_t *>(b);
+    int32_t diff = (int32_t)(fa->start - fb->start);
+
+    if (diff) {
+        return diff < 0 ? -1 : 1;
+    }
+
+    return fa->sender_id < fb->sender_id ? -1 : fa->sender_id > fb->sender_id;
+}
+
+void SimFleet::merge(lorawan_time_t until)
+{
+    uint32_t nb_frames = 0;
+
+    // the workers took those of the previous window as it started
+    _nb_downlinks = 0;
+
+    for (uint32_t i = 0; i < _config.nb_threads; i++) {
+        Worker &worker = _workers[i];
+        memcpy(&_frames[nb_frames], worker.outbox, worker.nb_outbox * sizeof(air_frame_t));
+        nb_frames += worker.nb_outbox;
+        worker.nb_outbox = 0;
+    }
+
+    // the order the frames would have been put on a single medium in
+    qsort(_frames, nb_frames, sizeof(air_frame_t), frame_order);
+
+    for (uint32_t i = 0; i < nb_frames; i++) {
+        _gateway.add_frame(_frames[i]);
+    }
+
+    _gateway.resolve(until);
+}
+
+void SimFleet::on_fate(const air_frame_t &frame, gateway_fate_t fate, float power)
+{
+    // radio identifiers are device indices from 1
+    sim_fleet_node_stats_t &stats = _stats[frame.sender_id - 1];
+
+    if (frame.size && (frame.payload[0] >> 5) == FRAME_TYPE_JOIN_REQ) {
+        // the join time tells of them
+    } else if (fate == GATEWAY_RECEIVED) {
+        stats.delivered++;
+    } else {
+        stats.lost[fate]++;
+    }
+
+    if (fate == GATEWAY_RECEIVED && _config.network) {
+        _server.on_uplink(frame, power);
+    }
+}
+
+bool SimFleet::broadcast(const air_frame_t &frame)
+{
+    if (_nb_downlinks == GATEWAY_MAX_DOWNLINKS) {
+        return false;
+    }
+
+    _downlinks[_nb_downlinks++] = frame;
+
+    return true;
+}
+
+bool SimFleet::Worker::start()
+{
+    const sim_fleet_config_t &config = fleet->_config;
+
+    clock = new SimClock(nb_devices + 1);
+    air = new VirtualAir(nb_devices, nb_devices + FLEET_AIR_FRAMES);
+    air->observe(mbed::callback(this, &Worker::on_frame));
+    devices = new Device[nb_devices];
+    queue_buffer = new unsigned char[SIM_QUEUE_SIZE];
+    queue = new events::EventQueue(SIM_QUEUE_SIZE, queue_buffer);
+    transmitter = new SimTransmitter(*air, *queue);
+    clock->add(*queue);
+
+    for (uint32_t k = 0; k < nb_devices; k++) {
+        uint32_t index = first + k * stride;
+        Device &device = devices[k];
+
+        device.fleet = fleet;
+        device.stats = &fleet->_stats[index];
+        device.random = fleet_seed(config.seed, index);
+        device.generated_at = 0;
+        device.sending = false;
+        device.join_start = 0;
+        fleet_otaa_keys(index, device.dev_eui, device.app_key);
+        device.node = new SimNode(*air, index + 1);
+        device.node->radio.set_position(device.stats->x, device.stats->y);
+        device.node->set_listener(mbed::callback(&device, &Device::on_event));
+        clock->add(device.node->queue, &device.node->random);
+
+        if (device.node->start() != LORAWAN_STATUS_OK) {
+            nb_devices = k + 1;
+            return false;
+        }
+
+        if (config.otaa) {
+            // joins spread over the first period
+            device.node->queue.call_in(1 + fleet_random(device.random) % config.period,
+                                       &device, &Device::join);
+            continue;
+        }
+
+        if (device.node->connect_abp(0x26000000 + index) != LORAWAN_STATUS_OK) {
+            nb_devices = k + 1;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void SimFleet::Worker::run()
+{
+    const sim_fleet_config_t &config = fleet->_config;
+
+    for (uint32_t end = 0; end < config.duration;) {
+        end += config.window;
+        if (end > config.duration) {
+            end = config.duration;
+        }
+
+        for (uint32_t i = 0; i < fleet->_nb_downlinks; i++) {
+            transmitter->schedule(fleet->_downlinks[i]);
+        }
+
+        clock->run_for(end - clock->now());
+
+        pthread_barrier_wait(&fleet->_barrier);
+        pthread_barrier_wait(&fleet->_barrier);
+    }
+}
+
+void SimFleet::Worker::stop()
+{
+    for (uint32_t k = 0; k < nb_devices; k++) {
+        devices[k].stats->airtime = devices[k].node->radio.get_stats().tx_time;
+    }
+
+    // the clock lets go of the queues first
+    delete clock;
+    delete transmitter;
+    delete queue;
+    delete[] queue_buffer;
+
+    for (uint32_t k = 0; k < nb_devices; k++) {
+        delete devices[k].node;
+    }
+
+    delete[] devices;
+    delete air;
+}
+
+void SimFleet::Worker::on_frame(const air_frame_t &frame)
+{
+    // the downlinks of the gateway
+    if (!frame.sender) {
+        return;
+    }
+
+    if (nb_outbox == max_outbox) {
+        outbox_overflow++;
+        return;
+    }
+
+    outbox[nb_outbox++] = frame;
+}
+
+void SimFleet::Worker::Device::join()
+{
+    join_start = node->queue.tick();
+
+    if (node->connect_otaa(dev_eui, MBED_CONF_LORA_NB_TRIALS, app_key)
+            != LORAWAN_STATUS_CONNECT_IN_PROGRESS) {
+        stats->failed++;
+    }
+}
+
+void SimFleet::Worker::Device::generate()
+{
+    const sim_fleet_config_t &config = fleet->_config;
+    LoRaWANInterface &lorawan = node->lorawan;
+    uint8_t flags = config.confirmed ? MSG_CONFIRMED_FLAG : MSG_UNCONFIRMED_FLAG;
+
+    stats->generated++;
+
+    if (!sending && lorawan.send(MBED_CONF_LORA_APP_PORT, fleet_payload, config.payload_size,
+                                 flags) == config.payload_size) {
+        stats->sent++;
+        generated_at = node->queue.tick();
+        sending = true;
+    } else {
+        stats->skipped++;
+    }
+
+    node->queue.call_in(next_delay(), this, &Device::generate);
+}
+
+void SimFleet::Worker::Device::on_event(lorawan_event_t event)
+{
+    if (event == CONNECTED) {
+        on_connected();
+        return;
+    }
+
+    if (!sending || (event != TX_DONE && event != TX_ERROR && event != TX_TIMEOUT
+                     && event != TX_SCHEDULING_ERROR && event != TX_CRYPTO_ERROR)) {
+        return;
+    }
+
+    sending = false;
+
+    if (event != TX_DONE) {
+        stats->failed++;
+        return;
+    }
+
+    uint32_t latency = node->queue.tick() - generated_at;
+    stats->latency_sum += latency;
+    stats->latency_count++;
+    if (latency > stats->latency_max) {
+        stats->latency_max = latency;
+    }
+}
+
+void SimFleet::Worker::Device::on_connected()
+{
+    const sim_fleet_config_t &config = fleet->_config;
+    LoRaWANInterface &lorawan = node->lorawan;
+
+    if (config.otaa) {
+        stats->joined = true;
+        stats->join_time = node->queue.tick() - join_start;
+    }
+
+    // the datarate is set once joined, the join requests pick their own
+    if (lorawan.disable_adaptive_datarate() != LORAWAN_STATUS_OK
+            || lorawan.set_datarate(stats->datarate) != LORAWAN_STATUS_OK
+            || (config.adr && lorawan.enable_adaptive_datarate() != LORAWAN_STATUS_OK)) {
+        stats->failed++;
+        return;
+    }
+
+    node->queue.call_in(next_delay(), this, &Device::generate);
+}
+
+lorawan_time_t SimFleet::Worker::Device::next_delay()
+{
+    const sim_fleet_config_t &config = fleet->_config;
+
+    // exponential, at least a tick
+    float delay = -logf(fleet_uniform(random)) * config.period;
+
+    return delay < 1.0f ? 1 : (lorawan_time_t) delay;
+}
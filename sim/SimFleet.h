@@ -0,0 +1,211 @@
+/**
+ * @file SimFleet.h
+ *
+ * @brief Many devices around a gateway, simulated across threads
+ *
+ * Every device is a SimNode, with the stack built for the target, sending
+ * uplinks at random, unconfirmed with ABP unless told otherwise. Devices are
+ * spread uniformly over a disc around a gateway at its centre and use the
+ * datarate their distance allows, unless one is given.
+ *
+ * The gateway can be backed by a VirtualNetworkServer, which knows every
+ * device: it then accepts joins, acknowledges confirmed uplinks and runs
+ * the ADR. OTAA devices join at a random time within the first period and
+ * start sending once joined.
+ *
+ * Devices are dealt out to worker threads, each with a SimClock and a
+ * VirtualAir of its own. The simulation is conservative and runs in
+ * windows: workers simulate their devices up to the end of a window, then
+ * the frames they put on air are merged, in the order they started, and
+ * handed to the gateway, which decides every frame which ended, see
+ * VirtualGateway. No device can be influenced by another within a window,
+ * uplinks not being received by devices, so the outcome does not depend on
+ * the number of threads. The downlinks the gateway transmits are handed to
+ * every worker at the start of the next window, which puts them on its
+ * medium when they start; the receive delays being longer than a window,
+ * none starts in the past.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_FLEET_H__
+#define MBED_LORAWAN_SIM_FLEET_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "platform/NonCopyable.h"
+#include "VirtualGateway.h"
+#include "VirtualNetworkServer.h"
+
+/**
+ * Margin (dB) above the sensitivity devices pick their datarate with
+ */
+#define FLEET_LINK_MARGIN           5
+
+/**
+ * Transmit power (dBm) the datarate is picked for, the default of EU868
+ */
+#define FLEET_TX_POWER              14
+
+/**
+ * Datarate picked from the distance
+ */
+#define FLEET_DATARATE_AUTO         0xFF
+
+/**
+ * Settings of a simulation
+ */
+typedef struct {
+    uint32_t nb_nodes;
+    uint32_t nb_threads;
+    /**
+     * Virtual time (ms) simulated
+     */
+    uint32_t duration;
+    /**
+     * Mean time (ms) between messages of a device, exponentially distributed
+     */
+    uint32_t period;
+    uint8_t payload_size;
+    /**
+     * Radius (m) of the disc the devices are on
+     */
+    float radius;
+    /**
+     * Length (ms) of a window, below the receive delays of the stack
+     */
+    uint32_t window;
+    /**
+     * Datarate of every device, or FLEET_DATARATE_AUTO
+     */
+    uint8_t datarate;
+    uint32_t seed;
+    /**
+     * A network server answers the devices
+     */
+    bool network;
+    /**
+     * Devices join with OTAA, which needs the network server
+     */
+    bool otaa;
+    bool confirmed;
+    /**
+     * Devices request ADR, and the network server runs it
+     */
+    bool adr;
+} sim_fleet_config_t;
+
+/**
+ * What became of the messages of a device
+ */
+typedef struct {
+    float x;
+    float y;
+    uint8_t datarate;
+    /**
+     * An OTAA device joined, and the time (ms) it took from its first join
+     * request
+     */
+    bool joined;
+    uint32_t join_time;
+    /**
+     * Messages the application had to send
+     */
+    uint32_t generated;
+    /**
+     * Messages dropped as the stack was busy with the previous one
+     */
+    uint32_t skipped;
+    /**
+     * Messages the stack took
+     */
+    uint32_t sent;
+    uint32_t failed;
+    /**
+     * Data frames the gateway received, retransmissions included
+     */
+    uint32_t delivered;
+    /**
+     * Data frames the gateway lost, per fate
+     */
+    uint32_t lost[GATEWAY_FATES];
+    /**
+     * Time (ms) from a message being generated to TX_DONE, summed over the
+     * messages done, and the longest
+     */
+    uint64_t latency_sum;
+    uint32_t latency_count;
+    uint32_t latency_max;
+    /**
+     * Time (ms) spent transmitting
+     */
+    uint32_t airtime;
+} sim_fleet_node_stats_t;
+
+class SimFleet : private mbed::NonCopyable<SimFleet> {
+public:
+    SimFleet(const sim_fleet_config_t &config);
+
+    ~SimFleet();
+
+    /** Runs the simulation to its end
+     *
+     * @return              false if the devices could not be started
+     */
+    bool run();
+
+    const sim_fleet_config_t &get_config() const;
+
+    const sim_fleet_node_stats_t &get_node_stats(uint32_t index) const;
+
+    /** Sum of the figures of every device, position and datarate aside
+     */
+    void get_total_stats(sim_fleet_node_stats_t &total) const;
+
+    const VirtualGateway &get_gateway() const;
+
+    const VirtualNetworkServer &get_server() const;
+
+    /** Frames the media of the workers dropped as they were saturated
+     */
+    uint32_t get_overflow_count() const;
+
+private:
+    class Worker;
+
+    static void *worker_main(void *arg);
+
+    void merge(lorawan_time_t until);
+
+    void on_fate(const air_frame_t &frame, gateway_fate_t fate, float power);
+
+    /**
+     * Transmitter of the gateway, the downlinks go to every worker
+     */
+    bool broadcast(const air_frame_t &frame);
+
+    sim_fleet_config_t _config;
+    VirtualGateway _gateway;
+    VirtualNetworkServer _server;
+    sim_fleet_node_stats_t *_stats;
+    Worker *_workers;
+
+    pthread_barrier_t _barrier;
+    /**
+     * The workers could start their devices
+     */
+    volatile bool _started;
+    /**
+     * Frames of a window, merged
+     */
+    air_frame_t *_frames;
+    uint32_t _max_frames;
+    /**
+     * Downlinks transmitted in a window, taken by the workers in the next
+     */
+    air_frame_t _downlinks[GATEWAY_MAX_DOWNLINKS];
+    uint32_t _nb_downlinks;
+};
+
+#endif /* MBED_LORAWAN_SIM_FLEET_H__ */
@@ -0,0 +1,28 @@
+/**
+ * @file SimKeys.h
+ *
+ * @brief Keys shared by the devices of the host simulation
+ *
+ * Devices have these keys unless given their own; they only need to be
+ * known to both ends. Devices joining on the same medium need AppKeys of
+ * their own: a join accept carries no address, a device takes any it can
+ * decrypt.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_KEYS_H__
+#define MBED_LORAWAN_SIM_KEYS_H__
+
+#include <stdint.h>
+
+extern uint8_t sim_app_eui[8];
+
+extern uint8_t sim_app_key[16];
+
+extern uint8_t sim_nwk_skey[16];
+
+extern uint8_t sim_app_skey[16];
+
+#endif /* MBED_LORAWAN_SIM_KEYS_H__ */
@@ -0,0 +1,122 @@
+/**
+ * @file SimLink.cpp
+ *
+ * @brief Propagation and interference model of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include "SimLink.h"
+
+/**
+ * Log-distance path loss, reference loss (dB) and distance (m), exponent
+ */
+#define PATH_LOSS_REF               127.41f
+#define PATH_LOSS_REF_DISTANCE      40.0f
+#define PATH_LOSS_EXPONENT          2.08f
+
+/**
+ * Sensitivity (dBm) at 125 kHz, SF7 to SF12
+ */
+static const float lora_sensitivity[6] = {
+    -123.0f, -126.0f, -129.0f, -132.0f, -134.5f, -137.0f
+};
+
+/**
+ * SIR (dB) the wanted frame (row, SF7 to SF12) needs over an interferer
+ * (column, SF7 to SF12)
+ */
+static const int8_t lora_sir_threshold[6][6] = {
+    {   6, -16, -18, -19, -19, -20 },
+    { -24,   6, -20, -22, -22, -22 },
+    { -27, -27,   6, -23, -25, -25 },
+    { -30, -30, -30,   6, -26, -28 },
+    { -33, -33, -33, -33,   6, -29 },
+    { -36, -36, -36, -36, -36,   6 },
+};
+
+/**
+ * Co-channel rejection (dB) of FSK
+ */
+#define FSK_SIR_THRESHOLD           9
+
+/**
+ * Sensitivity (dBm) of FSK at 50 kbps
+ */
+#define FSK_SENSITIVITY             -108.0f
+
+static uint8_t sf_index(uint32_t sf)
+{
+    if (sf < 7) {
+        return 0;
+    }
+
+    return sf > 12 ? 5 : sf - 7;
+}
+
+static float bandwidth_hz(const air_frame_t &frame)
+{
+    if (frame.modem == MODEM_FSK) {
+        return frame.bandwidth;
+    }
+
+    return 125000.0f * (1 << (frame.bandwidth < 3 ? frame.bandwidth : 0));
+}
+
+float SimLink::get_rx_power(const air_frame_t &frame, float x, float y)
+{
+    float dx = frame.x - x;
+    float dy = frame.y - y;
+    float distance = sqrtf(dx * dx + dy * dy);
+
+    if (distance < 1.0f) {
+        distance = 1.0f;
+    }
+
+    return frame.power - PATH_LOSS_REF
+           - 10.0f * PATH_LOSS_EXPONENT * log10f(distance / PATH_LOSS_REF_DISTANCE);
+}
+
+float SimLink::get_sensitivity(const air_frame_t &frame)
+{
+    if (frame.modem == MODEM_FSK) {
+        return FSK_SENSITIVITY;
+    }
+
+    return lora_sensitivity[sf_index(frame.datarate)]
+           + 10.0f * log10f(bandwidth_hz(frame) / 125000.0f);
+}
+
+float SimLink::get_snr(const air_frame_t &frame, float rx_power)
+{
+    float noise = -174.0f + 10.0f * log10f(bandwidth_hz(frame)) + LINK_NOISE_FIGURE;
+
+    return rx_power - noise;
+}
+
+bool SimLink::interferes(const air_frame_t &wanted, const air_frame_t &other)
+{
+    // a frame is told apart by its sender and start
+    bool same = other.sender_id == wanted.sender_id && other.start == wanted.start;
+
+    return !same
+           && other.frequency == wanted.frequency
+           && other.modem == wanted.modem
+           && other.iq_inverted == wanted.iq_inverted
+           && (int32_t)(other.start - wanted.end) < 0
+           && (int32_t)(other.end - wanted.start) > 0;
+}
+
+bool SimLink::survives(const air_frame_t &wanted, float wanted_power,
+                       const air_frame_t &other, float other_power)
+{
+    float threshold = FSK_SIR_THRESHOLD;
+
+    if (wanted.modem == MODEM_LORA) {
+        threshold = lora_sir_threshold[sf_index(wanted.datarate)][sf_index(other.datarate)];
+    }
+
+    return wanted_power - other_power >= threshold;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file SimLink.h
+ *
+ * @brief Propagation and interference model of the host simulation
+ *
+ *  - Path loss follows the log-distance model of LoRaSim (Bor et al.), 127.41
+ *    dB at 40 m and an exponent of 2.08, fit to measurements in a city.
+ *
+ *  - A LoRa frame can be demodulated down to the sensitivity of its spreading
+ *    factor, from the SX1276 data-sheet at 125 kHz, 3 dB less per doubling of
+ *    the bandwidth.
+ *
+ *  - Two frames interfere if they overlap in time on the same frequency and
+ *    with the same IQ polarity, downlinks being orthogonal to uplinks. The
+ *    wanted frame survives an interferer if its power is above the
+ *    interferer's by the threshold of Goursaud and Gorce, "Dedicated networks
+ *    for IoT: PHY / MAC state of the art and challenges": 6 dB for the same
+ *    spreading factor, which is the capture effect, and between -16 and -36
+ *    dB across spreading factors, which are quasi-orthogonal.
+ *
+ * FSK frames only interfere with FSK frames, with the co-channel threshold.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_LINK_H__
+#define MBED_LORAWAN_SIM_LINK_H__
+
+#include <stdint.h>
+#include "VirtualAir.h"
+
+/**
+ * Noise figure (dB) of the receivers
+ */
+#define LINK_NOISE_FIGURE           6
+
+class SimLink {
+public:
+    /** Power (dBm) a frame is received with
+     *
+     * @param frame         Frame, its power and the position of its sender
+     * @param x, y          Position (m) of the receiver
+     */
+    static float get_rx_power(const air_frame_t &frame, float x, float y);
+
+    /** Lowest power (dBm) a frame can be demodulated at
+     */
+    static float get_sensitivity(const air_frame_t &frame);
+
+    /** SNR (dB) of a frame received at a given power
+     */
+    static float get_snr(const air_frame_t &frame, float rx_power);
+
+    /** Both frames are on air at some point, on the same channel
+     */
+    static bool interferes(const air_frame_t &wanted, const air_frame_t &other);
+
+    /** The wanted frame is demodulated despite an interfering one
+     *
+     * @param wanted        Frame being received
+     * @param wanted_power  Power (dBm) it is received with
+     * @param other         Interfering frame
+     * @param other_power   Power (dBm) it is received with
+     */
+    static bool survives(const air_frame_t &wanted, float wanted_power,
+                         const air_frame_t &other, float other_power);
+};
+
+#endif /* MBED_LORAWAN_SIM_LINK_H__ */
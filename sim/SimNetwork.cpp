@@ -0,0 +1,71 @@
+/**
+ * @file SimNetwork.cpp
+ *
+ * @brief A gateway and its network server on a medium
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "SimNetwork.h"
+#include "SimNode.h"
+
+/**
+ * How long (ms) before its start the beacon is handed to the gateway
+ */
+#define BEACON_LEAD                 100
+
+SimNetwork::SimNetwork(VirtualAir &air, uint32_t max_devices, float x, float y)
+    : queue(SIM_QUEUE_SIZE, _queue_buffer),
+      gateway(x, y),
+      server(gateway, max_devices),
+      _transmitter(air, queue),
+      _beaconing(false),
+      _next_beacon(0)
+{
+    air.observe(mbed::callback(this, &SimNetwork::on_frame));
+    gateway.set_listener(mbed::callback(this, &SimNetwork::on_fate));
+    gateway.set_transmitter(mbed::callback(&_transmitter, &SimTransmitter::schedule));
+}
+
+void SimNetwork::on_frame(const air_frame_t &frame)
+{
+    // its own downlinks
+    if (!frame.sender) {
+        return;
+    }
+
+    gateway.add_frame(frame);
+    queue.call_in(frame.end - queue.tick(), this, &SimNetwork::resolve);
+}
+
+void SimNetwork::on_fate(const air_frame_t &frame, gateway_fate_t fate, float power)
+{
+    if (fate == GATEWAY_RECEIVED) {
+        server.on_uplink(frame, power);
+    }
+}
+
+void SimNetwork::resolve()
+{
+    gateway.resolve(queue.tick());
+}
+
+void SimNetwork::start_beacons()
+{
+    if (_beaconing) {
+        return;
+    }
+
+    _beaconing = true;
+    _next_beacon = server.get_next_beacon(queue.tick() + BEACON_LEAD);
+    queue.call_in(_next_beacon - BEACON_LEAD - queue.tick(), this, &SimNetwork::beacon);
+}
+
+void SimNetwork::beacon()
+{
+    server.send_beacon(_next_beacon);
+
+    _next_beacon += NS_BEACON_INTERVAL;
+    queue.call_in(_next_beacon - BEACON_LEAD - queue.tick(), this, &SimNetwork::beacon);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file SimNetwork.h
+ *
+ * @brief A gateway and its network server on a medium
+ *
+ * Wires a VirtualGateway and a VirtualNetworkServer to a VirtualAir for
+ * simulations on a single thread: the gateway is given every uplink as it
+ * starts and decides it at its end, from an event queue of its own which
+ * must be added to the SimClock of the medium, and its downlinks are put on
+ * the medium by a SimTransmitter. The network server can also be made to send
+ * the beacon, from the same queue, for Class B devices.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_NETWORK_H__
+#define MBED_LORAWAN_SIM_NETWORK_H__
+
+#include <stdint.h>
+#include "events/EventQueue.h"
+#include "platform/NonCopyable.h"
+#include "SimNode.h"
+#include "SimTransmitter.h"
+#include "VirtualAir.h"
+#include "VirtualGateway.h"
+#include "VirtualNetworkServer.h"
+
+class SimNetwork : private mbed::NonCopyable<SimNetwork> {
+public:
+    /** Creates a network on a medium
+     *
+     * @param air           Medium
+     * @param max_devices   Devices the network server can know
+     * @param x, y          Position (m) of the gateway
+     */
+    SimNetwork(VirtualAir &air, uint32_t max_devices, float x = 0, float y = 0);
+
+    /** Has the network server send the beacon of every period from the next
+     * one on, see VirtualNetworkServer::send_beacon()
+     */
+    void start_beacons();
+
+    events::EventQueue queue;
+    VirtualGateway gateway;
+    VirtualNetworkServer server;
+
+private:
+    void on_frame(const air_frame_t &frame);
+
+    void on_fate(const air_frame_t &frame, gateway_fate_t fate, float power);
+
+    void resolve();
+
+    void beacon();
+
+    SimTransmitter _transmitter;
+    /**
+     * Beacons are sent, and the start of the next one
+     */
+    bool _beaconing;
+    lorawan_time_t _next_beacon;
+    unsigned char _queue_buffer[SIM_QUEUE_SIZE];
+};
+
+#endif /* MBED_LORAWAN_SIM_NETWORK_H__ */
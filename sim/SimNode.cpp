@@ -0,0 +1,130 @@
+/**
+ * @file SimNode.cpp
+ *
+ * @brief A simulated device
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "SimNode.h"
+#include "SimKeys.h"
+#include "sim_random.h"
+
+uint8_t sim_app_eui[8] = { 0x70, 0xB3, 0xD5, 0x7E, 0xD0, 0x00, 0x00, 0x01 };
+
+uint8_t sim_app_key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                            0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+                          };
+
+uint8_t sim_nwk_skey[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                             0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10
+                           };
+
+uint8_t sim_app_skey[16] = { 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+                             0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20
+                           };
+
+SimNode::SimNode(VirtualAir &air, uint32_t id)
+    : queue(SIM_QUEUE_SIZE, _queue_buffer),
+      radio(air, queue, id),
+      lorawan(radio),
+      random(id),
+      _awaited(CONNECTED),
+      _awaited_count(0)
+{
+    memset(_counts, 0, sizeof(_counts));
+    _callbacks.events = mbed::callback(this, &SimNode::on_event);
+}
+
+lorawan_status_t SimNode::start()
+{
+    // the stack seeds rand() as it initializes
+    unsigned int *previous = sim_rand_select(&random);
+    lorawan_status_t status = lorawan.initialize(&queue);
+    sim_rand_select(previous);
+    if (status != LORAWAN_STATUS_OK) {
+        return status;
+    }
+
+    return lorawan.add_app_callbacks(&_callbacks);
+}
+
+lorawan_status_t SimNode::connect_abp(uint32_t dev_addr)
+{
+    lorawan_connect_t params;
+    params.connect_type = LORAWAN_CONNECTION_ABP;
+    params.connection_u.abp.nwk_id = dev_addr >> 25;
+    params.connection_u.abp.dev_addr = dev_addr;
+    params.connection_u.abp.nwk_skey = sim_nwk_skey;
+    params.connection_u.abp.app_skey = sim_app_skey;
+
+    return lorawan.connect(params);
+}
+
+lorawan_status_t SimNode::connect_otaa(uint8_t *dev_eui, uint8_t nb_trials, uint8_t *app_key)
+{
+    lorawan_connect_t params;
+    params.connect_type = LORAWAN_CONNECTION_OTAA;
+    params.connection_u.otaa.dev_eui = dev_eui;
+    params.connection_u.otaa.app_eui = sim_app_eui;
+    params.connection_u.otaa.app_key = app_key ? app_key : sim_app_key;
+    params.connection_u.otaa.nb_trials = nb_trials;
+
+    return lorawan.connect(params);
+}
+
+lorawan_status_t SimNode::set_rx_frame(mbed::Callback<void(const lorawan_rx_frame_t &)> rx_frame)
+{
+    _callbacks.rx_frame = rx_frame;
+
+    return lorawan.add_app_callbacks(&_callbacks);
+}
+
+lorawan_status_t SimNode::set_uplink_status(mbed::Callback<void(int16_t, lorawan_event_t)> uplink_status)
+{
+    _callbacks.uplink_status = uplink_status;
+
+    return lorawan.add_app_callbacks(&_callbacks);
+}
+
+void SimNode::set_listener(mbed::Callback<void(lorawan_event_t)> listener)
+{
+    _listener = listener;
+}
+
+uint32_t SimNode::count(lorawan_event_t event) const
+{
+    return event < SIM_MAX_EVENT ? _counts[event] : 0;
+}
+
+mbed::Callback<bool()> SimNode::seen(lorawan_event_t event)
+{
+    _awaited = event;
+    _awaited_count = 0;
+    return mbed::callback(this, &SimNode::awaited_seen);
+}
+
+mbed::Callback<bool()> SimNode::seen_next(lorawan_event_t event)
+{
+    _awaited = event;
+    _awaited_count = count(event);
+    return mbed::callback(this, &SimNode::awaited_seen);
+}
+
+void SimNode::on_event(lorawan_event_t event)
+{
+    if (event < SIM_MAX_EVENT) {
+        _counts[event]++;
+    }
+
+    if (_listener) {
+        _listener(event);
+    }
+}
+
+bool SimNode::awaited_seen()
+{
+    return count(_awaited) > _awaited_count;
+}
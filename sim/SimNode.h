@@ -0,0 +1,108 @@
+/**
+ * @file SimNode.h
+ *
+ * @brief A simulated device
+ *
+ * A LoRaWANInterface over a VirtualRadio, with an event queue of its own
+ * which is driven by a SimClock. The node counts the events the stack posts
+ * and forwards them to an optional listener. The stack draws from a rand()
+ * of its own, see sim_random.h.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_NODE_H__
+#define MBED_LORAWAN_SIM_NODE_H__
+
+#include <stdint.h>
+#include "events/EventQueue.h"
+#include "platform/NonCopyable.h"
+#include "lorawan/LoRaWANInterface.h"
+#include "VirtualAir.h"
+#include "VirtualRadio.h"
+
+/**
+ * Size of the event queue of a node
+ */
+#define SIM_QUEUE_SIZE              (16 * EVENTS_EVENT_SIZE)
+
+/**
+ * Events counted, lorawan_event_t values above are not
+ */
+#define SIM_MAX_EVENT               32
+
+class SimNode : private mbed::NonCopyable<SimNode> {
+public:
+    /** Creates a device
+     *
+     * @param air           Medium of the radio
+     * @param id            Identifier of the radio on the medium
+     */
+    SimNode(VirtualAir &air, uint32_t id);
+
+    /** Initializes the stack and registers the callbacks
+     */
+    lorawan_status_t start();
+
+    /** Connects with ABP and the session keys of the simulation
+     */
+    lorawan_status_t connect_abp(uint32_t dev_addr);
+
+    /** Connects with OTAA and the root keys of the simulation
+     *
+     * @param dev_eui       Device EUI, kept by the stack
+     * @param nb_trials     Join requests sent before giving up
+     * @param app_key       AppKey, kept by the stack, sim_app_key if NULL
+     */
+    lorawan_status_t connect_otaa(uint8_t *dev_eui, uint8_t nb_trials, uint8_t *app_key = NULL);
+
+    /** Has the stack hand received frames over to a callback, instead of
+     * RX_DONE and receive()
+     */
+    lorawan_status_t set_rx_frame(mbed::Callback<void(const lorawan_rx_frame_t &)> rx_frame);
+
+    /** Has the stack report the outcome of each message of queue_send() to a
+     * callback
+     */
+    lorawan_status_t set_uplink_status(mbed::Callback<void(int16_t, lorawan_event_t)> uplink_status);
+
+    /** Sets a listener of the events posted by the stack
+     */
+    void set_listener(mbed::Callback<void(lorawan_event_t)> listener);
+
+    /** Number of times an event was posted
+     */
+    uint32_t count(lorawan_event_t event) const;
+
+    /** Condition for SimClock::run_until(), an event was posted
+     */
+    mbed::Callback<bool()> seen(lorawan_event_t event);
+
+    /** Condition for SimClock::run_until(), an event was posted since the call
+     */
+    mbed::Callback<bool()> seen_next(lorawan_event_t event);
+
+    events::EventQueue queue;
+    VirtualRadio radio;
+    LoRaWANInterface lorawan;
+    /**
+     * State of rand() for the stack, to be given to the SimClock with the
+     * queue
+     */
+    unsigned int random;
+
+private:
+    void on_event(lorawan_event_t event);
+
+    bool awaited_seen();
+
+    lorawan_app_callbacks_t _callbacks;
+    mbed::Callback<void(lorawan_event_t)> _listener;
+    uint32_t _counts[SIM_MAX_EVENT];
+    lorawan_event_t _awaited;
+    uint32_t _awaited_count;
+    unsigned char _queue_buffer[SIM_QUEUE_SIZE];
+};
+
+#endif /* MBED_LORAWAN_SIM_NODE_H__ */
@@ -0,0 +1,61 @@
+/**
+ * @file SimTransmitter.cpp
+ *
+ * @brief Puts frames on a medium at their start, for senders without a radio
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "SimTransmitter.h"
+
+using namespace events;
+
+SimTransmitter::SimTransmitter(VirtualAir &air, EventQueue &queue)
+    : _air(air),
+      _queue(queue),
+      _dropped_count(0)
+{
+    memset(_pending, 0, sizeof(_pending));
+}
+
+SimTransmitter::~SimTransmitter()
+{
+    for (uint8_t i = 0; i < TRANSMITTER_MAX_FRAMES; i++) {
+        if (_pending[i]) {
+            _queue.cancel(_pending[i]);
+        }
+    }
+}
+
+bool SimTransmitter::schedule(const air_frame_t &frame)
+{
+    int32_t delay = (int32_t)(frame.start - _queue.tick());
+
+    for (uint8_t i = 0; delay >= 0 && i < TRANSMITTER_MAX_FRAMES; i++) {
+        if (!_pending[i]) {
+            _frames[i] = frame;
+            _pending[i] = _queue.call_in(delay, this, &SimTransmitter::transmit, i);
+            if (_pending[i]) {
+                return true;
+            }
+            break;
+        }
+    }
+
+    _dropped_count++;
+
+    return false;
+}
+
+uint32_t SimTransmitter::get_dropped_count() const
+{
+    return _dropped_count;
+}
+
+void SimTransmitter::transmit(uint8_t slot)
+{
+    _pending[slot] = 0;
+    _air.transmit(_frames[slot]);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file SimTransmitter.h
+ *
+ * @brief Puts frames on a medium at their start, for senders without a radio
+ *
+ * A gateway decides its downlinks ahead of time; the transmitter holds them
+ * and puts each on air when its start comes, from an event queue driven by
+ * the SimClock of the medium.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_TRANSMITTER_H__
+#define MBED_LORAWAN_SIM_TRANSMITTER_H__
+
+#include <stdint.h>
+#include "events/EventQueue.h"
+#include "platform/NonCopyable.h"
+#include "VirtualAir.h"
+
+/**
+ * Frames held at once
+ */
+#define TRANSMITTER_MAX_FRAMES      16
+
+class SimTransmitter : private mbed::NonCopyable<SimTransmitter> {
+public:
+    /** Creates a transmitter
+     *
+     * @param air           Medium the frames are put on
+     * @param queue         Queue the transmissions are posted to
+     */
+    SimTransmitter(VirtualAir &air, events::EventQueue &queue);
+
+    ~SimTransmitter();
+
+    /** Holds a frame until its start
+     *
+     * @return              false if too many frames are held, or its start
+     *                      is in the past
+     */
+    bool schedule(const air_frame_t &frame);
+
+    /** Frames which could not be held
+     */
+    uint32_t get_dropped_count() const;
+
+private:
+    void transmit(uint8_t slot);
+
+    VirtualAir &_air;
+    events::EventQueue &_queue;
+
+    air_frame_t _frames[TRANSMITTER_MAX_FRAMES];
+    /**
+     * Event putting each frame on air, 0 if the slot is free
+     */
+    int _pending[TRANSMITTER_MAX_FRAMES];
+
+    uint32_t _dropped_count;
+};
+
+#endif /* MBED_LORAWAN_SIM_TRANSMITTER_H__ */
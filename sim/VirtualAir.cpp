@@ -0,0 +1,139 @@
+/**
+ * @file VirtualAir.cpp
+ *
+ * @brief Radio medium of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "VirtualAir.h"
+#include "VirtualRadio.h"
+#include "SimLink.h"
+
+VirtualAir::VirtualAir(uint32_t max_radios, uint32_t max_frames)
+    : _max_radios(max_radios),
+      _nb_radios(0),
+      _max_frames(max_frames),
+      _frame_count(0),
+      _overflow_count(0)
+{
+    _radios = new VirtualRadio *[max_radios];
+    _frames = new air_frame_t[max_frames];
+    _in_use = new bool[max_frames];
+    memset(_in_use, 0, max_frames * sizeof(bool));
+}
+
+VirtualAir::~VirtualAir()
+{
+    delete[] _radios;
+    delete[] _frames;
+    delete[] _in_use;
+}
+
+bool VirtualAir::attach(VirtualRadio *radio)
+{
+    if (_nb_radios == _max_radios) {
+        return false;
+    }
+
+    _radios[_nb_radios++] = radio;
+
+    return true;
+}
+
+void VirtualAir::detach(VirtualRadio *radio)
+{
+    for (uint32_t i = 0; i < _nb_radios; i++) {
+        if (_radios[i] == radio) {
+            _radios[i] = _radios[--_nb_radios];
+            return;
+        }
+    }
+}
+
+bool VirtualAir::observe(mbed::Callback<void(const air_frame_t &)> observer)
+{
+    for (uint8_t i = 0; i < AIR_MAX_OBSERVERS; i++) {
+        if (!_observers[i]) {
+            _observers[i] = observer;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool VirtualAir::transmit(const air_frame_t &frame)
+{
+    air_frame_t *slot = NULL;
+
+    for (uint32_t i = 0; i < _max_frames; i++) {
+        // nothing still kept can overlap frames over for that long
+        if (!_in_use[i] || (int32_t)(_frames[i].end + AIR_RETENTION - frame.start) <= 0) {
+            _in_use[i] = true;
+            slot = &_frames[i];
+            break;
+        }
+    }
+
+    if (!slot) {
+        _overflow_count++;
+        return false;
+    }
+
+    *slot = frame;
+    _frame_count++;
+
+    for (uint8_t i = 0; i < AIR_MAX_OBSERVERS; i++) {
+        if (_observers[i]) {
+            _observers[i](*slot);
+        }
+    }
+
+    for (uint32_t i = 0; i < _nb_radios; i++) {
+        if (_radios[i] != frame.sender) {
+            _radios[i]->on_frame_start(*slot);
+        }
+    }
+
+    return true;
+}
+
+const air_frame_t *VirtualAir::get_frame(lorawan_time_t at, uint32_t index) const
+{
+    for (uint32_t i = 0; i < _max_frames; i++) {
+        if (_in_use[i] && (int32_t)(_frames[i].end - at) > 0
+                && (int32_t)(_frames[i].start - at) <= 0) {
+            if (index-- == 0) {
+                return &_frames[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+const air_frame_t *VirtualAir::get_interferer(const air_frame_t &frame, uint32_t index) const
+{
+    for (uint32_t i = 0; i < _max_frames; i++) {
+        if (_in_use[i] && SimLink::interferes(frame, _frames[i])) {
+            if (index-- == 0) {
+                return &_frames[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t VirtualAir::get_frame_count() const
+{
+    return _frame_count;
+}
+
+uint32_t VirtualAir::get_overflow_count() const
+{
+    return _overflow_count;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file VirtualAir.h
+ *
+ * @brief Radio medium of the host simulation
+ *
+ * Every VirtualRadio of a simulation is attached to the same medium. A
+ * transmission is a frame with its RF parameters, its sender and where it
+ * is, and its start and end on the virtual clock; the medium hands it over to
+ * every other radio when it starts. It keeps frames for AIR_RETENTION after
+ * their end, so a receiver opened late can still catch a preamble, and a
+ * receiver at the end of a frame can still see everything which overlapped
+ * it.
+ *
+ * Radios decide themselves whether they can hear a frame, see VirtualRadio
+ * and SimLink. Observers, e.g. a gateway, see every frame as it starts and
+ * can put frames on air without a radio of their own.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_VIRTUAL_AIR_H__
+#define MBED_LORAWAN_SIM_VIRTUAL_AIR_H__
+
+#include <stdint.h>
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+#include "lorawan/LoRaRadio.h"
+#include "lorawan/system/lorawan_data_structures.h"
+
+/**
+ * Default number of radios attached to a medium
+ */
+#define AIR_MAX_RADIOS              16
+
+/**
+ * Default number of frames kept at once
+ */
+#define AIR_MAX_FRAMES              32
+
+/**
+ * Observers of a medium
+ */
+#define AIR_MAX_OBSERVERS           4
+
+/**
+ * Time (ms) frames are kept after their end, above the longest time on air
+ */
+#define AIR_RETENTION               10000
+
+class VirtualRadio;
+
+/**
+ * A frame on air
+ */
+typedef struct {
+    /**
+     * Radio it comes from, NULL if put on air by an observer
+     */
+    VirtualRadio *sender;
+    /**
+     * Identifier of the sender, unique in a simulation
+     */
+    uint32_t sender_id;
+    /**
+     * Position (m) of the sender
+     */
+    float x;
+    float y;
+    radio_modems_t modem;
+    uint32_t frequency;
+    /**
+     * LoRa: bandwidth index, FSK: bandwidth in Hz
+     */
+    uint32_t bandwidth;
+    /**
+     * LoRa: spreading factor, FSK: bits/s
+     */
+    uint32_t datarate;
+    uint8_t coderate;
+    uint16_t preamble_len;
+    bool crc_on;
+    bool iq_inverted;
+    bool public_network;
+    /**
+     * Transmit power (dBm)
+     */
+    int8_t power;
+    lorawan_time_t start;
+    lorawan_time_t end;
+    uint8_t size;
+    uint8_t payload[255];
+} air_frame_t;
+
+class VirtualAir : private mbed::NonCopyable<VirtualAir> {
+public:
+    /** Creates a medium
+     *
+     * @param max_radios    Radios which can be attached
+     * @param max_frames    Frames kept at once, on air or within
+     *                      AIR_RETENTION of their end
+     */
+    VirtualAir(uint32_t max_radios = AIR_MAX_RADIOS, uint32_t max_frames = AIR_MAX_FRAMES);
+
+    ~VirtualAir();
+
+    /** Attaches a radio
+     *
+     * @return              false if there are too many radios
+     */
+    bool attach(VirtualRadio *radio);
+
+    void detach(VirtualRadio *radio);
+
+    /** Adds an observer of every frame put on air
+     *
+     * @return              false if there are too many observers
+     */
+    bool observe(mbed::Callback<void(const air_frame_t &)> observer);
+
+    /** Puts a frame on air
+     *
+     * Its start and end must be set, its start is normally now.
+     *
+     * @return              false if the medium is saturated
+     */
+    bool transmit(const air_frame_t &frame);
+
+    /** Frames on air at a given time
+     *
+     * @param at            Time of interest
+     * @param index         Frame wanted, from 0
+     *
+     * @return              The frame, NULL past the last one
+     */
+    const air_frame_t *get_frame(lorawan_time_t at, uint32_t index) const;
+
+    /** Frames interfering with a frame, see SimLink::interferes()
+     *
+     * @param frame         Frame of interest, still kept
+     * @param index         Frame wanted, from 0
+     *
+     * @return              The frame, NULL past the last one
+     */
+    const air_frame_t *get_interferer(const air_frame_t &frame, uint32_t index) const;
+
+    /** Number of frames put on air so far
+     */
+    uint32_t get_frame_count() const;
+
+    /** Number of frames dropped as the medium was saturated
+     */
+    uint32_t get_overflow_count() const;
+
+private:
+    VirtualRadio **_radios;
+    uint32_t _max_radios;
+    uint32_t _nb_radios;
+
+    mbed::Callback<void(const air_frame_t &)> _observers[AIR_MAX_OBSERVERS];
+
+    air_frame_t *_frames;
+    bool *_in_use;
+    uint32_t _max_frames;
+
+    uint32_t _frame_count;
+    uint32_t _overflow_count;
+};
+
+#endif /* MBED_LORAWAN_SIM_VIRTUAL_AIR_H__ */
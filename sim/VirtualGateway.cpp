@@ -0,0 +1,227 @@
+/**
+ * @file VirtualGateway.cpp
+ *
+ * @brief Gateway of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+#include "VirtualGateway.h"
+#include "SimLink.h"
+
+/**
+ * EU868 sub-bands (Hz) and their duty cycle, as 1 / share of the time
+ */
+static const struct {
+    uint32_t low;
+    uint32_t high;
+    uint16_t duty_cycle;
+} gateway_bands[GATEWAY_BANDS] = {
+    { 863000000, 868000000, 100 },
+    { 868000000, 868600000, 100 },
+    { 868700000, 869200000, 1000 },
+    { 869400000, 869650000, 10 },
+    { 869700000, 870000000, 100 },
+};
+
+VirtualGateway::VirtualGateway(float x, float y, uint32_t max_frames)
+    : _x(x),
+      _y(y),
+      _max_frames(max_frames),
+      _first(0),
+      _nb_entries(0),
+      _nb_decided(0),
+      _nb_downlinks(0)
+{
+    _entries = new entry_t[max_frames];
+    memset(_busy_until, 0, sizeof(_busy_until));
+    memset(_band_ready, 0, sizeof(_band_ready));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+VirtualGateway::~VirtualGateway()
+{
+    delete[] _entries;
+}
+
+void VirtualGateway::set_listener(mbed::Callback<void(const air_frame_t &, gateway_fate_t, float)> listener)
+{
+    _listener = listener;
+}
+
+void VirtualGateway::set_transmitter(mbed::Callback<bool(const air_frame_t &)> transmitter)
+{
+    _transmitter = transmitter;
+}
+
+bool VirtualGateway::transmit(const air_frame_t &frame)
+{
+    int8_t band = -1;
+
+    for (uint8_t i = 0; i < GATEWAY_BANDS; i++) {
+        if (frame.frequency >= gateway_bands[i].low && frame.frequency <= gateway_bands[i].high) {
+            band = i;
+        }
+    }
+
+    if (_nb_downlinks == GATEWAY_MAX_DOWNLINKS || transmitting(frame)
+            || (band >= 0 && (int32_t)(_band_ready[band] - frame.start) > 0)) {
+        _stats.downlink_rejected++;
+        return false;
+    }
+
+    if (_transmitter && !_transmitter(frame)) {
+        _stats.downlink_rejected++;
+        return false;
+    }
+
+    if (band >= 0) {
+        _band_ready[band] = frame.end
+                            + (frame.end - frame.start) * (gateway_bands[band].duty_cycle - 1);
+    }
+
+    _downlinks[_nb_downlinks++] = frame;
+    _stats.downlink_count++;
+
+    return true;
+}
+
+void VirtualGateway::add_frame(const air_frame_t &frame)
+{
+    if (frame.iq_inverted) {
+        return;
+    }
+
+    _stats.frame_count++;
+
+    if (_nb_entries == _max_frames) {
+        _stats.overflow_count++;
+        return;
+    }
+
+    entry_t &added = entry(_nb_entries++);
+    added.frame = frame;
+    added.power = SimLink::get_rx_power(frame, _x, _y);
+    added.decided = false;
+    added.demodulated = false;
+
+    // too weak to be detected, it does not hold a demodulator
+    if (added.power < SimLink::get_sensitivity(frame)) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < GATEWAY_DEMODULATORS; i++) {
+        if ((int32_t)(_busy_until[i] - frame.start) <= 0) {
+            _busy_until[i] = frame.end;
+            added.demodulated = true;
+            return;
+        }
+    }
+}
+
+void VirtualGateway::resolve(lorawan_time_t until)
+{
+    for (uint32_t i = _nb_decided; i < _nb_entries; i++) {
+        entry_t &wanted = entry(i);
+
+        if (wanted.decided || (int32_t)(wanted.frame.end - until) > 0) {
+            continue;
+        }
+
+        if (wanted.power < SimLink::get_sensitivity(wanted.frame)) {
+            decide(wanted, GATEWAY_LOST_WEAK);
+        } else if (!wanted.demodulated) {
+            decide(wanted, GATEWAY_LOST_DEMODULATOR);
+        } else if (transmitting(wanted.frame)) {
+            decide(wanted, GATEWAY_LOST_TRANSMITTING);
+        } else if (!survives(wanted)) {
+            decide(wanted, GATEWAY_LOST_COLLISION);
+        } else {
+            decide(wanted, GATEWAY_RECEIVED);
+        }
+    }
+
+    while (_nb_decided < _nb_entries && entry(_nb_decided).decided) {
+        _nb_decided++;
+    }
+
+    // nothing undecided started before these ended
+    while (_nb_decided > 0
+            && (int32_t)(entry(0).frame.end + AIR_RETENTION - until) <= 0) {
+        _first = (_first + 1) % _max_frames;
+        _nb_entries--;
+        _nb_decided--;
+    }
+
+    for (uint32_t i = 0; i < _nb_downlinks;) {
+        if ((int32_t)(_downlinks[i].end + AIR_RETENTION - until) <= 0) {
+            _downlinks[i] = _downlinks[--_nb_downlinks];
+        } else {
+            i++;
+        }
+    }
+}
+
+float VirtualGateway::get_x() const
+{
+    return _x;
+}
+
+float VirtualGateway::get_y() const
+{
+    return _y;
+}
+
+const virtual_gateway_stats_t &VirtualGateway::get_stats() const
+{
+    return _stats;
+}
+
+VirtualGateway::entry_t &VirtualGateway::entry(uint32_t index) const
+{
+    return _entries[(_first + index) % _max_frames];
+}
+
+bool VirtualGateway::survives(const entry_t &wanted) const
+{
+    for (uint32_t i = 0; i < _nb_entries; i++) {
+        const entry_t &other = entry(i);
+
+        // kept in the order they start, none of the rest overlaps
+        if ((int32_t)(other.frame.start - wanted.frame.end) >= 0) {
+            break;
+        }
+
+        if (SimLink::interferes(wanted.frame, other.frame)
+                && !SimLink::survives(wanted.frame, wanted.power, other.frame, other.power)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool VirtualGateway::transmitting(const air_frame_t &wanted) const
+{
+    // half-duplex, whatever the channel
+    for (uint32_t i = 0; i < _nb_downlinks; i++) {
+        if ((int32_t)(_downlinks[i].start - wanted.end) < 0
+                && (int32_t)(wanted.start - _downlinks[i].end) < 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void VirtualGateway::decide(entry_t &wanted, gateway_fate_t fate)
+{
+    wanted.decided = true;
+    _stats.fate_count[fate]++;
+
+    if (_listener) {
+        _listener(wanted.frame, fate, wanted.power);
+    }
+}
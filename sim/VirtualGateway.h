@@ -0,0 +1,221 @@
+/**
+ * @file VirtualGateway.h
+ *
+ * @brief Gateway of the host simulation
+ *
+ * A multi-channel receiver at a fixed position. It is given every uplink
+ * put on air, in the order they start, and decides what becomes of each:
+ *
+ *  - frames below the sensitivity of their spreading factor are lost,
+ *
+ *  - the others take one of GATEWAY_DEMODULATORS demodulators from their
+ *    start to their end, like the SX1301 does; frames starting while every
+ *    demodulator is busy are lost,
+ *
+ *  - a demodulated frame is received if it survives every frame which
+ *    overlapped it, see SimLink, and the gateway was not transmitting
+ *    meanwhile.
+ *
+ * A frame is only decided once its end is known to be in the past, see
+ * resolve(), as an interferer may still start while it is on air. Frames
+ * are then kept for AIR_RETENTION after their end, as long as they can
+ * interfere with undecided ones.
+ *
+ * Downlinks are not received: their IQ polarity is inverted.
+ *
+ * The gateway transmits what a network server hands it, one frame at a time
+ * and within the duty cycle of the EU868 sub-band of the frame.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_VIRTUAL_GATEWAY_H__
+#define MBED_LORAWAN_SIM_VIRTUAL_GATEWAY_H__
+
+#include <stdint.h>
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+#include "VirtualAir.h"
+
+/**
+ * Frames a gateway demodulates at once
+ */
+#define GATEWAY_DEMODULATORS        8
+
+/**
+ * Default number of frames kept at once
+ */
+#define GATEWAY_MAX_FRAMES          4096
+
+/**
+ * Downlinks a gateway has scheduled at once
+ */
+#define GATEWAY_MAX_DOWNLINKS       16
+
+/**
+ * EU868 sub-bands with a duty cycle of their own
+ */
+#define GATEWAY_BANDS               5
+
+/**
+ * What became of an uplink
+ */
+typedef enum {
+    GATEWAY_RECEIVED,
+    /**
+     * Below the sensitivity
+     */
+    GATEWAY_LOST_WEAK,
+    /**
+     * No demodulator was free
+     */
+    GATEWAY_LOST_DEMODULATOR,
+    /**
+     * Did not survive an interferer
+     */
+    GATEWAY_LOST_COLLISION,
+    /**
+     * The gateway was transmitting
+     */
+    GATEWAY_LOST_TRANSMITTING,
+    GATEWAY_FATES
+} gateway_fate_t;
+
+/**
+ * Uplinks seen by a gateway
+ */
+typedef struct {
+    uint32_t frame_count;
+    /**
+     * Frames per fate
+     */
+    uint32_t fate_count[GATEWAY_FATES];
+    /**
+     * Frames dropped as the gateway was saturated, never decided
+     */
+    uint32_t overflow_count;
+    uint32_t downlink_count;
+    /**
+     * Downlinks refused as the gateway was busy or out of duty cycle
+     */
+    uint32_t downlink_rejected;
+} virtual_gateway_stats_t;
+
+class VirtualGateway : private mbed::NonCopyable<VirtualGateway> {
+public:
+    /** Creates a gateway
+     *
+     * @param x, y          Position (m)
+     * @param max_frames    Frames kept at once, undecided or within
+     *                      AIR_RETENTION of their end
+     */
+    VirtualGateway(float x, float y, uint32_t max_frames = GATEWAY_MAX_FRAMES);
+
+    ~VirtualGateway();
+
+    /** Sets what is told the fate of every uplink
+     *
+     * It is called from resolve(), with the frame and the power (dBm) it is
+     * received with.
+     */
+    void set_listener(mbed::Callback<void(const air_frame_t &, gateway_fate_t, float)> listener);
+
+    /** Sets what puts the frames the gateway transmits on air, at their start
+     *
+     * It returns false if it cannot take the frame.
+     */
+    void set_transmitter(mbed::Callback<bool(const air_frame_t &)> transmitter);
+
+    /** Transmits a frame
+     *
+     * The frame must be ready for the medium: its start in the future and its
+     * end set.
+     *
+     * @return              false if the gateway is busy with another frame
+     *                      then, the sub-band is out of duty cycle, or the
+     *                      transmitter cannot take it
+     */
+    bool transmit(const air_frame_t &frame);
+
+    /** An uplink starts
+     *
+     * Frames must be added in the order they start, those starting at the
+     * same time by sender identifier, so runs are repeatable. It can observe
+     * a VirtualAir.
+     */
+    void add_frame(const air_frame_t &frame);
+
+    /** Decides the frames which ended
+     *
+     * Every frame starting before 'until' must have been added.
+     *
+     * @param until         Time up to which the medium is known
+     */
+    void resolve(lorawan_time_t until);
+
+    float get_x() const;
+    float get_y() const;
+
+    const virtual_gateway_stats_t &get_stats() const;
+
+private:
+    /**
+     * A frame kept and what is known of it
+     */
+    typedef struct {
+        air_frame_t frame;
+        float power;
+        bool decided;
+        /**
+         * A demodulator was free at its start, decided when added
+         */
+        bool demodulated;
+    } entry_t;
+
+    entry_t &entry(uint32_t index) const;
+
+    bool survives(const entry_t &wanted) const;
+
+    bool transmitting(const air_frame_t &wanted) const;
+
+    void decide(entry_t &wanted, gateway_fate_t fate);
+
+    float _x;
+    float _y;
+
+    mbed::Callback<void(const air_frame_t &, gateway_fate_t, float)> _listener;
+    mbed::Callback<bool(const air_frame_t &)> _transmitter;
+
+    /**
+     * Frames in the order they start, a ring of _max_frames
+     */
+    entry_t *_entries;
+    uint32_t _max_frames;
+    uint32_t _first;
+    uint32_t _nb_entries;
+    /**
+     * Entries before it are decided
+     */
+    uint32_t _nb_decided;
+
+    /**
+     * End of the frame each demodulator is busy with
+     */
+    lorawan_time_t _busy_until[GATEWAY_DEMODULATORS];
+
+    /**
+     * Frames transmitted, kept as long as undecided uplinks may overlap them
+     */
+    air_frame_t _downlinks[GATEWAY_MAX_DOWNLINKS];
+    uint32_t _nb_downlinks;
+
+    /**
+     * Time each sub-band is available again
+     */
+    lorawan_time_t _band_ready[GATEWAY_BANDS];
+
+    virtual_gateway_stats_t _stats;
+};
+
+#endif /* MBED_LORAWAN_SIM_VIRTUAL_GATEWAY_H__ */
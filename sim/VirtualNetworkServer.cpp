@@ -0,0 +1,1142 @@
+/**
+ * @file VirtualNetworkServer.cpp
+ *
+ * @brief Network server of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <string.h>
+#include "mbedtls/aes.h"
+#include "mbedtls/cipher.h"
+#include "mbedtls/cmac.h"
+#include "VirtualNetworkServer.h"
+#include "VirtualRadio.h"
+#include "SimLink.h"
+
+/**
+ * NetID of the network, type 0 experimental; devices joining get the
+ * DevAddr of their index
+ */
+#define NS_NET_ID                   0x000000
+
+/**
+ * Largest gap in the frame counter accepted
+ */
+#define NS_MAX_FCNT_GAP             16384
+
+/**
+ * EU868 defaults
+ */
+#define NS_RECEIVE_DELAY1           1000
+#define NS_JOIN_ACCEPT_DELAY1       5000
+#define NS_RX2_FREQUENCY            869525000
+#define NS_RX2_DATARATE             DR_0
+#define NS_DEFAULT_CHANNELS         0x0007
+#define NS_MAX_DATARATE             DR_5
+#define NS_MAX_TX_POWER             7
+
+/**
+ * EU868 Class B: the beacon, whose channel and datarate are those of the
+ * ping slots too
+ */
+#define NS_BEACON_FREQUENCY         869525000
+#define NS_BEACON_DATARATE          DR_3
+#define NS_BEACON_PREAMBLE_LEN      10
+#define NS_BEACON_SIZE              17
+#define NS_BEACON_RESERVED          2120
+#define NS_PING_SLOT_COUNT          4096
+#define NS_PING_SLOT_WINDOW         30
+
+/**
+ * Sizes (bytes) of the frames
+ */
+#define NS_MHDR_SIZE                1
+#define NS_FHDR_SIZE                7
+#define NS_MIC_SIZE                 4
+#define NS_MAX_FOPTS                15
+#define NS_JOIN_REQUEST_SIZE        23
+#define NS_JOIN_ACCEPT_SIZE         17
+
+/**
+ * Bits of FCtrl
+ */
+#define NS_FCTRL_ADR                0x80
+#define NS_FCTRL_ADR_ACK_REQ        0x40
+#define NS_FCTRL_ACK                0x20
+#define NS_FCTRL_CLASS_B            0x10
+
+/**
+ * Largest MACPayload less FHDR and FPort, per datarate
+ */
+static const uint8_t max_payload[NS_MAX_DATARATE + 1] = { 51, 51, 51, 115, 222, 222 };
+
+/**
+ * SNR (dB) the demodulator needs, per datarate
+ */
+static const float required_snr[NS_MAX_DATARATE + 1] = { -20.0f, -17.5f, -15.0f, -12.5f, -10.0f, -7.5f };
+
+static uint32_t read_u32(const uint8_t *buffer)
+{
+    return (uint32_t) buffer[0] | ((uint32_t) buffer[1] << 8)
+           | ((uint32_t) buffer[2] << 16) | ((uint32_t) buffer[3] << 24);
+}
+
+static void write_u32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+static void write_u24(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+}
+
+/**
+ * AES-CMAC of a message, prefixed with a block if not NULL, its 4 first
+ * bytes as the MIC is read
+ */
+static uint32_t compute_mic(const uint8_t *key, const uint8_t *block,
+                            const uint8_t *buffer, uint16_t size)
+{
+    uint8_t cmac[16];
+    mbedtls_cipher_context_t ctx;
+
+    mbedtls_cipher_init(&ctx);
+    mbedtls_cipher_setup(&ctx, mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB));
+    mbedtls_cipher_cmac_starts(&ctx, key, 128);
+    if (block) {
+        mbedtls_cipher_cmac_update(&ctx, block, 16);
+    }
+    mbedtls_cipher_cmac_update(&ctx, buffer, size);
+    mbedtls_cipher_cmac_finish(&ctx, cmac);
+    mbedtls_cipher_free(&ctx);
+
+    return read_u32(cmac);
+}
+
+/**
+ * Block B0, or A_i, of a data frame
+ */
+static void data_block(uint8_t *block, uint8_t first, uint8_t dir, uint32_t dev_addr,
+                       uint32_t fcnt, uint8_t last)
+{
+    memset(block, 0, 16);
+    block[0] = first;
+    block[5] = dir;
+    write_u32(&block[6], dev_addr);
+    write_u32(&block[10], fcnt);
+    block[15] = last;
+}
+
+static uint32_t compute_data_mic(const uint8_t *key, uint8_t dir, uint32_t dev_addr,
+                                 uint32_t fcnt, const uint8_t *buffer, uint8_t size)
+{
+    uint8_t b0[16];
+    data_block(b0, 0x49, dir, dev_addr, fcnt, size);
+
+    return compute_mic(key, b0, buffer, size);
+}
+
+/**
+ * Time on air (ms) of a LoRa frame, with its settings
+ */
+static uint32_t time_on_air(const air_frame_t &frame, bool fix_len = false)
+{
+    virtual_radio_config_t config;
+    config.modem = frame.modem;
+    config.bandwidth = frame.bandwidth;
+    config.datarate = frame.datarate;
+    config.coderate = frame.coderate;
+    config.preamble_len = frame.preamble_len;
+    config.fix_len = fix_len;
+    config.crc_on = frame.crc_on;
+    config.iq_inverted = frame.iq_inverted;
+
+    return VirtualRadio::get_time_on_air(config, frame.size);
+}
+
+/**
+ * FRMPayload encryption, its own inverse
+ */
+static void crypt_payload(const uint8_t *key, uint8_t dir, uint32_t dev_addr, uint32_t fcnt,
+                          const uint8_t *in, uint8_t size, uint8_t *out)
+{
+    mbedtls_aes_context aes;
+    uint8_t a[16];
+    uint8_t s[16];
+
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+
+    for (uint16_t i = 0; i < size; i++) {
+        if (i % 16 == 0) {
+            data_block(a, 0x01, dir, dev_addr, fcnt, i / 16 + 1);
+            mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, a, s);
+        }
+        out[i] = in[i] ^ s[i % 16];
+    }
+
+    mbedtls_aes_free(&aes);
+}
+
+/**
+ * CRC-16 of the beacon, CCITT polynomial from 0
+ */
+static uint16_t beacon_crc(const uint8_t *data, uint8_t size)
+{
+    uint16_t crc = 0;
+
+    while (size--) {
+        crc ^= (uint16_t) *data++ << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * Offset of the first ping slot of a device in a beacon period
+ */
+static uint16_t ping_offset(uint32_t beacon_time, uint32_t dev_addr, uint16_t ping_period)
+{
+    static const uint8_t zero_key[16] = { 0 };
+    mbedtls_aes_context aes;
+    uint8_t block[16];
+    uint8_t rand[16];
+
+    memset(block, 0, sizeof(block));
+    write_u32(&block[0], beacon_time);
+    write_u32(&block[4], dev_addr);
+
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, zero_key, 128);
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, block, rand);
+    mbedtls_aes_free(&aes);
+
+    return (rand[0] + rand[1] * 256) % ping_period;
+}
+
+VirtualNetworkServer::VirtualNetworkServer(VirtualGateway &gateway, uint32_t max_devices)
+    : _gateway(gateway),
+      _max_devices(max_devices),
+      _nb_devices(0),
+      _adr(false),
+      _adr_margin(NS_ADR_MARGIN),
+      _rx1_dr_offset(0),
+      _rx2_datarate(NS_RX2_DATARATE),
+      _rx2_frequency(NS_RX2_FREQUENCY),
+      _channels(0),
+      _app_nonce(0)
+{
+    _devices = new device_t[max_devices];
+
+    // at most half full
+    _addr_table_size = 16;
+    while (_addr_table_size < 2 * max_devices) {
+        _addr_table_size *= 2;
+    }
+    _addr_table = new int32_t[_addr_table_size];
+    memset(_addr_table, 0xFF, _addr_table_size * sizeof(int32_t));
+
+    memset(_channel_freq, 0, sizeof(_channel_freq));
+    memset(_channel_dr_range, 0, sizeof(_channel_dr_range));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+VirtualNetworkServer::~VirtualNetworkServer()
+{
+    delete[] _devices;
+    delete[] _addr_table;
+}
+
+int32_t VirtualNetworkServer::add_otaa_device(const uint8_t *dev_eui, const uint8_t *app_key)
+{
+    int32_t index = add_device();
+    if (index < 0) {
+        return index;
+    }
+
+    device_t &device = _devices[index];
+    device.otaa = true;
+    memcpy(device.dev_eui, dev_eui, sizeof(device.dev_eui));
+    memcpy(device.app_key, app_key, sizeof(device.app_key));
+
+    // kept across joins
+    device.state.dev_addr = ((uint32_t)(NS_NET_ID & 0x7F) << 25) | (index + 1);
+    insert_addr(device.state.dev_addr, index);
+
+    return index;
+}
+
+int32_t VirtualNetworkServer::add_abp_device(uint32_t dev_addr, const uint8_t *nwk_skey,
+                                             const uint8_t *app_skey)
+{
+    int32_t index = add_device();
+    if (index < 0) {
+        return index;
+    }
+
+    device_t &device = _devices[index];
+    device.otaa = false;
+    device.state.active = true;
+    device.state.dev_addr = dev_addr;
+    memcpy(device.nwk_skey, nwk_skey, sizeof(device.nwk_skey));
+    memcpy(device.app_skey, app_skey, sizeof(device.app_skey));
+    insert_addr(dev_addr, index);
+
+    return index;
+}
+
+void VirtualNetworkServer::set_adr(bool enabled, float margin)
+{
+    _adr = enabled;
+    _adr_margin = margin;
+}
+
+void VirtualNetworkServer::set_rx_params(uint8_t rx1_dr_offset, uint8_t rx2_datarate,
+                                         uint32_t rx2_frequency)
+{
+    _rx1_dr_offset = rx1_dr_offset;
+    _rx2_datarate = rx2_datarate;
+    _rx2_frequency = rx2_frequency;
+}
+
+bool VirtualNetworkServer::add_channel(uint8_t index, uint32_t frequency, uint8_t min_dr,
+                                       uint8_t max_dr)
+{
+    if (index < 3 || index >= NS_MAX_CHANNELS || min_dr > max_dr) {
+        return false;
+    }
+
+    _channel_freq[index] = frequency;
+    _channel_dr_range[index] = (max_dr << 4) | min_dr;
+    _channels |= 1 << index;
+
+    return true;
+}
+
+bool VirtualNetworkServer::send(uint32_t index, uint8_t port, const uint8_t *data, uint8_t size,
+                                bool confirmed)
+{
+    device_t &device = _devices[index];
+
+    if (device.app_queued || port == 0 || size > NS_MAX_APP_PAYLOAD) {
+        return false;
+    }
+
+    device.app_queued = true;
+    device.app_confirmed = confirmed;
+    device.app_sent = false;
+    device.app_port = port;
+    device.app_size = size;
+    memcpy(device.app_data, data, size);
+
+    return true;
+}
+
+bool VirtualNetworkServer::send_class_c(uint32_t index, lorawan_time_t at, uint8_t port,
+                                        const uint8_t *data, uint8_t size)
+{
+    device_t &device = _devices[index];
+    virtual_ns_device_t &state = device.state;
+
+    if (port == 0 || size > max_payload[state.rx2_datarate]) {
+        return false;
+    }
+
+    uint8_t buffer[255];
+    air_frame_t frame;
+    downlink_frame(frame, MBED_CONF_LORA_PUBLIC_NETWORK, buffer,
+                   data_downlink(device, port, data, size, buffer));
+    frame.frequency = state.rx2_frequency;
+    frame.datarate = 12 - state.rx2_datarate;
+    frame.start = at;
+    frame.end = at + time_on_air(frame);
+
+    if (!_gateway.transmit(frame)) {
+        return false;
+    }
+
+    state.fcnt_down++;
+    state.downlinks++;
+    _stats.class_c_downlinks++;
+
+    return true;
+}
+
+bool VirtualNetworkServer::send_class_b(uint32_t index, lorawan_time_t now, uint8_t port,
+                                        const uint8_t *data, uint8_t size)
+{
+    device_t &device = _devices[index];
+
+    if (!device.state.class_b || device.ping_queued || port == 0
+            || size > max_payload[NS_BEACON_DATARATE]) {
+        return false;
+    }
+
+    device.ping_queued = true;
+    device.ping_port = port;
+    device.ping_size = size;
+    memcpy(device.ping_data, data, size);
+
+    schedule_ping_slot(device, now);
+
+    return true;
+}
+
+lorawan_time_t VirtualNetworkServer::get_next_beacon(lorawan_time_t now) const
+{
+    // the simulation does not start on a period
+    uint32_t phase = (NS_GPS_EPOCH % (NS_BEACON_INTERVAL / 1000)) * 1000;
+
+    return now + NS_BEACON_INTERVAL - (now + phase) % NS_BEACON_INTERVAL;
+}
+
+bool VirtualNetworkServer::send_beacon(lorawan_time_t at)
+{
+    uint8_t buffer[NS_BEACON_SIZE];
+    uint16_t crc;
+
+    // RFU, the time and the CRC of the network common part, then the
+    // gateway specific part: InfoDesc 0, the antenna at coordinates 0
+    memset(buffer, 0, sizeof(buffer));
+    write_u32(&buffer[2], NS_GPS_EPOCH + at / 1000);
+    crc = beacon_crc(buffer, 6);
+    buffer[6] = crc;
+    buffer[7] = crc >> 8;
+    crc = beacon_crc(&buffer[8], 7);
+    buffer[15] = crc;
+    buffer[16] = crc >> 8;
+
+    air_frame_t frame;
+    downlink_frame(frame, MBED_CONF_LORA_PUBLIC_NETWORK, buffer, sizeof(buffer));
+    frame.frequency = NS_BEACON_FREQUENCY;
+    frame.datarate = 12 - NS_BEACON_DATARATE;
+    frame.preamble_len = NS_BEACON_PREAMBLE_LEN;
+    frame.iq_inverted = false;
+    frame.start = at;
+    frame.end = at + time_on_air(frame, true);
+
+    bool sent = _gateway.transmit(frame);
+    if (sent) {
+        _stats.beacons++;
+    }
+
+    // the devices keep their ping slots when a beacon is missed
+    for (uint32_t i = 0; i < _nb_devices; i++) {
+        if (_devices[i].ping_queued) {
+            schedule_ping_slot(_devices[i], at);
+        }
+    }
+
+    return sent;
+}
+
+void VirtualNetworkServer::set_listener(mbed::Callback<void(const virtual_ns_uplink_t &)> listener)
+{
+    _listener = listener;
+}
+
+void VirtualNetworkServer::on_uplink(const air_frame_t &frame, float power)
+{
+    if (frame.size < NS_MHDR_SIZE) {
+        return;
+    }
+
+    switch (frame.payload[0] >> 5) {
+        case FRAME_TYPE_JOIN_REQ:
+            handle_join(frame);
+            break;
+        case FRAME_TYPE_DATA_UNCONFIRMED_UP:
+        case FRAME_TYPE_DATA_CONFIRMED_UP:
+            handle_data(frame, power);
+            break;
+        default:
+            break;
+    }
+}
+
+const virtual_ns_device_t &VirtualNetworkServer::get_device(uint32_t index) const
+{
+    return _devices[index].state;
+}
+
+const virtual_ns_stats_t &VirtualNetworkServer::get_stats() const
+{
+    return _stats;
+}
+
+void VirtualNetworkServer::handle_join(const air_frame_t &frame)
+{
+    const uint8_t *request = frame.payload;
+
+    if (frame.size != NS_JOIN_REQUEST_SIZE) {
+        _stats.join_rejected++;
+        return;
+    }
+
+    // MHDR, AppEUI, DevEUI and DevNonce, the EUIs least significant byte first
+    int32_t index = find_eui(&request[9]);
+    if (index < 0) {
+        _stats.join_rejected++;
+        return;
+    }
+
+    device_t &device = _devices[index];
+    uint16_t dev_nonce = request[17] | (request[18] << 8);
+
+    if (compute_mic(device.app_key, NULL, request, 19) != read_u32(&request[19])) {
+        _stats.join_rejected++;
+        return;
+    }
+
+    if (device.has_nonce && device.dev_nonce == dev_nonce) {
+        if (device.last_start == frame.start) {
+            _stats.duplicates++;
+        } else {
+            _stats.join_rejected++;
+        }
+        return;
+    }
+
+    device.has_nonce = true;
+    device.dev_nonce = dev_nonce;
+    device.last_start = frame.start;
+
+    uint32_t app_nonce = ++_app_nonce & 0xFFFFFF;
+
+    // session keys
+    mbedtls_aes_context aes;
+    uint8_t block[16];
+
+    memset(block, 0, sizeof(block));
+    write_u24(&block[1], app_nonce);
+    write_u24(&block[4], NS_NET_ID);
+    block[7] = dev_nonce;
+    block[8] = dev_nonce >> 8;
+
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, device.app_key, 128);
+    block[0] = 0x01;
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, block, device.nwk_skey);
+    block[0] = 0x02;
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, block, device.app_skey);
+    mbedtls_aes_free(&aes);
+
+    // join accept, without CFList: the channels come with NewChannelReq
+    uint8_t accept[NS_JOIN_ACCEPT_SIZE];
+    accept[0] = FRAME_TYPE_JOIN_ACCEPT << 5;
+    write_u24(&accept[1], app_nonce);
+    write_u24(&accept[4], NS_NET_ID);
+    write_u32(&accept[7], device.state.dev_addr);
+    accept[11] = (_rx1_dr_offset << 4) | _rx2_datarate;
+    accept[12] = NS_RECEIVE_DELAY1 / 1000;
+    write_u32(&accept[13], compute_mic(device.app_key, NULL, accept, 13));
+
+    // encrypted with a decryption, so devices only need the encryption
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_dec(&aes, device.app_key, 128);
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_DECRYPT, &accept[1], &accept[1]);
+    mbedtls_aes_free(&aes);
+
+    // the device answers with its default settings
+    if (!schedule(device, frame, NS_JOIN_ACCEPT_DELAY1, 0, NS_RX2_DATARATE, NS_RX2_FREQUENCY,
+                  accept, sizeof(accept))) {
+        return;
+    }
+
+    virtual_ns_device_t &state = device.state;
+    state.active = true;
+    state.fcnt_up = 0;
+    state.fcnt_down = 0;
+    state.tx_power = 0;
+    state.channel_mask = NS_DEFAULT_CHANNELS;
+    state.rx1_dr_offset = _rx1_dr_offset;
+    state.rx2_datarate = _rx2_datarate;
+    state.rx2_frequency = NS_RX2_FREQUENCY;
+    state.joins++;
+
+    device.has_uplink = false;
+    device.adr_count = 0;
+    device.adr_next = 0;
+    device.adr_wanted = false;
+    device.adr_pending = false;
+    device.channels_done = 0;
+    device.channels_pending = 0;
+    device.rx_params_done = false;
+    device.rx_params_pending = false;
+    device.app_sent = false;
+
+    _stats.joins++;
+}
+
+void VirtualNetworkServer::handle_data(const air_frame_t &frame, float power)
+{
+    const uint8_t *buffer = frame.payload;
+    uint8_t size = frame.size;
+
+    if (size < NS_MHDR_SIZE + NS_FHDR_SIZE + NS_MIC_SIZE) {
+        _stats.mic_failures++;
+        return;
+    }
+
+    uint32_t dev_addr = read_u32(&buffer[1]);
+    uint8_t fctrl = buffer[5];
+    uint16_t fcnt16 = buffer[6] | (buffer[7] << 8);
+    uint8_t fopts_len = fctrl & 0x0F;
+    uint8_t payload_start = NS_MHDR_SIZE + NS_FHDR_SIZE + fopts_len;
+
+    if (payload_start + NS_MIC_SIZE > size) {
+        _stats.mic_failures++;
+        return;
+    }
+
+    int32_t index = find_addr(dev_addr);
+    if (index < 0 || !_devices[index].state.active) {
+        _stats.unknown++;
+        return;
+    }
+
+    device_t &device = _devices[index];
+    virtual_ns_device_t &state = device.state;
+
+    // the 16 bits sent extended with those of the last counter
+    uint32_t fcnt = (state.fcnt_up & 0xFFFF0000) | fcnt16;
+    if (device.has_uplink) {
+        if (fcnt < state.fcnt_up) {
+            fcnt += 0x10000;
+        }
+        if (fcnt - state.fcnt_up > NS_MAX_FCNT_GAP) {
+            _stats.replays++;
+            return;
+        }
+    }
+
+    if (compute_data_mic(device.nwk_skey, 0, dev_addr, fcnt, buffer, size - NS_MIC_SIZE)
+            != read_u32(&buffer[size - NS_MIC_SIZE])) {
+        _stats.mic_failures++;
+        return;
+    }
+
+    bool retransmission = false;
+
+    if (device.has_uplink && fcnt == state.fcnt_up) {
+        // another gateway received it too
+        if (frame.start == device.last_start) {
+            _stats.duplicates++;
+            return;
+        }
+        retransmission = true;
+        _stats.retransmissions++;
+    }
+
+    device.has_uplink = true;
+    device.last_start = frame.start;
+
+    float snr = SimLink::get_snr(frame, power);
+
+    state.fcnt_up = fcnt;
+    state.datarate = 12 - frame.datarate;
+    state.class_b = (fctrl & NS_FCTRL_CLASS_B) != 0;
+    state.snr = snr;
+    state.uplinks++;
+    _stats.uplinks++;
+
+    bool confirmed = (buffer[0] >> 5) == FRAME_TYPE_DATA_CONFIRMED_UP;
+
+    if ((fctrl & NS_FCTRL_ACK) && device.app_queued && device.app_sent) {
+        device.app_queued = false;
+        _stats.acked_downlinks++;
+    }
+
+    // FRMPayload, MAC commands on port 0
+    uint8_t payload[255];
+    uint8_t payload_size = 0;
+    int16_t port = -1;
+
+    if (size - NS_MIC_SIZE > payload_start) {
+        port = buffer[payload_start];
+        payload_size = size - NS_MIC_SIZE - payload_start - 1;
+        crypt_payload(port == 0 ? device.nwk_skey : device.app_skey, 0, dev_addr, fcnt,
+                      &buffer[payload_start + 1], payload_size, payload);
+    }
+
+    uint8_t answers[NS_MAX_FOPTS];
+    uint8_t nb_answers = 0;
+    bool needs_downlink = confirmed || (fctrl & NS_FCTRL_ADR_ACK_REQ);
+
+    if (port == 0) {
+        needs_downlink |= process_commands(device, frame, snr, payload, payload_size,
+                                           answers, nb_answers);
+    } else {
+        needs_downlink |= process_commands(device, frame, snr, &buffer[NS_MHDR_SIZE + NS_FHDR_SIZE],
+                                           fopts_len, answers, nb_answers);
+    }
+
+    if (port > 0 && !retransmission && _listener) {
+        virtual_ns_uplink_t uplink;
+        uplink.device = index;
+        uplink.fcnt = fcnt;
+        uplink.port = port;
+        uplink.payload = payload;
+        uplink.size = payload_size;
+        uplink.confirmed = confirmed;
+        uplink.frame = &frame;
+        uplink.power = power;
+        uplink.snr = snr;
+        _listener(uplink);
+    }
+
+    if (_adr && (fctrl & NS_FCTRL_ADR)) {
+        run_adr(device, snr);
+    }
+
+    bool has_requests = (!device.rx_params_done
+                         && (state.rx1_dr_offset != _rx1_dr_offset
+                             || state.rx2_datarate != _rx2_datarate
+                             || state.rx2_frequency != _rx2_frequency))
+                        || (_channels & ~device.channels_done)
+                        || device.adr_wanted;
+
+    if (needs_downlink || nb_answers || has_requests || device.app_queued) {
+        send_downlink(device, frame, confirmed, answers, nb_answers);
+    }
+}
+
+bool VirtualNetworkServer::process_commands(device_t &device, const air_frame_t &frame, float snr,
+                                            const uint8_t *commands, uint8_t size,
+                                            uint8_t *answers, uint8_t &nb_answers)
+{
+    virtual_ns_device_t &state = device.state;
+    bool needs_downlink = false;
+    uint8_t i = 0;
+
+    while (i < size) {
+        switch (commands[i++]) {
+            case MOTE_MAC_LINK_CHECK_REQ: {
+                float margin = snr - required_snr[state.datarate <= NS_MAX_DATARATE
+                                                  ? state.datarate : NS_MAX_DATARATE];
+                if (nb_answers + 3 <= NS_MAX_FOPTS) {
+                    answers[nb_answers++] = SRV_MAC_LINK_CHECK_ANS;
+                    answers[nb_answers++] = margin < 0 ? 0 : margin > 254 ? 254 : (uint8_t) margin;
+                    answers[nb_answers++] = 1;
+                }
+                break;
+            }
+            case MOTE_MAC_DEVICE_TIME_REQ: {
+                // time of the end of the uplink
+                uint32_t ms = frame.end;
+                if (nb_answers + 6 <= NS_MAX_FOPTS) {
+                    answers[nb_answers++] = SRV_MAC_DEVICE_TIME_ANS;
+                    write_u32(&answers[nb_answers], NS_GPS_EPOCH + ms / 1000);
+                    nb_answers += 4;
+                    answers[nb_answers++] = (ms % 1000) * 256 / 1000;
+                }
+                break;
+            }
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
+                state.ping_periodicity = commands[i++] & 0x07;
+                if (nb_answers + 1 <= NS_MAX_FOPTS) {
+                    answers[nb_answers++] = SRV_MAC_PING_SLOT_INFO_ANS;
+                }
+                break;
+            case MOTE_MAC_LINK_ADR_ANS: {
+                uint8_t status = commands[i++];
+                if (device.adr_pending) {
+                    device.adr_pending = false;
+                    if ((status & 0x07) == 0x07) {
+                        state.tx_power = device.adr_tx_power;
+                        _stats.adr_accepted++;
+                    }
+                }
+                break;
+            }
+            case MOTE_MAC_RX_PARAM_SETUP_ANS: {
+                uint8_t status = commands[i++];
+                if (device.rx_params_pending) {
+                    device.rx_params_pending = false;
+                    // not requested again if refused
+                    device.rx_params_done = true;
+                    if ((status & 0x07) == 0x07) {
+                        state.rx1_dr_offset = _rx1_dr_offset;
+                        state.rx2_datarate = _rx2_datarate;
+                        state.rx2_frequency = _rx2_frequency;
+                    }
+                }
+                // sticky, repeated until a downlink comes
+                needs_downlink = true;
+                break;
+            }
+            case MOTE_MAC_NEW_CHANNEL_ANS: {
+                uint8_t status = commands[i++];
+                // in the order they were requested
+                for (uint8_t ch = 0; ch < NS_MAX_CHANNELS; ch++) {
+                    if (device.channels_pending & (1 << ch)) {
+                        device.channels_pending &= ~(1 << ch);
+                        device.channels_done |= 1 << ch;
+                        if ((status & 0x03) == 0x03) {
+                            state.channel_mask |= 1 << ch;
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+            case MOTE_MAC_DEV_STATUS_ANS:
+                i += 2;
+                break;
+            case MOTE_MAC_DL_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+                i++;
+                needs_downlink = true;
+                break;
+            case MOTE_MAC_RX_TIMING_SETUP_ANS:
+                needs_downlink = true;
+                break;
+            case MOTE_MAC_BEACON_FREQ_ANS:
+                i++;
+                break;
+            case MOTE_MAC_DUTY_CYCLE_ANS:
+            case MOTE_MAC_TX_PARAM_SETUP_ANS:
+            case MOTE_MAC_BEACON_TIMING_REQ:
+                break;
+            default:
+                // unknown, the rest cannot be parsed
+                return needs_downlink;
+        }
+    }
+
+    return needs_downlink;
+}
+
+void VirtualNetworkServer::run_adr(device_t &device, float snr)
+{
+    virtual_ns_device_t &state = device.state;
+
+    device.adr_snr[device.adr_next] = snr;
+    device.adr_next = (device.adr_next + 1) % NS_ADR_HISTORY;
+    if (device.adr_count < NS_ADR_HISTORY) {
+        device.adr_count++;
+        return;
+    }
+
+    float max_snr = device.adr_snr[0];
+    for (uint8_t i = 1; i < NS_ADR_HISTORY; i++) {
+        if (device.adr_snr[i] > max_snr) {
+            max_snr = device.adr_snr[i];
+        }
+    }
+
+    uint8_t datarate = state.datarate <= NS_MAX_DATARATE ? state.datarate : NS_MAX_DATARATE;
+    uint8_t tx_power = state.tx_power;
+    int16_t steps = floorf((max_snr - required_snr[datarate] - _adr_margin) / 3);
+
+    while (steps > 0 && datarate < NS_MAX_DATARATE) {
+        datarate++;
+        steps--;
+    }
+    while (steps > 0 && tx_power < NS_MAX_TX_POWER) {
+        tx_power++;
+        steps--;
+    }
+    while (steps < 0 && tx_power > 0) {
+        tx_power--;
+        steps++;
+    }
+
+    device.adr_wanted = datarate != state.datarate || tx_power != state.tx_power;
+    device.adr_datarate = datarate;
+    device.adr_tx_power = tx_power;
+}
+
+bool VirtualNetworkServer::send_downlink(device_t &device, const air_frame_t &uplink, bool ack,
+                                         const uint8_t *answers, uint8_t nb_answers)
+{
+    virtual_ns_device_t &state = device.state;
+
+    // what fits in either window
+    int8_t rx1_dr = state.datarate - state.rx1_dr_offset;
+    uint8_t dr = rx1_dr < state.rx2_datarate ? (rx1_dr < 0 ? 0 : rx1_dr) : state.rx2_datarate;
+    uint8_t room = max_payload[dr <= NS_MAX_DATARATE ? dr : NS_MAX_DATARATE];
+
+    bool with_app = device.app_queued && device.app_size <= room;
+
+    // MAC commands go in FOpts, or on port 0 if there is no application data
+    uint8_t commands[255];
+    uint8_t nb_commands = 0;
+    uint8_t max_commands = with_app ? NS_MAX_FOPTS : room;
+
+    memcpy(commands, answers, nb_answers);
+    nb_commands = nb_answers;
+
+    device.rx_params_pending = false;
+    device.channels_pending = 0;
+    device.adr_pending = false;
+
+    if (!device.rx_params_done && nb_commands + 5 <= max_commands
+            && (state.rx1_dr_offset != _rx1_dr_offset || state.rx2_datarate != _rx2_datarate
+                || state.rx2_frequency != _rx2_frequency)) {
+        commands[nb_commands++] = SRV_MAC_RX_PARAM_SETUP_REQ;
+        commands[nb_commands++] = (_rx1_dr_offset << 4) | _rx2_datarate;
+        write_u24(&commands[nb_commands], _rx2_frequency / 100);
+        nb_commands += 3;
+        device.rx_params_pending = true;
+    }
+
+    for (uint8_t ch = 0; ch < NS_MAX_CHANNELS; ch++) {
+        if ((_channels & ~device.channels_done & (1 << ch)) && nb_commands + 5 <= max_commands) {
+            commands[nb_commands++] = SRV_MAC_NEW_CHANNEL_REQ;
+            commands[nb_commands++] = ch;
+            write_u24(&commands[nb_commands], _channel_freq[ch] / 100);
+            nb_commands += 3;
+            commands[nb_commands++] = _channel_dr_range[ch];
+            device.channels_pending |= 1 << ch;
+        }
+    }
+
+    // a channel mask leaving out channels being added would disable them,
+    // the ADR waits for their answers
+    if (device.adr_wanted && !device.channels_pending && nb_commands + 5 <= max_commands) {
+        commands[nb_commands++] = SRV_MAC_LINK_ADR_REQ;
+        commands[nb_commands++] = (device.adr_datarate << 4) | device.adr_tx_power;
+        commands[nb_commands++] = state.channel_mask;
+        commands[nb_commands++] = state.channel_mask >> 8;
+        // ChMaskCntl 0, NbTrans 1
+        commands[nb_commands++] = 0x01;
+        device.adr_pending = true;
+    }
+
+    uint8_t buffer[255];
+    uint8_t size = 0;
+    uint8_t fopts_len = with_app || nb_commands <= NS_MAX_FOPTS ? nb_commands : 0;
+    bool confirmed = with_app && device.app_confirmed;
+
+    buffer[size++] = (confirmed ? FRAME_TYPE_DATA_CONFIRMED_DOWN
+                      : FRAME_TYPE_DATA_UNCONFIRMED_DOWN) << 5;
+    write_u32(&buffer[size], state.dev_addr);
+    size += 4;
+    buffer[size++] = (_adr ? NS_FCTRL_ADR : 0) | (ack ? NS_FCTRL_ACK : 0) | fopts_len;
+    buffer[size++] = state.fcnt_down;
+    buffer[size++] = state.fcnt_down >> 8;
+    memcpy(&buffer[size], commands, fopts_len);
+    size += fopts_len;
+
+    if (with_app) {
+        buffer[size++] = device.app_port;
+        crypt_payload(device.app_skey, 1, state.dev_addr, state.fcnt_down,
+                      device.app_data, device.app_size, &buffer[size]);
+        size += device.app_size;
+    } else if (nb_commands > fopts_len) {
+        buffer[size++] = 0;
+        crypt_payload(device.nwk_skey, 1, state.dev_addr, state.fcnt_down,
+                      commands, nb_commands, &buffer[size]);
+        size += nb_commands;
+    }
+
+    write_u32(&buffer[size], compute_data_mic(device.nwk_skey, 1, state.dev_addr,
+                                              state.fcnt_down, buffer, size));
+    size += NS_MIC_SIZE;
+
+    if (!schedule(device, uplink, NS_RECEIVE_DELAY1, state.rx1_dr_offset, state.rx2_datarate,
+                  state.rx2_frequency, buffer, size)) {
+        // requested with the next one
+        device.rx_params_pending = false;
+        device.channels_pending = 0;
+        device.adr_pending = false;
+        return false;
+    }
+
+    state.fcnt_down++;
+
+    if (device.adr_pending) {
+        device.adr_wanted = false;
+        device.adr_count = 0;
+        _stats.adr_requests++;
+    }
+
+    if (with_app) {
+        // confirmed data stays queued until acknowledged
+        device.app_sent = true;
+        device.app_queued = confirmed;
+    }
+
+    return true;
+}
+
+bool VirtualNetworkServer::schedule(device_t &device, const air_frame_t &uplink, uint32_t delay,
+                                    uint8_t rx1_dr_offset, uint8_t rx2_datarate,
+                                    uint32_t rx2_frequency, const uint8_t *payload, uint8_t size)
+{
+    int8_t uplink_dr = 12 - uplink.datarate;
+    int8_t rx1_dr = uplink_dr - rx1_dr_offset;
+
+    air_frame_t frame;
+    downlink_frame(frame, uplink.public_network, payload, size);
+
+    for (uint8_t window = 1; window <= 2; window++) {
+        uint8_t dr = window == 1 ? (rx1_dr < 0 ? 0 : rx1_dr) : rx2_datarate;
+
+        frame.frequency = window == 1 ? uplink.frequency : rx2_frequency;
+        frame.datarate = 12 - dr;
+        frame.start = uplink.end + delay + (window - 1) * 1000;
+        frame.end = frame.start + time_on_air(frame);
+
+        if (_gateway.transmit(frame)) {
+            if (window == 1) {
+                _stats.rx1_downlinks++;
+            } else {
+                _stats.rx2_downlinks++;
+            }
+            device.state.downlinks++;
+            return true;
+        }
+    }
+
+    _stats.missed_downlinks++;
+
+    return false;
+}
+
+bool VirtualNetworkServer::schedule_ping_slot(device_t &device, lorawan_time_t now)
+{
+    virtual_ns_device_t &state = device.state;
+    lorawan_time_t beacon = get_next_beacon(now) - NS_BEACON_INTERVAL;
+    uint16_t ping_period = NS_PING_SLOT_COUNT >> (7 - state.ping_periodicity);
+    uint16_t ping_nb = 1 << (7 - state.ping_periodicity);
+    uint16_t offset = ping_offset(NS_GPS_EPOCH + beacon / 1000, state.dev_addr, ping_period);
+
+    uint8_t buffer[255];
+    air_frame_t frame;
+    downlink_frame(frame, MBED_CONF_LORA_PUBLIC_NETWORK, buffer,
+                   data_downlink(device, device.ping_port, device.ping_data, device.ping_size,
+                                 buffer));
+    frame.frequency = NS_BEACON_FREQUENCY;
+    frame.datarate = 12 - NS_BEACON_DATARATE;
+
+    for (uint16_t slot = 0; slot < ping_nb; slot++) {
+        frame.start = beacon + NS_BEACON_RESERVED
+                      + (offset + (uint32_t) slot * ping_period) * NS_PING_SLOT_WINDOW;
+        frame.end = frame.start + time_on_air(frame);
+
+        if ((int32_t)(frame.start - now) > 0 && _gateway.transmit(frame)) {
+            device.ping_queued = false;
+            state.fcnt_down++;
+            state.downlinks++;
+            _stats.class_b_downlinks++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint8_t VirtualNetworkServer::data_downlink(device_t &device, uint8_t port, const uint8_t *data,
+                                            uint8_t size, uint8_t *buffer) const
+{
+    const virtual_ns_device_t &state = device.state;
+    uint8_t length = 0;
+
+    buffer[length++] = FRAME_TYPE_DATA_UNCONFIRMED_DOWN << 5;
+    write_u32(&buffer[length], state.dev_addr);
+    length += 4;
+    buffer[length++] = _adr ? NS_FCTRL_ADR : 0;
+    buffer[length++] = state.fcnt_down;
+    buffer[length++] = state.fcnt_down >> 8;
+    buffer[length++] = port;
+    crypt_payload(device.app_skey, 1, state.dev_addr, state.fcnt_down, data, size,
+                  &buffer[length]);
+    length += size;
+    write_u32(&buffer[length], compute_data_mic(device.nwk_skey, 1, state.dev_addr,
+                                                state.fcnt_down, buffer, length));
+    length += NS_MIC_SIZE;
+
+    return length;
+}
+
+void VirtualNetworkServer::downlink_frame(air_frame_t &frame, bool public_network,
+                                          const uint8_t *payload, uint8_t size) const
+{
+    frame.sender = NULL;
+    frame.sender_id = 0;
+    frame.x = _gateway.get_x();
+    frame.y = _gateway.get_y();
+    frame.modem = MODEM_LORA;
+    frame.bandwidth = 0;
+    frame.coderate = 1;
+    frame.preamble_len = 8;
+    frame.crc_on = false;
+    frame.iq_inverted = true;
+    frame.public_network = public_network;
+    frame.power = NS_TX_POWER;
+    frame.size = size;
+    memcpy(frame.payload, payload, size);
+}
+
+int32_t VirtualNetworkServer::find_eui(const uint8_t *eui) const
+{
+    for (uint32_t i = 0; i < _nb_devices; i++) {
+        const device_t &device = _devices[i];
+        bool match = device.otaa;
+
+        for (uint8_t b = 0; match && b < 8; b++) {
+            match = device.dev_eui[b] == eui[7 - b];
+        }
+
+        if (match) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int32_t VirtualNetworkServer::find_addr(uint32_t dev_addr) const
+{
+    uint32_t mask = _addr_table_size - 1;
+
+    for (uint32_t slot = (dev_addr * 2654435761u) & mask; _addr_table[slot] >= 0;
+            slot = (slot + 1) & mask) {
+        if (_devices[_addr_table[slot]].state.dev_addr == dev_addr) {
+            return _addr_table[slot];
+        }
+    }
+
+    return -1;
+}
+
+void VirtualNetworkServer::insert_addr(uint32_t dev_addr, uint32_t index)
+{
+    uint32_t mask = _addr_table_size - 1;
+    uint32_t slot = (dev_addr * 2654435761u) & mask;
+
+    while (_addr_table[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    _addr_table[slot] = index;
+}
+
+int32_t VirtualNetworkServer::add_device()
+{
+    if (_nb_devices == _max_devices) {
+        return -1;
+    }
+
+    device_t &device = _devices[_nb_devices];
+    memset(&device, 0, sizeof(device));
+    device.state.channel_mask = NS_DEFAULT_CHANNELS;
+    device.state.rx2_datarate = NS_RX2_DATARATE;
+    device.state.rx2_frequency = NS_RX2_FREQUENCY;
+
+    return _nb_devices++;
+}
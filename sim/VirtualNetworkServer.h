@@ -0,0 +1,433 @@
+/**
+ * @file VirtualNetworkServer.h
+ *
+ * @brief Network server of the host simulation
+ *
+ * Stands in for the network server behind a gateway, enough for the stack
+ * to be exercised end to end with no external service. It implements the
+ * EU868 LoRaWAN 1.0.2 network side with its own crypto, independent of
+ * LoRaMacCrypto:
+ *
+ *  - OTAA joins, the join accept in RX1 or RX2 of the join request,
+ *
+ *  - uplinks checked against their MIC and frame counter: duplicates, the
+ *    same frame from another gateway, are dropped, retransmissions are
+ *    answered again but not delivered twice,
+ *
+ *  - ADR, the algorithm of the Semtech reference network server: the best
+ *    SNR of the last NS_ADR_HISTORY uplinks, less the SNR the datarate needs
+ *    and an installation margin, raises the datarate then lowers the
+ *    transmit power by steps of 3 dB,
+ *
+ *  - MAC commands: LinkADRReq, NewChannelReq for the channels added with
+ *    add_channel(), RXParamSetupReq for the settings of set_rx_params(),
+ *    LinkCheckAns and DeviceTimeAns, and the sticky answers of the device,
+ *    each of which gets a downlink,
+ *
+ *  - downlinks in RX1, or RX2 if the gateway cannot transmit in RX1, for
+ *    acknowledgements, MAC commands, ADRACKReq and application data,
+ *
+ *  - application data to Class C devices at any time, in their RX2,
+ *
+ *  - the EU868 beacon, when told to, and application data to Class B
+ *    devices in their next ping slot, once their uplinks carry the Class B
+ *    bit. The ping slots are those of LoRaWAN 1.0.3 Class B, derived from
+ *    the beacon time, the DevAddr and the periodicity of PingSlotInfoReq.
+ *
+ * It is told of every uplink a gateway received, see VirtualGateway, and
+ * has the gateway transmit its downlinks.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_VIRTUAL_NETWORK_SERVER_H__
+#define MBED_LORAWAN_SIM_VIRTUAL_NETWORK_SERVER_H__
+
+#include <stdint.h>
+#include "platform/Callback.h"
+#include "platform/NonCopyable.h"
+#include "VirtualAir.h"
+#include "VirtualGateway.h"
+
+/**
+ * Uplinks the ADR algorithm looks back on
+ */
+#define NS_ADR_HISTORY              20
+
+/**
+ * Default installation margin (dB) of the ADR algorithm
+ */
+#define NS_ADR_MARGIN               10
+
+/**
+ * Channels of a device, EU868
+ */
+#define NS_MAX_CHANNELS             16
+
+/**
+ * Largest application payload of a downlink
+ */
+#define NS_MAX_APP_PAYLOAD          222
+
+/**
+ * GPS time (s) at the start of the simulation, 2023-01-01 00:00:00 UTC
+ */
+#define NS_GPS_EPOCH                1356566418
+
+/**
+ * Transmit power (dBm) of the downlinks
+ */
+#define NS_TX_POWER                 14
+
+/**
+ * Beacon period (ms)
+ */
+#define NS_BEACON_INTERVAL          128000
+
+/**
+ * Uplinks and downlinks of the network server
+ */
+typedef struct {
+    uint32_t joins;
+    /**
+     * Join requests of unknown devices, with a wrong MIC or a DevNonce
+     * used before
+     */
+    uint32_t join_rejected;
+    /**
+     * Data frames accepted, retransmissions included
+     */
+    uint32_t uplinks;
+    uint32_t duplicates;
+    uint32_t retransmissions;
+    /**
+     * Frame counters behind the last one
+     */
+    uint32_t replays;
+    uint32_t mic_failures;
+    /**
+     * Data frames without a session
+     */
+    uint32_t unknown;
+    uint32_t rx1_downlinks;
+    uint32_t rx2_downlinks;
+    uint32_t class_c_downlinks;
+    uint32_t class_b_downlinks;
+    uint32_t beacons;
+    /**
+     * Downlinks the gateway could transmit in neither window
+     */
+    uint32_t missed_downlinks;
+    uint32_t adr_requests;
+    uint32_t adr_accepted;
+    /**
+     * Confirmed downlinks the device acknowledged
+     */
+    uint32_t acked_downlinks;
+} virtual_ns_stats_t;
+
+/**
+ * What the network server knows of a device
+ */
+typedef struct {
+    /**
+     * Has a session, joined or ABP
+     */
+    bool active;
+    uint32_t dev_addr;
+    /**
+     * Counter of the last uplink, and of the next downlink
+     */
+    uint32_t fcnt_up;
+    uint32_t fcnt_down;
+    /**
+     * Datarate and SNR (dB) of the last uplink
+     */
+    uint8_t datarate;
+    float snr;
+    /**
+     * Settings the device acknowledged
+     */
+    uint8_t tx_power;
+    uint16_t channel_mask;
+    uint8_t rx1_dr_offset;
+    uint8_t rx2_datarate;
+    uint32_t rx2_frequency;
+    /**
+     * The last uplink carried the Class B bit, and the periodicity of the
+     * last PingSlotInfoReq
+     */
+    bool class_b;
+    uint8_t ping_periodicity;
+    uint32_t joins;
+    uint32_t uplinks;
+    uint32_t downlinks;
+} virtual_ns_device_t;
+
+/**
+ * An uplink delivered to the application
+ */
+typedef struct {
+    uint32_t device;
+    uint32_t fcnt;
+    uint8_t port;
+    const uint8_t *payload;
+    uint8_t size;
+    bool confirmed;
+    /**
+     * Frame as received, and its power (dBm) and SNR (dB)
+     */
+    const air_frame_t *frame;
+    float power;
+    float snr;
+} virtual_ns_uplink_t;
+
+class VirtualNetworkServer : private mbed::NonCopyable<VirtualNetworkServer> {
+public:
+    /** Creates a network server
+     *
+     * @param gateway       Gateway the downlinks are transmitted by
+     * @param max_devices   Devices which can be added
+     */
+    VirtualNetworkServer(VirtualGateway &gateway, uint32_t max_devices);
+
+    ~VirtualNetworkServer();
+
+    /** Adds a device joining with OTAA
+     *
+     * @param dev_eui       Device EUI, most significant byte first
+     * @param app_key       Application key
+     *
+     * @return              Index of the device, -1 if there are too many
+     */
+    int32_t add_otaa_device(const uint8_t *dev_eui, const uint8_t *app_key);
+
+    /** Adds a device activated by personalization
+     *
+     * @return              Index of the device, -1 if there are too many
+     */
+    int32_t add_abp_device(uint32_t dev_addr, const uint8_t *nwk_skey,
+                           const uint8_t *app_skey);
+
+    /** Enables the ADR algorithm, for the devices requesting it
+     *
+     * @param margin        Installation margin (dB)
+     */
+    void set_adr(bool enabled, float margin = NS_ADR_MARGIN);
+
+    /** Settings of the receive windows the devices are given, in the join
+     * accept or with RXParamSetupReq
+     */
+    void set_rx_params(uint8_t rx1_dr_offset, uint8_t rx2_datarate, uint32_t rx2_frequency);
+
+    /** Adds a channel the devices are given with NewChannelReq
+     *
+     * @param index         3 to NS_MAX_CHANNELS - 1, the first three are
+     *                      the EU868 join channels
+     *
+     * @return              false if the index is not valid
+     */
+    bool add_channel(uint8_t index, uint32_t frequency, uint8_t min_dr, uint8_t max_dr);
+
+    /** Queues application data for a device, sent after its next uplink
+     *
+     * @return              false if data is still queued for the device, or
+     *                      too large
+     */
+    bool send(uint32_t device, uint8_t port, const uint8_t *data, uint8_t size, bool confirmed);
+
+    /** Sends application data to a Class C device at once, unconfirmed, in
+     * its RX2 settings
+     *
+     * @param at            Start of the transmission, in the future
+     *
+     * @return              false if the gateway cannot transmit then, or the
+     *                      data is too large for the datarate
+     */
+    bool send_class_c(uint32_t device, lorawan_time_t at, uint8_t port, const uint8_t *data,
+                      uint8_t size);
+
+    /** Queues application data for a Class B device, sent unconfirmed in
+     * its next ping slot
+     *
+     * A ping slot of the current beacon period is taken at once, a later
+     * one when its beacon is sent, see send_beacon().
+     *
+     * @param now           Current time
+     *
+     * @return              false if the device is not in Class B, data is
+     *                      still queued for it, or too large
+     */
+    bool send_class_b(uint32_t device, lorawan_time_t now, uint8_t port, const uint8_t *data,
+                      uint8_t size);
+
+    /** Start of the first beacon period after a time
+     *
+     * The periods start at the GPS times which are multiples of 128 s.
+     */
+    lorawan_time_t get_next_beacon(lorawan_time_t now) const;
+
+    /** Sends the beacon of a period, then the Class B data queued for its
+     * ping slots
+     *
+     * @param at            Start of the period, in the future
+     *
+     * @return              false if the gateway cannot transmit then
+     */
+    bool send_beacon(lorawan_time_t at);
+
+    /** Sets what the uplinks are delivered to
+     */
+    void set_listener(mbed::Callback<void(const virtual_ns_uplink_t &)> listener);
+
+    /** A gateway received an uplink
+     *
+     * @param frame         Frame, which ended
+     * @param power         Power (dBm) it was received with
+     */
+    void on_uplink(const air_frame_t &frame, float power);
+
+    const virtual_ns_device_t &get_device(uint32_t device) const;
+
+    const virtual_ns_stats_t &get_stats() const;
+
+private:
+    /**
+     * A device and its session
+     */
+    typedef struct {
+        virtual_ns_device_t state;
+        bool otaa;
+        uint8_t dev_eui[8];
+        uint8_t app_key[16];
+        uint8_t nwk_skey[16];
+        uint8_t app_skey[16];
+
+        bool has_nonce;
+        uint16_t dev_nonce;
+        /**
+         * An uplink was accepted in the session, and when it started
+         */
+        bool has_uplink;
+        lorawan_time_t last_start;
+
+        float adr_snr[NS_ADR_HISTORY];
+        uint8_t adr_count;
+        uint8_t adr_next;
+        /**
+         * Settings the ADR algorithm wants, and whether they were requested
+         */
+        bool adr_wanted;
+        uint8_t adr_datarate;
+        uint8_t adr_tx_power;
+        bool adr_pending;
+
+        /**
+         * Channels acknowledged or refused, and requested
+         */
+        uint16_t channels_done;
+        uint16_t channels_pending;
+        bool rx_params_done;
+        bool rx_params_pending;
+
+        bool app_queued;
+        bool app_confirmed;
+        bool app_sent;
+        uint8_t app_port;
+        uint8_t app_size;
+        uint8_t app_data[NS_MAX_APP_PAYLOAD];
+
+        /**
+         * Class B data waiting for a ping slot
+         */
+        bool ping_queued;
+        uint8_t ping_port;
+        uint8_t ping_size;
+        uint8_t ping_data[NS_MAX_APP_PAYLOAD];
+    } device_t;
+
+    void handle_join(const air_frame_t &frame);
+
+    void handle_data(const air_frame_t &frame, float power);
+
+    /**
+     * Processes the MAC commands of an uplink, adds the answers to 'answers',
+     * true if the device needs a downlink
+     */
+    bool process_commands(device_t &device, const air_frame_t &frame, float snr,
+                          const uint8_t *commands, uint8_t size,
+                          uint8_t *answers, uint8_t &nb_answers);
+
+    void run_adr(device_t &device, float snr);
+
+    /**
+     * Builds and schedules a downlink after an uplink
+     */
+    bool send_downlink(device_t &device, const air_frame_t &uplink, bool ack,
+                       const uint8_t *answers, uint8_t nb_answers);
+
+    /**
+     * Has the gateway transmit in RX1, or RX2, of an uplink
+     */
+    bool schedule(device_t &device, const air_frame_t &uplink, uint32_t delay,
+                  uint8_t rx1_dr_offset, uint8_t rx2_datarate, uint32_t rx2_frequency,
+                  const uint8_t *payload, uint8_t size);
+
+    /**
+     * Has the gateway transmit the Class B data of a device in its first
+     * ping slot after 'now', if it is in the current beacon period
+     */
+    bool schedule_ping_slot(device_t &device, lorawan_time_t now);
+
+    /**
+     * Builds an unconfirmed data downlink, its counter the next one
+     */
+    uint8_t data_downlink(device_t &device, uint8_t port, const uint8_t *data, uint8_t size,
+                          uint8_t *buffer) const;
+
+    /**
+     * Settings of a downlink of the gateway, but its channel, datarate and
+     * time
+     */
+    void downlink_frame(air_frame_t &frame, bool public_network, const uint8_t *payload,
+                        uint8_t size) const;
+
+    int32_t find_eui(const uint8_t *eui) const;
+
+    int32_t find_addr(uint32_t dev_addr) const;
+
+    void insert_addr(uint32_t dev_addr, uint32_t index);
+
+    int32_t add_device();
+
+    VirtualGateway &_gateway;
+    mbed::Callback<void(const virtual_ns_uplink_t &)> _listener;
+
+    device_t *_devices;
+    uint32_t _max_devices;
+    uint32_t _nb_devices;
+
+    /**
+     * Device index by DevAddr, open addressing, -1 for a free slot
+     */
+    int32_t *_addr_table;
+    uint32_t _addr_table_size;
+
+    bool _adr;
+    float _adr_margin;
+
+    uint8_t _rx1_dr_offset;
+    uint8_t _rx2_datarate;
+    uint32_t _rx2_frequency;
+
+    uint32_t _channel_freq[NS_MAX_CHANNELS];
+    uint8_t _channel_dr_range[NS_MAX_CHANNELS];
+    uint16_t _channels;
+
+    uint32_t _app_nonce;
+
+    virtual_ns_stats_t _stats;
+};
+
+#endif /* MBED_LORAWAN_SIM_VIRTUAL_NETWORK_SERVER_H__ */
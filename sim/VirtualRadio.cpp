@@ -0,0 +1,568 @@
+/**
+ * @file VirtualRadio.cpp
+ *
+ * @brief LoRaRadio on a virtual medium and clock
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <math.h>
+#include <string.h>
+#include "platform/profile.h"
+#include "VirtualRadio.h"
+#include "SimLink.h"
+
+using namespace events;
+
+/**
+ * Sync word, length and CRC bytes an FSK frame adds to its payload
+ */
+#define FSK_OVERHEAD                6
+
+/**
+ * Symbols a CAD listens for
+ */
+#define CAD_SYMBOLS                 2
+
+VirtualRadio::VirtualRadio(VirtualAir &air, EventQueue &queue, uint32_t id)
+    : _air(air),
+      _queue(queue),
+      _events(NULL),
+      _config(&_rx_config),
+      _state(RF_IDLE),
+      _op_start(0),
+      _pending(0),
+      _receiving(false),
+      _rx_power(0),
+      _id(id),
+      _positioned(false),
+      _x(0),
+      _y(0),
+      _rssi(-60),
+      _snr(10),
+      _irq_latency(RADIO_IRQ_LATENCY),
+      _op_delay(0),
+      _clock_skew(0),
+      _skew_start(0),
+      _tx_offset(0),
+      _tx_jitter(0),
+      _tx_done_at(0),
+      _rx_window_start(0),
+      _rx_window_length(0),
+      _rx_window_frequency(0),
+      // xorshift never leaves 0
+      _random(id * 2654435761u + 1)
+{
+    radio_reset();
+    reset_stats();
+    _air.attach(this);
+}
+
+VirtualRadio::~VirtualRadio()
+{
+    stop();
+    _air.detach(this);
+}
+
+void VirtualRadio::init_radio(radio_events_t *events)
+{
+    _events = events;
+    radio_reset();
+}
+
+void VirtualRadio::radio_reset()
+{
+    stop();
+
+    memset(&_tx_config, 0, sizeof(_tx_config));
+    memset(&_rx_config, 0, sizeof(_rx_config));
+    _tx_config.modem = MODEM_LORA;
+    _rx_config.modem = MODEM_LORA;
+    _config = &_rx_config;
+    _tx_power = 0;
+    _symb_timeout = 0;
+    _rx_continuous = false;
+    _frequency = 0;
+    _public_network = true;
+}
+
+void VirtualRadio::sleep(void)
+{
+    stop();
+}
+
+void VirtualRadio::standby(void)
+{
+    stop();
+}
+
+void VirtualRadio::set_rx_config(radio_modems_t modem, uint32_t bandwidth,
+                                 uint32_t datarate, uint8_t coderate,
+                                 uint32_t bandwidth_afc, uint16_t preamble_len,
+                                 uint16_t symb_timeout, bool fix_len,
+                                 uint8_t payload_len,
+                                 bool crc_on, bool freq_hop_on, uint8_t hop_period,
+                                 bool iq_inverted, bool rx_continuous)
+{
+    _rx_config.modem = modem;
+    _rx_config.bandwidth = bandwidth;
+    _rx_config.datarate = datarate;
+    _rx_config.coderate = coderate;
+    _rx_config.preamble_len = preamble_len;
+    _rx_config.fix_len = fix_len;
+    _rx_config.crc_on = crc_on;
+    _rx_config.iq_inverted = iq_inverted;
+    _symb_timeout = symb_timeout;
+    _rx_continuous = rx_continuous;
+    _config = &_rx_config;
+}
+
+void VirtualRadio::set_tx_config(radio_modems_t modem, int8_t power, uint32_t fdev,
+                                 uint32_t bandwidth, uint32_t datarate,
+                                 uint8_t coderate, uint16_t preamble_len,
+                                 bool fix_len, bool crc_on, bool freq_hop_on,
+                                 uint8_t hop_period, bool iq_inverted, uint32_t timeout)
+{
+    _tx_config.modem = modem;
+    _tx_config.bandwidth = bandwidth;
+    _tx_config.datarate = datarate;
+    _tx_config.coderate = coderate;
+    _tx_config.preamble_len = preamble_len;
+    _tx_config.fix_len = fix_len;
+    _tx_config.crc_on = crc_on;
+    _tx_config.iq_inverted = iq_inverted;
+    _tx_power = power;
+    _config = &_tx_config;
+}
+
+void VirtualRadio::send(uint8_t *buffer, uint8_t size)
+{
+    stop();
+
+    air_frame_t frame;
+    frame.sender = this;
+    frame.sender_id = _id;
+    frame.x = _x;
+    frame.y = _y;
+    frame.modem = _tx_config.modem;
+    frame.frequency = _frequency;
+    frame.bandwidth = _tx_config.bandwidth;
+    frame.datarate = _tx_config.datarate;
+    frame.coderate = _tx_config.coderate;
+    frame.preamble_len = _tx_config.preamble_len;
+    frame.crc_on = _tx_config.crc_on;
+    frame.iq_inverted = _tx_config.iq_inverted;
+    frame.public_network = _public_network;
+    frame.power = _tx_power;
+    frame.size = size;
+    memcpy(frame.payload, buffer, size);
+
+    uint32_t air_time = get_time_on_air(_tx_config, size);
+    frame.start = _queue.tick();
+    frame.end = frame.start + air_time;
+
+    _state = RF_TX_RUNNING;
+    _op_start = frame.start;
+    _stats.tx_count++;
+    _stats.tx_time += air_time;
+
+    _air.transmit(frame);
+
+    uint32_t early = _tx_offset + (_tx_jitter ? random() % (_tx_jitter + 1) : 0);
+    if (early > air_time) {
+        early = air_time;
+    }
+
+    _pending = _queue.call_in(irq_delay(air_time - early), this, &VirtualRadio::tx_done_irq);
+}
+
+void VirtualRadio::receive(void)
+{
+    stop();
+
+    _state = RF_RX_RUNNING;
+    _op_start = _queue.tick();
+    _stats.rx_count++;
+
+    if (!_rx_continuous) {
+        uint32_t timeout = ceilf(_symb_timeout * get_symbol_time(_rx_config));
+        _rx_window_start = (int32_t)(_op_start - _tx_done_at);
+        _rx_window_length = timeout;
+        _rx_window_frequency = _frequency;
+        _pending = _queue.call_in(irq_delay(timeout), this,
+                                  &VirtualRadio::rx_timeout_irq);
+    }
+
+    // the preamble of a frame already on air may still be caught
+    const air_frame_t *frame;
+    for (uint32_t i = 0; !_receiving && (frame = _air.get_frame(_op_start, i)) != NULL; i++) {
+        try_detect(*frame);
+    }
+}
+
+void VirtualRadio::set_channel(uint32_t freq)
+{
+    _frequency = freq;
+}
+
+uint32_t VirtualRadio::random(void)
+{
+    // xorshift32, the same sequence every run
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+uint8_t VirtualRadio::get_status(void)
+{
+    return _state;
+}
+
+void VirtualRadio::set_max_payload_length(radio_modems_t modem, uint8_t max)
+{
+}
+
+void VirtualRadio::set_public_network(bool enable)
+{
+    _public_network = enable;
+}
+
+uint32_t VirtualRadio::time_on_air(radio_modems_t modem, uint8_t pkt_len)
+{
+    virtual_radio_config_t config = *_config;
+    config.modem = modem;
+
+    return get_time_on_air(config, pkt_len);
+}
+
+bool VirtualRadio::perform_carrier_sense(radio_modems_t modem,
+                                         uint32_t freq,
+                                         int16_t rssi_threshold,
+                                         uint32_t max_carrier_sense_time)
+{
+    const air_frame_t *frame;
+    lorawan_time_t now = _queue.tick();
+
+    for (uint32_t i = 0; (frame = _air.get_frame(now, i)) != NULL; i++) {
+        if (frame->frequency == freq && frame->power >= rssi_threshold) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void VirtualRadio::start_cad(void)
+{
+    stop();
+
+    const air_frame_t *frame;
+    lorawan_time_t now = _queue.tick();
+    bool busy = false;
+
+    for (uint32_t i = 0; (frame = _air.get_frame(now, i)) != NULL; i++) {
+        busy = busy || can_hear(*frame);
+    }
+
+    _state = RF_CAD;
+    _op_start = now;
+    _pending = _queue.call_in(irq_delay(ceilf(CAD_SYMBOLS * get_symbol_time(_rx_config))),
+                              this, &VirtualRadio::cad_done_irq, busy);
+}
+
+bool VirtualRadio::check_rf_frequency(uint32_t frequency)
+{
+    return true;
+}
+
+void VirtualRadio::set_tx_continuous_wave(uint32_t freq, int8_t power, uint16_t time)
+{
+    stop();
+
+    // a carrier carries no frame, nobody can hear it
+    _frequency = freq;
+    _state = RF_TX_RUNNING;
+    _op_start = _queue.tick();
+    _stats.tx_time += (uint32_t) time * 1000;
+
+    _pending = _queue.call_in(irq_delay((uint32_t) time * 1000), this,
+                              &VirtualRadio::tx_done_irq);
+}
+
+void VirtualRadio::lock(void)
+{
+}
+
+void VirtualRadio::unlock(void)
+{
+}
+
+void VirtualRadio::on_frame_start(const air_frame_t &frame)
+{
+    try_detect(frame);
+}
+
+void VirtualRadio::set_irq_latency(uint32_t ms)
+{
+    _irq_latency = ms;
+}
+
+void VirtualRadio::set_clock_skew(uint32_t ppm)
+{
+    _clock_skew = ppm;
+    _skew_start = _queue.tick();
+}
+
+void VirtualRadio::set_timing_offset(uint32_t offset, uint32_t jitter)
+{
+    _tx_offset = offset;
+    _tx_jitter = jitter;
+}
+
+void VirtualRadio::get_last_rx_window(int32_t &start, uint32_t &length) const
+{
+    start = _rx_window_start;
+    length = _rx_window_length;
+}
+
+uint32_t VirtualRadio::get_last_rx_frequency() const
+{
+    return _rx_window_frequency;
+}
+
+uint32_t VirtualRadio::irq_delay(uint32_t duration)
+{
+    // what a fast clock counted in excess since the skew was set, at the
+    // end of the operation
+    uint64_t elapsed = (uint32_t)(_queue.tick() + duration - _skew_start);
+    uint32_t skew = (uint32_t)(elapsed * _clock_skew / 1000000);
+
+    _op_delay = _irq_latency + skew;
+    return duration + _op_delay;
+}
+
+void VirtualRadio::set_link(int16_t rssi, int8_t snr)
+{
+    _rssi = rssi;
+    _snr = snr;
+}
+
+void VirtualRadio::set_position(float x, float y)
+{
+    _positioned = true;
+    _x = x;
+    _y = y;
+}
+
+uint32_t VirtualRadio::get_id() const
+{
+    return _id;
+}
+
+VirtualAir &VirtualRadio::get_air()
+{
+    return _air;
+}
+
+const virtual_radio_stats_t &VirtualRadio::get_stats() const
+{
+    return _stats;
+}
+
+void VirtualRadio::reset_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+float VirtualRadio::get_symbol_time(const virtual_radio_config_t &config)
+{
+    if (config.modem == MODEM_FSK) {
+        // a byte, the unit FSK preambles and timeouts are in
+        return config.datarate ? 8000.0f / config.datarate : 0;
+    }
+
+    uint32_t bandwidth = 125000 << (config.bandwidth < 3 ? config.bandwidth : 0);
+
+    return (float)(1 << config.datarate) * 1000.0f / bandwidth;
+}
+
+uint32_t VirtualRadio::get_time_on_air(const virtual_radio_config_t &config, uint8_t pkt_len)
+{
+    float ts = get_symbol_time(config);
+
+    if (config.modem == MODEM_FSK) {
+        return ceilf((config.preamble_len + FSK_OVERHEAD + pkt_len) * ts);
+    }
+
+    // SX126X data-sheet 6.1.4, low datarate optimization above 16 ms symbols
+    int32_t sf = config.datarate;
+    int32_t de = ts >= 16.0f ? 1 : 0;
+    int32_t bits = 8 * pkt_len - 4 * sf + 28 + (config.crc_on ? 16 : 0)
+                   - (config.fix_len ? 20 : 0);
+    int32_t per_block = 4 * (sf - 2 * de);
+    int32_t blocks = bits > 0 ? (bits + per_block - 1) / per_block : 0;
+    float symbols = config.preamble_len + 4.25f + 8
+                    + blocks * ((config.coderate % 4) + 4);
+
+    return ceilf(symbols * ts);
+}
+
+bool VirtualRadio::can_hear(const air_frame_t &frame) const
+{
+    const virtual_radio_config_t &rx = _rx_config;
+
+    return frame.frequency == _frequency
+           && frame.modem == rx.modem
+           && frame.bandwidth == rx.bandwidth
+           && frame.datarate == rx.datarate
+           && (frame.modem == MODEM_FSK
+               || (frame.iq_inverted == rx.iq_inverted
+                   && frame.public_network == _public_network));
+}
+
+void VirtualRadio::try_detect(const air_frame_t &frame)
+{
+    if (_state != RF_RX_RUNNING || _receiving || !can_hear(frame)) {
+        return;
+    }
+
+    lorawan_time_t now = _queue.tick();
+    float ts = get_symbol_time(_rx_config);
+
+    // listening started after the frame did, only the rest of the
+    // preamble can be detected
+    int32_t late = (int32_t)(now - frame.start);
+    float detected = (late > 0 ? late : 0) + RADIO_DETECT_SYMBOLS * ts;
+
+    if (detected > frame.preamble_len * ts) {
+        return;
+    }
+
+    if (!_rx_continuous
+            && (int32_t)(frame.start - _op_start) + detected > _symb_timeout * ts) {
+        return;
+    }
+
+    if (_positioned) {
+        _rx_power = SimLink::get_rx_power(frame, _x, _y);
+        if (_rx_power < SimLink::get_sensitivity(frame)) {
+            return;
+        }
+    }
+
+    if (_pending) {
+        _queue.cancel(_pending);
+    }
+
+    _receiving = true;
+    _rx_frame = frame;
+
+    _pending = _queue.call_in(irq_delay(frame.end - now), this,
+                              &VirtualRadio::rx_done_irq);
+}
+
+void VirtualRadio::tx_done_irq()
+{
+    PROFILE_ZONE(PROFILE_HANDLE_DIO1_IRQ);
+
+    _pending = 0;
+    _state = RF_IDLE;
+    _tx_done_at = _queue.tick();
+
+    if (_events && _events->tx_done) {
+        _events->tx_done();
+    }
+}
+
+void VirtualRadio::rx_done_irq()
+{
+    PROFILE_ZONE(PROFILE_HANDLE_DIO1_IRQ);
+
+    int16_t rssi = _rssi;
+    int8_t snr = _snr;
+
+    if (_positioned) {
+        // everything which overlapped the frame is known by its end
+        const air_frame_t *other;
+        for (uint32_t i = 0; (other = _air.get_interferer(_rx_frame, i)) != NULL; i++) {
+            if (!SimLink::survives(_rx_frame, _rx_power, *other,
+                                   SimLink::get_rx_power(*other, _x, _y))) {
+                rx_error_irq();
+                return;
+            }
+        }
+
+        rssi = (int16_t) _rx_power;
+        snr = (int8_t) SimLink::get_snr(_rx_frame, _rx_power);
+    }
+
+    _pending = 0;
+    _receiving = false;
+    _stats.rx_done_count++;
+
+    if (!_rx_continuous) {
+        _stats.rx_time += _queue.tick() - _op_delay - _op_start;
+        _state = RF_IDLE;
+    }
+
+    if (_events && _events->rx_done) {
+        _events->rx_done(_rx_frame.payload, _rx_frame.size, rssi, snr);
+    }
+}
+
+void VirtualRadio::rx_timeout_irq()
+{
+    PROFILE_ZONE(PROFILE_HANDLE_DIO1_IRQ);
+
+    _pending = 0;
+    _stats.rx_timeout_count++;
+    _stats.rx_time += _queue.tick() - _op_delay - _op_start;
+    _state = RF_IDLE;
+
+    if (_events && _events->rx_timeout) {
+        _events->rx_timeout();
+    }
+}
+
+void VirtualRadio::rx_error_irq()
+{
+    _pending = 0;
+    _receiving = false;
+    _stats.rx_error_count++;
+
+    if (!_rx_continuous) {
+        _stats.rx_time += _queue.tick() - _op_delay - _op_start;
+        _state = RF_IDLE;
+    }
+
+    if (_events && _events->rx_error) {
+        _events->rx_error();
+    }
+}
+
+void VirtualRadio::cad_done_irq(bool busy)
+{
+    _pending = 0;
+    _state = RF_IDLE;
+
+    if (_events && _events->cad_done) {
+        _events->cad_done(busy);
+    }
+}
+
+void VirtualRadio::stop()
+{
+    if (_pending) {
+        _queue.cancel(_pending);
+        _pending = 0;
+    }
+
+    if (_state == RF_RX_RUNNING) {
+        _stats.rx_time += _queue.tick() - _op_start;
+    }
+
+    _state = RF_IDLE;
+    _receiving = false;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file VirtualRadio.h
+ *
+ * @brief LoRaRadio on a virtual medium and clock
+ *
+ * Stands in for SX126X_LoRaRadio in the host simulation. What the stack can
+ * observe of a real radio is modelled on the virtual clock:
+ *
+ *  - airtime, with the time on air formula of the SX126X, so transmissions
+ *    take as long as they would on target and tx_done comes at their end,
+ *
+ *  - receive windows. A single reception listens for 'symb_timeout' symbols
+ *    and stops on preamble detection, like the SX126X does with
+ *    StopOnPreamble set. A frame is caught if the radio listens to
+ *    RADIO_DETECT_SYMBOLS symbols of its preamble before the timeout, and it
+ *    matches the RF settings: frequency, modem, bandwidth, datarate, IQ
+ *    polarity and sync word.
+ *
+ *  - the interrupt latency, the delay between the end of an operation and
+ *    its callback, which the stack timestamps frames with, and the skew of
+ *    the device clock, which delays the callbacks more as time goes on.
+ *    The end of a transmission can be reported early, by a fixed offset
+ *    and a jitter, for downlinks to seem to land late.
+ *
+ *  - once the radio is given a position, the link: frames below the
+ *    sensitivity are not detected, and a frame which does not survive an
+ *    interferer, see SimLink, ends in rx_error instead of rx_done. Without
+ *    a position every frame is received with the RSSI and SNR of set_link().
+ *
+ * Callbacks are posted to the event queue given at construction, as the
+ * interrupt handlers of the target would run. Every call is non-blocking.
+ *
+ * The radio accounts its time in TX and RX so energy can be compared between
+ * runs.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_VIRTUAL_RADIO_H__
+#define MBED_LORAWAN_SIM_VIRTUAL_RADIO_H__
+
+#include <stdint.h>
+#include "events/EventQueue.h"
+#include "lorawan/LoRaRadio.h"
+#include "VirtualAir.h"
+
+/**
+ * Preamble symbols the receiver needs to detect a frame
+ */
+#define RADIO_DETECT_SYMBOLS        4
+
+/**
+ * Default delay (ms) from the end of an operation to its callback
+ */
+#define RADIO_IRQ_LATENCY           1
+
+/**
+ * Modem settings of either direction
+ */
+typedef struct {
+    radio_modems_t modem;
+    uint32_t bandwidth;
+    uint32_t datarate;
+    uint8_t coderate;
+    uint16_t preamble_len;
+    bool fix_len;
+    bool crc_on;
+    bool iq_inverted;
+} virtual_radio_config_t;
+
+/**
+ * Activity of a radio
+ */
+typedef struct {
+    uint32_t tx_count;
+    /**
+     * Time (ms) spent transmitting
+     */
+    uint32_t tx_time;
+    /**
+     * Receptions started
+     */
+    uint32_t rx_count;
+    /**
+     * Time (ms) spent receiving
+     */
+    uint32_t rx_time;
+    uint32_t rx_done_count;
+    uint32_t rx_timeout_count;
+    /**
+     * Frames lost to interference after their preamble was detected
+     */
+    uint32_t rx_error_count;
+} virtual_radio_stats_t;
+
+class VirtualRadio : public LoRaRadio {
+public:
+    /** Attaches a radio to a medium
+     *
+     * @param air           Medium
+     * @param queue         Queue the callbacks are posted to
+     * @param id            Identifies the radio on the medium, also seeds
+     *                      random()
+     */
+    VirtualRadio(VirtualAir &air, events::EventQueue &queue, uint32_t id);
+
+    virtual ~VirtualRadio();
+
+    virtual void init_radio(radio_events_t *events);
+    virtual void radio_reset();
+    virtual void sleep(void);
+    virtual void standby(void);
+    virtual void set_rx_config(radio_modems_t modem, uint32_t bandwidth,
+                               uint32_t datarate, uint8_t coderate,
+                               uint32_t bandwidth_afc, uint16_t preamble_len,
+                               uint16_t symb_timeout, bool fix_len,
+                               uint8_t payload_len,
+                               bool crc_on, bool freq_hop_on, uint8_t hop_period,
+                               bool iq_inverted, bool rx_continuous);
+    virtual void set_tx_config(radio_modems_t modem, int8_t power, uint32_t fdev,
+                               uint32_t bandwidth, uint32_t datarate,
+                               uint8_t coderate, uint16_t preamble_len,
+                               bool fix_len, bool crc_on, bool freq_hop_on,
+                               uint8_t hop_period, bool iq_inverted, uint32_t timeout);
+    virtual void send(uint8_t *buffer, uint8_t size);
+    virtual void receive(void);
+    virtual void set_channel(uint32_t freq);
+    virtual uint32_t random(void);
+    virtual uint8_t get_status(void);
+    virtual void set_max_payload_length(radio_modems_t modem, uint8_t max);
+    virtual void set_public_network(bool enable);
+    virtual uint32_t time_on_air(radio_modems_t modem, uint8_t pkt_len);
+    virtual bool perform_carrier_sense(radio_modems_t modem,
+                                       uint32_t freq,
+                                       int16_t rssi_threshold,
+                                       uint32_t max_carrier_sense_time);
+    virtual void start_cad(void);
+    virtual bool check_rf_frequency(uint32_t frequency);
+    virtual void set_tx_continuous_wave(uint32_t freq, int8_t power, uint16_t time);
+    virtual void lock(void);
+    virtual void unlock(void);
+
+    /** A frame starts on the medium
+     */
+    void on_frame_start(const air_frame_t &frame);
+
+    /** Sets the delay (ms) from the end of an operation to its callback
+     */
+    void set_irq_latency(uint32_t ms);
+
+    /** Makes the device clock run fast from now on
+     *
+     * The stack timestamps the callbacks with its own clock. Each callback
+     * is delayed by what a clock 'ppm' fast would have counted in excess
+     * since, so that the times the stack sees run fast against the network.
+     *
+     * @param ppm           Skew, 0 for none
+     */
+    void set_clock_skew(uint32_t ppm);
+
+    /** Makes the stack see the end of its uplinks early
+     *
+     * tx_done comes 'offset' ms, plus up to 'jitter' ms drawn for each
+     * frame, before the frame leaves the air, so that the downlinks answering
+     * it seem to land that late. The offset is capped by the time on air.
+     */
+    void set_timing_offset(uint32_t offset, uint32_t jitter);
+
+    /** Last reception with a timeout
+     *
+     * @param start         [out] Opening (ms) after the last tx_done callback
+     * @param length        [out] Length (ms)
+     */
+    void get_last_rx_window(int32_t &start, uint32_t &length) const;
+
+    /** Frequency (Hz) of the last reception with a timeout
+     */
+    uint32_t get_last_rx_frequency() const;
+
+    /** Sets what received frames are reported with, without a position
+     */
+    void set_link(int16_t rssi, int8_t snr);
+
+    /** Places the radio, which enables the link model
+     *
+     * @param x, y          Position (m)
+     */
+    void set_position(float x, float y);
+
+    uint32_t get_id() const;
+
+    VirtualAir &get_air();
+
+    const virtual_radio_stats_t &get_stats() const;
+
+    void reset_stats();
+
+    /** Time on air (ms) of a frame
+     *
+     * @param config        Modem settings
+     * @param pkt_len       Payload size
+     */
+    static uint32_t get_time_on_air(const virtual_radio_config_t &config, uint8_t pkt_len);
+
+    /** Length (ms) of a symbol
+     */
+    static float get_symbol_time(const virtual_radio_config_t &config);
+
+private:
+    bool can_hear(const air_frame_t &frame) const;
+
+    /**
+     * Starts receiving a frame if enough of its preamble can be heard
+     */
+    void try_detect(const air_frame_t &frame);
+
+    void tx_done_irq();
+    void rx_done_irq();
+    void rx_timeout_irq();
+    void rx_error_irq();
+    void cad_done_irq(bool busy);
+
+    /**
+     * Delay (ms) to the callback of an operation lasting 'duration'
+     */
+    uint32_t irq_delay(uint32_t duration);
+
+    /**
+     * Drops whatever operation is in progress
+     */
+    void stop();
+
+    VirtualAir &_air;
+    events::EventQueue &_queue;
+    radio_events_t *_events;
+
+    virtual_radio_config_t _tx_config;
+    virtual_radio_config_t _rx_config;
+    /**
+     * Settings the time on air is computed with, the last ones set
+     */
+    const virtual_radio_config_t *_config;
+
+    int8_t _tx_power;
+    uint16_t _symb_timeout;
+    bool _rx_continuous;
+    uint32_t _frequency;
+    bool _public_network;
+
+    radio_state_t _state;
+    lorawan_time_t _op_start;
+    /**
+     * Event ending the current operation, 0 if none
+     */
+    int _pending;
+
+    /**
+     * A frame is being received, and its power (dBm)
+     */
+    bool _receiving;
+    air_frame_t _rx_frame;
+    float _rx_power;
+
+    uint32_t _id;
+    bool _positioned;
+    float _x;
+    float _y;
+
+    int16_t _rssi;
+    int8_t _snr;
+    uint32_t _irq_latency;
+    /**
+     * Delay from the end of the current operation to its callback
+     */
+    uint32_t _op_delay;
+    uint32_t _clock_skew;
+    lorawan_time_t _skew_start;
+    uint32_t _tx_offset;
+    uint32_t _tx_jitter;
+    lorawan_time_t _tx_done_at;
+    int32_t _rx_window_start;
+    uint32_t _rx_window_length;
+    uint32_t _rx_window_frequency;
+    uint32_t _random;
+
+    virtual_radio_stats_t _stats;
+};
+
+#endif /* MBED_LORAWAN_SIM_VIRTUAL_RADIO_H__ */
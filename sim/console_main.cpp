@@ -0,0 +1,258 @@
+/**
+ * @file console_main.cpp
+ *
+ * @brief Console ring against a slow port
+ *
+ * Writes bursts of lines, as the event handler of the application does, to
+ * the console ring of platform/console_ring.h while another thread drains
+ * it to a sink taking bytes no faster than a serial port would. Prints how
+ * long the writes took, against how long waiting on the port would have,
+ * and checks that what came out is every line written, in order and whole,
+ * but for those the drop lines account for. Exits non-zero if not.
+ *
+ *   lorawan_console [-b baud] [-n lines] [-l lines per burst]
+ *                   [-i burst interval (ms)] [-w]
+ *
+ * -w has the writers wait for room rather than drop.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "platform/console_ring.h"
+
+// written last, until it fits, so the lines dropped before it are told
+static const char end_line[] = "end\r\n";
+
+static uint32_t baud = 115200;
+
+static uint64_t start;
+static uint64_t sent;
+
+static char *capture;
+static size_t capture_size;
+
+static bool writing = true;
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static void format_line(char *line, size_t size, uint32_t index)
+{
+    snprintf(line, size, "line %06lu: Message #%lu queued for transmission (%lu bytes)\r\n",
+             (unsigned long) index, (unsigned long)(index % 256), (unsigned long)(index % 51));
+}
+
+/**
+ * Takes what a port of 10 bits a byte would have sent since the start
+ */
+static size_t slow_sink(const char *data, size_t size)
+{
+    uint64_t budget = (now_ns() - start) * (baud / 10) / 1000000000u - sent;
+
+    if (size > budget) {
+        size = budget;
+    }
+
+    memcpy(&capture[capture_size], data, size);
+    capture_size += size;
+    sent += size;
+
+    return size;
+}
+
+static bool wait_for_room()
+{
+    usleep(1000);
+    return true;
+}
+
+static void *drain(void *)
+{
+    while (true) {
+        bool last = !__atomic_load_n(&writing, __ATOMIC_ACQUIRE);
+        const char *data;
+
+        console_ring_drain(slow_sink);
+
+        if (console_ring_peek(&data) == 0 && last) {
+            return NULL;
+        }
+
+        usleep(1000);
+    }
+}
+
+/**
+ * Checks the capture against the lines written, returning the bytes of the
+ * lines missing from it, or -1 if the capture is wrong
+ */
+static long check_capture(uint32_t nb_lines, unsigned long &told_dropped)
+{
+    char expected[128];
+    uint32_t next = 0;
+    long missing = 0;
+
+    capture[capture_size] = 0;
+    told_dropped = 0;
+
+    for (char *line = capture; *line;) {
+        char *end = strchr(line, '\n');
+        if (!end) {
+            printf("  capture ends in the middle of a line\n");
+            return -1;
+        }
+        *end = 0;
+
+        unsigned long dropped;
+        unsigned long index;
+        if (sscanf(line, "[console: %lu bytes dropped]", &dropped) == 1) {
+            told_dropped += dropped;
+        } else if (sscanf(line, "line %lu:", &index) == 1) {
+            if (index < next || index >= nb_lines) {
+                printf("  line %lu out of order\n", index);
+                return -1;
+            }
+            format_line(expected, sizeof(expected), index);
+            if (strncmp(line, expected, end - line) != 0 || expected[end - line + 1] != 0) {
+                printf("  line %lu is not whole\n", index);
+                return -1;
+            }
+            for (; next < index; next++) {
+                format_line(expected, sizeof(expected), next);
+                missing += strlen(expected);
+            }
+            next++;
+        } else if (*line != 0 && strcmp(line, "\r") != 0 && strcmp(line, "end\r") != 0) {
+            printf("  unexpected line: %s\n", line);
+            return -1;
+        }
+
+        line = end + 1;
+    }
+
+    for (; next < nb_lines; next++) {
+        format_line(expected, sizeof(expected), next);
+        missing += strlen(expected);
+    }
+
+    return missing;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t nb_lines = 400;
+    uint32_t burst = 8;
+    uint32_t interval = 20;
+    bool wait = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "b:n:l:i:w")) != -1) {
+        switch (option) {
+            case 'b':
+                baud = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                nb_lines = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                burst = strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                interval = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                wait = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b baud] [-n lines] [-l lines per burst]\n"
+                        "       [-i burst interval (ms)] [-w]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (baud < 10 || burst == 0) {
+        fprintf(stderr, "baud and lines per burst must be set\n");
+        return 2;
+    }
+
+    capture = static_cast<char *>(malloc((size_t) nb_lines * 128 + 1));
+
+    if (wait) {
+        console_ring_set_wait(wait_for_room);
+    }
+
+    start = now_ns();
+
+    pthread_t drainer;
+    pthread_create(&drainer, NULL, drain, NULL);
+
+    char line[128];
+    uint64_t latency_total = 0;
+    uint64_t latency_max = 0;
+    uint64_t bytes = 0;
+
+    for (uint32_t i = 0; i < nb_lines; i++) {
+        format_line(line, sizeof(line), i);
+        size_t length = strlen(line);
+
+        uint64_t before = now_ns();
+        console_ring_write(line, length);
+        uint64_t latency = now_ns() - before;
+
+        latency_total += latency;
+        if (latency > latency_max) {
+            latency_max = latency;
+        }
+        bytes += length;
+
+        if ((i + 1) % burst == 0) {
+            usleep(interval * 1000);
+        }
+    }
+
+    uint32_t end_attempts = 1;
+    while (console_ring_write(end_line, sizeof(end_line) - 1) == 0) {
+        end_attempts++;
+        usleep(1000);
+    }
+
+    __atomic_store_n(&writing, false, __ATOMIC_RELEASE);
+    pthread_join(drainer, NULL);
+
+    unsigned long told_dropped;
+    long missing = check_capture(nb_lines, told_dropped);
+    if (missing >= 0) {
+        missing += (end_attempts - 1) * (sizeof(end_line) - 1);
+    }
+    unsigned long dropped = console_ring_get_dropped();
+
+    printf("%lu lines, %lu bytes at %lu baud, %s when full\n", (unsigned long) nb_lines,
+           (unsigned long) bytes, (unsigned long) baud, wait ? "waiting" : "dropping");
+    printf("write      mean %.2f us  max %.2f us  (%.2f us a line waiting on the port)\n",
+           latency_total / 1000.0 / nb_lines, latency_max / 1000.0,
+           bytes * 10 * 1e6 / baud / nb_lines);
+    printf("ring       %lu bytes  peak %lu  dropped %lu  told %lu  missing %ld\n",
+           (unsigned long) CONSOLE_RING_SIZE, (unsigned long) console_ring_get_peak(),
+           dropped, told_dropped, missing);
+
+    free(capture);
+
+    if (missing < 0 || (unsigned long) missing != dropped || told_dropped != dropped
+            || (wait && dropped != 0)) {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file fleet_main.cpp
+ *
+ * @brief Command line of the fleet simulation
+ *
+ * Runs a SimFleet and prints what became of the messages of all devices,
+ * and of each device to a CSV file if asked to.
+ *
+ *   lorawan_fleet [-n nodes] [-H hours] [-t threads] [-p period (s)]
+ *                 [-s payload size] [-r radius (m)] [-w window (ms)]
+ *                 [-d datarate] [-S seed] [-o per-node CSV]
+ *                 [-N] [-j] [-c] [-a] [-P]
+ *
+ * -N runs a network server behind the gateway, -j has the devices join with
+ * OTAA, -c send confirmed messages and -a request ADR; the last three imply
+ * -N. -P prints the time spent in the zones of platform/profile.h, summed
+ * over the devices and threads.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "platform/profile.h"
+#include "SimFleet.h"
+
+static const char *fate_names[GATEWAY_FATES] = {
+    "received", "weak", "demodulator", "collision", "transmitting"
+};
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n nodes] [-H hours] [-t threads] [-p period (s)]\n"
+            "       [-s payload size] [-r radius (m)] [-w window (ms)] [-d datarate]\n"
+            "       [-S seed] [-o per-node CSV] [-N] [-j] [-c] [-a] [-P]\n", name);
+}
+
+static bool write_csv(const char *path, const SimFleet &fleet)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "node,x,y,datarate,joined,join_time,generated,skipped,sent,failed,delivered,"
+            "lost_weak,lost_demodulator,lost_collision,lost_transmitting,latency_mean,latency_max,"
+            "airtime\n");
+
+    for (uint32_t i = 0; i < fleet.get_config().nb_nodes; i++) {
+        const sim_fleet_node_stats_t &stats = fleet.get_node_stats(i);
+
+        fprintf(file, "%lu,%.1f,%.1f,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%lu,%lu\n",
+                (unsigned long) i, stats.x, stats.y, stats.datarate, stats.joined,
+                (unsigned long) stats.join_time, (unsigned long) stats.generated, (unsigned long) stats.skipped,
+                (unsigned long) stats.sent, (unsigned long) stats.failed,
+                (unsigned long) stats.delivered,
+                (unsigned long) stats.lost[GATEWAY_LOST_WEAK],
+                (unsigned long) stats.lost[GATEWAY_LOST_DEMODULATOR],
+                (unsigned long) stats.lost[GATEWAY_LOST_COLLISION],
+                (unsigned long) stats.lost[GATEWAY_LOST_TRANSMITTING],
+                stats.latency_count ? (double) stats.latency_sum / stats.latency_count : 0.0,
+                (unsigned long) stats.latency_max, (unsigned long) stats.airtime);
+    }
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    sim_fleet_config_t config;
+    config.nb_nodes = 1000;
+    config.nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    config.duration = 3600000;
+    config.period = 600000;
+    config.payload_size = 20;
+    config.radius = 300;
+    config.window = 500;
+    config.datarate = FLEET_DATARATE_AUTO;
+    config.seed = 1;
+    config.network = false;
+    config.otaa = false;
+    config.confirmed = false;
+    config.adr = false;
+
+    const char *csv = NULL;
+    bool profile = false;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:H:t:p:s:r:w:d:S:o:NjcaP")) != -1) {
+        switch (option) {
+            case 'n':
+                config.nb_nodes = strtoul(optarg, NULL, 0);
+                break;
+            case 'H':
+                config.duration = strtod(optarg, NULL) * 3600000;
+                break;
+            case 't':
+                config.nb_threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                config.period = strtod(optarg, NULL) * 1000;
+                break;
+            case 's':
+                config.payload_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                config.radius = strtod(optarg, NULL);
+                break;
+            case 'w':
+                config.window = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                config.datarate = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                config.seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                csv = optarg;
+                break;
+            case 'N':
+                config.network = true;
+                break;
+            case 'j':
+                config.network = config.otaa = true;
+                break;
+            case 'c':
+                config.network = config.confirmed = true;
+                break;
+            case 'a':
+                config.network = config.adr = true;
+                break;
+            case 'P':
+                profile = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    // devices must not hear back from the gateway within a window
+    if (config.nb_nodes == 0 || config.window == 0 || config.window > 1000
+            || config.period == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    SimFleet fleet(config);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!fleet.run()) {
+        fprintf(stderr, "devices could not be started\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    sim_fleet_node_stats_t total;
+    fleet.get_total_stats(total);
+    const virtual_gateway_stats_t &gateway = fleet.get_gateway().get_stats();
+    const sim_fleet_config_t &used = fleet.get_config();
+
+    printf("%lu nodes, %.2f h in %.1f s on %lu threads\n",
+           (unsigned long) used.nb_nodes, used.duration / 3600000.0, elapsed,
+           (unsigned long) used.nb_threads);
+    printf("messages   generated %lu  skipped %lu  sent %lu  done %lu  failed %lu\n",
+           (unsigned long) total.generated, (unsigned long) total.skipped,
+           (unsigned long) total.sent, (unsigned long) total.latency_count,
+           (unsigned long) total.failed);
+    printf("gateway    frames %lu", (unsigned long) gateway.frame_count);
+    for (uint8_t fate = 0; fate < GATEWAY_FATES; fate++) {
+        printf("  %s %lu", fate_names[fate], (unsigned long) gateway.fate_count[fate]);
+    }
+    printf("  overflow %lu\n", (unsigned long)(gateway.overflow_count
+                                               + fleet.get_overflow_count()));
+    if (used.network) {
+        const virtual_ns_stats_t &server = fleet.get_server().get_stats();
+        uint32_t joined = 0;
+        uint64_t join_time = 0;
+
+        for (uint32_t i = 0; i < used.nb_nodes; i++) {
+            joined += fleet.get_node_stats(i).joined;
+            join_time += fleet.get_node_stats(i).join_time;
+        }
+
+        printf("server     uplinks %lu  duplicates %lu  retransmissions %lu  mic failures %lu\n",
+               (unsigned long) server.uplinks, (unsigned long) server.duplicates,
+               (unsigned long) server.retransmissions, (unsigned long) server.mic_failures);
+        printf("downlinks  rx1 %lu  rx2 %lu  missed %lu  gateway rejected %lu\n",
+               (unsigned long) server.rx1_downlinks, (unsigned long) server.rx2_downlinks,
+               (unsigned long) server.missed_downlinks, (unsigned long) gateway.downlink_rejected);
+        if (used.otaa) {
+            printf("joins      %lu of %lu devices, mean %.0f ms  rejected %lu\n",
+                   (unsigned long) joined, (unsigned long) used.nb_nodes,
+                   joined ? (double) join_time / joined : 0.0,
+                   (unsigned long) server.join_rejected);
+        }
+        if (used.adr) {
+            printf("adr        requests %lu  accepted %lu\n",
+                   (unsigned long) server.adr_requests, (unsigned long) server.adr_accepted);
+        }
+    }
+    uint32_t frames = total.delivered;
+    for (uint8_t fate = 0; fate < GATEWAY_FATES; fate++) {
+        frames += total.lost[fate];
+    }
+    printf("delivery   %.2f %% of the data frames\n",
+           frames ? 100.0 * total.delivered / frames : 0.0);
+    printf("latency    mean %.0f ms  max %lu ms\n",
+           total.latency_count ? (double) total.latency_sum / total.latency_count : 0.0,
+           (unsigned long) total.latency_max);
+    printf("airtime    %.1f s, %.3f %% per node\n", total.airtime / 1000.0,
+           100.0 * total.airtime / used.nb_nodes / used.duration);
+
+    if (profile) {
+        profile_dump();
+    }
+
+    if (csv && !write_csv(csv, fleet)) {
+        fprintf(stderr, "cannot write %s\n", csv);
+        return 1;
+    }
+
+    return 0;
+}
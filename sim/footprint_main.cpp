@@ -0,0 +1,47 @@
+/**
+ * @file footprint_main.cpp
+ *
+ * @brief RAM of the objects of the stack
+ *
+ * Prints the size of the objects an application holds the stack in, as
+ * built with mbed_config.h, and the feature switches they were built with.
+ * The objects are not in the static RAM that make footprint reads from the
+ * object files, but wherever the application puts its LoRaWANInterface.
+ * The sizes are those of the host, with its 64-bit pointers; they are to
+ * compare profiles, not to size the target.
+ *
+ *   lorawan_footprint
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include "lorawan/LoRaWANInterface.h"
+#include "lorawan/lorastack/phy/loraphy_target.h"
+
+static void print_size(const char *name, size_t size)
+{
+    printf("  %-28s %6lu\n", name, (unsigned long) size);
+}
+
+int main()
+{
+    printf("profile: class-c %d, multicast-groups %d, fsk %d, custom-channel-plans %d, "
+           "continuous-wave %d\n",
+           MBED_CONF_LORA_CLASS_C, MBED_CONF_LORA_MULTICAST_GROUPS, MBED_CONF_LORA_FSK,
+           MBED_CONF_LORA_CUSTOM_CHANNEL_PLANS, MBED_CONF_LORA_CONTINUOUS_WAVE);
+
+    printf("objects (bytes):\n");
+    print_size("LoRaWANInterface", sizeof(LoRaWANInterface));
+    print_size("  LoRaWANStack", sizeof(LoRaWANStack));
+    print_size("    LoRaMac", sizeof(LoRaMac));
+    print_size("      LoRaMacCommand", sizeof(LoRaMacCommand));
+    print_size("      LoRaMacChannelPlan", sizeof(LoRaMacChannelPlan));
+    print_size("      LoRaMacCrypto", sizeof(LoRaMacCrypto));
+    print_size("      LoRaMacClassB", sizeof(LoRaMacClassB));
+    print_size("      multicast groups", sizeof(multicast_group_t) * MBED_CONF_LORA_MULTICAST_GROUPS);
+    print_size("  PHY of the region", sizeof(LoRaPHY_region));
+
+    return 0;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file frag_main.cpp
+ *
+ * @brief FEC decoder of the Fragmented Data Block Transport against loss
+ *
+ * Cuts a random image into fragments and codes it as a server of the
+ * LoRaWAN Fragmented Data Block Transport does, with a parity matrix of its
+ * own after the specification. A LoRaWANFragDecoder on a LoRaWANRamStorage
+ * then gets the uncoded fragments, and coded ones until the block is whole,
+ * each fragment being lost with a given probability. For 10, 20 and 30 %
+ * loss prints the fragments lost, the coded fragments it took, the
+ * wall-clock time spent in process() a run and the image bytes restored a
+ * second of it, and the storage scratch space the rows took; the RAM of the
+ * decoder is fixed. A run fails if the block is not restored with as many
+ * coded fragments as uncoded ones, or differs from the image.
+ *
+ * A run then sends every uncoded fragment twice, the lost ones late, once
+ * coded fragments have started, and checks each counts once. A last run loses one
+ * fragment more than MBED_CONF_LORA_FRAG_MAX_REDUNDANCY, which the decoder
+ * must report instead of restoring a wrong block. Exits non-zero if a run
+ * fails.
+ *
+ *   lorawan_frag [-s image size] [-f fragment size] [-r runs] [-S seed]
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lorawan/system/LoRaWANFragDecoder.h"
+#include "lorawan/system/LoRaWANRamStorage.h"
+
+#define ERASE_SIZE      4096
+
+#define MAX_IMAGE_SIZE  (MBED_CONF_LORA_FRAG_MAX_FRAGMENTS * MBED_CONF_LORA_FRAG_MAX_SIZE)
+
+/**
+ * The block and a scratch row for every fragment which can be recovered
+ */
+#define STORAGE_SIZE    ((MAX_IMAGE_SIZE + MBED_CONF_LORA_FRAG_MAX_REDUNDANCY     \
+                          * MBED_CONF_LORA_FRAG_MAX_SIZE + ERASE_SIZE - 1)        \
+                         / ERASE_SIZE * ERASE_SIZE)
+
+static uint8_t image[MAX_IMAGE_SIZE];
+
+static uint8_t flash[STORAGE_SIZE];
+
+static LoRaWANFragDecoder decoder;
+
+static uint32_t image_size = 100 * 1024;
+static uint8_t frag_size = 232;
+static uint16_t nb_frag;
+
+/**
+ * Outcome of a run
+ */
+typedef struct {
+    bool passed;
+    uint32_t lost;          /**< Uncoded fragments lost */
+    uint32_t coded;         /**< Coded fragments sent until restored */
+    uint64_t decode_ns;     /**< Time spent in process() */
+} frag_result_t;
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static uint32_t prbs23(uint32_t x)
+{
+    uint32_t b0 = x & 1;
+    uint32_t b1 = (x >> 5) & 1;
+    return (x >> 1) | ((b0 ^ b1) << 22);
+}
+
+/**
+ * Coded fragment M + n, the XOR of the uncoded fragments of its row of the
+ * parity matrix
+ */
+static void code_fragment(uint16_t n, uint8_t *coded)
+{
+    static uint8_t line[MBED_CONF_LORA_FRAG_MAX_FRAGMENTS];
+    uint32_t m = nb_frag;
+    uint32_t modulo = (m & (m - 1)) == 0 ? m + 1 : m;
+    uint32_t x = 1 + 1001 * (uint32_t) n;
+
+    memset(line, 0, m);
+    for (uint32_t i = 0; i < m / 2; i++) {
+        uint32_t r;
+        do {
+            x = prbs23(x);
+            r = x % modulo;
+        } while (r >= m);
+        line[r] = 1;
+    }
+
+    memset(coded, 0, frag_size);
+    for (uint32_t i = 0; i < m; i++) {
+        if (line[i]) {
+            for (uint8_t b = 0; b < frag_size; b++) {
+                coded[b] ^= image[i * frag_size + b];
+            }
+        }
+    }
+}
+
+static bool process(uint16_t index, const uint8_t *data, frag_result_t &result)
+{
+    uint64_t start = now_ns();
+    lorawan_status_t status = decoder.process(index, data);
+    result.decode_ns += now_ns() - start;
+
+    if (status != LORAWAN_STATUS_OK) {
+        printf("  fragment %u: status %d\n", index, status);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Sends the block, losing each fragment with a probability of 'loss' %, or
+ * the first 'nb_lost' uncoded fragments if not 0
+ */
+static frag_result_t run(LoRaWANRamStorage &storage, uint32_t loss, uint32_t nb_lost)
+{
+    frag_result_t result = { false, 0, 0, 0 };
+    uint8_t coded[MBED_CONF_LORA_FRAG_MAX_SIZE];
+
+    for (uint32_t i = 0; i < image_size; i++) {
+        image[i] = rand();
+    }
+    // the last fragment is padded
+    memset(&image[image_size], 0, (uint32_t) nb_frag * frag_size - image_size);
+
+    if (decoder.setup(&storage, 0, sizeof(flash), nb_frag, frag_size) != LORAWAN_STATUS_OK) {
+        printf("  cannot set up %u fragments of %u\n", nb_frag, frag_size);
+        return result;
+    }
+
+    for (uint16_t i = 0; i < nb_frag; i++) {
+        if (nb_lost ? i < nb_lost : (uint32_t) rand() % 100 < loss) {
+            result.lost++;
+            continue;
+        }
+        if (!process(i + 1, &image[i * frag_size], result)) {
+            return result;
+        }
+    }
+
+    while (!decoder.is_complete() && !decoder.is_out_of_memory() && result.coded < nb_frag) {
+        result.coded++;
+        code_fragment(result.coded, coded);
+        if (!nb_lost && (uint32_t) rand() % 100 < loss) {
+            continue;
+        }
+        if (!process(nb_frag + result.coded, coded, result)) {
+            return result;
+        }
+    }
+
+    if (nb_lost > MBED_CONF_LORA_FRAG_MAX_REDUNDANCY) {
+        result.passed = decoder.is_out_of_memory() && !decoder.is_complete();
+        if (!result.passed) {
+            printf("  %lu fragments lost: not reported\n", (unsigned long) nb_lost);
+        }
+        return result;
+    }
+
+    if (!decoder.is_complete()) {
+        printf("  %lu%% loss: %u fragments missing after %lu coded\n", (unsigned long) loss,
+               decoder.get_nb_missing(), (unsigned long) result.coded);
+        return result;
+    }
+
+    if (memcmp(flash, image, image_size) != 0) {
+        printf("  %lu%% loss: block differs from the image\n", (unsigned long) loss);
+        return result;
+    }
+
+    result.passed = true;
+    return result;
+}
+
+/**
+ * Loses the first uncoded fragments, sends a coded one, then the lost ones
+ * late, each uncoded fragment twice
+ */
+static bool run_duplicates(LoRaWANRamStorage &storage)
+{
+    frag_result_t result = { false, 0, 0, 0 };
+    uint8_t coded[MBED_CONF_LORA_FRAG_MAX_SIZE];
+    uint16_t nb_lost = nb_frag / 2 < 4 ? nb_frag / 2 : 4;
+
+    for (uint32_t i = 0; i < image_size; i++) {
+        image[i] = rand();
+    }
+    memset(&image[image_size], 0, (uint32_t) nb_frag * frag_size - image_size);
+
+    if (decoder.setup(&storage, 0, sizeof(flash), nb_frag, frag_size) != LORAWAN_STATUS_OK) {
+        return false;
+    }
+
+    for (uint16_t i = nb_lost; i < nb_frag; i++) {
+        for (uint8_t copy = 0; copy < 2; copy++) {
+            if (!process(i + 1, &image[i * frag_size], result)) {
+                return false;
+            }
+        }
+    }
+
+    code_fragment(1, coded);
+    if (!process(nb_frag + 1, coded, result)) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < nb_lost; i++) {
+        for (uint8_t copy = 0; copy < 2; copy++) {
+            if (!process(i + 1, &image[i * frag_size], result)) {
+                return false;
+            }
+        }
+        // the coded fragment and the late ones restore the block early
+        if (decoder.is_complete()) {
+            break;
+        }
+        if (decoder.get_nb_received() != nb_frag - nb_lost + 2 + i) {
+            printf("  late fragment %u counted %u times\n", i + 1,
+                   decoder.get_nb_received() - (nb_frag - nb_lost + 1 + i));
+            return false;
+        }
+    }
+
+    if (!decoder.is_complete() || memcmp(flash, image, image_size) != 0) {
+        printf("  duplicates: block not restored\n");
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    LoRaWANRamStorage storage(flash, sizeof(flash), ERASE_SIZE);
+    uint32_t nb_runs = 20;
+    unsigned int seed = 1;
+    uint32_t failures = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "s:f:r:S:")) != -1) {
+        switch (option) {
+            case 's':
+                image_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frag_size = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                nb_runs = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s image size] [-f fragment size] [-r runs] "
+                        "[-S seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (frag_size == 0 || frag_size > MBED_CONF_LORA_FRAG_MAX_SIZE || image_size == 0
+            || (image_size + frag_size - 1) / frag_size > MBED_CONF_LORA_FRAG_MAX_FRAGMENTS
+            || nb_runs == 0) {
+        fprintf(stderr, "at most %d fragments of at most %d bytes, and a run\n",
+                MBED_CONF_LORA_FRAG_MAX_FRAGMENTS, MBED_CONF_LORA_FRAG_MAX_SIZE);
+        return 2;
+    }
+
+    srand(seed);
+    nb_frag = (image_size + frag_size - 1) / frag_size;
+
+    printf("%lu bytes in %u fragments of %u, %lu runs, decoder RAM %lu bytes\n",
+           (unsigned long) image_size, nb_frag, frag_size, (unsigned long) nb_runs,
+           (unsigned long) sizeof(LoRaWANFragDecoder));
+    printf("%6s %10s %10s %10s %10s %10s %10s\n", "loss", "lost", "coded", "coded max",
+           "decode ms", "MB/s", "scratch");
+
+    for (uint32_t loss = 10; loss <= 30; loss += 10) {
+        uint64_t lost = 0;
+        uint64_t coded = 0;
+        uint64_t decode_ns = 0;
+        uint32_t most_coded = 0;
+        uint32_t most_lost = 0;
+
+        for (uint32_t i = 0; i < nb_runs; i++) {
+            frag_result_t result = run(storage, loss, 0);
+
+            if (!result.passed) {
+                failures++;
+            }
+            lost += result.lost;
+            coded += result.coded;
+            decode_ns += result.decode_ns;
+            most_coded = result.coded > most_coded ? result.coded : most_coded;
+            most_lost = result.lost > most_lost ? result.lost : most_lost;
+        }
+
+        printf("%5lu%% %10.1f %10.1f %10lu %10.2f %10.1f %10lu\n", (unsigned long) loss,
+               (double) lost / nb_runs, (double) coded / nb_runs, (unsigned long) most_coded,
+               decode_ns / 1e6 / nb_runs,
+               (double) image_size * nb_runs * 1e3 / (decode_ns ? decode_ns : 1),
+               (unsigned long) most_lost * frag_size);
+    }
+
+    if (nb_frag >= 2) {
+        bool passed = run_duplicates(storage);
+        printf("duplicates: %s\n", passed ? "counted once" : "FAILED");
+        if (!passed) {
+            failures++;
+        }
+    }
+
+    if (nb_frag > MBED_CONF_LORA_FRAG_MAX_REDUNDANCY) {
+        frag_result_t result = run(storage, 0, MBED_CONF_LORA_FRAG_MAX_REDUNDANCY + 1);
+        printf("%d lost, beyond the redundancy: %s\n", MBED_CONF_LORA_FRAG_MAX_REDUNDANCY + 1,
+               result.passed ? "reported" : "FAILED");
+        if (!result.passed) {
+            failures++;
+        }
+    }
+
+    printf("%lu failed\n", (unsigned long) failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file grid_main.cpp
+ *
+ * @brief Channels of the fixed channel plans against the tables they replaced
+ *
+ * US915, AU915 and CN470 compute their channels from const grids instead of
+ * filling a table of 72 or 96 channel_params_t in their constructor. Builds
+ * each of these PHYs and checks every channel index, the frequency, the
+ * datarates, the band and the RX1 frequency, against the loops of the former
+ * constructors, and that the indices past the last grid are not defined.
+ * Exits non-zero if a check fails.
+ *
+ *   lorawan_grid
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include "lorawan/lorastack/phy/LoRaPHYAU915.h"
+#include "lorawan/lorastack/phy/LoRaPHYCN470.h"
+#include "lorawan/lorastack/phy/LoRaPHYUS915.h"
+
+static uint32_t failures = 0;
+
+#define GRID_CHECK(cond, region, channel)                                   \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("  %s:%d: %s channel %u: check failed: %s\n", __FILE__,  \
+                   __LINE__, region, channel, #cond);                       \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/**
+ * A channel as the former constructor of its region filled it in
+ */
+static void us915_channel(uint8_t i, channel_params_t *channel)
+{
+    if (i < US915_MAX_NB_CHANNELS - 8) {
+        channel->frequency = 902300000 + i * 200000;
+        channel->dr_range.value = (DR_3 << 4) | DR_0;
+    } else {
+        channel->frequency = 903000000 + (i - (US915_MAX_NB_CHANNELS - 8)) * 1600000;
+        channel->dr_range.value = (DR_4 << 4) | DR_4;
+    }
+    channel->band = 0;
+}
+
+static void au915_channel(uint8_t i, channel_params_t *channel)
+{
+    if (i < AU915_MAX_NB_CHANNELS - 8) {
+        channel->frequency = 915200000 + i * 200000;
+        channel->dr_range.value = (DR_5 << 4) | DR_0;
+    } else {
+        channel->frequency = 915900000 + (i - (AU915_MAX_NB_CHANNELS - 8)) * 1600000;
+        channel->dr_range.value = (DR_6 << 4) | DR_6;
+    }
+    channel->band = 0;
+}
+
+static void cn470_channel(uint8_t i, channel_params_t *channel)
+{
+    channel->frequency = 470300000 + i * 200000;
+    channel->dr_range.value = (DR_5 << 4) | DR_0;
+    channel->band = 0;
+}
+
+/**
+ * Checks the 'nb_channels' channels of a PHY, then the indices past them
+ */
+static void check_region(const char *region, LoRaPHY &phy, uint8_t nb_channels,
+                         void (*former)(uint8_t, channel_params_t *))
+{
+    uint32_t failed = failures;
+
+    GRID_CHECK(phy.get_max_nb_channels() == nb_channels, region, nb_channels);
+
+    for (uint16_t i = 0; i <= 255; i++) {
+        channel_params_t expected = { 0 };
+        channel_params_t channel;
+
+        if (i < nb_channels) {
+            former(i, &expected);
+        }
+        phy.get_channel(i, &channel);
+
+        GRID_CHECK(phy.get_channel_frequency(i) == expected.frequency, region, i);
+        GRID_CHECK(channel.frequency == expected.frequency, region, i);
+        GRID_CHECK(channel.dr_range.value == expected.dr_range.value, region, i);
+        GRID_CHECK(phy.get_channel_dr_range(i).value == expected.dr_range.value, region, i);
+        GRID_CHECK(channel.band == expected.band, region, i);
+        GRID_CHECK(channel.rx1_frequency == 0, region, i);
+    }
+
+    printf("%-6s %3u channels: %s\n", region, nb_channels, failures == failed ? "same" : "FAILED");
+}
+
+int main()
+{
+    LoRaPHYUS915 us915;
+    LoRaPHYAU915 au915;
+    LoRaPHYCN470 cn470;
+
+    check_region("US915", us915, US915_MAX_NB_CHANNELS, us915_channel);
+    check_region("AU915", au915, AU915_MAX_NB_CHANNELS, au915_channel);
+    check_region("CN470", cn470, CN470_MAX_NB_CHANNELS, cn470_channel);
+
+    printf("%lu failed\n", (unsigned long) failures);
+
+    return failures ? 1 : 0;
+}
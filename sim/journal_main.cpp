@@ -0,0 +1,187 @@
+/**
+ * @file journal_main.cpp
+ *
+ * @brief Frame counter journal against power loss
+ *
+ * Sends uplinks as the stack does, reserving a block of counters in a
+ * LoRaWANCounterJournal on a LoRaWANRamStorage whenever the counter goes
+ * beyond the last one, and maintaining the journal after it, and cuts the
+ * power once a given number of bytes has been written:
+ * every number, from none to all the run writes, so that each record and
+ * each erase is torn at each byte. The journal is then mounted again on
+ * what the storage holds, and must give an uplink counter beyond every one
+ * an uplink went out with, that is one a successful reservation covered.
+ *
+ * A second pass has the power come back at once, a program or an erase
+ * failing alone, runs maintain() as the stack then would, and only then
+ * resets. Both passes run with two erase units, where the unit to free
+ * after moving on is the one holding the newest record, and with four.
+ * Prints how many cuts each made and the most counters a reset skipped.
+ * Exits non-zero if a counter could be used twice.
+ *
+ *   lorawan_journal [-u uplinks]
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lorawan/system/LoRaWANCounterJournal.h"
+#include "lorawan/system/LoRaWANRamStorage.h"
+
+// three records a unit, the journal moves on every third block
+#define UNIT_SIZE       64
+#define MAX_UNITS       4
+#define DEV_ADDR        0x26011240
+
+static uint8_t flash[MAX_UNITS * UNIT_SIZE];
+
+static uint32_t nb_uplinks = 24 * MBED_CONF_LORA_FCNT_JOURNAL_BLOCK;
+
+/**
+ * Outcome of a run cut short
+ */
+typedef struct {
+    bool struck;            /**< The power loss struck during the run */
+    bool passed;
+    uint32_t skipped;       /**< Counters the reset skipped */
+} cut_result_t;
+
+static cut_result_t run_cut(uint32_t units, uint32_t cut, bool transient)
+{
+    cut_result_t result = { false, false, 0 };
+    LoRaWANRamStorage storage(flash, units * UNIT_SIZE, UNIT_SIZE);
+    LoRaWANCounterJournal journal;
+    uint32_t counter = 0;
+    // counter after the last one an uplink went out with
+    uint32_t used = 0;
+
+    memset(flash, 0xFF, sizeof(flash));
+    if (journal.mount(&storage, 0, units * UNIT_SIZE) != LORAWAN_STATUS_OK) {
+        printf("  cannot mount %lu units\n", (unsigned long) units);
+        return result;
+    }
+
+    storage.inject_power_loss(cut);
+
+    for (uint32_t i = 0; i < nb_uplinks; i++) {
+        lorawan_status_t status = LORAWAN_STATUS_OK;
+
+        if (!journal.is_reserved(DEV_ADDR, counter)) {
+            status = journal.reserve(DEV_ADDR, counter, 0);
+        }
+
+        // an uplink the journal does not cover is not sent
+        if (status == LORAWAN_STATUS_OK) {
+            used = ++counter;
+        } else if (status != LORAWAN_STATUS_BUSY) {
+            break;
+        }
+
+        if (journal.needs_maintenance()
+                && journal.maintain() == LORAWAN_STATUS_STORAGE_ERROR) {
+            break;
+        }
+    }
+
+    result.struck = storage.is_powered_off();
+    storage.restore_power();
+
+    if (transient && result.struck) {
+        // the write failed alone, the maintenance queued meanwhile runs
+        // before the reset
+        if (journal.needs_maintenance()) {
+            journal.maintain();
+        }
+    }
+
+    LoRaWANCounterJournal rebooted;
+    uint32_t ul_counter = 0;
+    uint32_t dl_counter;
+
+    if (rebooted.mount(&storage, 0, units * UNIT_SIZE) != LORAWAN_STATUS_OK) {
+        printf("  %lu units, cut after %lu bytes: cannot mount\n",
+               (unsigned long) units, (unsigned long) cut);
+        return result;
+    }
+
+    if (!rebooted.get_counters(DEV_ADDR, ul_counter, dl_counter) && used > 0) {
+        printf("  %lu units, cut after %lu bytes%s: counters lost, %lu used\n",
+               (unsigned long) units, (unsigned long) cut, transient ? ", transient" : "",
+               (unsigned long) used);
+        return result;
+    }
+
+    if (ul_counter < used) {
+        printf("  %lu units, cut after %lu bytes%s: counter %lu after %lu used\n",
+               (unsigned long) units, (unsigned long) cut, transient ? ", transient" : "",
+               (unsigned long) ul_counter, (unsigned long) used);
+        return result;
+    }
+
+    result.passed = true;
+    result.skipped = ul_counter - used;
+
+    return result;
+}
+
+/**
+ * Cuts the power at every byte of a run
+ */
+static bool run_cuts(uint32_t units, bool transient)
+{
+    uint32_t cuts = 0;
+    uint32_t failures = 0;
+    uint32_t most_skipped = 0;
+
+    for (uint32_t cut = 0;; cut++) {
+        cut_result_t result = run_cut(units, cut, transient);
+
+        if (!result.passed) {
+            failures++;
+        } else if (result.skipped > most_skipped) {
+            most_skipped = result.skipped;
+        }
+
+        if (!result.struck) {
+            break;
+        }
+        cuts++;
+    }
+
+    printf("%lu units%-11s %6lu cuts  %4lu failed  at most %lu counters skipped\n",
+           (unsigned long) units, transient ? ", transient" : "", (unsigned long) cuts,
+           (unsigned long) failures, (unsigned long) most_skipped);
+
+    return failures == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int option;
+    bool passed = true;
+
+    while ((option = getopt(argc, argv, "u:")) != -1) {
+        switch (option) {
+            case 'u':
+                nb_uplinks = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-u uplinks]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    printf("%lu uplinks, blocks of %d counters, units of %d bytes\n",
+           (unsigned long) nb_uplinks, MBED_CONF_LORA_FCNT_JOURNAL_BLOCK, UNIT_SIZE);
+
+    for (uint32_t units = 2; units <= MAX_UNITS; units += 2) {
+        passed = run_cuts(units, false) && passed;
+        passed = run_cuts(units, true) && passed;
+    }
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file multicast_config.h
+ *
+ * @brief Configuration of the stack for lorawan_multicast
+ *
+ * mbed_config.h with a multicast group table of MULTICAST_BENCH_GROUPS
+ * entries, for the lookup to be timed with more groups than a device links.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MULTICAST_CONFIG_H_
+#define MULTICAST_CONFIG_H_
+
+#include "mbed_config.h"
+
+#ifndef MULTICAST_BENCH_GROUPS
+#define MULTICAST_BENCH_GROUPS      128
+#endif
+
+#undef MBED_CONF_LORA_MULTICAST_GROUPS
+#define MBED_CONF_LORA_MULTICAST_GROUPS MULTICAST_BENCH_GROUPS
+
+#endif /* MULTICAST_CONFIG_H_ */
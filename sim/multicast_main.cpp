@@ -0,0 +1,221 @@
+/**
+ * @file multicast_main.cpp
+ *
+ * @brief Cost of the multicast group lookup against the number of groups
+ *
+ * Links 1, 2, 4... groups of random addresses to a LoRaMac, up to the size
+ * of its table, and times LoRaMac::find_multicast_group() on the address of
+ * a linked group, a hit, and on one linked to none, a miss: the case of
+ * every downlink heard for another device. The same lookups over a linked
+ * list of the groups, as the table replaced, are timed alongside. Times are
+ * wall-clock nanoseconds a lookup, the best of a few runs. Exits non-zero if
+ * the table finds a group the list does not, or the other way round.
+ *
+ *   lorawan_multicast [-n lookups] [-S seed]
+ *
+ * The stack is built for it with multicast_config.h, a table larger than
+ * mbed_config.h gives.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lorawan/lorastack/mac/LoRaMac.h"
+
+#define RUNS            5
+
+/**
+ * Group of the linked list, as multicast_params_t had it
+ */
+typedef struct list_group_s {
+    uint32_t address;
+    uint32_t dl_frame_counter;
+    uint8_t nwk_skey[16];
+    uint8_t app_skey[16];
+    struct list_group_s *next;
+} list_group_t;
+
+static LoRaMac mac;
+
+static list_group_t list_groups[MBED_CONF_LORA_MULTICAST_GROUPS];
+
+static uint32_t linked[MBED_CONF_LORA_MULTICAST_GROUPS];
+
+static uint32_t *hits;
+static uint32_t *misses;
+
+static uint32_t random_address()
+{
+    return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static list_group_t *find_list_group(list_group_t *head, uint32_t address)
+{
+    for (list_group_t *group = head; group; group = group->next) {
+        if (group->address == address) {
+            return group;
+        }
+    }
+
+    return NULL;
+}
+
+static bool is_linked(uint32_t address, uint32_t nb_groups)
+{
+    for (uint32_t i = 0; i < nb_groups; i++) {
+        if (linked[i] == address) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Best time of the lookups of the table, ns a lookup, and how many found
+ */
+static double time_table(const uint32_t *addresses, uint32_t nb_lookups, uint32_t &found)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < RUNS; run++) {
+        uint32_t count = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < nb_lookups; i++) {
+            count += mac.find_multicast_group(addresses[i]) != NULL;
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        found = count;
+    }
+
+    return (double) best / nb_lookups;
+}
+
+static double time_list(list_group_t *head, const uint32_t *addresses, uint32_t nb_lookups,
+                        uint32_t &found)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int run = 0; run < RUNS; run++) {
+        uint32_t count = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < nb_lookups; i++) {
+            count += find_list_group(head, addresses[i]) != NULL;
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+        found = count;
+    }
+
+    return (double) best / nb_lookups;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t nb_lookups = 100000;
+    unsigned int seed = 1;
+    int option;
+    int failures = 0;
+
+    while ((option = getopt(argc, argv, "n:S:")) != -1) {
+        switch (option) {
+            case 'n':
+                nb_lookups = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n lookups] [-S seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (nb_lookups == 0) {
+        fprintf(stderr, "no lookups\n");
+        return 2;
+    }
+
+    srand(seed);
+    hits = new uint32_t[nb_lookups];
+    misses = new uint32_t[nb_lookups];
+
+    printf("%lu lookups, table of %d groups, ns a lookup\n",
+           (unsigned long) nb_lookups, MBED_CONF_LORA_MULTICAST_GROUPS);
+    printf("%8s %10s %10s %10s %10s\n", "groups", "table hit", "miss", "list hit", "miss");
+
+    for (uint32_t nb_groups = 1; nb_groups <= MBED_CONF_LORA_MULTICAST_GROUPS; nb_groups *= 2) {
+        multicast_params_t params;
+        list_group_t *head = NULL;
+
+        memset(&params, 0, sizeof(params));
+
+        // the table grows by the groups added since the last row, the list
+        // gets them at its head as linking did
+        for (uint32_t i = 0; i < nb_groups; i++) {
+            if (i >= nb_groups / 2) {
+                do {
+                    linked[i] = random_address();
+                } while (is_linked(linked[i], i));
+
+                params.address = linked[i];
+                if (mac.multicast_channel_link(&params) != LORAWAN_STATUS_OK) {
+                    fprintf(stderr, "cannot link group %lu\n", (unsigned long) i);
+                    return 1;
+                }
+            }
+
+            list_group_t *group = &list_groups[i];
+            memset(group, 0, sizeof(*group));
+            group->address = linked[i];
+            group->next = head;
+            head = group;
+        }
+
+        for (uint32_t i = 0; i < nb_lookups; i++) {
+            hits[i] = linked[rand() % nb_groups];
+            do {
+                misses[i] = random_address();
+            } while (is_linked(misses[i], nb_groups));
+        }
+
+        uint32_t table_hits, table_misses, list_hits, list_misses;
+        double table_hit = time_table(hits, nb_lookups, table_hits);
+        double table_miss = time_table(misses, nb_lookups, table_misses);
+        double list_hit = time_list(head, hits, nb_lookups, list_hits);
+        double list_miss = time_list(head, misses, nb_lookups, list_misses);
+
+        printf("%8lu %10.1f %10.1f %10.1f %10.1f\n", (unsigned long) nb_groups,
+               table_hit, table_miss, list_hit, list_miss);
+
+        if (table_hits != nb_lookups || list_hits != nb_lookups
+                || table_misses != 0 || list_misses != 0) {
+            printf("  lookups found %lu/%lu hits, %lu/%lu misses\n",
+                   (unsigned long) table_hits, (unsigned long) list_hits,
+                   (unsigned long) table_misses, (unsigned long) list_misses);
+            failures++;
+        }
+    }
+
+    delete[] hits;
+    delete[] misses;
+
+    return failures ? 1 : 0;
+}
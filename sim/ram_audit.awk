@@ -0,0 +1,264 @@
+# Padding audit of the objects of the stack
+#
+# Reads the output of readelf --debug-dump=info for object files and, from
+# the types given in roots (space separated), walks every struct and class
+# they hold, transitively. A type only declared in one object is taken from
+# the object that defines it. Prints one line per type with padding:
+#
+#   <padding> <size> <type> <holes>
+#
+# where the holes are <member>+<bytes> for the padding after a member, and
+# +<bytes> at the end for the tail padding. Then, for each root, its size
+# and the padding it holds, its own and that of every member, nested.
+#
+#   readelf --debug-dump=info <objects> | awk -v roots=... -f ram_audit.awk
+#
+# Copyright (c) 2017, Arm Limited and affiliates.
+# SPDX-License-Identifier: BSD-3-Clause
+
+function value(line)
+{
+    sub(/^[^:]*: */, "", line)
+    sub(/^\(indirect string, offset: 0x[0-9a-f]*\): /, "", line)
+    sub(/^\(indexed string: 0x[0-9a-f]*\): /, "", line)
+    return line
+}
+
+function ref(line)
+{
+    match(line, /<0x[0-9a-f]+>/)
+    return file ":" substr(line, RSTART + 1, RLENGTH - 2)
+}
+
+# Definition of a type, wherever it is
+function defined(die)
+{
+    if ((die in declaration) && (name[die] in definition)) {
+        return definition[name[die]]
+    }
+    return die
+}
+
+# Size of a type, through its typedefs, qualifiers and array bounds
+function size_of(die,    i, count)
+{
+    if (die == "") {
+        return 0
+    }
+    die = defined(die)
+    if (die in byte_size) {
+        return byte_size[die]
+    }
+    if (tag[die] == "DW_TAG_array_type") {
+        count = 1
+        for (i = 0; i < nb_bounds[die]; i++) {
+            count *= bounds[die, i]
+        }
+        return count * size_of(type[die])
+    }
+    return size_of(type[die])
+}
+
+# Struct or class behind a member type, and how many of it there are
+function record_of(die,    i)
+{
+    record_count = 1
+    while (die != "" && tag[die] != "DW_TAG_structure_type" && tag[die] != "DW_TAG_class_type") {
+        if (tag[die] == "DW_TAG_array_type") {
+            for (i = 0; i < nb_bounds[die]; i++) {
+                record_count *= bounds[die, i]
+            }
+        } else if (tag[die] != "DW_TAG_typedef" && tag[die] != "DW_TAG_const_type" &&
+                   tag[die] != "DW_TAG_volatile_type") {
+            return ""
+        }
+        die = type[die]
+    }
+    return die == "" ? "" : defined(die)
+}
+
+function name_of(die,    typedef_name, length_of_name)
+{
+    if (die in name) {
+        return name[die]
+    }
+    if (die in linkage) {
+        # the typedef name of an anonymous struct, mangled, the last
+        # component of N<length><name>...E when nested in a class
+        typedef_name = linkage[die]
+        sub(/^N/, "", typedef_name)
+        sub(/E$/, "", typedef_name)
+        while (match(typedef_name, /^[0-9]+/)) {
+            length_of_name = substr(typedef_name, 1, RLENGTH) + 0
+            typedef_name = substr(typedef_name, RLENGTH + 1)
+            if (length(typedef_name) == length_of_name) {
+                break
+            }
+            typedef_name = substr(typedef_name, length_of_name + 1)
+        }
+        return typedef_name
+    }
+    return "<anonymous>"
+}
+
+# Own padding of a record, with its holes
+function audit(die,    i, m, end, next_start, pad, holes)
+{
+    pad = 0
+    holes = ""
+    for (i = 0; i < nb_members[die]; i++) {
+        m = members[die, i]
+        if (m in bit_size) {
+            end = int((bit_offset[m] + bit_size[m] + 7) / 8)
+        } else {
+            end = location[m] + size_of(type[m])
+        }
+        # a bit-field may start in the byte the one before ends in
+        if (i + 1 < nb_members[die]) {
+            m = members[die, i + 1]
+            next_start = (m in bit_size) ? int(bit_offset[m] / 8) : location[m]
+            if (next_start > end) {
+                pad += next_start - end
+                holes = holes " " name[members[die, i]] "+" next_start - end
+            }
+        } else if (byte_size[die] > end) {
+            pad += byte_size[die] - end
+            holes = holes " +" byte_size[die] - end
+        }
+    }
+    own_padding[die] = pad
+    own_holes[die] = holes
+}
+
+# Padding of a record, its own and that of the records it holds
+function nested_padding(die,    i, m, record, total)
+{
+    if (die in nested) {
+        return nested[die]
+    }
+    total = own_padding[die]
+    for (i = 0; i < nb_members[die]; i++) {
+        m = members[die, i]
+        record = record_of(type[m])
+        if (record != "") {
+            total += record_count * nested_padding(record)
+        }
+    }
+    nested[die] = total
+    return total
+}
+
+function visit(die,    i, record)
+{
+    if (die in visited) {
+        return
+    }
+    visited[die] = 1
+    audit(die)
+    for (i = 0; i < nb_members[die]; i++) {
+        record = record_of(type[members[die, i]])
+        if (record != "") {
+            visit(record)
+        }
+    }
+}
+
+/^File: / {
+    file++
+    next
+}
+
+/^ *<[0-9a-f]+><[0-9a-f]+>: Abbrev Number: [0-9]+ \(DW_TAG_/ {
+    match($0, /^ *<[0-9a-f]+>/)
+    depth = substr($0, RSTART, RLENGTH)
+    gsub(/[ <>]/, "", depth)
+    depth += 0
+
+    match($0, /><[0-9a-f]+>/)
+    die = file ":0x" substr($0, RSTART + 2, RLENGTH - 3)
+
+    match($0, /DW_TAG_[a-z_]+/)
+    tag[die] = substr($0, RSTART, RLENGTH)
+    parent[depth] = die
+
+    if (depth > 0) {
+        up = parent[depth - 1]
+        if ((tag[die] == "DW_TAG_member" || tag[die] == "DW_TAG_inheritance") &&
+                (tag[up] == "DW_TAG_structure_type" || tag[up] == "DW_TAG_class_type")) {
+            members[up, nb_members[up]++] = die
+        } else if (tag[die] == "DW_TAG_subrange_type" && tag[up] == "DW_TAG_array_type") {
+            bound = up
+        }
+    }
+    next
+}
+
+/^ *<[0-9a-f]+> +DW_AT_/ {
+    attribute = $2
+    sub(/:$/, "", attribute)
+
+    if (attribute == "DW_AT_name") {
+        name[die] = value($0)
+    } else if (attribute == "DW_AT_linkage_name") {
+        linkage[die] = value($0)
+    } else if (attribute == "DW_AT_byte_size") {
+        byte_size[die] = value($0) + 0
+    } else if (attribute == "DW_AT_type") {
+        type[die] = ref($0)
+    } else if (attribute == "DW_AT_data_member_location") {
+        location[die] = value($0) + 0
+    } else if (attribute == "DW_AT_data_bit_offset") {
+        bit_offset[die] = value($0) + 0
+    } else if (attribute == "DW_AT_bit_size") {
+        bit_size[die] = value($0) + 0
+    } else if (attribute == "DW_AT_declaration") {
+        declaration[die] = 1
+    } else if (attribute == "DW_AT_upper_bound" && tag[die] == "DW_TAG_subrange_type") {
+        bounds[bound, nb_bounds[bound]++] = value($0) + 1
+    } else if (attribute == "DW_AT_count" && tag[die] == "DW_TAG_subrange_type") {
+        bounds[bound, nb_bounds[bound]++] = value($0) + 0
+    }
+}
+
+END {
+    nb_roots = split(roots, root_names, " ")
+    for (die in tag) {
+        if ((tag[die] == "DW_TAG_structure_type" || tag[die] == "DW_TAG_class_type") &&
+                !(die in declaration)) {
+            if (die in name) {
+                definition[name[die]] = die
+            }
+            for (r = 1; r <= nb_roots; r++) {
+                if (name_of(die) == root_names[r] && !(r in root_die)) {
+                    root_die[r] = die
+                }
+            }
+        }
+    }
+
+    for (r = 1; r <= nb_roots; r++) {
+        if (r in root_die) {
+            visit(root_die[r])
+        } else {
+            print "no type " root_names[r] > "/dev/stderr"
+            status = 1
+        }
+    }
+
+    # types of the same name seen through several paths are the same type
+    for (die in visited) {
+        if (own_padding[die] > 0 && !(name_of(die) in printed)) {
+            printed[name_of(die)] = 1
+            printf "%6d %6d  %-36s%s\n", own_padding[die], byte_size[die], name_of(die), own_holes[die]
+        }
+    }
+
+    for (r = 1; r <= nb_roots; r++) {
+        if (r in root_die) {
+            printf "total  %-28s %6d bytes, %5d of padding\n", root_names[r],
+                   byte_size[root_die[r]], nested_padding(root_die[r])
+        }
+    }
+
+    exit status
+}
@@ -0,0 +1,42 @@
+/*
+ * Critical sections of the host simulation
+ *
+ * Copyright (c) 2015-2016, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Declare __STDC_LIMIT_MACROS so stdint.h defines UINT32_MAX when using C++ */
+#define __STDC_LIMIT_MACROS
+#include <assert.h>
+#include <stdint.h>
+#include "platform/mbed_critical.h"
+
+// The simulation has no interrupts and nothing is shared between its
+// threads, only the nesting is checked.
+static __thread uint32_t critical_section_reentrancy_counter = 0;
+
+void core_util_critical_section_enter(void)
+{
+    assert(critical_section_reentrancy_counter < UINT32_MAX);
+
+    ++critical_section_reentrancy_counter;
+}
+
+void core_util_critical_section_exit(void)
+{
+    assert(critical_section_reentrancy_counter > 0);
+
+    --critical_section_reentrancy_counter;
+}
@@ -0,0 +1,1359 @@
+/**
+ * @file sim_main.cpp
+ *
+ * @brief Scenarios of the host simulation
+ *
+ * Each scenario runs a LoRaWANInterface over a VirtualRadio on the virtual
+ * clock, 20 m from a gateway and its network server, see SimNetwork, and
+ * checks what the application, the medium and the network see. Devices the
+ * scenario does not add to the network server get no answer. The program
+ * exits non-zero if any scenario fails, so it can gate changes to the stack;
+ * the figures printed for the passing ones (virtual time, airtime, receive
+ * time, dispatches) are there to compare runs.
+ *
+ *   lorawan_sim [-T trace file] [-P]
+ *
+ * -T writes the traces of the stack, in the binary format of the trace
+ * ring, for lorawan_trace to decode. -P prints the time spent in the zones
+ * of platform/profile.h by each scenario, in wall-clock nanoseconds.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "events/equeue/equeue_platform.h"
+#include "platform/profile.h"
+#include "platform/trace_ring.h"
+#include "lorawan/system/LoRaWANRamStorage.h"
+#include "SimClock.h"
+#include "SimKeys.h"
+#include "SimNetwork.h"
+#include "SimNode.h"
+
+static uint8_t dev_eui[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+
+static int failures = 0;
+
+static FILE *trace_file = NULL;
+
+static bool profile = false;
+
+#define SIM_CHECK(cond)                                                     \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false;                                                   \
+        }                                                                   \
+    } while (0)
+
+static void report(const char *name, bool passed, SimClock &clock, lorawan_time_t start,
+                   const VirtualRadio &radio)
+{
+    const virtual_radio_stats_t &stats = radio.get_stats();
+
+    if (!passed) {
+        failures++;
+        printf("FAIL %s\n", name);
+        return;
+    }
+
+    printf("PASS %-28s %8lu ms  tx %lu/%lu ms  rx %lu/%lu ms  dispatches %lu\n", name,
+           (unsigned long)(clock.now() - start),
+           (unsigned long) stats.tx_count, (unsigned long) stats.tx_time,
+           (unsigned long) stats.rx_count, (unsigned long) stats.rx_time,
+           (unsigned long) clock.get_dispatch_count());
+}
+
+/**
+ * ABP device, an unconfirmed uplink nobody answers: TX_DONE once both
+ * receive windows closed empty
+ */
+static bool abp_unconfirmed_uplink(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "hello";
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011234) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    node.radio.reset_stats();
+    SIM_CHECK(node.lorawan.send(15, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG)
+              == sizeof(payload));
+    SIM_CHECK(clock.run_until(node.seen(TX_DONE), 10000));
+
+    const virtual_radio_stats_t &stats = node.radio.get_stats();
+    SIM_CHECK(stats.tx_count == 1);
+    SIM_CHECK(stats.rx_count == 2);
+    SIM_CHECK(stats.rx_timeout_count == 2);
+    SIM_CHECK(stats.rx_done_count == 0);
+
+    return true;
+}
+
+/**
+ * ABP device unknown to the network, a confirmed uplink nobody acknowledges: every retry is sent
+ * and the application is told
+ */
+static bool abp_confirmed_no_ack(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = { 0x01, 0x02, 0x03 };
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011235) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.set_confirmed_msg_retries(3) == LORAWAN_STATUS_OK);
+
+    node.radio.reset_stats();
+    SIM_CHECK(node.lorawan.send(15, payload, sizeof(payload), MSG_CONFIRMED_FLAG)
+              == sizeof(payload));
+    SIM_CHECK(clock.run_until(node.seen(TX_ERROR), 600000));
+    SIM_CHECK(node.count(TX_DONE) == 0);
+    // the first transmission and three retries
+    SIM_CHECK(node.radio.get_stats().tx_count == 4);
+
+    return true;
+}
+
+/**
+ * OTAA device unknown to the network: the join requests go out, spaced by the
+ * join duty cycle, then the join fails. The PHY does not give up before
+ * MBED_CONF_LORA_NB_TRIALS requests.
+ */
+static bool otaa_unknown(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_otaa(dev_eui, MBED_CONF_LORA_NB_TRIALS) == LORAWAN_STATUS_CONNECT_IN_PROGRESS);
+    SIM_CHECK(clock.run_until(node.seen(JOIN_FAILURE), 3600000));
+    SIM_CHECK(node.count(CONNECTED) == 0);
+    SIM_CHECK(node.radio.get_stats().tx_count == MBED_CONF_LORA_NB_TRIALS);
+
+    return true;
+}
+
+/**
+ * Sends a message and waits for its outcome. The stack may be busy with an
+ * uplink of its own, answering MAC commands: the message waits for it.
+ */
+static bool send_and_wait(SimNode &node, SimClock &clock, const uint8_t *payload, uint8_t size,
+                          int flags)
+{
+    mbed::Callback<bool()> done = node.seen_next(TX_DONE);
+    lorawan_time_t end = clock.now() + 600000;
+    int16_t ret;
+
+    while ((ret = node.lorawan.send(15, payload, size, flags)) == LORAWAN_STATUS_WOULD_BLOCK
+            && (int32_t)(end - clock.now()) > 0) {
+        clock.run_for(1000);
+    }
+
+    return ret == size && clock.run_until(done, 600000);
+}
+
+/**
+ * OTAA device known to the network: it joins with the first request, the
+ * join accept coming in RX1
+ */
+static bool otaa_join(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    SIM_CHECK(network.server.add_otaa_device(dev_eui, sim_app_key) == 0);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_otaa(dev_eui, MBED_CONF_LORA_NB_TRIALS) == LORAWAN_STATUS_CONNECT_IN_PROGRESS);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 60000));
+    SIM_CHECK(node.radio.get_stats().tx_count == 1);
+
+    const virtual_ns_stats_t &stats = network.server.get_stats();
+    SIM_CHECK(stats.joins == 1);
+    SIM_CHECK(stats.rx1_downlinks == 1);
+
+    // the session keys match: an uplink gets through
+    static const uint8_t payload[] = "joined";
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_CONFIRMED_FLAG));
+    SIM_CHECK(stats.uplinks == 1);
+    SIM_CHECK(stats.mic_failures == 0);
+
+    return true;
+}
+
+/**
+ * ABP device known to the network, a confirmed uplink is acknowledged at
+ * the first transmission
+ */
+static bool abp_confirmed_ack(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = { 0x01, 0x02, 0x03 };
+
+    SIM_CHECK(network.server.add_abp_device(0x26011236, sim_nwk_skey, sim_app_skey) == 0);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011236) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    node.radio.reset_stats();
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_CONFIRMED_FLAG));
+    SIM_CHECK(node.count(TX_ERROR) == 0);
+    SIM_CHECK(node.radio.get_stats().tx_count == 1);
+    SIM_CHECK(node.radio.get_stats().rx_done_count == 1);
+    SIM_CHECK(network.server.get_device(0).fcnt_down == 1);
+
+    return true;
+}
+
+/**
+ * Application data queued at the network comes after each uplink
+ */
+static bool abp_downlink_data(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "ping";
+    static const uint8_t data[] = "pong";
+    static const uint8_t nb_messages = 10;
+
+    SIM_CHECK(network.server.add_abp_device(0x26011237, sim_nwk_skey, sim_app_skey) == 0);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011237) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    for (uint8_t i = 0; i < nb_messages; i++) {
+        SIM_CHECK(network.server.send(0, 2, data, sizeof(data), false));
+        SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+        SIM_CHECK(node.count(RX_DONE) == i + 1u);
+
+        uint8_t received[16];
+        SIM_CHECK(node.lorawan.receive(2, received, sizeof(received), MSG_UNCONFIRMED_FLAG)
+                  == sizeof(data));
+        SIM_CHECK(memcmp(received, data, sizeof(data)) == 0);
+    }
+
+    SIM_CHECK(network.server.get_stats().rx1_downlinks == nb_messages);
+
+    return true;
+}
+
+/**
+ * The network adds five channels, moves RX2 to DR3 and, once the ADR has
+ * seen enough uplinks, raises the datarate of a device close to the gateway
+ */
+static bool abp_mac_commands(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = { 0x42 };
+    VirtualNetworkServer &server = network.server;
+
+    SIM_CHECK(server.add_abp_device(0x26011238, sim_nwk_skey, sim_app_skey) == 0);
+    server.set_adr(true);
+    server.set_rx_params(0, DR_3, 869525000);
+    for (uint8_t ch = 3; ch < 8; ch++) {
+        SIM_CHECK(server.add_channel(ch, 867100000 + (ch - 3) * 200000, DR_0, DR_5));
+    }
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011238) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.disable_adaptive_datarate() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_datarate(DR_0) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.enable_adaptive_datarate() == LORAWAN_STATUS_OK);
+
+    for (uint8_t i = 0; i < NS_ADR_HISTORY + 5; i++) {
+        SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    }
+
+    const virtual_ns_device_t &device = server.get_device(0);
+    SIM_CHECK(device.channel_mask == 0x00FF);
+    SIM_CHECK(device.rx2_datarate == DR_3);
+    SIM_CHECK(server.get_stats().adr_accepted == 1);
+    SIM_CHECK(device.datarate == DR_5);
+    SIM_CHECK(server.get_stats().mic_failures == 0);
+
+    return true;
+}
+
+static uint8_t session_flash[16 * 256];
+
+#if MBED_CONF_LORA_CLASS_C
+/**
+ * Sends a Class C downlink as soon as the gateway takes it, the duty cycle
+ * of the RX2 sub-band spacing them
+ */
+static bool send_class_c(SimNetwork &network, SimClock &clock, uint32_t device,
+                         const uint8_t *data, uint8_t size, uint8_t port = 2)
+{
+    lorawan_time_t end = clock.now() + 600000;
+
+    while (!network.server.send_class_c(device, clock.now() + 1, port, data, size)) {
+        if ((int32_t)(end - clock.now()) <= 0) {
+            return false;
+        }
+        clock.run_for(100);
+    }
+
+    return true;
+}
+
+/**
+ * Class C device, a frame waits for receive() while a burst of frames for
+ * another device comes in: they go through the other slots of the RX ring,
+ * and receive() reads the first frame intact
+ */
+static bool class_c_burst_receive(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t first[] = "first";
+    static const uint8_t other[] = "not for this device";
+    static const uint8_t nb_others = MBED_CONF_LORA_RX_RING_SLOTS + 2;
+
+    SIM_CHECK(network.server.add_abp_device(0x26011239, sim_nwk_skey, sim_app_skey) == 0);
+    SIM_CHECK(network.server.add_abp_device(0x2601123A, sim_nwk_skey, sim_app_skey) == 1);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011239) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.set_device_class(CLASS_C) == LORAWAN_STATUS_OK);
+
+    SIM_CHECK(send_class_c(network, clock, 0, first, sizeof(first)));
+    SIM_CHECK(clock.run_until(node.seen(RX_DONE), 10000));
+
+    node.radio.reset_stats();
+    for (uint8_t i = 0; i < nb_others; i++) {
+        SIM_CHECK(send_class_c(network, clock, 1, other, sizeof(other)));
+    }
+    clock.run_for(10000);
+    SIM_CHECK(node.radio.get_stats().rx_done_count == nb_others);
+    SIM_CHECK(node.count(RX_DONE) == 1);
+    SIM_CHECK(node.lorawan.get_rx_drop_count() == 0);
+
+    uint8_t received[16];
+    SIM_CHECK(node.lorawan.receive(2, received, sizeof(received), MSG_UNCONFIRMED_FLAG)
+              == sizeof(first));
+    SIM_CHECK(memcmp(received, first, sizeof(first)) == 0);
+
+    return true;
+}
+
+static lorawan_rx_frame_t held_frames[MBED_CONF_LORA_RX_RING_SLOTS + 1];
+
+static uint8_t nb_held_frames;
+
+static void hold_frame(const lorawan_rx_frame_t &frame)
+{
+    if (nb_held_frames <= MBED_CONF_LORA_RX_RING_SLOTS) {
+        held_frames[nb_held_frames] = frame;
+    }
+    nb_held_frames++;
+}
+
+static bool held_frame_seen()
+{
+    return nb_held_frames > MBED_CONF_LORA_RX_RING_SLOTS;
+}
+
+/**
+ * Class C device handing the frames over without copying them: a burst
+ * fills the RX ring with held frames, the frames coming once it is full are
+ * dropped and counted, and releasing a frame makes room for the next
+ */
+static bool class_c_burst_held(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t nb_burst = MBED_CONF_LORA_RX_RING_SLOTS + 2;
+    uint8_t data[nb_burst + 1][4];
+
+    for (uint8_t i = 0; i <= nb_burst; i++) {
+        data[i][0] = 'r';
+        data[i][1] = 'x';
+        data[i][2] = i / 10 + '0';
+        data[i][3] = i % 10 + '0';
+    }
+
+    SIM_CHECK(network.server.add_abp_device(0x2601123B, sim_nwk_skey, sim_app_skey) == 0);
+
+    nb_held_frames = 0;
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.set_rx_frame(mbed::callback(hold_frame)) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x2601123B) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.set_device_class(CLASS_C) == LORAWAN_STATUS_OK);
+
+    node.radio.reset_stats();
+    for (uint8_t i = 0; i < nb_burst; i++) {
+        SIM_CHECK(send_class_c(network, clock, 0, data[i], sizeof(data[i])));
+    }
+    clock.run_for(10000);
+    SIM_CHECK(node.radio.get_stats().rx_done_count == nb_burst);
+    SIM_CHECK(nb_held_frames == MBED_CONF_LORA_RX_RING_SLOTS);
+    SIM_CHECK(node.lorawan.get_rx_drop_count() == nb_burst - MBED_CONF_LORA_RX_RING_SLOTS);
+
+    // the held frames were not overwritten by the ones dropped
+    for (uint8_t i = 0; i < MBED_CONF_LORA_RX_RING_SLOTS; i++) {
+        SIM_CHECK(held_frames[i].size == sizeof(data[i]));
+        SIM_CHECK(memcmp(held_frames[i].buffer, data[i], sizeof(data[i])) == 0);
+    }
+
+    // the newest one, out of order: the next frame takes its slot and the
+    // older ones stay intact
+    const lorawan_rx_frame_t &released = held_frames[MBED_CONF_LORA_RX_RING_SLOTS - 1];
+    SIM_CHECK(node.lorawan.release_rx_frame(released) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.release_rx_frame(released) == LORAWAN_STATUS_NO_OP);
+    SIM_CHECK(send_class_c(network, clock, 0, data[nb_burst], sizeof(data[nb_burst])));
+    SIM_CHECK(clock.run_until(mbed::callback(held_frame_seen), 10000));
+    SIM_CHECK(node.lorawan.get_rx_drop_count() == nb_burst - MBED_CONF_LORA_RX_RING_SLOTS);
+    for (uint8_t i = 0; i + 1 < MBED_CONF_LORA_RX_RING_SLOTS; i++) {
+        SIM_CHECK(memcmp(held_frames[i].buffer, data[i], sizeof(data[i])) == 0);
+    }
+    SIM_CHECK(held_frames[MBED_CONF_LORA_RX_RING_SLOTS].buffer == released.buffer);
+    SIM_CHECK(memcmp(released.buffer, data[nb_burst], sizeof(data[nb_burst])) == 0);
+
+    return true;
+}
+
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+/**
+ * Class C device in a multicast group: the frames sent to the group address
+ * with the keys of the group are received, and counted for the group
+ */
+static bool class_c_multicast(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t data[] = "group";
+    static const uint8_t nb_frames = 3;
+    multicast_params_t group;
+    lorawan_multicast_status_t status;
+    uint8_t received[16];
+    int flags;
+    uint8_t port;
+
+    group.address = 0x26FFFF01;
+    for (uint8_t i = 0; i < 16; i++) {
+        group.nwk_skey[i] = 0xA0 + i;
+        group.app_skey[i] = 0xB0 + i;
+    }
+    group.dl_frame_counter = 0;
+    group.group_id = 0;
+
+    // the network sends to the group as to a device of its own
+    SIM_CHECK(network.server.add_abp_device(0x26011243, sim_nwk_skey, sim_app_skey) == 0);
+    SIM_CHECK(network.server.add_abp_device(group.address, group.nwk_skey, group.app_skey) == 1);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011243) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.get_multicast_group_status(group.address, status)
+              == LORAWAN_STATUS_PARAMETER_INVALID);
+    SIM_CHECK(node.lorawan.add_multicast_group(group) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.get_multicast_group_status(group.address, status) == LORAWAN_STATUS_OK);
+    SIM_CHECK(status.rx_count == 0);
+    SIM_CHECK(node.lorawan.set_device_class(CLASS_C) == LORAWAN_STATUS_OK);
+
+    for (uint8_t i = 0; i < nb_frames; i++) {
+        mbed::Callback<bool()> done = node.seen_next(RX_DONE);
+        SIM_CHECK(send_class_c(network, clock, 1, data, sizeof(data)));
+        SIM_CHECK(clock.run_until(done, 10000));
+
+        flags = MSG_MULTICAST_FLAG;
+        port = 2;
+        SIM_CHECK(node.lorawan.receive(received, sizeof(received), port, flags) == sizeof(data));
+        SIM_CHECK(flags == MSG_MULTICAST_FLAG);
+        SIM_CHECK(memcmp(received, data, sizeof(data)) == 0);
+    }
+
+    SIM_CHECK(node.lorawan.get_multicast_group_status(group.address, status) == LORAWAN_STATUS_OK);
+    SIM_CHECK(status.rx_count == nb_frames);
+    SIM_CHECK(status.dl_frame_counter == nb_frames - 1u);
+
+    SIM_CHECK(node.lorawan.remove_multicast_group(group.address) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.get_multicast_group_status(group.address, status)
+              == LORAWAN_STATUS_PARAMETER_INVALID);
+
+    return true;
+}
+
+static uint8_t frag_ans[16];
+
+static uint8_t frag_ans_size;
+
+static void record_frag_ans(const virtual_ns_uplink_t &uplink)
+{
+    if (uplink.port == MBED_CONF_LORA_FRAG_PORT && uplink.size <= sizeof(frag_ans)) {
+        memcpy(frag_ans, uplink.payload, uplink.size);
+        frag_ans_size = uplink.size;
+    }
+}
+
+static bool frag_ans_seen()
+{
+    return frag_ans_size > 0;
+}
+
+/**
+ * Links a multicast group known to the network as device 'device'
+ */
+static bool link_group(SimNode &node, SimNetwork &network, uint32_t device, uint32_t address,
+                       uint8_t group_id)
+{
+    multicast_params_t group;
+
+    group.address = address;
+    for (uint8_t i = 0; i < 16; i++) {
+        group.nwk_skey[i] = 0xA0 + group_id + i;
+        group.app_skey[i] = 0xB0 + group_id + i;
+    }
+    group.dl_frame_counter = 0;
+    group.group_id = group_id;
+
+    SIM_CHECK(network.server.add_abp_device(address, group.nwk_skey, group.app_skey)
+              == (int32_t) device);
+    SIM_CHECK(node.lorawan.add_multicast_group(group) == LORAWAN_STATUS_OK);
+
+    return true;
+}
+
+/**
+ * Class C device in two multicast groups gets a fragmentation session for
+ * one of them: the session is answered once its area is erased, takes the
+ * fragments of that group only, and restores the block
+ */
+static bool class_c_frag_session(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t nb_frag = 4;
+    static const uint8_t frag_size = 8;
+    // session 1, McGroupBitMask of group 1, no padding, descriptor 0x12345678
+    static const uint8_t setup[] = {
+        0x02, 0x12, nb_frag, 0x00, frag_size, 0x00, 0x00, 0x78, 0x56, 0x34, 0x12
+    };
+    LoRaWANRamStorage storage(session_flash, sizeof(session_flash), 256);
+    lorawan_frag_status_t status;
+    lorawan_multicast_status_t group;
+    uint8_t fragment[3 + frag_size];
+
+    memset(session_flash, 0, sizeof(session_flash));
+    frag_ans_size = 0;
+    network.server.set_listener(mbed::callback(record_frag_ans));
+
+    SIM_CHECK(network.server.add_abp_device(0x26011244, sim_nwk_skey, sim_app_skey) == 0);
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_frag_session_storage(&storage, 0, sizeof(session_flash))
+              == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011244) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(link_group(node, network, 1, 0x26FFFF02, 1));
+    SIM_CHECK(link_group(node, network, 2, 0x26FFFF03, 2));
+    SIM_CHECK(node.lorawan.set_device_class(CLASS_C) == LORAWAN_STATUS_OK);
+
+    SIM_CHECK(send_class_c(network, clock, 0, setup, sizeof(setup), MBED_CONF_LORA_FRAG_PORT));
+    SIM_CHECK(clock.run_until(frag_ans_seen, 60000));
+    SIM_CHECK(frag_ans_size == 2);
+    SIM_CHECK(frag_ans[0] == 0x02);
+    SIM_CHECK(frag_ans[1] == 0x40);
+    SIM_CHECK(session_flash[0] == 0xFF);
+
+    SIM_CHECK(node.lorawan.get_frag_session_status(status) == LORAWAN_STATUS_OK);
+    SIM_CHECK(status.active);
+    SIM_CHECK(status.frag_index == 1);
+    SIM_CHECK(status.mc_group_mask == 0x02);
+    SIM_CHECK(status.descriptor == 0x12345678);
+
+    // group 2 is not in the session, then group 1 sends the block
+    for (uint8_t device = 2; device >= 1; device--) {
+        const uint32_t address = device == 1 ? 0x26FFFF02 : 0x26FFFF03;
+
+        for (uint8_t n = 1; n <= nb_frag; n++) {
+            fragment[0] = 0x08;
+            fragment[1] = n;
+            fragment[2] = 1 << 6;
+            memset(&fragment[3], 'a' + n, frag_size);
+            SIM_CHECK(send_class_c(network, clock, device, fragment, sizeof(fragment),
+                                   MBED_CONF_LORA_FRAG_PORT));
+            clock.run_for(2000);
+        }
+
+        SIM_CHECK(node.lorawan.get_multicast_group_status(address, group) == LORAWAN_STATUS_OK);
+        SIM_CHECK(group.rx_count == nb_frag);
+        SIM_CHECK(node.lorawan.get_frag_session_status(status) == LORAWAN_STATUS_OK);
+        SIM_CHECK(status.nb_received == (device == 1 ? nb_frag : 0));
+    }
+
+    SIM_CHECK(node.count(FRAG_SESSION_COMPLETE) == 1);
+    SIM_CHECK(status.complete);
+    for (uint8_t n = 1; n <= nb_frag; n++) {
+        SIM_CHECK(session_flash[(n - 1) * frag_size] == 'a' + n);
+    }
+
+    return true;
+}
+#endif
+#endif
+
+/**
+ * Boots a device on a session storage: the time (ms) from connect() to the
+ * end of its first uplink
+ */
+static bool boot_and_send(SimNode &node, SimClock &clock, LoRaWANStorage &storage,
+                          uint32_t &time)
+{
+    static const uint8_t payload[] = "boot";
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_session_storage(&storage) == LORAWAN_STATUS_OK);
+
+    lorawan_time_t start = clock.now();
+    lorawan_status_t status = node.connect_otaa(dev_eui, MBED_CONF_LORA_NB_TRIALS);
+    SIM_CHECK(status == LORAWAN_STATUS_OK || status == LORAWAN_STATUS_CONNECT_IN_PROGRESS);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 60000));
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    time = clock.now() - start;
+
+    return true;
+}
+
+/**
+ * Cuts the power of a device, its radio stopping and its stack never
+ * running again, and boots another one on the same storage
+ */
+static bool reboot_and_send(SimNode &node, SimClock &clock, LoRaWANStorage &storage,
+                            uint32_t &time)
+{
+    node.radio.sleep();
+    clock.remove(node.queue);
+
+    // another id, for another DevNonce if it joins
+    SimNode rebooted(node.radio.get_air(), node.radio.get_id() + 1);
+    rebooted.radio.set_position(20, 0);
+    clock.add(rebooted.queue, &rebooted.random);
+
+    bool passed = boot_and_send(rebooted, clock, storage, time);
+
+    rebooted.radio.sleep();
+    clock.remove(rebooted.queue);
+
+    return passed;
+}
+
+/**
+ * OTAA device with a session storage: it joins, then after a reset resumes
+ * the saved session, its first uplink going out without a join
+ */
+static bool otaa_resume(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    LoRaWANRamStorage storage(session_flash, sizeof(session_flash), 256);
+    const virtual_ns_stats_t &stats = network.server.get_stats();
+    uint32_t join_time;
+    uint32_t resume_time;
+
+    memset(session_flash, 0xFF, sizeof(session_flash));
+    SIM_CHECK(network.server.add_otaa_device(dev_eui, sim_app_key) == 0);
+
+    SIM_CHECK(boot_and_send(node, clock, storage, join_time));
+    SIM_CHECK(stats.joins == 1);
+
+    SIM_CHECK(reboot_and_send(node, clock, storage, resume_time));
+    SIM_CHECK(stats.joins == 1);
+    SIM_CHECK(stats.uplinks == 2);
+    SIM_CHECK(stats.mic_failures == 0);
+    SIM_CHECK(resume_time < join_time);
+
+    printf("  time to first uplink: join %lu ms, resume %lu ms\n",
+           (unsigned long) join_time, (unsigned long) resume_time);
+
+    return true;
+}
+
+/**
+ * OTAA device with a storage too small for the frame counter journal: the
+ * saved session cannot tell which counters were used, so after a reset the
+ * device joins again
+ */
+static bool otaa_resume_no_journal(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    LoRaWANRamStorage storage(session_flash, 1024, 1024);
+    const virtual_ns_stats_t &stats = network.server.get_stats();
+    uint32_t time;
+
+    memset(session_flash, 0xFF, sizeof(session_flash));
+    SIM_CHECK(network.server.add_otaa_device(dev_eui, sim_app_key) == 0);
+
+    SIM_CHECK(boot_and_send(node, clock, storage, time));
+    SIM_CHECK(reboot_and_send(node, clock, storage, time));
+    SIM_CHECK(stats.joins == 2);
+    SIM_CHECK(stats.uplinks == 2);
+    SIM_CHECK(stats.mic_failures == 0);
+
+    return true;
+}
+
+/**
+ * ABP device with a frame counter journal whose storage fails: the uplink
+ * is refused rather than sent with a counter the journal does not cover,
+ * and goes out once the storage works again, with the counter it had
+ */
+static bool abp_journal_failure(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "counted";
+    LoRaWANRamStorage storage(session_flash, sizeof(session_flash), 256);
+
+    memset(session_flash, 0xFF, sizeof(session_flash));
+    SIM_CHECK(network.server.add_abp_device(0x2601123C, sim_nwk_skey, sim_app_skey) == 0);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_session_storage(&storage) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x2601123C) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    // the reservation tears half way
+    storage.inject_power_loss(8);
+    SIM_CHECK(node.lorawan.send(15, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG)
+              == LORAWAN_STATUS_STORAGE_ERROR);
+    clock.run_for(10000);
+    SIM_CHECK(node.radio.get_stats().tx_count == 0);
+    SIM_CHECK(node.count(TX_DONE) == 0);
+
+    storage.restore_power();
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    SIM_CHECK(node.radio.get_stats().tx_count == 1);
+    SIM_CHECK(network.server.get_stats().uplinks == 1);
+    SIM_CHECK(network.server.get_device(0).fcnt_up == 0);
+
+    return true;
+}
+
+/**
+ * Skew (ppm) of the device clock in abp_device_time
+ */
+#define SIM_CLOCK_SKEW      20
+
+/**
+ * Asks for the time on an uplink, then checks the GPS time the device keeps
+ * against the network's: behind it by the interrupt latency and the skew
+ * counted so far, and by less than a 1/256 s step of the answer
+ */
+static bool sync_device_time(SimNode &node, SimClock &clock, uint32_t skew)
+{
+    static const uint8_t payload[] = "time";
+    uint32_t synced = node.count(DEVICE_TIME_SYNCED);
+    uint32_t seconds;
+    uint16_t ms;
+
+    SIM_CHECK(node.lorawan.add_device_time_request() == LORAWAN_STATUS_OK);
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    SIM_CHECK(node.count(DEVICE_TIME_SYNCED) == synced + 1);
+
+    SIM_CHECK(node.lorawan.get_gps_time(seconds, ms) == LORAWAN_STATUS_OK);
+    uint64_t network = (uint64_t) NS_GPS_EPOCH * 1000 + clock.now();
+    int64_t behind = (int64_t)(network - ((uint64_t) seconds * 1000 + ms));
+    SIM_CHECK(behind >= RADIO_IRQ_LATENCY + skew);
+    SIM_CHECK(behind < RADIO_IRQ_LATENCY + skew + 4 + 1);
+
+    return true;
+}
+
+/**
+ * ABP device whose clock runs SIM_CLOCK_SKEW ppm fast: DeviceTimeAns sets
+ * its GPS time, and a second answer some 35 minutes later both sets it again
+ * and gives the drift
+ */
+static bool abp_device_time(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    uint32_t seconds;
+    uint16_t ms;
+    int32_t drift;
+
+    SIM_CHECK(network.server.add_abp_device(0x26011245, sim_nwk_skey, sim_app_skey) == 0);
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011245) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.get_gps_time(seconds, ms) == LORAWAN_STATUS_NO_OP);
+    SIM_CHECK(node.lorawan.get_clock_drift(drift) == LORAWAN_STATUS_NO_OP);
+
+    lorawan_time_t skew_start = clock.now();
+    node.radio.set_clock_skew(SIM_CLOCK_SKEW);
+
+    SIM_CHECK(sync_device_time(node, clock, 0));
+    // one reference tells nothing of the drift
+    SIM_CHECK(node.lorawan.get_clock_drift(drift) == LORAWAN_STATUS_NO_OP);
+
+    clock.run_for(2100000);
+
+    // the uplink ended a few seconds before the answer was read
+    uint32_t skew = (uint64_t)(clock.now() - skew_start) * SIM_CLOCK_SKEW / 1000000;
+    SIM_CHECK(sync_device_time(node, clock, skew - 1));
+    SIM_CHECK(node.lorawan.get_clock_drift(drift) == LORAWAN_STATUS_OK);
+    SIM_CHECK(drift >= SIM_CLOCK_SKEW - 2 && drift <= SIM_CLOCK_SKEW + 2);
+    SIM_CHECK(node.count(DEVICE_TIME_SYNCED) == 2);
+
+    return true;
+}
+
+/**
+ * Offset (ms) and jitter of the downlinks in abp_rx_window
+ */
+#define SIM_RX_OFFSET       12
+#define SIM_RX_JITTER       4
+
+/**
+ * Sends a confirmed uplink at a datarate, and reads the window the ack came
+ * in
+ */
+static bool confirmed_window(SimNode &node, SimClock &clock, uint8_t datarate, int32_t &start,
+                             uint32_t &length)
+{
+    static const uint8_t payload[] = "window";
+
+    SIM_CHECK(node.lorawan.set_datarate(datarate) == LORAWAN_STATUS_OK);
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_CONFIRMED_FLAG));
+    node.radio.get_last_rx_window(start, length);
+    // out of the duty cycle of the RX1 sub-band
+    clock.run_for(10000);
+
+    return true;
+}
+
+/**
+ * ABP device whose downlinks land SIM_RX_OFFSET ms late, give or take
+ * SIM_RX_JITTER: the RX1 window of a datarate shrinks and moves onto them
+ * once it has seen a few, the window of another datarate stays as it was,
+ * and a missed acknowledgement sends all of them back to the worst case
+ */
+static bool abp_rx_window(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    int32_t start4, start0, start;
+    uint32_t length4, length0, length;
+
+    SIM_CHECK(network.server.add_abp_device(0x26011246, sim_nwk_skey, sim_app_skey) == 0);
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011246) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.disable_adaptive_datarate() == LORAWAN_STATUS_OK);
+    node.radio.set_timing_offset(SIM_RX_OFFSET, SIM_RX_JITTER);
+
+    SIM_CHECK(confirmed_window(node, clock, DR_4, start4, length4));
+    SIM_CHECK(confirmed_window(node, clock, DR_5, start0, length0));
+
+    // the offsets of four downlinks are needed
+    for (uint8_t i = 0; i < 5; i++) {
+        SIM_CHECK(confirmed_window(node, clock, DR_5, start, length));
+    }
+    SIM_CHECK(length < length0);
+    int32_t shift = (start + (int32_t) length / 2) - (start0 + (int32_t) length0 / 2);
+    printf("  RX1 window at DR5: %lu ms at +%ld ms, learnt %lu ms at +%ld ms, centre moved %ld ms\n",
+           (unsigned long) length0, (long) start0, (unsigned long) length, (long) start,
+           (long) shift);
+    SIM_CHECK(shift >= SIM_RX_OFFSET - 1 && shift <= SIM_RX_OFFSET + SIM_RX_JITTER + 1);
+
+    SIM_CHECK(confirmed_window(node, clock, DR_4, start, length));
+    SIM_CHECK(start == start4 && length == length4);
+
+    // out of range, the acknowledgement does not come
+    SIM_CHECK(node.lorawan.set_confirmed_msg_retries(1) == LORAWAN_STATUS_OK);
+    node.radio.set_position(100000, 0);
+    SIM_CHECK(node.lorawan.send(15, (const uint8_t *) "lost", 4, MSG_CONFIRMED_FLAG) == 4);
+    SIM_CHECK(clock.run_until(node.seen(TX_ERROR), 600000));
+    node.radio.set_position(20, 0);
+    clock.run_for(10000);
+
+    SIM_CHECK(confirmed_window(node, clock, DR_5, start, length));
+    SIM_CHECK(start == start0 && length == length0);
+    SIM_CHECK(node.count(TX_ERROR) == 1);
+
+    return true;
+}
+
+#if MBED_CONF_LORA_MULTI_REGION
+static uint32_t uplink_frequency;
+
+static void record_uplink(const air_frame_t &frame)
+{
+    if (frame.sender) {
+        uplink_frequency = frame.frequency;
+    }
+}
+
+/**
+ * ABP device switched from EU868 to US915 once initialized: its uplink goes
+ * out on a US915 channel and its RX2 window opens on 923.3 MHz
+ */
+static bool abp_region_switch(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "region";
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_region(LORAWAN_REGION_US915) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x26011247) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.radio.get_air().observe(mbed::callback(record_uplink)));
+
+    uplink_frequency = 0;
+    node.radio.reset_stats();
+    SIM_CHECK(node.lorawan.send(15, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG)
+              == sizeof(payload));
+    SIM_CHECK(clock.run_until(node.seen(TX_DONE), 10000));
+    SIM_CHECK(node.radio.get_stats().tx_count == 1);
+    SIM_CHECK(node.radio.get_stats().rx_count == 2);
+
+    // 64 channels of 125 kHz from 902.3 MHz, 8 of 500 kHz from 903.0 MHz
+    printf("  uplink on %lu Hz, RX2 on %lu Hz\n", (unsigned long) uplink_frequency,
+           (unsigned long) node.radio.get_last_rx_frequency());
+    bool narrow = uplink_frequency >= 902300000 && uplink_frequency <= 914900000
+                  && (uplink_frequency - 902300000) % 200000 == 0;
+    bool wide = uplink_frequency >= 903000000 && uplink_frequency <= 914200000
+                && (uplink_frequency - 903000000) % 1600000 == 0;
+    SIM_CHECK(narrow || wide);
+    SIM_CHECK(node.radio.get_last_rx_frequency() == 923300000);
+
+    return true;
+}
+#endif
+
+/**
+ * Class B device under a beaconing gateway: it finds the beacon with a
+ * continuous search, tracks it, and gets application data in its ping
+ * slots, also in a period whose beacon it missed
+ */
+static bool class_b_beacon(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "class b";
+    static const uint8_t data[] = "slot";
+    static const uint8_t nb_downlinks = 4;
+    VirtualNetworkServer &server = network.server;
+    lorawan_class_b_status_t status;
+    uint32_t max_latency = 0;
+    uint32_t total_latency = 0;
+    uint8_t received[16];
+
+    SIM_CHECK(server.add_abp_device(0x2601123D, sim_nwk_skey, sim_app_skey) == 0);
+    network.start_beacons();
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(0x2601123D) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    lorawan_time_t search_start = clock.now();
+    SIM_CHECK(node.lorawan.set_device_class(CLASS_B) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(BEACON_LOCKED), NS_BEACON_INTERVAL + 2000));
+    uint32_t search_time = clock.now() - search_start;
+
+    // PingSlotInfoReq, answered, then an uplink with the Class B bit
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    SIM_CHECK(server.get_device(0).class_b);
+
+    for (uint8_t i = 0; i < nb_downlinks; i++) {
+        mbed::Callback<bool()> done = node.seen_next(RX_DONE);
+        lorawan_time_t queued = clock.now();
+
+        SIM_CHECK(server.send_class_b(0, queued, 2, data, sizeof(data)));
+        SIM_CHECK(clock.run_until(done, 2 * NS_BEACON_INTERVAL));
+
+        uint32_t latency = clock.now() - queued;
+        total_latency += latency;
+        max_latency = latency > max_latency ? latency : max_latency;
+
+        SIM_CHECK(node.lorawan.receive(2, received, sizeof(received), MSG_UNCONFIRMED_FLAG)
+                  == sizeof(data));
+        SIM_CHECK(memcmp(received, data, sizeof(data)) == 0);
+    }
+
+    SIM_CHECK(node.lorawan.get_class_b_status(status) == LORAWAN_STATUS_OK);
+    SIM_CHECK(status.beacons_missed == 0);
+    SIM_CHECK(status.ping_slot_frames == nb_downlinks);
+    SIM_CHECK(status.info_desc == 0);
+    uint32_t beacons = status.beacons_received;
+
+    // out of range of the next beacon, back for the ping slot after it
+    node.radio.set_position(2000, 0);
+    for (uint32_t waited = 0; status.beacons_missed == 0; waited += 100) {
+        SIM_CHECK(waited < NS_BEACON_INTERVAL + 2000);
+        clock.run_for(100);
+        node.lorawan.get_class_b_status(status);
+    }
+    node.radio.set_position(20, 0);
+
+    mbed::Callback<bool()> done = node.seen_next(RX_DONE);
+    SIM_CHECK(server.send_class_b(0, clock.now(), 2, data, sizeof(data)));
+    SIM_CHECK(clock.run_until(done, NS_BEACON_INTERVAL));
+    node.lorawan.get_class_b_status(status);
+    SIM_CHECK(status.beacons_received == beacons);
+    SIM_CHECK(node.lorawan.receive(2, received, sizeof(received), MSG_UNCONFIRMED_FLAG)
+              == sizeof(data));
+
+    // tracked again with the next beacon
+    clock.run_for(NS_BEACON_INTERVAL);
+    node.lorawan.get_class_b_status(status);
+    SIM_CHECK(status.beacons_received == beacons + 1);
+    SIM_CHECK(status.beacons_missed == 1);
+    SIM_CHECK(status.ping_slot_frames == nb_downlinks + 1u);
+    SIM_CHECK(node.count(BEACON_LOST) == 0);
+    SIM_CHECK(server.get_stats().class_b_downlinks == nb_downlinks + 1u);
+
+    printf("  beacon search %lu ms, ping slot latency mean %lu ms, max %lu ms, period %lu ms\n",
+           (unsigned long) search_time, (unsigned long)(total_latency / nb_downlinks),
+           (unsigned long) max_latency, (unsigned long) status.ping_period);
+    printf("  radio on: beacons %lu ms, ping slots %lu ms over %lu slots\n",
+           (unsigned long) status.beacon_radio_on_time,
+           (unsigned long) status.ping_radio_on_time,
+           (unsigned long) status.ping_slots_opened);
+
+    return true;
+}
+
+#if MBED_CONF_LORA_AUTOMATIC_UPLINK_MESSAGE
+/**
+ * Period of the application uplinks of the MAC answer scenarios, short
+ * enough for the next one to come before the automatic uplink deadline
+ */
+#define SIM_APP_PERIOD      8000
+
+/**
+ * Connects a device known to the network and sends uplinks every
+ * SIM_APP_PERIOD, for the stack to learn the period; the network then asks
+ * for new receive window settings, in the downlink of the last one. Returns
+ * once that uplink is done.
+ */
+static bool learn_app_period(SimNode &node, SimNetwork &network, SimClock &clock,
+                             uint32_t dev_addr)
+{
+    static const uint8_t payload[] = { 0x42 };
+
+    SIM_CHECK(network.server.add_abp_device(dev_addr, sim_nwk_skey, sim_app_skey) == 0);
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(dev_addr) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+
+    node.radio.reset_stats();
+    for (uint8_t i = 0; i < 5; i++) {
+        lorawan_time_t start = clock.now();
+        if (i == 4) {
+            network.server.set_rx_params(0, DR_3, 869525000);
+        }
+        SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+        if (i < 4) {
+            clock.run_for(SIM_APP_PERIOD - (clock.now() - start));
+        }
+    }
+    SIM_CHECK(node.radio.get_stats().tx_count == 5);
+
+    return true;
+}
+
+/**
+ * Device sending at a steady period: the answer to a MAC command the
+ * network sends is held back and rides in the FOpts of the next application
+ * uplink, no empty uplink is sent for it
+ */
+static bool abp_mac_answer_piggyback(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = { 0x42 };
+
+    SIM_CHECK(learn_app_period(node, network, clock, 0x26011241));
+    SIM_CHECK(network.server.get_device(0).rx2_datarate != DR_3);
+
+    // the next application uplink, on time
+    clock.run_for(SIM_APP_PERIOD - 3000);
+    SIM_CHECK(node.radio.get_stats().tx_count == 5);
+    SIM_CHECK(send_and_wait(node, clock, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG));
+    SIM_CHECK(network.server.get_device(0).rx2_datarate == DR_3);
+
+    // nothing is sent after it either
+    clock.run_for(2 * MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE);
+    SIM_CHECK(node.radio.get_stats().tx_count == 6);
+    SIM_CHECK(node.count(AUTOMATIC_UPLINK_ERROR) == 0);
+
+    return true;
+}
+
+/**
+ * Device sending at a steady period, then falling silent: the held back
+ * answer to a MAC command goes out in an uplink of its own once the
+ * deadline expires
+ */
+static bool abp_mac_answer_fallback(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    SIM_CHECK(learn_app_period(node, network, clock, 0x26011242));
+    lorawan_time_t held = clock.now();
+
+    while (node.radio.get_stats().tx_count == 5) {
+        SIM_CHECK(clock.now() - held < 2 * MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE);
+        clock.run_for(100);
+    }
+
+    // held from the downlink, just before the end of the last uplink
+    uint32_t waited = clock.now() - held;
+    SIM_CHECK(waited + 1000 >= MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE);
+    SIM_CHECK(waited <= MBED_CONF_LORA_AUTOMATIC_UPLINK_DEADLINE + 100);
+
+    clock.run_for(10000);
+    SIM_CHECK(network.server.get_device(0).rx2_datarate == DR_3);
+    SIM_CHECK(node.radio.get_stats().tx_count == 6);
+    SIM_CHECK(node.count(AUTOMATIC_UPLINK_ERROR) == 0);
+
+    return true;
+}
+#endif
+
+#define SIM_MAX_QUEUED      8
+
+static int16_t queued_ids[SIM_MAX_QUEUED];
+
+static lorawan_event_t queued_outcomes[SIM_MAX_QUEUED];
+
+static uint8_t nb_queued_outcomes;
+
+static uint8_t queued_ports[SIM_MAX_QUEUED];
+
+static uint8_t nb_queued_ports;
+
+static uint8_t nb_awaited_outcomes;
+
+static void record_uplink_status(int16_t id, lorawan_event_t event)
+{
+    if (nb_queued_outcomes < SIM_MAX_QUEUED) {
+        queued_ids[nb_queued_outcomes] = id;
+        queued_outcomes[nb_queued_outcomes] = event;
+    }
+    nb_queued_outcomes++;
+}
+
+static void record_queued_uplink(const virtual_ns_uplink_t &uplink)
+{
+    if (nb_queued_ports < SIM_MAX_QUEUED) {
+        queued_ports[nb_queued_ports] = uplink.port;
+    }
+    nb_queued_ports++;
+}
+
+static bool queued_outcomes_seen()
+{
+    return nb_queued_outcomes >= nb_awaited_outcomes;
+}
+
+/**
+ * Connects an ABP device known to the network at DR0, recording the outcome
+ * of each queued message and the port of each uplink the network receives
+ */
+static bool connect_queue(SimNode &node, SimNetwork &network, SimClock &clock, uint32_t dev_addr)
+{
+    nb_queued_outcomes = 0;
+    nb_queued_ports = 0;
+
+    SIM_CHECK(network.server.add_abp_device(dev_addr, sim_nwk_skey, sim_app_skey) == 0);
+    network.server.set_listener(mbed::callback(record_queued_uplink));
+
+    SIM_CHECK(node.start() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.set_uplink_status(mbed::callback(record_uplink_status)) == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.connect_abp(dev_addr) == LORAWAN_STATUS_OK);
+    SIM_CHECK(clock.run_until(node.seen(CONNECTED), 1000));
+    SIM_CHECK(node.lorawan.disable_adaptive_datarate() == LORAWAN_STATUS_OK);
+    SIM_CHECK(node.lorawan.set_datarate(DR_0) == LORAWAN_STATUS_OK);
+
+    return true;
+}
+
+/**
+ * Messages queued together go out highest priority first, in the order they
+ * were queued among equal priorities, one frame each
+ */
+static bool abp_queue_priority(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "queued";
+    int16_t ids[4];
+
+    SIM_CHECK(connect_queue(node, network, clock, 0x2601123E));
+
+    node.radio.reset_stats();
+    ids[0] = node.lorawan.queue_send(10, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG, 0, 0);
+    ids[1] = node.lorawan.queue_send(11, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG, 2, 0);
+    ids[2] = node.lorawan.queue_send(12, payload, sizeof(payload), MSG_CONFIRMED_FLAG, 1, 0);
+    ids[3] = node.lorawan.queue_send(13, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG, 2, 0);
+    for (uint8_t i = 0; i < 4; i++) {
+        SIM_CHECK(ids[i] >= 0);
+    }
+
+    nb_awaited_outcomes = 4;
+    SIM_CHECK(clock.run_until(mbed::callback(queued_outcomes_seen), 600000));
+
+    static const uint8_t order[4] = { 1, 3, 2, 0 };
+    for (uint8_t i = 0; i < 4; i++) {
+        SIM_CHECK(queued_ids[i] == ids[order[i]]);
+        SIM_CHECK(queued_outcomes[i] == TX_DONE);
+        SIM_CHECK(queued_ports[i] == 10 + order[i]);
+    }
+    SIM_CHECK(nb_queued_outcomes == 4);
+    SIM_CHECK(nb_queued_ports == 4);
+    SIM_CHECK(node.radio.get_stats().tx_count == 4);
+
+    return true;
+}
+
+/**
+ * A message waiting behind another one passes its deadline: it is reported
+ * expired and never sent
+ */
+static bool abp_queue_expiry(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "queued";
+
+    SIM_CHECK(connect_queue(node, network, clock, 0x2601123F));
+
+    node.radio.reset_stats();
+    int16_t first = node.lorawan.queue_send(10, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG,
+                                            0, 0);
+    int16_t late = node.lorawan.queue_send(11, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG,
+                                           0, 1000);
+    SIM_CHECK(first >= 0 && late >= 0);
+
+    nb_awaited_outcomes = 2;
+    SIM_CHECK(clock.run_until(mbed::callback(queued_outcomes_seen), 600000));
+    SIM_CHECK(queued_ids[0] == first && queued_outcomes[0] == TX_DONE);
+    SIM_CHECK(queued_ids[1] == late && queued_outcomes[1] == UPLINK_EXPIRED);
+    SIM_CHECK(node.count(UPLINK_EXPIRED) == 1);
+
+    clock.run_for(10000);
+    SIM_CHECK(nb_queued_ports == 1 && queued_ports[0] == 10);
+    SIM_CHECK(node.radio.get_stats().tx_count == 1);
+
+    return true;
+}
+
+/**
+ * A message larger than a frame is refused, so is one more message than
+ * the queue holds, until the messages waiting in it expire
+ */
+static bool abp_queue_full(SimNode &node, SimNetwork &network, SimClock &clock)
+{
+    static const uint8_t payload[] = "queued";
+    // DR0 of EU868 carries 51 bytes
+    static const uint8_t large[52] = { 0 };
+    static const uint8_t nb_waiting = MBED_CONF_LORA_UPLINK_QUEUE_SIZE - 1;
+
+    SIM_CHECK(connect_queue(node, network, clock, 0x26011240));
+
+    SIM_CHECK(node.lorawan.queue_send(10, large, sizeof(large), MSG_UNCONFIRMED_FLAG, 0, 0)
+              == LORAWAN_STATUS_LENGTH_ERROR);
+    SIM_CHECK(node.lorawan.queue_send(10, large, sizeof(large) - 1, MSG_UNCONFIRMED_FLAG, 0, 0)
+              >= 0);
+
+    // in flight, then the queue fills behind it
+    clock.run_for(100);
+    for (uint8_t i = 0; i < nb_waiting; i++) {
+        SIM_CHECK(node.lorawan.queue_send(11, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG,
+                                          0, 500) >= 0);
+    }
+    SIM_CHECK(node.lorawan.queue_send(12, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG, 0, 0)
+              == LORAWAN_STATUS_WOULD_BLOCK);
+
+    // the first message still waits for its receive windows
+    clock.run_for(500);
+    SIM_CHECK(nb_queued_outcomes == 0);
+
+    int16_t last = node.lorawan.queue_send(12, payload, sizeof(payload), MSG_UNCONFIRMED_FLAG,
+                                           0, 0);
+    SIM_CHECK(last >= 0);
+
+    nb_awaited_outcomes = nb_waiting + 2;
+    SIM_CHECK(clock.run_until(mbed::callback(queued_outcomes_seen), 600000));
+    SIM_CHECK(node.count(UPLINK_EXPIRED) == nb_waiting);
+    SIM_CHECK(queued_ids[nb_waiting + 1] == last);
+    SIM_CHECK(queued_outcomes[nb_waiting + 1] == TX_DONE);
+    SIM_CHECK(nb_queued_ports == 2 && queued_ports[0] == 10 && queued_ports[1] == 12);
+
+    return true;
+}
+
+typedef bool (*scenario_t)(SimNode &node, SimNetwork &network, SimClock &clock);
+
+static void run(const char *name, scenario_t scenario)
+{
+    VirtualAir air;
+    SimNode node(air, 1);
+    SimNetwork network(air, 3);
+    SimClock clock(2);
+    clock.add(node.queue, &node.random);
+    clock.add(network.queue);
+    node.radio.set_position(20, 0);
+    lorawan_time_t start = clock.now();
+
+    profile_reset();
+
+    bool passed = scenario(node, network, clock);
+
+    report(name, passed, clock, start, node.radio);
+
+    if (profile) {
+        profile_dump();
+    }
+
+    uint32_t words[256];
+    uint32_t count;
+    while (trace_file && (count = trace_ring_read(words, 256)) > 0) {
+        fwrite(words, sizeof(uint32_t), count, trace_file);
+    }
+}
+
+static uint32_t trace_clock()
+{
+    return equeue_tick();
+}
+
+int main(int argc, char **argv)
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "T:P")) != -1) {
+        switch (option) {
+            case 'T':
+                trace_file = fopen(optarg, "wb");
+                if (!trace_file) {
+                    fprintf(stderr, "cannot write %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'P':
+                profile = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-T trace file] [-P]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (trace_file) {
+        trace_ring_set_clock(trace_clock);
+        trace_ring_set_enabled(true);
+    }
+
+    run("abp_unconfirmed_uplink", abp_unconfirmed_uplink);
+    run("abp_confirmed_no_ack", abp_confirmed_no_ack);
+    run("otaa_unknown", otaa_unknown);
+    run("otaa_join", otaa_join);
+    run("abp_confirmed_ack", abp_confirmed_ack);
+    run("abp_downlink_data", abp_downlink_data);
+    run("abp_mac_commands", abp_mac_commands);
+#if MBED_CONF_LORA_CLASS_C
+    run("class_c_burst_receive", class_c_burst_receive);
+    run("class_c_burst_held", class_c_burst_held);
+#if MBED_CONF_LORA_MULTICAST_GROUPS
+    run("class_c_multicast", class_c_multicast);
+    run("class_c_frag_session", class_c_frag_session);
+#endif
+#endif
+    run("otaa_resume", otaa_resume);
+    run("otaa_resume_no_journal", otaa_resume_no_journal);
+    run("abp_journal_failure", abp_journal_failure);
+    run("abp_device_time", abp_device_time);
+    run("abp_rx_window", abp_rx_window);
+#if MBED_CONF_LORA_MULTI_REGION
+    run("abp_region_switch", abp_region_switch);
+#endif
+    run("class_b_beacon", class_b_beacon);
+    run("abp_queue_priority", abp_queue_priority);
+    run("abp_queue_expiry", abp_queue_expiry);
+    run("abp_queue_full", abp_queue_full);
+#if MBED_CONF_LORA_AUTOMATIC_UPLINK_MESSAGE
+    run("abp_mac_answer_piggyback", abp_mac_answer_piggyback);
+    run("abp_mac_answer_fallback", abp_mac_answer_fallback);
+#endif
+
+    if (trace_file) {
+        fclose(trace_file);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file sim_random.c
+ *
+ * @brief rand() of the host simulation
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "sim_random.h"
+
+static __thread unsigned int thread_state = 1;
+static __thread unsigned int *selected_state = NULL;
+
+unsigned int *sim_rand_select(unsigned int *state)
+{
+    unsigned int *previous = selected_state;
+
+    selected_state = state;
+
+    return previous;
+}
+
+void srand(unsigned int seed)
+{
+    *(selected_state ? selected_state : &thread_state) = seed;
+}
+
+int rand(void)
+{
+    unsigned int *state = selected_state ? selected_state : &thread_state;
+    uint32_t z;
+
+    // splitmix32, any seed will do
+    *state += 0x9E3779B9u;
+    z = *state;
+    z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+    z ^= z >> 16;
+
+    return (int)(z & RAND_MAX);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file sim_random.h
+ *
+ * @brief rand() of the host simulation
+ *
+ * The stack draws channels and backoffs from rand(), which the C library
+ * shares between every device and thread of the process: the draws of a
+ * device would depend on what the others did, and on how the devices are
+ * dealt out to threads. The simulation replaces rand() and srand() with a
+ * generator working on a state the caller selects, one per device.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef MBED_LORAWAN_SIM_RANDOM_H__
+#define MBED_LORAWAN_SIM_RANDOM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Selects the state rand() and srand() work on, for the calling thread
+ *
+ * @param state         State, NULL for the one of the thread
+ *
+ * @return              State selected before
+ */
+unsigned int *sim_rand_select(unsigned int *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBED_LORAWAN_SIM_RANDOM_H__ */
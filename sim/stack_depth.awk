@@ -0,0 +1,188 @@
+# Worst case stack depth of the tasks, from the call graph of the build
+#
+# Reads the .ci files gcc writes with -fcallgraph-info=su, one per object:
+# the frame of every function defined in the object and the calls it makes.
+# A task is given as
+#
+#   <name>;<dispatcher>;<roots>
+#
+# where the roots, a regex over the names of the functions, are what the
+# task runs, and the dispatcher, a regex too or empty, what it runs them
+# from, the event queue calling them through pointers. The depth of a task
+# is that of its dispatcher plus that of its deepest root, each the largest
+# sum of frames along the direct calls it makes; a function met again on the
+# path is not counted twice.
+#
+# Prints, for each task of tasks (space separated), the depth and the path
+# to it, frame by frame, then every root with its depth. A depth is a lower
+# bound where the path goes out of the graph:
+#
+#   *   calls through a pointer, of which the graph knows nothing
+#   ?   calls a function not in the objects, libc or the driver
+#   d   has a frame of dynamic size
+#   r   is recursive, the recursion counted once
+#
+#   awk -v tasks=... -f stack_depth.awk <.ci files>
+#
+# Copyright (c) 2017, Arm Limited and affiliates.
+# SPDX-License-Identifier: BSD-3-Clause
+
+function quoted(line, key)
+{
+    if (!match(line, key ": \"[^\"]*\"")) {
+        return ""
+    }
+    return substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 4)
+}
+
+# Depth of a function, its frame and the deepest of its callees
+function depth(f,    i, callee, d, best, best_callee)
+{
+    if (f in done) {
+        return worst[f]
+    }
+    if (f in on_path) {
+        recursive[f] = 1
+        return 0
+    }
+    on_path[f] = 1
+
+    best = 0
+    best_callee = ""
+    for (i = 0; i < nb_calls[f]; i++) {
+        callee = calls[f, i]
+        if (callee == "__indirect_call") {
+            indirect[f] = 1
+            continue
+        }
+        if (!(callee in frame)) {
+            external[f] = 1
+            if (best_callee == "") {
+                best_callee = callee
+            }
+            continue
+        }
+        d = depth(callee)
+        if (d > best || best_callee == "" || !(best_callee in frame)) {
+            best = d
+            best_callee = callee
+        }
+    }
+
+    delete on_path[f]
+    done[f] = 1
+    next_on_path[f] = best_callee
+    worst[f] = frame[f] + best
+    return worst[f]
+}
+
+function marks(f)
+{
+    return ((f in indirect) ? "*" : "") ((f in external) ? "?" : "") \
+           ((f in dynamic) ? "d" : "") ((f in recursive) ? "r" : "")
+}
+
+function print_path(f)
+{
+    while (f != "") {
+        if (f in frame) {
+            printf "  %8d  %-4s %s\n", frame[f], marks(f), label[f]
+        } else {
+            printf "  %8s  %-4s %s\n", "", "?", (f in label) ? label[f] : f
+            break
+        }
+        f = next_on_path[f]
+    }
+}
+
+# Deepest function of those whose name matches a regex, and the matches
+function deepest(regex, list,    f, n, best)
+{
+    n = 0
+    best = ""
+    if (regex == "") {
+        return ""
+    }
+    for (f in frame) {
+        if (label[f] ~ regex) {
+            list[++n] = f
+            if (best == "" || depth(f) > depth(best)) {
+                best = f
+            }
+        }
+    }
+    list[0] = n
+    return best
+}
+
+/^node: / {
+    f = quoted($0, "title")
+    split(quoted($0, "label"), parts, /\\n/)
+    # gcc names some C functions by a bit of their declaration
+    if (parts[1] !~ /[A-Za-z_]/) {
+        parts[1] = f
+    }
+    if (!(f in label)) {
+        label[f] = parts[1]
+    }
+    # inline functions and templates are defined in every object that
+    # uses them; the largest frame counts, and a definition names the
+    # function as its own language does
+    if (match(parts[3], /^[0-9]+ bytes/)) {
+        label[f] = parts[1]
+        size = substr(parts[3], 1, RLENGTH - 6) + 0
+        if (!(f in frame) || size > frame[f]) {
+            frame[f] = size
+        }
+        if (parts[3] ~ /dynamic/) {
+            dynamic[f] = 1
+        }
+    }
+    next
+}
+
+/^edge: / {
+    from = quoted($0, "sourcename")
+    to = quoted($0, "targetname")
+    if (!((from, to) in called)) {
+        called[from, to] = 1
+        calls[from, nb_calls[from]++] = to
+    }
+}
+
+END {
+    nb_tasks = split(tasks, task_specs, " ")
+    for (t = 1; t <= nb_tasks; t++) {
+        split(task_specs[t], spec, ";")
+        dispatcher = deepest(spec[2], unused)
+        root = deepest(spec[3], roots)
+        if (root == "") {
+            print "no root of " spec[1] " in the objects" > "/dev/stderr"
+            status = 1
+            continue
+        }
+
+        total = depth(root) + (dispatcher != "" ? depth(dispatcher) : 0)
+        printf "%-8s %6d bytes\n", spec[1], total
+        if (dispatcher != "") {
+            print_path(dispatcher)
+            printf "  %8s  %-4s %s\n", "", "*", "then"
+        }
+        print_path(root)
+
+        # roots, deepest first
+        printf "  roots\n"
+        for (i = 1; i <= roots[0]; i++) {
+            for (j = i + 1; j <= roots[0]; j++) {
+                if (depth(roots[j]) > depth(roots[i])) {
+                    f = roots[i]
+                    roots[i] = roots[j]
+                    roots[j] = f
+                }
+            }
+            printf "  %8d  %s\n", depth(roots[i]), label[roots[i]]
+        }
+        print ""
+    }
+    exit status
+}
@@ -0,0 +1,199 @@
+/**
+ * @file tlv_main.cpp
+ *
+ * @brief Encoding and decoding of the aggregated uplink records
+ *
+ * Checks lorawan_tlv.h against the framing it describes: the size and the
+ * bytes of records with a value in the header byte and with the extended
+ * length byte, the records it refuses, packs of random records decoded
+ * back in order, and truncated packs reported malformed. Exits non-zero if
+ * a check fails.
+ *
+ *   lorawan_tlv [-r runs] [-S seed]
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lorawan/system/lorawan_tlv.h"
+
+static uint32_t failures = 0;
+
+#define TLV_CHECK(cond)                                                     \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static uint8_t value[255];
+
+static void check_sizes()
+{
+    TLV_CHECK(lorawan_tlv_encoded_size(0) == 2);
+    TLV_CHECK(lorawan_tlv_encoded_size(1) == 2);
+    TLV_CHECK(lorawan_tlv_encoded_size(LORAWAN_TLV_MAX_SHORT_LENGTH) == 16);
+    TLV_CHECK(lorawan_tlv_encoded_size(LORAWAN_TLV_MAX_SHORT_LENGTH + 1) == 18);
+    TLV_CHECK(lorawan_tlv_encoded_size(255) == 257);
+}
+
+/**
+ * Encodes a single record and checks its bytes and what decodes from them
+ */
+static void check_record(uint8_t tag, uint8_t length)
+{
+    uint8_t buffer[300];
+    uint16_t offset = 0;
+    bool extended = length == 0 || length > LORAWAN_TLV_MAX_SHORT_LENGTH;
+    uint16_t header = extended ? 2 : 1;
+
+    memset(buffer, 0xEE, sizeof(buffer));
+    TLV_CHECK(lorawan_tlv_encode(buffer, sizeof(buffer), &offset, tag, value, length));
+    TLV_CHECK(offset == lorawan_tlv_encoded_size(length));
+    TLV_CHECK(offset == header + length);
+
+    if (extended) {
+        TLV_CHECK(buffer[0] == tag << 4);
+        TLV_CHECK(buffer[1] == length);
+    } else {
+        TLV_CHECK(buffer[0] == ((tag << 4) | length));
+    }
+    TLV_CHECK(memcmp(&buffer[header], value, length) == 0);
+    TLV_CHECK(buffer[offset] == 0xEE);
+
+    lorawan_tlv_record_t record;
+    uint16_t pos = 0;
+    TLV_CHECK(lorawan_tlv_decode(buffer, offset, &pos, &record) == 1);
+    TLV_CHECK(record.tag == tag);
+    TLV_CHECK(record.length == length);
+    TLV_CHECK(record.value == &buffer[header]);
+    TLV_CHECK(pos == offset);
+    TLV_CHECK(lorawan_tlv_decode(buffer, offset, &pos, &record) == 0);
+
+    // cut anywhere, the record is malformed
+    for (uint16_t size = 1; size < offset; size++) {
+        pos = 0;
+        TLV_CHECK(lorawan_tlv_decode(buffer, size, &pos, &record) == -1);
+        TLV_CHECK(pos == 0);
+    }
+}
+
+static void check_refused()
+{
+    uint8_t buffer[20];
+    uint16_t offset = 0;
+
+    TLV_CHECK(!lorawan_tlv_encode(buffer, sizeof(buffer), &offset, LORAWAN_TLV_MAX_TAG + 1,
+                                  value, 1));
+    TLV_CHECK(offset == 0);
+
+    // 16 bytes take the length byte and no longer fit
+    TLV_CHECK(!lorawan_tlv_encode(buffer, 17, &offset, 1, value, 16));
+    TLV_CHECK(lorawan_tlv_encode(buffer, 18, &offset, 1, value, 16));
+    TLV_CHECK(offset == 18);
+
+    // a pack filled to the last byte
+    offset = 0;
+    TLV_CHECK(lorawan_tlv_encode(buffer, sizeof(buffer), &offset, 2, value, 15));
+    TLV_CHECK(!lorawan_tlv_encode(buffer, sizeof(buffer), &offset, 3, value, 4));
+    TLV_CHECK(offset == 16);
+    TLV_CHECK(lorawan_tlv_encode(buffer, sizeof(buffer), &offset, 3, value, 3));
+    TLV_CHECK(offset == sizeof(buffer));
+    TLV_CHECK(!lorawan_tlv_encode(buffer, sizeof(buffer), &offset, 4, value, 0));
+}
+
+/**
+ * Packs random records until the buffer is full, then decodes them back
+ */
+static void check_pack()
+{
+    uint8_t buffer[242];
+    uint8_t tags[242];
+    uint8_t lengths[242];
+    const uint8_t *values[242];
+    uint16_t nb_records = 0;
+    uint16_t offset = 0;
+
+    for (;;) {
+        uint8_t tag = rand() % (LORAWAN_TLV_MAX_TAG + 1);
+        // mostly short readings, a long one now and then
+        uint8_t length = rand() % 8 ? rand() % 9 : rand() % 64;
+        uint16_t start = offset;
+
+        if (!lorawan_tlv_encode(buffer, sizeof(buffer), &offset, tag, value + nb_records % 64,
+                                length)) {
+            TLV_CHECK(offset == start);
+            TLV_CHECK(start + lorawan_tlv_encoded_size(length) > sizeof(buffer));
+            break;
+        }
+        tags[nb_records] = tag;
+        lengths[nb_records] = length;
+        values[nb_records] = value + nb_records % 64;
+        nb_records++;
+    }
+
+    lorawan_tlv_record_t record;
+    uint16_t pos = 0;
+    for (uint16_t i = 0; i < nb_records; i++) {
+        if (lorawan_tlv_decode(buffer, offset, &pos, &record) != 1) {
+            printf("  record %u of %u not decoded\n", i, nb_records);
+            failures++;
+            return;
+        }
+        TLV_CHECK(record.tag == tags[i]);
+        TLV_CHECK(record.length == lengths[i]);
+        TLV_CHECK(memcmp(record.value, values[i], lengths[i]) == 0);
+    }
+    TLV_CHECK(pos == offset);
+    TLV_CHECK(lorawan_tlv_decode(buffer, offset, &pos, &record) == 0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t nb_runs = 1000;
+    unsigned int seed = 1;
+    int option;
+
+    while ((option = getopt(argc, argv, "r:S:")) != -1) {
+        switch (option) {
+            case 'r':
+                nb_runs = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r runs] [-S seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    srand(seed);
+    for (uint16_t i = 0; i < sizeof(value); i++) {
+        value[i] = rand();
+    }
+
+    check_sizes();
+
+    for (uint8_t tag = 0; tag <= LORAWAN_TLV_MAX_TAG; tag++) {
+        for (uint16_t length = 0; length <= 255; length++) {
+            check_record(tag, length);
+        }
+    }
+
+    check_refused();
+
+    for (uint32_t i = 0; i < nb_runs; i++) {
+        check_pack();
+    }
+
+    printf("%lu packs of random records, %lu failed\n", (unsigned long) nb_runs,
+           (unsigned long) failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file tlv_unpack.cpp
+ *
+ * @brief Unpacker of aggregated uplinks for the network backend
+ *
+ * Splits the FRMPayload of uplinks sent with add_record() back into their
+ * records, with the decoder of lorawan_tlv.h the device packs them with.
+ * Each payload is given in hex, or in base64 as network servers deliver it
+ * with -b, on the command line or one a line on the standard input. Prints a
+ * line a record:
+ *
+ *   <payload> <tag> <length> <value in hex>
+ *
+ * the payload being counted from 0. A payload which is not valid hex or
+ * base64, or whose records are malformed, is reported on the standard error
+ * with the records before the fault printed; the exit status is then 1.
+ *
+ *   lorawan_unpack [-b] [payload ...]
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "lorawan/system/lorawan_tlv.h"
+
+// larger than any FRMPayload
+#define MAX_PAYLOAD     256
+
+static bool base64 = false;
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static int base64_digit(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    if (c == '+' || c == '-') {
+        return 62;
+    }
+    if (c == '/' || c == '_') {
+        return 63;
+    }
+    return -1;
+}
+
+/**
+ * Decodes the text of a payload, -1 if it is not valid or too long
+ */
+static int parse(const char *text, uint8_t *payload)
+{
+    int size = 0;
+
+    if (base64) {
+        uint32_t bits = 0;
+        int nb_bits = 0;
+
+        for (; *text && *text != '='; text++) {
+            int digit = base64_digit(*text);
+            if (digit < 0) {
+                return -1;
+            }
+            bits = (bits << 6) | digit;
+            nb_bits += 6;
+            if (nb_bits >= 8) {
+                nb_bits -= 8;
+                if (size == MAX_PAYLOAD) {
+                    return -1;
+                }
+                payload[size++] = bits >> nb_bits;
+            }
+        }
+        // what is left is padding, of at most two characters
+        while (*text == '=') {
+            text++;
+        }
+        return *text == 0 && nb_bits < 6 ? size : -1;
+    }
+
+    for (; text[0]; text += 2) {
+        int high = hex_digit(text[0]);
+        int low = text[1] ? hex_digit(text[1]) : -1;
+        if (high < 0 || low < 0 || size == MAX_PAYLOAD) {
+            return -1;
+        }
+        payload[size++] = (high << 4) | low;
+    }
+
+    return size;
+}
+
+static bool unpack(unsigned long index, const char *text)
+{
+    uint8_t payload[MAX_PAYLOAD];
+    int size = parse(text, payload);
+
+    if (size < 0) {
+        fprintf(stderr, "payload %lu: not %s: %s\n", index, base64 ? "base64" : "hex", text);
+        return false;
+    }
+
+    lorawan_tlv_record_t record;
+    uint16_t offset = 0;
+    int ret;
+
+    while ((ret = lorawan_tlv_decode(payload, size, &offset, &record)) == 1) {
+        printf("%lu %u %u ", index, record.tag, record.length);
+        for (uint8_t i = 0; i < record.length; i++) {
+            printf("%02x", record.value[i]);
+        }
+        printf("\n");
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "payload %lu: malformed record at byte %u\n", index, offset);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long index = 0;
+    bool passed = true;
+    int option;
+
+    while ((option = getopt(argc, argv, "b")) != -1) {
+        switch (option) {
+            case 'b':
+                base64 = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b] [payload ...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            passed = unpack(index++, argv[i]) && passed;
+        }
+        return passed ? 0 : 1;
+    }
+
+    char line[4 * MAX_PAYLOAD];
+    while (fgets(line, sizeof(line), stdin)) {
+        size_t length = strlen(line);
+        while (length > 0 && isspace((unsigned char) line[length - 1])) {
+            line[--length] = 0;
+        }
+        passed = unpack(index++, line) && passed;
+    }
+
+    return passed ? 0 : 1;
+}
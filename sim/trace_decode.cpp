@@ -0,0 +1,204 @@
+/**
+ * @file trace_decode.cpp
+ *
+ * @brief Decoder of the binary trace ring
+ *
+ * Turns the words drained from platform/trace_ring.h back into text, with
+ * the format strings of the image that wrote them: its TRACE_RING_SECTION
+ * section, extracted with objcopy.
+ *
+ *   lorawan_trace [-r ticks per second] table capture
+ *
+ * The capture is the words as read from the ring, little-endian. Words
+ * which are not a record header are skipped, so a capture may start in the
+ * middle of a record. Timestamps are printed as they are, or in seconds if
+ * the rate of the clock is given.
+ *
+ * Copyright (c) 2017, Arm Limited and affiliates.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "platform/trace_ring.h"
+
+static const char *level_names[] = { "", "ERR", "INF", "DBG" };
+
+static uint8_t *read_file(const char *path, size_t &size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // terminated, the last format string may be cut
+    uint8_t *data = static_cast<uint8_t *>(malloc(size + 1));
+    if (data && fread(data, 1, size, file) != size) {
+        free(data);
+        data = NULL;
+    }
+    if (data) {
+        data[size] = 0;
+    }
+
+    fclose(file);
+
+    return data;
+}
+
+/**
+ * Prints a format with its arguments, each a word
+ */
+static void print_message(const char *format, const uint32_t *args, uint8_t nargs)
+{
+    uint8_t next = 0;
+
+    while (*format) {
+        if (*format != '%') {
+            putchar(*format++);
+            continue;
+        }
+
+        if (format[1] == '%') {
+            putchar('%');
+            format += 2;
+            continue;
+        }
+
+        // flags, width and precision are kept, the length is not: every
+        // argument is a word
+        char spec[16];
+        size_t len = 0;
+        spec[len++] = *format++;
+        while (*format && strchr("-+ #0123456789.", *format) && len < sizeof(spec) - 3) {
+            spec[len++] = *format++;
+        }
+        while (*format && strchr("hlLjzt", *format)) {
+            format++;
+        }
+
+        char conversion = *format ? *format++ : 'x';
+        uint32_t arg = next < nargs ? args[next] : 0;
+        next++;
+
+        switch (conversion) {
+            case 'd':
+            case 'i':
+                spec[len++] = 'd';
+                spec[len] = 0;
+                printf(spec, (int32_t) arg);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            case 'c':
+                spec[len++] = conversion;
+                spec[len] = 0;
+                printf(spec, arg);
+                break;
+            default:
+                // %s and %p: the address is all there is
+                printf("0x%08lx", (unsigned long) arg);
+                break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double rate = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "r:")) != -1) {
+        switch (option) {
+            case 'r':
+                rate = strtod(optarg, NULL);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r ticks per second] table capture\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "usage: %s [-r ticks per second] table capture\n", argv[0]);
+        return 2;
+    }
+
+    size_t table_size, capture_size;
+    uint8_t *table = read_file(argv[optind], table_size);
+    uint8_t *capture = read_file(argv[optind + 1], capture_size);
+
+    if (!table || !capture) {
+        fprintf(stderr, "cannot read %s\n", !table ? argv[optind] : argv[optind + 1]);
+        return 1;
+    }
+
+    size_t nb_words = capture_size / 4;
+    uint32_t *words = static_cast<uint32_t *>(malloc(nb_words * sizeof(uint32_t) + 1));
+    for (size_t i = 0; i < nb_words; i++) {
+        const uint8_t *word = &capture[i * 4];
+        words[i] = word[0] | (word[1] << 8) | (word[2] << 16) | ((uint32_t) word[3] << 24);
+    }
+
+    uint32_t skipped = 0;
+
+    for (size_t i = 0; i < nb_words;) {
+        uint32_t header = words[i];
+        uint32_t id = TRACE_RING_HEADER_ID(header);
+        uint8_t nargs = TRACE_RING_HEADER_NARGS(header);
+
+        if (!TRACE_RING_HEADER_VALID(header) || nargs > TRACE_RING_MAX_ARGS
+                || (id != TRACE_RING_ID_DROPPED && id >= table_size)
+                || i + 2 + nargs > nb_words) {
+            skipped++;
+            i++;
+            continue;
+        }
+
+        uint32_t timestamp = words[i + 1];
+        const uint32_t *args = &words[i + 2];
+        i += 2 + nargs;
+
+        if (rate > 0) {
+            printf("[%12.6f] ", timestamp / rate);
+        } else {
+            printf("[%10lu] ", (unsigned long) timestamp);
+        }
+        printf("%s ", level_names[TRACE_RING_HEADER_LEVEL(header)]);
+
+        if (id == TRACE_RING_ID_DROPPED) {
+            printf("%lu records dropped\n", (unsigned long) args[0]);
+            continue;
+        }
+
+        // location, then the format
+        const char *location = reinterpret_cast<const char *>(&table[id]);
+        const char *format = strchr(location, '\x1f');
+        if (!format) {
+            printf("%s\n", location);
+            continue;
+        }
+
+        printf("%.*s: ", (int)(format - location), location);
+        print_message(format + 1, args, nargs);
+        putchar('\n');
+    }
+
+    if (skipped) {
+        fprintf(stderr, "%lu words skipped\n", (unsigned long) skipped);
+    }
+
+    free(words);
+    free(capture);
+    free(table);
+
+    return 0;
+}
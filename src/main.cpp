@@ -29,6 +29,8 @@
 #include "../events/EventQueue.h"
 
 // Application helpers
+#include "platform/profile.h"
+#include "platform/stack_watch.h"
 #include "trace.h"
 #include "../lora_radio_helper.h"
 
@@ -51,6 +53,40 @@ using namespace events;
 #define  RADIO_TASK_PRIO                    1u
 #define  RADIO_TASK_STK_SIZE               1024u
 
+/*
+ * Drains the binary trace ring to the SWO, below every other task
+ */
+#define  TRACE_TASK_PRIO                    3u
+#define  TRACE_TASK_STK_SIZE               256u
+
+/*
+ * ITM stimulus port of the binary traces, port 0 carries printf
+ */
+#define  TRACE_ITM_PORT                     1u
+
+/*
+ * Reads of a full ITM FIFO before the trace task gives up the CPU for a tick, and ticks it waits
+ * before it drops the rest of the record, the SWO being stalled or not captured
+ */
+#define  TRACE_ITM_SPIN                    64u
+#define  TRACE_ITM_TICKS                    8u
+
+/*
+ * Drains the console ring of printf to the SWO, below the trace task
+ */
+#define  CONSOLE_TASK_PRIO                  4u
+#define  CONSOLE_TASK_STK_SIZE             256u
+
+/*
+ * The stacks of the tasks the start task creates are painted for their high-water marks, not cleared;
+ * the check of the kernel, which counts zeroed words as free, is left to stack_watch
+ */
+#if STACK_WATCH_ENABLED
+#define  APP_TASK_STK_OPT                  (OS_OPT_NONE)
+#else
+#define  APP_TASK_STK_OPT                  (OS_OPT_TASK_STK_CLR)
+#endif
+
 
 /*
  * Sets up an application dependent transmission timer in ms. Used only when Duty Cycling is off for testing
@@ -93,6 +129,18 @@ static  CPU_STK  RadioTaskStk[RADIO_TASK_STK_SIZE];
 
 static  OS_TCB   RadioTaskTCB;                                  /* Radio Task TCB.                                      */
 
+#if TR_BINARY
+static  CPU_STK  TraceTaskStk[TRACE_TASK_STK_SIZE];
+
+static  OS_TCB   TraceTaskTCB;                                  /* Trace Task TCB.                                      */
+#endif
+
+#if RETARGET_BUFFERED
+static  CPU_STK  ConsoleTaskStk[CONSOLE_TASK_STK_SIZE];
+
+static  OS_TCB   ConsoleTaskTCB;                                /* Console Task TCB.                                    */
+#endif
+
 /* Counts 1ms timeTicks */
 volatile uint32_t msTicks = 0;
 
@@ -101,9 +149,9 @@ static OS_SEM    App_SemRadio;
 
 // Max payload size can be LORAMAC_PHY_MAXPAYLOAD.
 // This example only communicates with much shorter messages (<256 bytes).
-// If longer messages are used, these buffers must be changed accordingly.
+// If longer messages are used, this buffer must be changed accordingly.
+// Received messages are read directly out of the stack, see receive_message().
 uint8_t tx_buffer[256];
-uint8_t rx_buffer[256];
 
 /*
 ********************************************************************************************************
@@ -132,6 +180,14 @@ static  void  LoRaTask (void  *p_arg);
 
 static  void  RadioTask (void  *p_arg);
 
+#if TR_BINARY
+static  void  TraceTask (void  *p_arg);
+#endif
+
+#if RETARGET_BUFFERED
+static  void  ConsoleTask (void  *p_arg);
+#endif
+
 
 /**
 * This event queue is the global event queue for both the
@@ -140,7 +196,12 @@ static  void  RadioTask (void  *p_arg);
 * providing an event queue to the stack that will be used for ISR deferment as
 * well as application information event queuing.
 */
+#if MBED_CONF_EVENTS_STATIC_MEMORY
+static unsigned char ev_queue_buffer[MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE];
+static EventQueue ev_queue(sizeof(ev_queue_buffer), ev_queue_buffer);
+#else
 static EventQueue ev_queue(MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE);
+#endif
 
 /**
  * Event handler.
@@ -150,6 +211,8 @@ static EventQueue ev_queue(MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE);
  */
 static void lora_event_handler(lorawan_event_t event);
 
+static void receive_message(const lorawan_rx_frame_t &frame);
+
 /**
  * Application specific callbacks
  */
@@ -238,6 +301,7 @@ static void LoRaTask (void  *p_arg)
 
         // prepare application callbacks
         callbacks.events = mbed::callback(lora_event_handler);
+        callbacks.rx_frame = mbed::callback(receive_message);
         p_lorawan->add_app_callbacks(&callbacks);
 
         // Set number of retries in case of CONFIRMED messages
@@ -289,48 +353,38 @@ static void send_message()
 
     printf("\n Send_data = %s \n", tx_buffer);
 
-    retcode = p_lorawan->send(MBED_CONF_LORA_APP_PORT, tx_buffer, packet_len,
-                           MSG_UNCONFIRMED_FLAG);
+    // The stack sends queued messages as soon as the radio and duty cycle
+    // allow, no need to retry on our side
+    retcode = p_lorawan->queue_send(MBED_CONF_LORA_APP_PORT, tx_buffer, packet_len,
+                                    MSG_UNCONFIRMED_FLAG, 0, 0);
 
     if (retcode < 0) {
-        retcode == LORAWAN_STATUS_WOULD_BLOCK ? printf("send - WOULD BLOCK\r\n")
-        : printf("\r\n send() - Error code %d \r\n", retcode);
-
-        if (retcode == LORAWAN_STATUS_WOULD_BLOCK) {
-            //retry in 3 seconds
-            if (MBED_CONF_LORA_DUTY_CYCLE_ON) {
-                ev_queue.call_in(3000, send_message);
-            }
-        }
+        retcode == LORAWAN_STATUS_WOULD_BLOCK ? printf("send - QUEUE FULL\r\n")
+        : printf("\r\n queue_send() - Error code %d \r\n", retcode);
         return;
     }
 
-    printf("\r\n %d bytes scheduled for transmission \r\n", retcode);
+    printf("\r\n Message #%d queued for transmission (%d bytes) \r\n", retcode, packet_len);
     memset(tx_buffer, 0, sizeof(tx_buffer));
 }
 
 /**
  * Receive a message from the Network Server
+ *
+ * The payload is a view into the stack's RX frame ring, it must be
+ * released to free up the slot for further downlinks.
  */
-static void receive_message()
+static void receive_message(const lorawan_rx_frame_t &frame)
 {
-    uint8_t port;
-    int flags;
-
-    int16_t retcode = p_lorawan->receive(rx_buffer, sizeof(rx_buffer), port, flags);
-
-    if (retcode < 0) {
-        printf("\r\n receive() - Error code %d \r\n", retcode);
-        return;
-    }
+    printf("\r\n Received message from Network Server \r\n");
 
-    printf(" RX Data on port %u (%d bytes): ", port, retcode);
+    printf(" RX Data on port %u (%d bytes): ", frame.port, frame.size);
 
-    printf("\n Received_data = %s \n", rx_buffer);
+    printf("\n Received_data = %.*s \n", frame.size, (const char *) frame.buffer);
 
     printf("\r\n");
 
-    memset(rx_buffer, 0, sizeof(rx_buffer));
+    p_lorawan->release_rx_frame(frame);
 }
 
 /**
@@ -367,6 +421,13 @@ static void lora_event_handler(lorawan_event_t event)
             break;
         case TX_DONE:
             printf("\r\n Message Sent to Network Server \r\n");
+#if PROFILE_ENABLED
+            // the receive windows are over, the zones hold the whole exchange
+            profile_dump();
+#endif
+#if STACK_WATCH_ENABLED
+            stack_watch_dump();
+#endif
             if (MBED_CONF_LORA_DUTY_CYCLE_ON) {
             	Delay(2);
                 send_message();
@@ -383,8 +444,7 @@ static void lora_event_handler(lorawan_event_t event)
             }
             break;
         case RX_DONE:
-            printf("\r\n Received message from Network Server \r\n");
-            receive_message();
+            // Not posted as payloads are delivered through receive_message()
             break;
         case RX_TIMEOUT:
         case RX_ERROR:
@@ -439,6 +499,107 @@ static  void  RadioTask (void  *p_arg)
     }
 }
 
+#if TR_BINARY
+/*
+*********************************************************************************************************
+*                                          TraceTask()
+*
+* Description : This task drains the binary trace ring to ITM stimulus port TRACE_ITM_PORT, a word at a
+*               time. The records are timestamped in core cycles.
+*
+* Argument(s) : p_arg   Argument passed from task creation. Unused, in this case.
+*
+* Return(s)   : None.
+*
+* Notes       : Decode the capture of the port with sim/lorawan_trace and the lorawan_trace section of
+*               the image, -r giving the core clock. A record the FIFO does not take within
+*               TRACE_ITM_TICKS is cut short; the decoder skips what is left of it.
+*********************************************************************************************************
+*/
+static uint32_t trace_cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+static bool trace_itm_ready(void)
+{
+    RTOS_ERR  err;
+
+    for (uint32_t tick = 0; tick <= TRACE_ITM_TICKS; tick++) {
+        for (uint32_t spin = 0; spin < TRACE_ITM_SPIN; spin++) {
+            if (ITM->PORT[TRACE_ITM_PORT].u32 != 0) {
+                return true;
+            }
+        }
+        if (tick < TRACE_ITM_TICKS) {
+            OSTimeDly(1, OS_OPT_TIME_DLY, &err);
+        }
+    }
+
+    return false;
+}
+
+static  void  TraceTask (void  *p_arg)
+{
+    RTOS_ERR  err;
+    uint32_t  words[TRACE_RING_MAX_ARGS + 2];
+
+    PP_UNUSED_PARAM(p_arg);                                     /* Prevent compiler warning.                            */
+
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    ITM->TER  |= (1u << TRACE_ITM_PORT);
+
+    trace_ring_set_clock(trace_cycles);
+    trace_ring_set_enabled(true);
+
+    while (1) {
+        uint32_t count = trace_ring_read(words, TRACE_RING_MAX_ARGS + 2);
+
+        if (count == 0) {
+            OSTimeDly(10, OS_OPT_TIME_DLY, &err);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (!trace_itm_ready()) {
+                break;                                          /* The decoder skips to the next header.                */
+            }
+            ITM->PORT[TRACE_ITM_PORT].u32 = words[i];
+        }
+    }
+}
+#endif
+
+#if RETARGET_BUFFERED
+/*
+*********************************************************************************************************
+*                                          ConsoleTask()
+*
+* Description : This task drains the console ring that printf writes to, to the SWO, so that printf
+*               returns as soon as its text is copied.
+*
+* Argument(s) : p_arg   Argument passed from task creation. Unused, in this case.
+*
+* Return(s)   : None.
+*
+* Notes       : Text that does not fit in the ring is dropped, and a line of the console tells how much;
+*               raise CONSOLE_RING_SIZE if it shows up.
+*********************************************************************************************************
+*/
+static  void  ConsoleTask (void  *p_arg)
+{
+    RTOS_ERR  err;
+
+    PP_UNUSED_PARAM(p_arg);                                     /* Prevent compiler warning.                            */
+
+    while (1) {
+        if (RETARGET_Drain() == 0) {
+            OSTimeDly(10, OS_OPT_TIME_DLY, &err);
+        }
+    }
+}
+#endif
+
 /*
  *****************************************************************************
  *                         gpioCallback(uint8_t )
@@ -522,6 +683,14 @@ int  main (void)
     /* Configures the SWO to output both printf-information, PC-samples and interrupt trace. */
     setupSWOForPrint();
 
+#if MBED_CONF_LORA_STATIC_MEMORY
+    setvbuf(stdout, NULL, _IONBF, 0);                           /* Newlib would allocate the stdout buffer.             */
+#endif
+
+#if PROFILE_ENABLED
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;                        /* Profiler zones count core cycles.                    */
+#endif
+
     BSP_SystemInit();                                           /* Initialize System.                                   */
     CPU_Init();                                                 /* Initialize CPU.                                      */
 
@@ -593,6 +762,9 @@ static  void  MainStartTask (void  *p_arg)
                                                                 /* ... will register all the hardware controller to ... */
                                                                 /* ... the platform manager at this moment.             */
 
+#if STACK_WATCH_ENABLED
+    stack_watch_add("LoRa Task", LoRaTaskStk, sizeof(LoRaTaskStk));
+#endif
     OSTaskCreate(&LoRaTaskTCB,                                /* Create the LoRa Task.                               */
                      "LoRa Task",
                       LoRaTask,
@@ -604,7 +776,7 @@ static  void  MainStartTask (void  *p_arg)
                       0u,
                       0u,
                       DEF_NULL,
-                     (OS_OPT_TASK_STK_CLR),
+                     APP_TASK_STK_OPT,
                      &err);
                                                                     /*   Check error code.                                  */
     APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(err) == RTOS_ERR_NONE), 1);
@@ -614,6 +786,9 @@ static  void  MainStartTask (void  *p_arg)
            DEBUG_BREAK;
      }
 
+#if STACK_WATCH_ENABLED
+    stack_watch_add("Radio Task", RadioTaskStk, sizeof(RadioTaskStk));
+#endif
     OSTaskCreate(&RadioTaskTCB,                          /* Create the Radio Task.                               */
                  "Radio Task",
                   RadioTask,
@@ -625,10 +800,52 @@ static  void  MainStartTask (void  *p_arg)
                   0u,
                   0u,
                   DEF_NULL,
-                 (OS_OPT_TASK_STK_CLR),
+                 APP_TASK_STK_OPT,
+                 &err);
+                                                                /*   Check error code.                                  */
+    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(err) == RTOS_ERR_NONE), 1);
+
+#if TR_BINARY
+#if STACK_WATCH_ENABLED
+    stack_watch_add("Trace Task", TraceTaskStk, sizeof(TraceTaskStk));
+#endif
+    OSTaskCreate(&TraceTaskTCB,                          /* Create the Trace Task.                               */
+                 "Trace Task",
+                  TraceTask,
+                  DEF_NULL,
+                  TRACE_TASK_PRIO,
+                 &TraceTaskStk[0],
+                 (TRACE_TASK_STK_SIZE / 10u),
+                  TRACE_TASK_STK_SIZE,
+                  0u,
+                  0u,
+                  DEF_NULL,
+                 APP_TASK_STK_OPT,
+                 &err);
+                                                                /*   Check error code.                                  */
+    APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(err) == RTOS_ERR_NONE), 1);
+#endif
+
+#if RETARGET_BUFFERED
+#if STACK_WATCH_ENABLED
+    stack_watch_add("Console Task", ConsoleTaskStk, sizeof(ConsoleTaskStk));
+#endif
+    OSTaskCreate(&ConsoleTaskTCB,                        /* Create the Console Task.                             */
+                 "Console Task",
+                  ConsoleTask,
+                  DEF_NULL,
+                  CONSOLE_TASK_PRIO,
+                 &ConsoleTaskStk[0],
+                 (CONSOLE_TASK_STK_SIZE / 10u),
+                  CONSOLE_TASK_STK_SIZE,
+                  0u,
+                  0u,
+                  DEF_NULL,
+                 APP_TASK_STK_OPT,
                  &err);
                                                                 /*   Check error code.                                  */
     APP_RTOS_ASSERT_DBG((RTOS_ERR_CODE_GET(err) == RTOS_ERR_NONE), 1);
+#endif
 
     while (DEF_ON) {
 
@@ -14,12 +14,48 @@
  ******************************************************************************/
 
 #include "em_cmu.h"
+#include "pg_retargetswo.h"
+#include "platform/console_ring.h"
 
 int RETARGET_WriteChar(char c)
 {
   return ITM_SendChar(c);
 }
 
+int RETARGET_Write(const char *ptr, int len)
+{
+#if RETARGET_BUFFERED
+  /* What does not fit is dropped and counted, it is not retried. */
+  console_ring_write(ptr, len);
+#else
+  int txCount;
+
+  for (txCount = 0; txCount < len; txCount++) {
+    ITM_SendChar(*ptr++);
+  }
+#endif
+
+  return len;
+}
+
+#if RETARGET_BUFFERED
+static size_t swoSink(const char *data, size_t size)
+{
+  size_t txCount;
+
+  for (txCount = 0; txCount < size; txCount++) {
+    ITM_SendChar(data[txCount]);
+  }
+
+  return size;
+}
+
+size_t RETARGET_Drain(void)
+{
+  return console_ring_drain(swoSink);
+}
+#endif
+
 int RETARGET_ReadChar(void)
 {
   return 0;
@@ -27,12 +27,27 @@
  * @{
  ******************************************************************************/
 
+#include <stddef.h>
+
+/**
+ * printf goes to the console ring of platform/console_ring.h, drained to the
+ * SWO by a low priority task with RETARGET_Drain(), rather than waiting on
+ * the SWO a character at a time
+ */
+#ifndef RETARGET_BUFFERED
+#define RETARGET_BUFFERED       1
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /* Regular functions */
 int RETARGET_WriteChar(char c);
+int RETARGET_Write(const char *ptr, int len);
+#if RETARGET_BUFFERED
+size_t RETARGET_Drain(void);
+#endif
 int RETARGET_ReadChar(void);
 void setupSWOForPrint(void);
 #ifdef __cplusplus
@@ -2,26 +2,47 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
+#ifndef TR_DEBUG
 #define   TR_DEBUG                  0
+#endif
+#ifndef TR_INFO
 #define   TR_INFO                   0
+#endif
+#ifndef TR_ERROR
 #define   TR_ERROR                  0
+#endif
 #define   __DEBUG                   1
 
+/*
+ * 1 writes the traces to the binary ring of platform/trace_ring.h instead of
+ * formatting them to stderr: a call site then costs a few dozen cycles and
+ * never waits on the output, see trace_ring_read()
+ */
+#ifndef TR_BINARY
+#define   TR_BINARY                 0
+#endif
+
+#if TR_BINARY
+  #include "platform/trace_ring.h"
+  #define tr_print( level, format, args... )   TRACE_RING_LOG( level, format, ##args )
+#else
+  #define tr_print( level, format, args... )   fprintf( stderr, "\n %s::%s(%d) \n" format, __FILE__, __FUNCTION__,  __LINE__, ##args )
+#endif
 
 #if TR_DEBUG
-  #define tr_debug( format, args... )   fprintf( stderr, "\n %s::%s(%d) \n" format, __FILE__, __FUNCTION__,  __LINE__, ##args )
+  #define tr_debug( format, args... )   tr_print( TRACE_RING_LEVEL_DEBUG, format, ##args )
 #else
   #define tr_debug( format, args... )   ((void)0)
 #endif
 
-#if TR_DEBUG
-  #define tr_info( format, args... )   fprintf( stderr, "\n %s::%s(%d) \n" format, __FILE__, __FUNCTION__,  __LINE__, ##args )
+#if TR_INFO
+  #define tr_info( format, args... )   tr_print( TRACE_RING_LEVEL_INFO, format, ##args )
 #else
   #define tr_info( format, args... )   ((void)0)
 #endif
 
 #if TR_ERROR
-  #define tr_error( format, args... )   fprintf( stderr, "\n %s::%s(%d) \n" format, __FILE__, __FUNCTION__,  __LINE__, ##args )
+  #define tr_error( format, args... )   tr_print( TRACE_RING_LEVEL_ERROR, format, ##args )
 #else
   #define tr_error( format, args... )   ((void)0)
 #endif
@@ -34,7 +55,7 @@
 #define MBED_ASSERT(expression)  \
  ((void)((expression) ? 0 : (__myassert (#expression, __FILE__, __LINE__), 0)))
 
-static void
+static inline void
 __assfail(const char *format,...)
 {
    va_list arg;